@@ -0,0 +1,45 @@
+TARGET=gnatvClothBatch
+CONFIG+=c++17 console
+CONFIG-=app_bundle
+
+# vertex normals are computed in parallel with OpenMP
+linux:QMAKE_CXXFLAGS+= -fopenmp
+linux:LIBS+= -fopenmp
+
+# scoped phase timers (see Profiler.h), build with CONFIG+=profiling to record them
+profiling:DEFINES+= GNATV_PROFILING
+
+# simulation core only, no ui/rendering sources
+SOURCES+= main.cpp \
+          ../gnatvCloth/src/Cloth.cpp \
+          ../gnatvCloth/src/MassPoint.cpp \
+          ../gnatvCloth/src/Triangle.cpp \
+          ../gnatvCloth/src/ClothInterface.cpp \
+          ../gnatvCloth/src/MeshCache.cpp \
+          ../gnatvCloth/src/ObjSequenceWriter.cpp \
+          ../gnatvCloth/src/PointCache.cpp \
+          ../gnatvCloth/src/ClothRenderMesh.cpp \
+          ../gnatvCloth/src/SceneDescription.cpp \
+          ../gnatvCloth/src/ClothGrid.cpp \
+          ../gnatvCloth/src/Profiler.cpp \
+          ../gnatvCloth/src/SolverTelemetry.cpp \
+          ../gnatvCloth/src/WindField.cpp \
+          ../gnatvCloth/src/ForceField.cpp \
+          ../gnatvCloth/src/ClothEnsemble.cpp \
+          ../gnatvCloth/src/ForceDisplacementTest.cpp \
+          ../gnatvCloth/src/MaterialCalibration.cpp \
+          ../gnatvCloth/src/SelfCollision.cpp \
+          ../gnatvCloth/src/Obstacle.cpp \
+          ../gnatvCloth/src/ClothDrag.cpp
+
+INCLUDEPATH+= ../gnatvCloth/include
+
+OTHER_FILES+= scenes/hangLowResXZ.scene \
+              scenes/hangGrid256.scene \
+              scenes/sweepLowResXZ.scene
+
+# Following code written by Jon Macey
+include($$(HOME)/NGL/UseNGL.pri)
+
+# NGL is only needed for its maths types, so drop the Qt gui/OpenGL modules it asks for
+QT-= gui opengl
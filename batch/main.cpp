@@ -0,0 +1,187 @@
+/****************************************************************************
+headless batch runner, bakes a cloth scene without Qt/OpenGL
+usage: gnatvClothBatch [--trace trace_file] [--threads n] scene_file
+--trace writes the phase timings out as a Chrome trace (CONFIG+=profiling builds)
+--threads sets the thread pool size for scenes with sweeps (default: one per core)
+scenes with sweeps run every case with ClothEnsemble and print a summary table
+****************************************************************************/
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+#include "ClothEnsemble.h"
+#include "ClothInterface.h"
+#include "Profiler.h"
+#include "SceneDescription.h"
+
+namespace
+{
+    /**
+     * @brief writes the phase timings out, if a trace file was asked for
+    */
+    void writeTrace(const std::string &_traceFile)
+    {
+        if(_traceFile.empty())
+        {
+            return;
+        }
+#if !defined(GNATV_PROFILING)
+        std::cerr << "warning: built without CONFIG+=profiling, the trace will be empty\n";
+#endif
+        if(!Profiler::instance().writeChromeTrace(_traceFile))
+        {
+            std::cerr << "can't write trace " << _traceFile << '\n';
+        }
+    }
+
+    /**
+     * @brief runs every case of a sweep scene on a thread pool and prints the summary
+    */
+    int runSweep(const SceneDescription &_scene, size_t _numThreads)
+    {
+        if(!_scene.objSequenceDir.empty() || !_scene.pointCache.empty() || !_scene.telemetry.empty())
+        {
+            std::cerr << "warning: sweeps don't write obj sequences, point caches or telemetry\n";
+        }
+        auto cases = ClothEnsemble::casesFromScene(_scene);
+        std::cout << "sweep: " << cases.size() << " cases\n";
+        auto start = std::chrono::steady_clock::now();
+        ClothEnsemble ensemble(_scene);
+        auto results = ensemble.run(cases, _numThreads);
+        std::chrono::duration<double> wall = std::chrono::steady_clock::now() - start;
+        ClothEnsemble::printSummary(results, std::cout);
+        double serial = 0.0;
+        for(auto &r : results)
+        {
+            serial += r.seconds;
+        }
+        std::cout << "wall: " << wall.count() << " s, sum of runs: " << serial << " s, speedup "
+                  << serial / wall.count() << '\n';
+        return EXIT_SUCCESS;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::string sceneFile, traceFile;
+    size_t numThreads = 0;
+    bool badArgs = false;
+    for(int i = 1; i < argc && !badArgs; ++i)
+    {
+        std::string arg = argv[i];
+        if(arg == "--trace" && i + 1 < argc)
+        {
+            traceFile = argv[++i];
+        }
+        else if(arg == "--threads" && i + 1 < argc)
+        {
+            numThreads = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if(sceneFile.empty() && arg.rfind("--", 0) != 0)
+        {
+            sceneFile = arg;
+        }
+        else
+        {
+            badArgs = true;
+        }
+    }
+    if(badArgs || sceneFile.empty())
+    {
+        std::cerr << "usage: " << argv[0] << " [--trace trace_file] [--threads n] scene_file\n";
+        return EXIT_FAILURE;
+    }
+    // read in the scene
+    SceneDescription scene;
+    std::string error;
+    if(!scene.load(sceneFile, error))
+    {
+        std::cerr << error << '\n';
+        return EXIT_FAILURE;
+    }
+    if(scene.isSweep())
+    {
+        auto result = runSweep(scene, numThreads);
+        writeTrace(traceFile);
+        return result;
+    }
+    // set up the cloth and outputs
+    using clock = std::chrono::steady_clock;
+    auto setupStart = clock::now();
+    ClothInterface ci(scene);
+    std::chrono::duration<double> setupTime = clock::now() - setupStart;
+    std::cout << "cloth: " << ci.numClothPts() << " points, " << ci.numClothTris() << " triangles\n";
+    ci.printMemoryUsage(std::cout);
+    bool writeObjs = !scene.objSequenceDir.empty();
+    if(writeObjs)
+    {
+        ci.setWriteOutPath(scene.objSequenceDir, scene.objSequencePrefix);
+    }
+    if(!scene.pointCache.empty())
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(std::filesystem::path(scene.pointCache).parent_path(), ec);
+        if(!ci.startRecording(scene.pointCache))
+        {
+            std::cerr << "can't open point cache " << scene.pointCache << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+    if(!scene.telemetry.empty())
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(std::filesystem::path(scene.telemetry).parent_path(), ec);
+        if(!ci.startTelemetry(scene.telemetry, scene.telemetryBinary ? SolverTelemetry::BINARY : SolverTelemetry::CSV))
+        {
+            std::cerr << "can't open telemetry file " << scene.telemetry << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+    // run the sim, timing each step
+    std::vector<double> stepTimes;
+    stepTimes.reserve(scene.steps);
+    auto runStart = clock::now();
+    for(size_t i = 0; i < scene.steps; ++i)
+    {
+        if(writeObjs)
+        {
+            ci.writeOutCloth();
+        }
+        auto stepStart = clock::now();
+        ci.updateCloth(scene.dt);
+        stepTimes.push_back(std::chrono::duration<double, std::milli>(clock::now() - stepStart).count());
+    }
+    ci.stopWriteOut();
+    ci.stopRecording();
+    ci.stopTelemetry();
+    std::chrono::duration<double> runTime = clock::now() - runStart;
+    writeTrace(traceFile);
+    // timing summary
+    if(stepTimes.empty())
+    {
+        return EXIT_SUCCESS;
+    }
+    double total = 0.0;
+    for(auto t : stepTimes)
+    {
+        total += t;
+    }
+    auto sorted = stepTimes;
+    std::sort(sorted.begin(), sorted.end());
+    std::cout << "setup: " << setupTime.count() << " s\n";
+    std::cout << "steps: " << stepTimes.size() << " in " << runTime.count() << " s (including output)\n";
+    std::cout << "step ms: mean " << total / stepTimes.size()
+              << ", median " << sorted[sorted.size() / 2]
+              << ", min " << sorted.front()
+              << ", max " << sorted.back() << '\n';
+    std::cout << "sim/wall time: " << (scene.dt * stepTimes.size()) / runTime.count() << '\n';
+    if(ci.isJacobianReuseOn())
+    {
+        auto &reuse = ci.jacobianReuseStats();
+        std::cout << "jacobian reuse: " << reuse.reused << " steps reused, " << reuse.rebuilt
+                  << " rebuilt, ratio " << reuse.reuseRatio() << '\n';
+    }
+    return EXIT_SUCCESS;
+}
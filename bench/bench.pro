@@ -0,0 +1,31 @@
+TARGET=gnatvClothBench
+CONFIG+=c++17 console
+CONFIG-=app_bundle
+
+# vertex normals are computed in parallel with OpenMP
+linux:QMAKE_CXXFLAGS+= -fopenmp
+linux:LIBS+= -fopenmp
+
+# scoped phase timers (see Profiler.h), build with CONFIG+=profiling to record them
+profiling:DEFINES+= GNATV_PROFILING
+
+SOURCES+= main.cpp \
+          ../gnatvCloth/src/Cloth.cpp \
+          ../gnatvCloth/src/MassPoint.cpp \
+          ../gnatvCloth/src/Triangle.cpp \
+          ../gnatvCloth/src/MeshCache.cpp \
+          ../gnatvCloth/src/ClothGrid.cpp \
+          ../gnatvCloth/src/Profiler.cpp \
+          ../gnatvCloth/src/SolverTelemetry.cpp \
+          ../gnatvCloth/src/SelfCollision.cpp \
+          ../gnatvCloth/src/Obstacle.cpp \
+          ../gnatvCloth/src/WindField.cpp
+
+LIBS+= -lbenchmark -lpthread
+INCLUDEPATH+= ../gnatvCloth/include
+
+# Following code written by Jon Macey
+include($$(HOME)/NGL/UseNGL.pri)
+
+# NGL is only needed for its maths types, so drop the Qt gui/OpenGL modules it asks for
+QT-= gui opengl
@@ -0,0 +1,266 @@
+/****************************************************************************
+microbenchmarks for the cloth sim hot paths, built on google benchmark
+results are written out as JSON (with machine info) to bench_results.json
+unless --benchmark_out is given
+****************************************************************************/
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include "Cloth.h"
+#include "ClothGrid.h"
+#include "FixPtTestDefaults.h"
+
+/**
+ * @class ClothBenchAccess
+ * @brief friend of Cloth, gives the benchmarks the private solver steps
+*/
+class ClothBenchAccess
+{
+public:
+    static void readObj(Cloth &io_c, const std::string &_filename)
+    {
+        std::vector<Cloth::Triref> triangles;
+        io_c.readObj(_filename, triangles);
+    }
+    static void nullForces(Cloth &io_c) { io_c.nullForces(); }
+    static std::vector<ngl::Vec3> conjugateGradient(Cloth &io_c, float _h) { return io_c.conjugateGradient(_h, false, true); }
+    static std::vector<ngl::Vec3> jMatrixMultOp(Cloth &io_c, float _h, const std::vector<ngl::Vec3> &_vec)
+    {
+        return io_c.jMatrixMultOp(true, false, true, _h, _vec);
+    }
+    static void rk4Integrate(Cloth &io_c, float _h, const std::vector<ngl::Vec3> &_externalf)
+    {
+        io_c.rk4Integrate(_h, true, _externalf);
+    }
+    static void calcNormals(Cloth &io_c) { io_c.calcNormals(); }
+};
+
+namespace
+{
+    /**
+     * @brief a mesh to run the benchmarks over, either a shipped .obj or a generated grid
+    */
+    struct BenchMesh
+    {
+        std::string name;
+        std::string filename;
+        std::function<ngl::Vec2(ngl::Vec3)> toParam;
+        std::vector<size_t> corners;
+        std::shared_ptr<ClothGrid> grid;
+        bool large;
+    };
+
+    /**
+     * @brief the shipped meshes plus generated grids from 4k to 1M masspoints
+     *
+     * The largest grid only runs the benchmarks that don't build jacobians.
+    */
+    std::vector<BenchMesh> benchMeshes()
+    {
+        std::string objPath = "../gnatvCloth/obj/";
+        std::vector<BenchMesh> meshes = {
+            {"LowResXZ", objPath + "clothLowResXZ.obj", toParamXZ, lowResXZFixpts, nullptr, false},
+            {"HiResXZ", objPath + "clothHiResXZ.obj", toParamXZ, hiResFixpts, nullptr, false},
+            {"WeftTest", objPath + "weftTestCloth.obj", toParamXZ, wwsTestFixpts, nullptr, false},
+            {"WarpTest", objPath + "warpTestCloth.obj", toParamXZ, wwsTestFixpts, nullptr, false}
+        };
+        for(size_t n : {64, 128, 256, 1024})
+        {
+            auto name = "Grid" + std::to_string(n) + "x" + std::to_string(n);
+            auto grid = std::make_shared<ClothGrid>(n, n, PLANE_XZ);
+            meshes.push_back({name, "", grid->toParam(), grid->fixPoints(), grid, n > 256});
+        }
+        return meshes;
+    }
+
+    /**
+     * @brief sets up a wool cloth hanging from two corners
+    */
+    Cloth hangingCloth(const BenchMesh &_mesh)
+    {
+        Cloth c(WOOL);
+        if(_mesh.grid)
+        {
+            c.init(*_mesh.grid, _mesh.corners, 9.0f);
+        }
+        else
+        {
+            c.init(_mesh.filename, _mesh.toParam, _mesh.corners, 9.0f);
+        }
+        std::vector<bool> hang = {0, 0, 1, 1};
+        c.fixCorners(hang);
+        return c;
+    }
+
+    void setCounters(benchmark::State &io_state, const Cloth &_c)
+    {
+        io_state.counters["masspoints"] = _c.numMasses();
+        io_state.counters["triangles"] = _c.numTriangles();
+        io_state.counters["bytes/masspoint"] = _c.memoryUsage().bytesPerMasspoint();
+        io_state.counters["masspoints/s"] = benchmark::Counter(_c.numMasses(), benchmark::Counter::kIsIterationInvariantRate);
+    }
+
+    void BM_readObj(benchmark::State &io_state, BenchMesh _mesh)
+    {
+        Cloth c(WOOL);
+        for(auto _ : io_state)
+        {
+            c.clear();
+            ClothBenchAccess::readObj(c, _mesh.filename);
+        }
+        setCounters(io_state, c);
+    }
+
+    void BM_initGrid(benchmark::State &io_state, BenchMesh _mesh)
+    {
+        Cloth c(WOOL);
+        for(auto _ : io_state)
+        {
+            c.clear();
+            c.init(*_mesh.grid, _mesh.corners, 9.0f);
+        }
+        setCounters(io_state, c);
+    }
+
+    void BM_forceCalc(benchmark::State &io_state, BenchMesh _mesh, bool _calcJacobians)
+    {
+        auto c = hangingCloth(_mesh);
+        std::vector<ngl::Vec3> externalf(c.numMasses());
+        for(auto _ : io_state)
+        {
+            ClothBenchAccess::nullForces(c);
+            c.forceCalc(true, externalf, _calcJacobians);
+        }
+        setCounters(io_state, c);
+    }
+
+    void BM_conjugateGradient(benchmark::State &io_state, BenchMesh _mesh)
+    {
+        auto c = hangingCloth(_mesh);
+        std::vector<ngl::Vec3> externalf(c.numMasses());
+        for(auto _ : io_state)
+        {
+            // the solve scales the jacobians in place, so they're rebuilt (untimed) every time
+            io_state.PauseTiming();
+            ClothBenchAccess::nullForces(c);
+            c.forceCalc(true, externalf, true);
+            io_state.ResumeTiming();
+            benchmark::DoNotOptimize(ClothBenchAccess::conjugateGradient(c, 0.01f));
+        }
+        setCounters(io_state, c);
+    }
+
+    void BM_jMatrixMultOp(benchmark::State &io_state, BenchMesh _mesh)
+    {
+        auto c = hangingCloth(_mesh);
+        std::vector<ngl::Vec3> externalf(c.numMasses());
+        ClothBenchAccess::nullForces(c);
+        c.forceCalc(true, externalf, true);
+        std::vector<ngl::Vec3> vec(c.numMasses(), ngl::Vec3(1.0f, 1.0f, 1.0f));
+        for(auto _ : io_state)
+        {
+            benchmark::DoNotOptimize(ClothBenchAccess::jMatrixMultOp(c, 0.01f, vec));
+        }
+        setCounters(io_state, c);
+    }
+
+    void BM_rk4Integrate(benchmark::State &io_state, BenchMesh _mesh)
+    {
+        auto start = hangingCloth(_mesh);
+        auto c = start;
+        std::vector<ngl::Vec3> externalf(c.numMasses());
+        size_t steps = 0;
+        for(auto _ : io_state)
+        {
+            // start over every so often so the cloth never drifts far from the tested state
+            if(++steps % 100 == 0)
+            {
+                io_state.PauseTiming();
+                c = start;
+                io_state.ResumeTiming();
+            }
+            ClothBenchAccess::rk4Integrate(c, 0.001f, externalf);
+        }
+        setCounters(io_state, c);
+    }
+
+    void BM_calcNormals(benchmark::State &io_state, BenchMesh _mesh)
+    {
+        auto c = hangingCloth(_mesh);
+        for(auto _ : io_state)
+        {
+            ClothBenchAccess::calcNormals(c);
+        }
+        setCounters(io_state, c);
+    }
+
+    void BM_render(benchmark::State &io_state, BenchMesh _mesh)
+    {
+        auto c = hangingCloth(_mesh);
+        std::vector<float> vertexData;
+        for(auto _ : io_state)
+        {
+            // move a point so the normals are recomputed, as they would be after a step
+            c.setPosAtPoint(0, c.posAtPoint(0));
+            vertexData.clear();
+            c.render(vertexData);
+            benchmark::DoNotOptimize(vertexData.data());
+        }
+        setCounters(io_state, c);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    // default to JSON output so runs can be compared release to release
+    std::vector<char *> args(argv, argv + argc);
+    std::string out = "--benchmark_out=bench_results.json";
+    std::string format = "--benchmark_out_format=json";
+    bool hasOut = false;
+    for(int i = 1; i < argc; ++i)
+    {
+        hasOut |= std::string(argv[i]).rfind("--benchmark_out=", 0) == 0;
+    }
+    if(!hasOut)
+    {
+        args.push_back(&out[0]);
+        args.push_back(&format[0]);
+    }
+    int numArgs = static_cast<int>(args.size());
+    benchmark::Initialize(&numArgs, args.data());
+    // machine info beyond what google benchmark records itself
+#if defined(__VERSION__)
+    benchmark::AddCustomContext("compiler", __VERSION__);
+#endif
+#if defined(_OPENMP)
+    benchmark::AddCustomContext("openmp", std::to_string(_OPENMP));
+#endif
+    // register every hot path for every mesh
+    for(auto &mesh : benchMeshes())
+    {
+        if(mesh.grid)
+        {
+            benchmark::RegisterBenchmark(("initGrid/" + mesh.name).c_str(), BM_initGrid, mesh)->Unit(benchmark::kMillisecond);
+        }
+        else
+        {
+            benchmark::RegisterBenchmark(("readObj/" + mesh.name).c_str(), BM_readObj, mesh)->Unit(benchmark::kMillisecond);
+        }
+        benchmark::RegisterBenchmark(("forceCalc/" + mesh.name).c_str(), BM_forceCalc, mesh, false)->Unit(benchmark::kMicrosecond);
+        benchmark::RegisterBenchmark(("calcNormals/" + mesh.name).c_str(), BM_calcNormals, mesh)->Unit(benchmark::kMicrosecond);
+        benchmark::RegisterBenchmark(("render/" + mesh.name).c_str(), BM_render, mesh)->Unit(benchmark::kMicrosecond);
+        if(mesh.large)
+        {
+            continue;
+        }
+        benchmark::RegisterBenchmark(("forceCalcJacobians/" + mesh.name).c_str(), BM_forceCalc, mesh, true)->Unit(benchmark::kMicrosecond);
+        benchmark::RegisterBenchmark(("conjugateGradient/" + mesh.name).c_str(), BM_conjugateGradient, mesh)->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark(("jMatrixMultOp/" + mesh.name).c_str(), BM_jMatrixMultOp, mesh)->Unit(benchmark::kMicrosecond);
+        benchmark::RegisterBenchmark(("rk4Integrate/" + mesh.name).c_str(), BM_rk4Integrate, mesh)->Unit(benchmark::kMillisecond);
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -1,5 +1,14 @@
 TARGET=gnatvCloth
 
+CONFIG+=c++17
+
+# vertex normals are computed in parallel with OpenMP
+linux:QMAKE_CXXFLAGS+= -fopenmp
+linux:LIBS+= -fopenmp
+
+# scoped phase timers (see Profiler.h), build with CONFIG+=profiling to record them
+profiling:DEFINES+= GNATV_PROFILING
+
 QT+=gui opengl core charts
 
 OBJECTS_DIR=obj
@@ -13,7 +22,23 @@ SOURCES+= src/main.cpp \
           src/NGLSceneMouseControls.cpp \
           src/MainWindow.cpp \
           src/ClothInterface.cpp \
-          src/VisGraph.cpp
+          src/VisGraph.cpp \
+          src/MeshCache.cpp \
+          src/ObjSequenceWriter.cpp \
+          src/PointCache.cpp \
+          src/ClothRenderMesh.cpp \
+          src/SceneDescription.cpp \
+          src/ClothGrid.cpp \
+          src/Profiler.cpp \
+          src/SolverTelemetry.cpp \
+          src/WindField.cpp \
+          src/ForceField.cpp \
+          src/ClothEnsemble.cpp \
+          src/ForceDisplacementTest.cpp \
+          src/MaterialCalibration.cpp \
+          src/SelfCollision.cpp \
+          src/Obstacle.cpp \
+          src/ClothDrag.cpp
 
 HEADERS+= include/Cloth.h \
           include/MassPoint.h \
@@ -24,7 +49,27 @@ HEADERS+= include/Cloth.h \
           include/MainWindow.h \
           include/ClothInterface.h \
           include/FixPtTestDefaults.h \
-          include/VisGraph.h
+          include/VisGraph.h \
+          include/MeshCache.h \
+          include/ObjSequenceWriter.h \
+          include/PointCache.h \
+          include/ClothRenderMesh.h \
+          include/SceneDescription.h \
+          include/ClothGrid.h \
+          include/SpscQueue.h \
+          include/TripleBuffer.h \
+          include/Profiler.h \
+          include/SolverTelemetry.h \
+          include/WindField.h \
+          include/ForceField.h \
+          include/ArrayView.h \
+          include/ClothEnsemble.h \
+          include/ParallelFor.h \
+          include/ForceDisplacementTest.h \
+          include/MaterialCalibration.h \
+          include/SelfCollision.h \
+          include/Obstacle.h \
+          include/ClothDrag.h
 
 FORMS+= ui/MainWindow.ui
 
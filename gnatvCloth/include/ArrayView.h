@@ -0,0 +1,61 @@
+/**
+ * @file ArrayView.h
+ * @brief Read-only view of a contiguous array, for passing per-masspoint data without copying it
+ * @author Rachel Strohkorb
+ *
+ * A pointer and a size, nothing more. A std::vector converts to a view of itself, so anything
+ * that used to take a vector by value or const reference can take a view instead and its callers
+ * are unchanged. The view doesn't own what it looks at, it must not outlive the array.
+*/
+
+#ifndef ARRAYVIEW_H_
+#define ARRAYVIEW_H_
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * @class ArrayView
+ * @brief non-owning, read-only view of _size contiguous T, empty by default
+*/
+template<typename T>
+class ArrayView
+{
+public:
+    /**
+     * @brief empty view
+    */
+    ArrayView() = default;
+    /**
+     * @brief view of _size T starting at _data
+    */
+    ArrayView(const T *_data, size_t _size) : m_data(_data), m_size(_size) {;}
+    /**
+     * @brief view of the whole vector, only valid until the vector is resized or destroyed
+    */
+    ArrayView(const std::vector<T> &_vector) : m_data(_vector.data()), m_size(_vector.size()) {;}
+    /**
+     * @brief returns the number of elements in view
+    */
+    size_t size() const { return m_size; }
+    /**
+     * @brief returns whether or not there's nothing in view
+    */
+    bool empty() const { return m_size == 0; }
+    /**
+     * @brief returns element _i, unchecked
+    */
+    const T &operator[](size_t _i) const { return m_data[_i]; }
+    /**
+     * @brief returns the first element's address
+    */
+    const T *data() const { return m_data; }
+    const T *begin() const { return m_data; }
+    const T *end() const { return m_data + m_size; }
+
+private:
+    const T *m_data = nullptr;  /**< First element in view */
+    size_t m_size = 0;          /**< Number of elements in view */
+};
+
+#endif
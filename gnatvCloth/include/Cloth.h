@@ -7,13 +7,58 @@
 #ifndef CLOTH_H_
 #define CLOTH_H_
 
+#include <array>
+#include <cmath>
 #include <vector>
+#include <cstdint>
 #include <functional>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <string>
 #include <boost/math/interpolators/cubic_b_spline.hpp>
 #include <ngl/Vec2.h>
 #include <ngl/Vec3.h>
 #include "MassPoint.h"
 #include "Triangle.h"
+#include "ClothGrid.h"
+#include "SolverTelemetry.h"
+#include "SelfCollision.h"
+#include "ArrayView.h"
+#include "ForceField.h"
+#include "Obstacle.h"
+#include "WindField.h"
+
+/**
+ * @class StressCurve
+ * @brief a material's stress/strain spline, giving NaN rather than throwing for a strain it can't place
+ *
+ * The spline throws for a strain too far out to index its knots (or not a number at all), and the
+ * forces are worked out inside OpenMP regions, where an exception ends the process. A NaN carries
+ * on into the state instead, where the caller can see the cloth has blown up.
+*/
+class StressCurve
+{
+public:
+    StressCurve() = default;
+    StressCurve(boost::math::cubic_b_spline<float> _spline) : m_spline(std::move(_spline)) {;}
+    /**
+     * @brief returns the stress at _strain
+    */
+    float operator()(float _strain) const { return placeable(_strain) ? m_spline(_strain) : std::numeric_limits<float>::quiet_NaN(); }
+    /**
+     * @brief returns the slope of the curve at _strain
+    */
+    float prime(float _strain) const { return placeable(_strain) ? m_spline.prime(_strain) : std::numeric_limits<float>::quiet_NaN(); }
+
+private:
+    /**
+     * @brief returns whether or not the spline can be evaluated at _strain, false for NaN
+    */
+    static bool placeable(float _strain) { return std::abs(_strain) < 1e6f; }
+
+    boost::math::cubic_b_spline<float> m_spline;    /**< Fitted to the material's measured graph */
+};
 
 /**
  * @enum material_type
@@ -21,6 +66,171 @@
 */
 enum material_type { WOOL, JUTE, CUSTOM };
 
+/**
+ * @enum IntegrationMethod
+ * @brief how Cloth::update steps the cloth forward in time
+ *
+ * The explicit methods take the force on each masspoint as its acceleration, as RK4 always has,
+ * so their stable step depends on the stiffness alone (see Cloth::stableTimestep).
+*/
+enum IntegrationMethod
+{
+    RK4,                /**< Classic explicit Runge-Kutta, four force evaluations a step */
+    CGM,                /**< Implicit Euler solved with preconditioned CG, Baraff & Witkin */
+    SYMPLECTIC_EULER,   /**< Explicit, velocity then position, one force evaluation a step */
+    VERLET,             /**< Explicit velocity Verlet, one force evaluation a step after the first */
+    RK45,               /**< Explicit Dormand-Prince, sub-steps sized to an error tolerance */
+    IMEX                /**< CGM with only weft/warp stiffness in the system, shear, air and wind explicit */
+};
+
+/**
+ * @struct MaterialCurve
+ * @brief one stress/strain curve, stress sampled at equal strain intervals (see Materials.h)
+*/
+struct MaterialCurve
+{
+    float start = 0.0f;         /**< Strain of the first sample */
+    float step = 0.0f;          /**< Strain between samples */
+    std::vector<float> data;    /**< Stress at each sample */
+};
+
+/**
+ * @struct MaterialData
+ * @brief everything a cloth needs to know about its material
+*/
+struct MaterialData
+{
+    float mass = 0.0f;      /**< Mass of one square meter of the cloth in kg/m^2 */
+    MaterialCurve weft;     /**< Weft stress/strain curve */
+    MaterialCurve warp;     /**< Warp stress/strain curve */
+    MaterialCurve shear;    /**< Shear stress/strain curve */
+
+    /**
+     * @brief returns the data for a material, CUSTOM is read from the graph UI files in graphsFromUI/
+    */
+    static MaterialData standard(material_type _mt);
+    /**
+     * @brief reads the curves from the graph UI files, <_dir>/weft_graphData.txt etc
+     * @returns false if any of the files couldn't be read
+    */
+    bool readGraphs(const std::string &_dir);
+    /**
+     * @brief writes the curves out as graph UI files, the format VisGraph saves and CUSTOM reads
+     * @returns false if any of the files couldn't be written
+    */
+    bool writeGraphs(const std::string &_dir) const;
+};
+
+/**
+ * @struct ClothMemoryUsage
+ * @brief bytes used by a cloth object, broken down by what they're for
+ *
+ * Containers are counted by capacity. Jacobian storage and the material splines are estimates,
+ * as their allocations aren't visible from outside the containers.
+*/
+struct ClothMemoryUsage
+{
+    size_t massPoints = 0;          /**< MassPoint objects, excluding their jacobians */
+    size_t triangles = 0;           /**< Triangles and their masspoint references */
+    size_t jacobians = 0;           /**< Jacobian maps of every masspoint */
+    size_t solverWorkspaces = 0;    /**< Filter and preconditioner matrices, the peak temporaries of a CG step if the last update was implicit, and the explicit integrators' buffers */
+    size_t materialTables = 0;      /**< Weft/warp/shear splines */
+    size_t renderBuffers = 0;       /**< Cached vertex/face normals and the vertex->triangle adjacency */
+    size_t numMasses = 0;           /**< Number of masspoints, for bytesPerMasspoint */
+
+    /**
+     * @brief returns the sum of every category
+    */
+    size_t total() const { return massPoints + triangles + jacobians + solverWorkspaces + materialTables + renderBuffers; }
+    /**
+     * @brief returns the total divided by the number of masspoints
+    */
+    double bytesPerMasspoint() const { return numMasses == 0 ? 0.0 : static_cast<double>(total()) / numMasses; }
+    /**
+     * @brief writes out one line per category plus the total and bytes per masspoint
+    */
+    void print(std::ostream &_out) const;
+};
+
+/**
+ * @struct StaticSolveStats
+ * @brief how a quasi-static equilibrium solve went, see Cloth::solveStatic
+*/
+struct StaticSolveStats
+{
+    size_t newtonIterations = 0;    /**< Newton steps taken */
+    size_t cgIterations = 0;        /**< CG iterations summed over every Newton step */
+    float residual = 0.0f;          /**< Remaining free force norm, relative to the applied load */
+    bool converged = false;         /**< Whether the residual got under the tolerance */
+};
+
+/**
+ * @struct AdaptiveStepStats
+ * @brief how the sub-steps of the last RK45 update went, see Cloth::setAdaptiveTolerance
+*/
+struct AdaptiveStepStats
+{
+    size_t accepted = 0;    /**< Sub-steps taken */
+    size_t rejected = 0;    /**< Sub-steps thrown away for too large an error and retried shorter */
+    float lastStep = 0.0f;  /**< Length of the last sub-step taken */
+};
+
+/**
+ * @struct JacobianReuseStats
+ * @brief how often the implicit updates rebuilt their system, see Cloth::setJacobianReuse
+*/
+struct JacobianReuseStats
+{
+    size_t rebuilt = 0;     /**< Updates that worked out the jacobians and preconditioner afresh */
+    size_t reused = 0;      /**< Updates that solved with the ones kept from an earlier step */
+
+    /**
+     * @brief returns the fraction of the updates that reused the system, 0 before any
+    */
+    double reuseRatio() const { return rebuilt + reused == 0 ? 0.0 : static_cast<double>(reused) / (rebuilt + reused); }
+};
+
+/**
+ * @struct ButcherTableau
+ * @brief coefficients of an explicit Runge-Kutta method with up to 7 stages
+*/
+struct ButcherTableau
+{
+    size_t stages;      /**< Number of derivative evaluations a step */
+    float a[7][7];      /**< Row s weighs the derivatives of the stages before s, for the state of stage s */
+    float b[7];         /**< Weights of the step */
+    float e[7];         /**< Weights of the error estimate, b less the embedded method's, all 0 for none */
+};
+
+/**
+ * @struct ClothForces
+ * @brief the forces, and optionally the position jacobians, Cloth::evaluateForces works out for
+ * one state of the cloth, plus the scratch it needs on the way
+ *
+ * The buffers are sized on first use and kept, so reusing one for every evaluation doesn't
+ * allocate. The jacobians are stored a row per masspoint: row i is blocks offsets[i] to
+ * offsets[i + 1] - 1, block k being df_i/dx_j for masspoint j = columns[k].
+*/
+struct ClothForces
+{
+    std::vector<ngl::Vec3> forces;              /**< Force on each masspoint */
+    std::vector<size_t> offsets;                /**< First jacobian block of each masspoint's row, plus one past the last */
+    std::vector<size_t> columns;                /**< Masspoint each jacobian block is with respect to, sorted within a row */
+    std::vector<ngl::Mat3> jacobians;           /**< Position jacobian blocks, only filled when asked for */
+    std::vector<ngl::Vec3> triangleForces;      /**< Scratch, each triangle's force on its 3 corners */
+    std::vector<ngl::Mat3> triangleJacobians;   /**< Scratch, each triangle's 9 jacobian blocks */
+    std::vector<ngl::Vec3> airForces;           /**< Scratch, drag plus lift on each triangle */
+
+    /**
+     * @brief returns df_i/dx_j, zero if the two masspoints share no triangle
+    */
+    ngl::Mat3 jacobian(size_t _i, size_t _j) const;
+    /**
+     * @brief returns the heap bytes held by the buffers
+    */
+    size_t memoryBytes() const;
+};
+
 /**
  * @class Cloth
  * @brief Stores/operates on a cloth object that derives its internal forces from the
@@ -28,6 +238,11 @@ enum material_type { WOOL, JUTE, CUSTOM };
 */
 class Cloth
 {
+    /**
+     * @brief the benchmark suite (bench/main.cpp) times the private solver steps directly
+    */
+    friend class ClothBenchAccess;
+
 public:
     // CONSTRUCTORS/INITIALIZERS
     /**
@@ -38,6 +253,11 @@ public:
      * @brief user constructor, sets the material properties of the cloth
     */
     Cloth(material_type _mt);
+    /**
+     * @brief constructor for material data that isn't one of the built in materials, the
+     * cloth's material reads as CUSTOM
+    */
+    Cloth(const MaterialData &_material);
     /**
      * @brief initializes cloth object
      * @param _filename path to an .obj file defining the cloth object.
@@ -49,6 +269,14 @@ public:
     */
     void init(std::string _filename, std::function<ngl::Vec2(ngl::Vec3)> _toParam,
               std::vector<size_t> _corners, float _dampingCoefficient = 3.0f);
+    /**
+     * @brief initializes cloth object from a generated grid, no .obj file or mesh cache involved
+     * @param _grid grid to take the masspoints, triangles, UVs and toParam plane from
+     * @param _corners Id values for the 'corner' points, or points the user wishes to fix
+     * (see ClothGrid::corners and ClothGrid::fixPoints)
+     * @param _dampingCoefficient the coefficient used for damping in implicit integration
+    */
+    void init(const ClothGrid &_grid, std::vector<size_t> _corners, float _dampingCoefficient = 3.0f);
     /**
      * @brief clears all elements stored in cloth
     */
@@ -62,7 +290,7 @@ public:
     /**
      * @brief returns the current number of triangles in the cloth object
     */
-    size_t numTriangles() const { return m_triangles.size(); }
+    size_t numTriangles() const { return m_rest->triangles.size(); }
     /**
      * @brief returns the total mass of the cloth object
     */
@@ -71,10 +299,26 @@ public:
      * @brief returns the mass of the first masspoint
     */
     float firstMass() const { return m_mspts[0].mass(); }
+    /**
+     * @brief returns the mass of a given masspoint
+    */
+    float massAtPoint(const size_t _pt) const { return m_mspts[_pt].mass(); }
     /**
      * @brief returns the cloth's material
     */
     material_type material() const { return m_material; }
+    /**
+     * @brief returns the mass and curves the cloth's material was made from
+    */
+    const MaterialData &materialData() const { return m_materialData; }
+    /**
+     * @brief returns whether or not init reads/writes the precomputed mesh cache
+    */
+    bool meshCacheEnabled() const { return m_useMeshCache; }
+    /**
+     * @brief returns whether or not the cloth's own loops run in parallel with OpenMP
+    */
+    bool parallel() const { return m_parallel; }
     /**
      * @brief returns the cloth 'corners'
     */
@@ -87,12 +331,209 @@ public:
      * @brief returns forces acting on given masspoint, for weft/warp/shear tests
     */
     ngl::Vec3 forcesAtPoint(const size_t _pt) const { return m_mspts[_pt].forces(); }
+    /**
+     * @brief returns velocity of given masspoint
+    */
+    ngl::Vec3 velAtPoint(const size_t _pt) const { return m_mspts[_pt].vel(); }
+    /**
+     * @brief returns whether or not the given masspoint is fixed
+    */
+    bool fixedAtPoint(const size_t _pt) const { return m_mspts[_pt].fixed(); }
+    /**
+     * @brief returns whether or not update keeps the cloth from passing through itself
+    */
+    bool selfCollision() const { return m_selfCollision; }
+    /**
+     * @brief returns the distance collisions keep the cloth from itself and from obstacles
+    */
+    float collisionThickness() const { return m_collisionThickness; }
+    /**
+     * @brief returns the number of obstacles the cloth collides with
+    */
+    size_t numObstacles() const { return m_obstacles.size(); }
+    /**
+     * @brief returns the number of force fields acting on the cloth
+    */
+    size_t numForceFields() const { return m_forceFields.size(); }
+    /**
+     * @brief returns the signed distance from the given masspoint to the nearest obstacle, as of the
+     * last force calculation
+    */
+    float obstacleDistance(const size_t _pt) const
+    {
+        return m_obstacleDistances.empty() ? std::numeric_limits<float>::max() : m_obstacleDistances[_pt];
+    }
+    /**
+     * @brief returns the wind blowing on the cloth
+    */
+    const WindField &wind() const { return m_wind; }
+    /**
+     * @brief returns the sim time, the sum of the steps update has taken
+    */
+    float time() const { return m_time; }
+    /**
+     * @brief returns whether or not the explicit methods split each update into stable sub-steps
+    */
+    bool stableSubsteps() const { return m_stableSubsteps; }
+    /**
+     * @brief returns how the sub-steps of the last RK45 update went
+    */
+    const AdaptiveStepStats &adaptiveStats() const { return m_adaptiveStats; }
+    /**
+     * @brief returns whether or not CGM/IMEX updates keep their system between steps
+    */
+    bool jacobianReuse() const { return m_jacobianReuse; }
+    /**
+     * @brief returns how many CGM/IMEX updates rebuilt or reused their system since reuse was turned on
+    */
+    const JacobianReuseStats &jacobianReuseStats() const { return m_reuseStats; }
+    /**
+     * @brief returns an estimate of the longest step the given method stays stable at
+     *
+     * Each triangle's stiffness comes from the slopes of the weft/warp/shear curves at its current
+     * strain (or a sample further along, so a slack cloth isn't taken to have none), its stresses,
+     * its area and the weights of its corners. The stiffest corner times the most triangles any
+     * masspoint has bounds the cloth's highest frequency, and the step is 80% of the method's
+     * stability limit along the imaginary axis over that frequency. It costs about as much as one
+     * pass of the force calculation without the Jacobians. For IMEX only the shear, the explicit
+     * part of its step, counts.
+     * @returns the largest float for CGM, which is stable at any step
+    */
+    float stableTimestep(IntegrationMethod _method) const;
+    /**
+     * @brief returns the self contacts found in the last update
+    */
+    const std::vector<CollisionContact> &contacts() const { return m_contacts; }
+    /**
+     * @brief returns the bytes this cloth is using, broken down by category
+    */
+    ClothMemoryUsage memoryUsage() const;
 
     // SETTERS
     /**
      * @brief sets position of given masspoint, for weft/warp/shear tests
     */
-    void setPosAtPoint(const size_t _pt, const ngl::Vec3 _pos) { m_mspts[_pt].setPos(_pos); }
+    void setPosAtPoint(const size_t _pt, const ngl::Vec3 _pos) { m_mspts[_pt].setPos(_pos); m_normalsDirty = true; }
+    /**
+     * @brief sets velocity of given masspoint
+    */
+    void setVelAtPoint(const size_t _pt, const ngl::Vec3 _vel) { m_mspts[_pt].setVel(_vel); }
+    /**
+     * @brief turns self collision on/off (off by default)
+     *
+     * Each update refits a BVH over the triangles (see SelfCollision.h) to the positions swept
+     * over the step and finds the vertex-triangle and edge-edge pairs that are, or could get,
+     * closer than the thickness. The velocities of each pair are then projected so it can't
+     * close past the thickness by the end of the step. With CG the vertex of each touching
+     * vertex-triangle pair is also held by the filter, so the solve can't move it any further
+     * along the contact normal, and the projection runs again on the solved velocities.
+     * The explicit methods only get the projection before the step.
+     * @param _thickness see setCollisionThickness
+    */
+    void setSelfCollision(const bool _selfCollision, const float _thickness = 0.0f);
+    /**
+     * @brief sets the distance collisions keep the cloth from itself and from obstacles
+     * @param _thickness the distance, 0 for a quarter of the mean edge length
+    */
+    void setCollisionThickness(const float _thickness);
+    /**
+     * @brief adds a static obstacle for the cloth to collide with
+     *
+     * Each force calculation looks every masspoint up in the obstacles' distance grids, in the
+     * same parallel pass as gravity and the air forces. Update then removes any velocity that
+     * would take a masspoint closer than the thickness, easing it back out if it's already
+     * inside. With CG a masspoint within the thickness is also held along the surface normal for
+     * the solve while the forces on it push it into the obstacle, so it slides over the surface
+     * rather than through it, and it's released once they pull it away. Obstacles are shared
+     * between copies of the cloth and kept through clear.
+    */
+    void addObstacle(std::shared_ptr<const Obstacle> _obstacle);
+    /**
+     * @brief removes every obstacle
+    */
+    void clearObstacles();
+    /**
+     * @brief adds an external force field acting on the cloth, see ForceField
+     *
+     * The fields are evaluated wherever the forces are summed, on top of gravity, the air and the
+     * external forces passed in. Fields are shared between copies of the cloth and kept through clear.
+    */
+    void addForceField(std::shared_ptr<const ForceField> _field);
+    /**
+     * @brief removes the given force field, if the cloth has it
+    */
+    void removeForceField(const ForceField *_field);
+    /**
+     * @brief removes every force field
+    */
+    void clearForceFields();
+    /**
+     * @brief sets the wind blowing on the cloth (still air by default)
+     *
+     * Whenever gravity is on, each force calculation works out the air's velocity relative to
+     * each triangle, from the wind at its centre at the current sim time less the mean of its
+     * corners' velocities. That makes drag along the relative wind and lift across it, both
+     * scaled by the triangle's area and how square on to the air it is, with its face normal
+     * (Keckeisen et al. 2004), and a third of each goes to each corner. In still air that's
+     * just the cloth's air resistance.
+    */
+    void setWind(const WindField &_wind) { m_wind = _wind; }
+    /**
+     * @brief sets the drag and lift coefficients of the cloth's triangles
+    */
+    void setAirCoefficients(const float _drag, const float _lift);
+    /**
+     * @brief turns the precomputed mesh cache used by init on/off (on by default)
+     *
+     * With the cache on, init writes a binary cache file next to the .obj after parsing it,
+     * and later inits of the same .obj/toParam plane map that file instead of parsing.
+    */
+    void setMeshCacheEnabled(const bool _useMeshCache) { m_useMeshCache = _useMeshCache; }
+    /**
+     * @brief sets where the CG solver reports its per-step statistics, nullptr to stop
+     *
+     * The cloth doesn't own the sink, and copies of the cloth report into the same one.
+     * The statistics are only gathered while the sink has a file open.
+    */
+    void setSolverTelemetry(SolverTelemetry *_telemetry) { m_telemetry = _telemetry; }
+    /**
+     * @brief turns the cloth's OpenMP loops on/off (on by default)
+     *
+     * Turn this off when many cloths are stepped on their own threads (see ClothEnsemble),
+     * otherwise every thread starts an OpenMP team of its own and the machine is oversubscribed.
+    */
+    void setParallel(const bool _parallel) { m_parallel = _parallel; }
+    /**
+     * @brief turns splitting each update into equal sub-steps no longer than stableTimestep on/off
+     * for RK4, SYMPLECTIC_EULER and VERLET (off by default)
+    */
+    void setStableSubsteps(const bool _stableSubsteps) { m_stableSubsteps = _stableSubsteps; }
+    /**
+     * @brief sets the error RK45 allows each sub-step, in meters of position (1e-4 by default)
+     *
+     * The error is the largest difference between the 5th and 4th order positions, or between
+     * their velocities times the sub-step, over every masspoint. Each sub-step is sized from the
+     * last one's error, and one that misses the tolerance is thrown away and retried shorter.
+    */
+    void setAdaptiveTolerance(const float _tolerance) { m_adaptiveTolerance = _tolerance; }
+    /**
+     * @brief turns keeping the position jacobians and CG preconditioner between CGM/IMEX updates
+     * on/off (off by default), and resets the reuse stats
+     *
+     * With it on, an update only works the system out afresh when some triangle's weft or warp
+     * direction has moved more than _tolerance from where it was built (so turning counts as well
+     * as stretching), a strain has come off or gone onto its clamp, the last CG solve hit its
+     * iteration cap or took half as many iterations again as the first solve on the system, or the
+     * step, method or damping changed. The forces are still worked out every step, so only the
+     * matrix lags behind the state. A cloth at rest reuses its system every step; a moving one
+     * rebuilds most steps, as its slack triangles keep crossing the clamp where the materials'
+     * stiffness switches on.
+    */
+    void setJacobianReuse(const bool _reuse, const float _tolerance = 1e-3f);
+    /**
+     * @brief sets the damping coefficient used in implicit integration on every masspoint
+    */
+    void setDampingCoefficient(const float _dampingCoefficient);
 
     // SPIT OUT VERTEX/TRIANGLE DATA
     /**
@@ -110,16 +551,78 @@ public:
      * @brief writes out the current cloth state to an obj file
     */
     void writeToObj(std::string _filename);
+    /**
+     * @brief fills the list with the current position of each masspoint
+    */
+    void positions(std::vector<ngl::Vec3> &o_positions) const;
+    /**
+     * @brief fills the list with the current vertex normal of each masspoint
+    */
+    void vertexNormals(std::vector<ngl::Vec3> &o_normals);
+    /**
+     * @brief returns the vertex normal of each masspoint
+     *
+     * The normals are kept in a persistent buffer and only recomputed if the cloth has moved
+     * since the last call, so rendering and writing out the same step share one computation.
+    */
+    const std::vector<ngl::Vec3> &normals();
+    /**
+     * @brief fills the list with the UV coordinates of each masspoint
+    */
+    void vertexUVs(std::vector<ngl::Vec2> &o_uvs) const;
+    /**
+     * @brief fills the list with the masspoint ids of each triangle, 3 per triangle
+    */
+    void triangleIndices(std::vector<size_t> &o_indices) const;
+    /**
+     * @brief fills the list with the UV coordinates of each triangle corner, 3 per triangle
+    */
+    void triangleUVs(std::vector<ngl::Vec2> &o_uvs) const;
 
     // RUN SIMULATION
     /**
      * @brief runs one step of cloth sim
      * @param _h time step
-     * @param _useRK4 whether we're using RK4 or CGM
+     * @param _method how to step the cloth forward
      * @param _gravityOn whether or not gravity is on
-     * @param _externalf any non-gravity external forces acting on the masspoints
+     * @param _externalf any non-gravity external forces acting on the masspoints, one per masspoint
+     * or empty for none, on top of the force fields
+    */
+    void update(float _h, IntegrationMethod _method, bool _gravityOn, ArrayView<ngl::Vec3> _externalf = ArrayView<ngl::Vec3>());
+    /**
+     * @brief moves the cloth to force equilibrium under the given load, skipping the dynamics
+     *
+     * Newton iterations on f(x) = 0: each step solves (-Jpos + mu M) dx = f with preconditioned
+     * CG, fixed points held by the filter, then line searches along dx for the energy minimum.
+     * The materials have no stiffness at zero strain, so mu starts large enough to keep the first
+     * step short, shrinks as full steps succeed and grows again when one fails. The current
+     * positions are the starting guess, so stepping a load up level by level warm-starts every
+     * solve from the last equilibrium. Velocities are zeroed, the cloth is left at rest. The solve
+     * gives up early if |f| stops dropping, which is where float precision runs out on stiff meshes.
+     * @param _externalf non-gravity external forces acting on the masspoints, as for update
+     * @param _tolerance stop once |f| <= _tolerance * max(1, |applied load|)
+     * @param _maxIterations cap on the Newton steps
+    */
+    StaticSolveStats solveStatic(bool _gravityOn, ArrayView<ngl::Vec3> _externalf,
+                                 float _tolerance = 1e-3f, size_t _maxIterations = 100);
+    /**
+     * @brief solves K x = b for the free points, K = -Jpos the stiffness at the current positions
+     *
+     * Uses the Jacobians from the last force evaluation, so call it after solveStatic to get the
+     * response of the equilibrium to a small change in load: dx = K^-1 df. K is symmetric, so the
+     * same solve gives adjoints, see materialSensitivity.
+     * @returns false if CG made no progress, K is singular along b
     */
-    void update(float _h, bool _useRK4, bool _gravityOn, std::vector<ngl::Vec3> _externalf);
+    bool solveStiffness(const std::vector<ngl::Vec3> &_b, std::vector<ngl::Vec3> &o_x);
+    /**
+     * @brief returns _adjoint . df/dy for every weft, warp and shear data value y at the current positions
+     *
+     * The splines are linear in their data, so df/dy is the force the cloth would have if that
+     * curve were swapped for the spline through the unit vector at y. At an equilibrium, with
+     * K _adjoint = dd/dx from solveStiffness, this is the derivative of d with respect to the data.
+     * @returns the sensitivities laid out like the cloth's MaterialData, mass left at 0
+    */
+    MaterialData materialSensitivity(const std::vector<ngl::Vec3> &_adjoint);
 
     // FIX POINT OPERATORS
     /**
@@ -133,20 +636,63 @@ public:
      * @brief returns a list of bool values recording whether or not a 'corner' is fixed
     */
     std::vector<bool> isCornerFixed() const;
+    /**
+     * @brief fixes or frees any one masspoint, corner or not
+    */
+    void fixPoint(const size_t _pt, const bool _fixed);
 
     // READ/ADJUST CLOTH STATE
     /**
      * @brief calculates the internal forces acting on the cloth's masspoints
-     * @param _externalf non-gravity external forces acting on the masspoints
+     * @param _externalf non-gravity external forces acting on the masspoints, as for update
      * @param _calcJacobians whether or not the jacobians should be calculated
      * @param _useJvel whether or not the velocity jacobians should be calculated
     */
-    void forceCalc(bool _gravityOn, std::vector<ngl::Vec3> _externalf, bool _calcJacobians, bool _useJvel = false);
+    void forceCalc(bool _gravityOn, ArrayView<ngl::Vec3> _externalf, bool _calcJacobians, bool _useJvel = false);
+    /**
+     * @brief works out the forces on the masspoints for any state, leaving the cloth untouched
+     *
+     * The same forces forceCalc puts on the masspoints (internal, air, gravity, external and the
+     * force fields), but for the positions, velocities and time given, into o_forces. Triangles
+     * are evaluated in parallel and each masspoint gathers from its own triangles, so nothing is
+     * written twice. The cloth itself isn't changed, so trial states (integrator stages, line
+     * searches, speculative steps) need no copy of it, and several states can be evaluated at
+     * once from different threads, each into its own ClothForces. The cloth must have been
+     * through init, the gather goes through the masspoint -> triangle adjacency init builds.
+     * @param _pos position of each masspoint
+     * @param _vel velocity of each masspoint, for the air forces and force fields
+     * @param _time sim time the wind and force fields are evaluated at
+     * @param _externalf non-gravity external forces acting on the masspoints, as for update
+     * @param _jacobians whether or not to work out the position jacobians as well
+    */
+    void evaluateForces(ArrayView<ngl::Vec3> _pos, ArrayView<ngl::Vec3> _vel, float _time, bool _gravityOn,
+                        ArrayView<ngl::Vec3> _externalf, bool _jacobians, ClothForces &o_forces) const;
     /**
      * @brief run newton iterative relaxations on the cloth object
-     * Intended for use after the user adjusts cloth point positions in order to maintain cloth stability
+     * Intended for use after the user adjusts cloth point positions in order to maintain cloth stability.
+     * Equivalent to solveStatic with no gravity or external forces.
     */
     void newtonRelax();
+    /**
+     * @brief returns the masspoint nearest to where the ray first hits the cloth, -1 if it misses
+     *
+     * The ray is tested against a hierarchy over the triangles (see SelfCollision::raycast), built
+     * on the first pick and only refit to the current positions on the picks after that.
+    */
+    long pick(const ngl::Vec3 &_origin, const ngl::Vec3 &_direction);
+    /**
+     * @brief returns every masspoint within _rings edges of _pt, _pt first then a ring at a time
+    */
+    std::vector<size_t> ringNeighbourhood(const size_t _pt, const size_t _rings) const;
+    /**
+     * @brief returns a cloth made of the triangles touching _points, to relax that part of this one on its own
+     *
+     * The region keeps this cloth's material, masses, damping and rest shapes. Its masspoints are
+     * _points, in order, then the other corners of their triangles, which are fixed so relaxing the
+     * region only moves _points. Points already fixed in this cloth stay fixed.
+     * @param o_toCloth the id in this cloth of each of the region's masspoints
+    */
+    Cloth region(const std::vector<size_t> &_points, std::vector<size_t> &o_toCloth) const;
 
 private:
     // STRUCT
@@ -161,76 +707,209 @@ private:
         size_t b;
         size_t c;
     };
+    /**
+     * @struct NormalAdjacency
+     * @brief masspoint -> triangle adjacency, packed, masspoint i's triangles are
+     * triangles[offsets[i]] to triangles[offsets[i + 1] - 1]
+     *
+     * Only depends on the topology, so copies of a cloth share it.
+    */
+    struct NormalAdjacency
+    {
+        std::vector<size_t> offsets;
+        std::vector<size_t> triangles;
+    };
+    /**
+     * @struct RestMesh
+     * @brief the triangles' corners, uvs, r-weights and rest areas, fixed once the mesh is set up
+     *
+     * Copies of a cloth only differ in their state, so like the adjacency they share it.
+    */
+    struct RestMesh
+    {
+        std::vector<Triref> triangles;
+    };
+    /**
+     * @struct TriangleStrain
+     * @brief weft/warp directions, strain and stress of a triangle in some state
+    */
+    struct TriangleStrain
+    {
+        ngl::Vec3 U;        /**< Current weft direction */
+        ngl::Vec3 V;        /**< Current warp direction */
+        ngl::Vec3 strain;   /**< Weft, warp and shear strain */
+        ngl::Vec3 stress;   /**< Weft, warp and shear stress */
+    };
 
     // HELPER FUNCTIONS
     /**
      * @brief reads in data from .obj file, and creates/assigns data to triangles and masspoints
     */
-    void readObj(std::string _filename);
+    void readObj(std::string _filename, std::vector<Triref> &o_triangles);
+    /**
+     * @brief fills the masspoints and triangles from the mesh cache for the given obj
+     * @returns false if there is no valid cache for this obj and key
+    */
+    bool readCache(std::string _filename, uint64_t _key);
+    /**
+     * @brief writes the current masspoint and triangle data out to the mesh cache
+    */
+    void writeCache(std::string _filename, uint64_t _key, const std::vector<std::vector<size_t>> &_sparsity);
+    /**
+     * @brief computes the r-weights, masses and jacobian sparsity of freshly read masspoints/triangles,
+     * and makes _triangles the rest mesh
+     * @returns the sparsity pattern, so it can go in the mesh cache
+    */
+    std::vector<std::vector<size_t>> setupMesh(std::vector<Triref> _triangles, std::function<ngl::Vec2(ngl::Vec3)> _toParam);
+    /**
+     * @brief works out each triangle's current area from the masspoint positions
+    */
+    void updateAreas();
+    /**
+     * @brief sets damping, corners, filter and normal buffers, the last step of every init
+    */
+    void finishInit(std::vector<size_t> _corners, float _dampingCoefficient);
     /**
-     * @brief resets the forces and jacobians of each masspoint to 0
+     * @brief returns the sorted ids each masspoint shares a jacobian with, based on the triangles
     */
-    void nullForces();
+    std::vector<std::vector<size_t>> sparsityPattern() const;
+    /**
+     * @brief resets the forces, and unless told otherwise the jacobians, of each masspoint to 0
+    */
+    void nullForces(bool _jacobians = true);
+    /**
+     * @brief returns whether the kept system is still good for a step of _h with _method, see setJacobianReuse
+    */
+    bool systemCurrent(float _h, IntegrationMethod _method) const;
     /**
      * @brief calculates the internal forces acting within a given triangle
-     * @param _tr the triangle for which we are calculating the current internal forces
+     * @param _t the triangle for which we are calculating the current internal forces
      * @param _calcJacobians whether or not the jacobians should be calculated
      * @param _useJvel whether or not the velocity jacobians should be calculated
     */
-    void forceCalcPerTriangle(Triref _tr, bool _calcJacobians, bool _useJvel);
+    void forceCalcPerTriangle(size_t _t, bool _calcJacobians, bool _useJvel);
+    /**
+     * @brief returns the strain state of a triangle with its corners at _a, _b and _c
+    */
+    TriangleStrain triangleStrain(const Triref &_tr, const ngl::Vec3 &_a, const ngl::Vec3 &_b, const ngl::Vec3 &_c) const;
+    /**
+     * @brief works out the internal force triangle _t puts on each of its 3 corners
+    */
+    void triangleForces(size_t _t, const TriangleStrain &_state, ngl::Vec3 *o_forces) const;
+    /**
+     * @brief returns the force on one masspoint from gravity, the air forces on its triangles
+     * (_airForces, empty for none), the external forces and the dense force fields
+    */
+    ngl::Vec3 externalForce(size_t _pt, const ngl::Vec3 &_pos, const ngl::Vec3 &_vel, float _time, bool _gravityOn,
+                            ArrayView<ngl::Vec3> _externalf, const std::vector<ngl::Vec3> &_airForces) const;
     /**
      * @brief runs implicit integration on the cloth object using the CG method
      * @param _h time step
      * @param _useJvel whether or not the velocity jacobians are being used
      * @param _useDamping whether or not damping is being used
+     * @param _keptPrecon whether or not the preconditioner from the last solve still fits the jacobians
     */
-    std::vector<ngl::Vec3> conjugateGradient(float _h, bool _useJvel, bool _useDamping);
+    std::vector<ngl::Vec3> conjugateGradient(float _h, bool _useJvel, bool _useDamping, bool _keptPrecon = false);
     /**
-     * @brief solves for change in position during the newtonian relaxation (successive over-relaxation)
+     * @brief solves (-Jpos + mu M) x = b with Jacobi preconditioned CG, for solveStatic
      *
-     * Solves linear system present in Newton relaxation. For Ax = b, A = J, b = -F, x = change in position
+     * b must already be filtered. Stops early if the matrix turns out not to be positive
+     * definite along the search direction, keeping the progress so far.
+     * @param io_iterations incremented by the number of iterations run
+     * @returns false if not even one iteration could be run
+    */
+    bool stiffnessSolve(const std::vector<ngl::Vec3> &_b, float _mu, std::vector<ngl::Vec3> &o_x, size_t &io_iterations);
+    /**
+     * @brief returns the norm of the filtered masspoint forces, i.e. the force on the free points
     */
-    std::vector<ngl::Vec3> sor();
+    float freeForceNorm();
     /**
-     * @brief runs explicit RK4 integration on the cloth object
+     * @brief runs one of the explicit methods over a step, on the persistent stage buffers
+     *
+     * Expects the forces at the start of the step to be on the masspoints already, as update
+     * leaves them. The stages are evaluated with evaluateForces on the buffers, the masspoints
+     * are only written once, at the end of the step.
      * @param _h time step
+     * @param _method RK4, SYMPLECTIC_EULER, VERLET or RK45
      * @param _gravityOn whether or not gravity is on
-     * @param _externalf non-gravity external forces acting on the masspoints
+     * @param _externalf non-gravity external forces acting on the masspoints, as for update
+    */
+    void explicitIntegrate(float _h, IntegrationMethod _method, bool _gravityOn, ArrayView<ngl::Vec3> _externalf);
+    /**
+     * @brief runs explicit RK4 integration on the cloth object, see explicitIntegrate
+    */
+    void rk4Integrate(float _h, bool _gravityOn, ArrayView<ngl::Vec3> _externalf);
+    /**
+     * @brief fills stage _stage's accelerations from the filtered forces at _pos, with the
+     * velocities already in the stage's buffer
+    */
+    void explicitDerivatives(size_t _stage, ArrayView<ngl::Vec3> _pos, float _time, bool _gravityOn,
+                             ArrayView<ngl::Vec3> _externalf);
+    /**
+     * @brief takes one step of an explicit Runge-Kutta method from m_startPos and stage 0, into
+     * m_trialPos and m_trialVel
+     * @param _time sim time at the start of the step
+     * @returns the error estimate relative to the adaptive tolerance, 0 if the method has none
+    */
+    float rungeKuttaStep(float _h, float _time, const ButcherTableau &_tableau, bool _gravityOn,
+                         ArrayView<ngl::Vec3> _externalf);
+    /**
+     * @brief takes one symplectic Euler step from m_startPos and stage 0, in place
     */
-    void rk4Integrate(float _h, bool _gravityOn, std::vector<ngl::Vec3> _externalf);
+    void symplecticEulerStep(float _h);
+    /**
+     * @brief takes one velocity Verlet step from m_startPos and stage 0
+     *
+     * The forces at the end are worked out with the velocities an Euler step predicts, and
+     * become stage 0 of the next step.
+    */
+    void verletStep(float _h, float _time, bool _gravityOn, ArrayView<ngl::Vec3> _externalf);
+    /**
+     * @brief runs RK45 over a step in as many sub-steps as the tolerance needs
+    */
+    void adaptiveIntegrate(float _h, bool _gravityOn, ArrayView<ngl::Vec3> _externalf);
 
+    /**
+     * @brief builds the weft/warp/shear splines from the material data
+    */
+    void setMaterial(const MaterialData &_material);
     /**
      * @brief calculates current strain based on the warp/weft vectors U and V
     */
-    ngl::Vec3 calcStrain(ngl::Vec3 _u, ngl::Vec3 _v);
+    ngl::Vec3 calcStrain(ngl::Vec3 _u, ngl::Vec3 _v) const;
     /**
      * @brief calculates change in strain based on warp/weft and change in warp/weft
     */
-    ngl::Vec3 calcStrainPrime(ngl::Vec3 _u, ngl::Vec3 _up, ngl::Vec3 _v, ngl::Vec3 _vp);
+    ngl::Vec3 calcStrainPrime(ngl::Vec3 _u, ngl::Vec3 _up, ngl::Vec3 _v, ngl::Vec3 _vp) const;
     /**
      * @brief calculates current stress based on strain state
     */
-    ngl::Vec3 calcStress(ngl::Vec3 _strain);
+    ngl::Vec3 calcStress(ngl::Vec3 _strain) const;
 
     /**
      * @brief computes the position jacobians for the given triangle
-     * @param _tr the triangle for which we are computing the position jacobians
+     * @param _t the triangle for which we are computing the position jacobians
      * @param _u current weft direction of the triangle
      * @param _v current warp direction of the triangle
      * @param _strain current strain state of the triangle
      * @param _stress current stress state of the triangle
     */
-    void computeJpos(Triref _tr, ngl::Vec3 _u, ngl::Vec3 _v, ngl::Vec3 _strain, ngl::Vec3 _stress);
+    void computeJpos(size_t _t, ngl::Vec3 _u, ngl::Vec3 _v, ngl::Vec3 _strain, ngl::Vec3 _stress);
+    /**
+     * @brief works out triangle _t's 9 position jacobian blocks, o_blocks[3 * i + j] = df_i/dx_j
+     * for corners i and j in a, b, c order
+    */
+    void jposBlocks(size_t _t, const TriangleStrain &_state, ngl::Mat3 *o_blocks) const;
     /**
      * @brief computes the velocity jacobians for the given triangle
-     * @param _tr the triangle for which we are computing the position jacobians
+     * @param _t the triangle for which we are computing the position jacobians
      * @param _u current weft direction of the triangle
      * @param _v current warp direction of the triangle
      *
      * Does not currently work, as the relationship between change in strain and stress needs
      * to be defined in data in order to properly compute df/dv.
     */
-    void computeJvel(Triref _tr, ngl::Vec3 _u, ngl::Vec3 _v);
+    void computeJvel(size_t _t, ngl::Vec3 _u, ngl::Vec3 _v);
     /**
      * @brief multiplies an nx1 vector of 3x1 vectors by the nxn jacobian matrix stored in masspoints
      * @param _isA whether the operation is using A = M - Jvel - Jpos or just Jpos
@@ -244,7 +923,7 @@ private:
     /**
      * @brief creates a 3x3 matrix from mutiplying a vector by the transpose of another vector
     */
-    ngl::Mat3 vecVecTranspose(ngl::Vec3 _a, ngl::Vec3 _b);
+    ngl::Mat3 vecVecTranspose(ngl::Vec3 _a, ngl::Vec3 _b) const;
     /**
      * @brief performs a dot product operation on two nx1 vectors composed of 3x1 vectors
     */
@@ -252,11 +931,18 @@ private:
     /**
      * @brief clears near-zero entries in a vector to zero to prevent floating point instability
     */
-    ngl::Vec3 cleanNearZero(ngl::Vec3 io_a);
+    ngl::Vec3 cleanNearZero(ngl::Vec3 io_a) const;
     /**
-     * @brief returns vertex normals for each masspoint
+     * @brief builds the masspoint -> triangle adjacency used to gather the vertex normals
     */
-    std::vector<ngl::Vec3> calcNormals();
+    void buildNormalAdjacency();
+    /**
+     * @brief recomputes the vertex normals for each masspoint into m_normals
+     *
+     * Face normals are computed in parallel over the triangles, then each masspoint gathers
+     * from its own adjacent triangles, so no two threads ever write the same normal.
+    */
+    void calcNormals();
 
     /**
      * @brief creates the preconditioning matrix needed in the CG method (diag P = 1/diag A)
@@ -266,21 +952,112 @@ private:
      * @brief multiplies the input by the filter matrix that defines fixed properties of masspoints
     */
     void filter(std::vector<ngl::Vec3> &io_vec);
+    /**
+     * @brief refits the collision hierarchy and finds the self contacts for a step of _h
+    */
+    void findContacts(float _h);
+    /**
+     * @brief works out the collision thickness, and builds the collision hierarchy for the current mesh
+     * if self collision is on
+    */
+    void buildCollision();
+    /**
+     * @brief changes the velocities so no contact closes past the thickness over a step of _h
+     *
+     * Gauss-Seidel over the contacts, each one getting an impulse along its normal shared out
+     * by weight and inverse mass. Fixed points don't move.
+    */
+    void projectContactVelocities(float _h);
+    /**
+     * @brief works out the drag and lift on every triangle in one parallel pass, into m_airForces
+    */
+    void aerodynamicForces();
+    /**
+     * @brief returns the drag plus lift on a triangle with its corners at _a, _b, _c moving at
+     * _va, _vb, _vc
+    */
+    ngl::Vec3 airForce(const ngl::Vec3 &_a, const ngl::Vec3 &_b, const ngl::Vec3 &_c, const ngl::Vec3 &_va,
+                       const ngl::Vec3 &_vb, const ngl::Vec3 &_vc, float _time) const;
+    /**
+     * @brief changes the velocities so no free masspoint gets closer to an obstacle than the
+     * thickness over a step of _h
+    */
+    void projectObstacleVelocities(float _h);
+    /**
+     * @brief restricts the filter of each vertex in a touching vertex-triangle contact, or
+     * touching an obstacle that the forces push it into, so CG can't move it along the contact normal
+    */
+    void filterContacts();
 
     // MEMBER VARIABLES
     std::vector<MassPoint> m_mspts;     /**< Stores the masspoints */
-    std::vector<Triref> m_triangles;    /**< Stores the triangles */
+    std::shared_ptr<const RestMesh> m_rest = std::make_shared<const RestMesh>();    /**< Stores the triangles, shared between copies */
+    std::vector<float> m_areas;         /**< Current area of each triangle, the forces scale with it */
     material_type m_material;           /**< Reference for the cloth's material */
 
     float m_mass = 0.0f;        /**< Mass of the entire cloth object */
     float m_shearOffset = 0.0f; /**< Starting point of the shear dataset */
+    MaterialData m_materialData;    /**< Data the weft/warp/shear splines were made from */
 
-    boost::math::cubic_b_spline<float> m_weft;  /**< function for the weft data */
-    boost::math::cubic_b_spline<float> m_warp;  /**< function for the warp data */
-    boost::math::cubic_b_spline<float> m_shear; /**< function for the shear data */
+    StressCurve m_weft;     /**< function for the weft data */
+    StressCurve m_warp;     /**< function for the warp data */
+    StressCurve m_shear;    /**< function for the shear data */
 
     std::vector<size_t> m_corners;      /**< This object's 'corners', or the points the user wishes to fix/unfix */
     std::vector<ngl::Mat3> m_filter;    /**< Filter matrix used in CG method for fixed points */
+
+    bool m_useMeshCache = true;         /**< Whether or not init uses the precomputed mesh cache */
+    SolverTelemetry *m_telemetry = nullptr; /**< Sink for CG solver statistics, not owned */
+
+    std::vector<ngl::Vec3> m_faceNormals;   /**< Unit normal per triangle, scratch for calcNormals */
+    std::vector<ngl::Vec3> m_normals;       /**< Vertex normal per masspoint */
+    std::shared_ptr<const NormalAdjacency> m_adjacency;    /**< Triangles adjacent to each masspoint, shared between copies */
+    bool m_normalsDirty = true;             /**< Whether the masspoints have moved since m_normals was computed */
+    bool m_parallel = true;                 /**< Whether the cloth's loops run in parallel with OpenMP */
+    bool m_smoothForces = false;            /**< Skips the near-zero snapping of U/V/strain/stress, set during solveStatic */
+    bool m_tensileJacobians = false;        /**< Leaves shear out of the position jacobians, set during an IMEX update */
+
+    SelfCollision m_collision;              /**< Hierarchy over the triangles for self collision */
+    SelfCollision m_pickTree;               /**< Hierarchy over the triangles for pick, built on first use */
+    std::vector<CollisionContact> m_contacts;   /**< Self contacts found in the last update */
+    bool m_selfCollision = false;           /**< Whether or not update handles self collision */
+    float m_collisionThickness = 0.0f;      /**< Distance collisions keep the cloth from itself and obstacles */
+    float m_thicknessSetting = 0.0f;        /**< Thickness asked for, 0 for automatic */
+    std::vector<std::shared_ptr<const Obstacle>> m_obstacles;   /**< Static obstacles, shared between copies */
+    std::vector<float> m_obstacleDistances; /**< Signed distance from each masspoint to the nearest obstacle */
+    std::vector<ngl::Vec3> m_obstacleNormals;   /**< Outward normal of the nearest obstacle at each masspoint */
+    std::vector<std::shared_ptr<const ForceField>> m_forceFields;   /**< External force fields, shared between copies */
+
+    WindField m_wind;                       /**< Air velocity over the cloth */
+    float m_time = 0.0f;                    /**< Sim time the wind is evaluated at */
+    float m_dragCoefficient = 1.2f;         /**< Drag coefficient of a triangle square on to the air */
+    float m_liftCoefficient = 0.5f;         /**< Lift coefficient, peaking at 45 degrees to the air */
+    std::vector<ngl::Vec3> m_airForces;     /**< Drag plus lift on each triangle, scratch for forceCalc */
+
+    std::vector<ngl::Vec3> m_startPos;      /**< Positions at the start of an explicit step, its velocities are stage 0's */
+    std::vector<ngl::Vec3> m_trialPos;      /**< Positions of the explicit stage being evaluated */
+    std::vector<ngl::Vec3> m_trialVel;      /**< Velocities at the end of an explicit step */
+    std::array<std::vector<ngl::Vec3>, 7> m_stageVel;   /**< Velocity of each explicit stage */
+    std::array<std::vector<ngl::Vec3>, 7> m_stageAcc;   /**< Filtered acceleration of each explicit stage */
+    ClothForces m_stageForces;              /**< Forces of the explicit stage being evaluated */
+    bool m_stableSubsteps = false;          /**< Whether the explicit methods sub-step to stableTimestep */
+    float m_adaptiveTolerance = 1e-4f;      /**< Error RK45 allows a sub-step */
+    float m_adaptiveStep = 0.0f;            /**< Sub-step RK45 tries next, 0 before the first */
+    AdaptiveStepStats m_adaptiveStats;      /**< How the last RK45 update went */
+
+    bool m_jacobianReuse = false;           /**< Whether CGM/IMEX updates keep their system between steps */
+    float m_reuseTolerance = 1e-3f;         /**< Weft/warp direction change that has the kept system rebuilt */
+    bool m_systemKept = false;              /**< Whether the jacobians on the masspoints and m_precon are a kept system */
+    float m_systemStep = 0.0f;              /**< Step the kept system was built for */
+    IntegrationMethod m_systemMethod = CGM; /**< Method the kept system was built for */
+    std::vector<TriangleStrain> m_systemStates; /**< Each triangle when the kept system was built */
+    size_t m_systemIterations = 0;          /**< CG iterations of the first solve on the kept system */
+    size_t m_lastIterations = 0;            /**< CG iterations of the last solve */
+    bool m_lastCapped = false;              /**< Whether the last CG solve hit its iteration cap */
+    std::vector<ngl::Mat3> m_precon;        /**< Preconditioner of the last CG solve */
+    std::vector<ngl::Mat3> m_preconInv;     /**< Its inverse */
+    bool m_implicitUpdate = false;          /**< Whether the last update solved a system, for memoryUsage's CG temporaries */
+    JacobianReuseStats m_reuseStats;        /**< Rebuilt/reused updates since reuse was turned on */
 };
 
 #endif
@@ -0,0 +1,80 @@
+/**
+ * @file ClothDrag.h
+ * @brief Dragging one masspoint of a cloth around, relaxing only the cloth near it
+ * @author Rachel Strohkorb
+ *
+ * Grabbing a masspoint fixes it and cuts the rings of masspoints around it out of the cloth as a
+ * small cloth of its own (Cloth::region), held at its outer edge. Each move walks the grabbed point
+ * over to where it's asked to go, a fraction of an edge at a time, running Cloth::solveStatic on
+ * the region alone after each step, then copies the region's positions back. A move costs the
+ * same on the HiRes mesh as on the LowRes one, and the rest of the cloth catches up when the sim
+ * steps, with the grabbed point as a moving position constraint.
+ *
+ * Moves along a ray (for the mouse) keep the point on the plane through where it was grabbed,
+ * facing the ray it was grabbed with.
+*/
+
+#ifndef CLOTHDRAG_H_
+#define CLOTHDRAG_H_
+
+#include <memory>
+#include <vector>
+#include <ngl/Vec3.h>
+#include "Cloth.h"
+
+/**
+ * @class ClothDrag
+ * @brief one drag of one masspoint, from grab to release
+*/
+class ClothDrag
+{
+public:
+    /**
+     * @brief grabs the given masspoint, fixing it where it is
+     * @param _rings how many rings of masspoints around it are relaxed as it moves
+    */
+    void grab(Cloth &io_cloth, size_t _pt, size_t _rings = 4);
+    /**
+     * @brief grabs the masspoint nearest to where the ray hits the cloth, see Cloth::pick
+     * @returns false if the ray misses the cloth
+    */
+    bool grab(Cloth &io_cloth, const ngl::Vec3 &_origin, const ngl::Vec3 &_direction, size_t _rings = 4);
+    /**
+     * @brief moves the grabbed masspoint to _pos and relaxes the region around it
+     * @returns how the region's relax went
+    */
+    StaticSolveStats moveTo(Cloth &io_cloth, const ngl::Vec3 &_pos);
+    /**
+     * @brief moves the grabbed masspoint to where the ray crosses the drag plane
+     * @returns how the region's relax went, nothing is moved if the ray runs along the plane
+    */
+    StaticSolveStats moveAlong(Cloth &io_cloth, const ngl::Vec3 &_origin, const ngl::Vec3 &_direction);
+    /**
+     * @brief lets go of the masspoint, it's fixed again only if it was before the grab
+    */
+    void release(Cloth &io_cloth);
+    /**
+     * @brief returns whether or not a masspoint is grabbed
+    */
+    bool active() const { return m_region != nullptr; }
+    /**
+     * @brief returns the grabbed masspoint
+    */
+    size_t point() const { return m_point; }
+    /**
+     * @brief returns the number of masspoints a move relaxes, the grabbed one included
+    */
+    size_t regionSize() const { return m_free; }
+
+private:
+    std::unique_ptr<Cloth> m_region;    /**< The grabbed point's neighbourhood as a cloth of its own */
+    std::vector<size_t> m_toCloth;      /**< Id in the whole cloth of each region masspoint */
+    size_t m_free = 0;                  /**< Region masspoints a move relaxes, the rest are its boundary */
+    size_t m_point = 0;                 /**< Grabbed masspoint */
+    bool m_wasFixed = false;            /**< Whether the grabbed masspoint was fixed before the grab */
+    float m_edgeLength = 1.0f;          /**< Mean length of the edges around the grabbed masspoint */
+    ngl::Vec3 m_planePoint;             /**< Point on the drag plane */
+    ngl::Vec3 m_planeNormal;            /**< Normal of the drag plane, zero if the grab wasn't from a ray */
+};
+
+#endif
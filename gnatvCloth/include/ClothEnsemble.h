@@ -0,0 +1,106 @@
+/**
+ * @file ClothEnsemble.h
+ * @brief Runs many independent cloth sims side by side, for parameter sweeps
+ * @author Rachel Strohkorb
+*/
+
+#ifndef CLOTHENSEMBLE_H_
+#define CLOTHENSEMBLE_H_
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <ngl/Vec3.h>
+#include "Cloth.h"
+#include "SceneDescription.h"
+
+/**
+ * @struct EnsembleCase
+ * @brief the settings of one run in an ensemble
+*/
+struct EnsembleCase
+{
+    std::string name;                   /**< Label for the summary */
+    material_type material = WOOL;      /**< Cloth material */
+    float damping = 9.0f;               /**< Damping coefficient */
+    float windStrength = 0.0f;          /**< Multiplies the scene's wind velocity, 0 for no wind */
+    float dt = 0.01f;                   /**< Time step */
+    size_t steps = 100;                 /**< Number of steps to run */
+    IntegrationMethod integrator = CGM; /**< How to step the cloth forward */
+};
+
+/**
+ * @struct EnsembleResult
+ * @brief summary of one finished run
+*/
+struct EnsembleResult
+{
+    EnsembleCase settings;              /**< What was run */
+    bool stable = true;                 /**< False if the cloth blew up, the run stops there */
+    size_t stepsRun = 0;                /**< Steps run before finishing or blowing up */
+    double seconds = 0.0;               /**< Wall time of the run */
+    double meanStepMs = 0.0;            /**< Mean time per step */
+    double maxStepMs = 0.0;             /**< Slowest step */
+    ngl::Vec3 centroid;                 /**< Mean masspoint position at the end */
+    float lowestY = 0.0f;               /**< Lowest masspoint height at the end */
+    float maxSpeed = 0.0f;              /**< Fastest masspoint speed at the end */
+    double reuseRatio = 0.0;            /**< Fraction of the steps that reused the cgm/imex system */
+};
+
+/**
+ * @class ClothEnsemble
+ * @brief runs independent copies of one scene's cloth across a pool of threads
+ *
+ * The mesh is read once per material into a prototype cloth, and every run steps a copy of
+ * it. Copies share the immutable data (material splines, normal adjacency) and own only their
+ * simulation state. Each copy runs with its OpenMP loops off so the pool threads don't
+ * oversubscribe the machine.
+*/
+class ClothEnsemble
+{
+public:
+    // CONSTRUCTORS
+    /**
+     * @brief sets up an ensemble of the scene's cloth (mesh or grid, plane, fixed points, wind)
+    */
+    ClothEnsemble(const SceneDescription &_scene);
+
+    // CASES
+    /**
+     * @brief returns every combination of the scene's swept values
+     *
+     * Anything not swept takes the scene's own setting, so a scene with no sweeps gives one case.
+    */
+    static std::vector<EnsembleCase> casesFromScene(const SceneDescription &_scene);
+
+    // RUN
+    /**
+     * @brief runs every case to completion
+     * @param _numThreads threads in the pool, 0 for one per hardware thread
+     * @returns a result per case, in the order of the cases
+    */
+    std::vector<EnsembleResult> run(const std::vector<EnsembleCase> &_cases, size_t _numThreads = 0);
+    /**
+     * @brief writes out a table of the results
+    */
+    static void printSummary(const std::vector<EnsembleResult> &_results, std::ostream &_out);
+
+private:
+    // HELPER FUNCTIONS
+    /**
+     * @brief returns the cloth every run of the given material is copied from, building it if needed
+    */
+    const Cloth &prototype(material_type _material);
+    /**
+     * @brief steps a copy of the prototype through one case
+    */
+    EnsembleResult runCase(const EnsembleCase &_case, const Cloth &_prototype) const;
+
+    // MEMBER VARIABLES
+    SceneDescription m_scene;                       /**< Scene every case starts from */
+    std::map<material_type, Cloth> m_prototypes;    /**< Initialized cloth per material */
+    std::vector<std::shared_ptr<const Obstacle>> m_obstacles;   /**< Obstacles from the scene, shared by every case */
+};
+
+#endif
@@ -0,0 +1,120 @@
+/**
+ * @file ClothGrid.h
+ * @brief In-memory generator for rectangular triangulated cloth grids
+ * @author Rachel Strohkorb
+*/
+
+#ifndef CLOTHGRID_H_
+#define CLOTHGRID_H_
+
+#include <functional>
+#include <vector>
+#include <ngl/Vec2.h>
+#include <ngl/Vec3.h>
+
+/**
+ * @enum GridPlane
+ * @brief the plane a generated cloth grid lies in
+*/
+enum GridPlane {PLANE_XY, PLANE_XZ};
+
+/**
+ * @class ClothGrid
+ * @brief generates an n x m grid of masspoints, two triangles per quad, centred on the origin
+ *
+ * Masspoint (i, j) has id j*n + i and UV (i/(n-1), j/(m-1)), so i runs along the weft (u) and
+ * j along the warp (v). The grid can be passed straight to Cloth::init without going through
+ * an .obj file.
+ *
+ * The fixed point sets follow the layout of the lists in FixPtTestDefaults.h:
+ *  corners         (u0,v0), (u1,v0), (u0,v1), (u1,v1)
+ *  weft hold/pull  the points between the corners on the u = 0 and u = 1 edges
+ *  warp hold/pull  the points between the corners on the v = 0 and v = 1 edges
+ * so on a square grid fixPoints() can be used with ClothInterface's FixPtSetup options
+ * (HANG holds the v = 1 edge's corners, FLAG the u = 0 edge's).
+*/
+class ClothGrid
+{
+public:
+    // CONSTRUCTORS
+    /**
+     * @brief generates the grid
+     * @param _n number of masspoints along the weft (at least 2)
+     * @param _m number of masspoints along the warp (at least 2)
+     * @param _plane plane the grid lies in, facing +y for XZ and +z for XY
+     * @param _width size of the grid along the weft
+     * @param _height size of the grid along the warp
+    */
+    ClothGrid(size_t _n, size_t _m, GridPlane _plane, float _width = 10.0f, float _height = 10.0f);
+
+    // GETTERS
+    /**
+     * @brief returns the number of masspoints along the weft
+    */
+    size_t n() const { return m_n; }
+    /**
+     * @brief returns the number of masspoints along the warp
+    */
+    size_t m() const { return m_m; }
+    /**
+     * @brief returns the plane the grid lies in
+    */
+    GridPlane plane() const { return m_plane; }
+    /**
+     * @brief returns the id of masspoint (i, j)
+    */
+    size_t id(size_t _i, size_t _j) const { return _j*m_n + _i; }
+    /**
+     * @brief returns the position of each masspoint
+    */
+    const std::vector<ngl::Vec3> &positions() const { return m_positions; }
+    /**
+     * @brief returns the UV coordinates of each masspoint
+    */
+    const std::vector<ngl::Vec2> &uvs() const { return m_uvs; }
+    /**
+     * @brief returns the masspoint ids of each triangle, 3 per triangle
+    */
+    const std::vector<size_t> &indices() const { return m_indices; }
+    /**
+     * @brief returns the toParam function for the grid's plane
+    */
+    std::function<ngl::Vec2(ngl::Vec3)> toParam() const;
+
+    // FIXED POINT SETS
+    /**
+     * @brief returns the 4 corner ids
+    */
+    std::vector<size_t> corners() const;
+    /**
+     * @brief returns the ids on the u = 0 edge, corners excluded
+    */
+    std::vector<size_t> weftHold() const;
+    /**
+     * @brief returns the ids on the u = 1 edge, corners excluded
+    */
+    std::vector<size_t> weftPull() const;
+    /**
+     * @brief returns the ids on the v = 0 edge, corners excluded
+    */
+    std::vector<size_t> warpHold() const;
+    /**
+     * @brief returns the ids on the v = 1 edge, corners excluded
+    */
+    std::vector<size_t> warpPull() const;
+    /**
+     * @brief returns corners, weft hold, weft pull, warp hold and warp pull in one list
+    */
+    std::vector<size_t> fixPoints() const;
+
+private:
+    // MEMBER VARIABLES
+    size_t m_n;                         /**< Masspoints along the weft */
+    size_t m_m;                         /**< Masspoints along the warp */
+    GridPlane m_plane;                  /**< Plane the grid lies in */
+    std::vector<ngl::Vec3> m_positions; /**< Position per masspoint */
+    std::vector<ngl::Vec2> m_uvs;       /**< UV per masspoint */
+    std::vector<size_t> m_indices;      /**< Masspoint ids, 3 per triangle */
+};
+
+#endif
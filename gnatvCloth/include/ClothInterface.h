@@ -7,20 +7,30 @@
 #ifndef CLOTH_INTERFACE_H_
 #define CLOTH_INTERFACE_H_
 
+#include <atomic>
+#include <functional>
+#include <memory>
 #include <string>
+#include <thread>
 #include <ngl/Vec3.h>
 #include "Cloth.h"
+#include "ClothDrag.h"
+#include "ObjSequenceWriter.h"
+#include "PointCache.h"
+#include "SolverTelemetry.h"
+#include "ClothRenderMesh.h"
+#include "ForceDisplacementTest.h"
+#include "SceneDescription.h"
+#include "SpscQueue.h"
+#include "TripleBuffer.h"
 
-/**
- * @enum integrationMethod
- * @brief describes possible cloth integration methods
-*/
-enum IntegrationMethod {RK4, CGM};
 /**
  * @enum startConfig
  * @brief describes starting configuration for the cloth object
+ *
+ * SCENE takes the mesh, plane, fixed points and damping from a SceneDescription.
 */
-enum Config {LRXZ, LRXY, HRXZ, HRXY, WEFTXZ, WARPXZ};
+enum Config {LRXZ, LRXY, HRXZ, HRXY, WEFTXZ, WARPXZ, SCENE};
 /**
  * @enum FixPtSetup
  * @brief options for fixing points within the cloth, for testing purposes
@@ -30,6 +40,11 @@ enum FixPtSetup {NONE, CORNERS, HANG, FLAG, WEFT_TEST, WARP_TEST};
 /**
  * @class ClothInterface
  * @brief interface between ui and cloth object to make testing/baking easier
+ *
+ * The sim can either be stepped by the caller with updateCloth, or run on its own thread
+ * (startSimThread). While the thread runs, the setters are queued up and applied between
+ * steps on the sim thread, and renderCloth draws the newest finished frame. The getters
+ * read the live state, so they are only reliable while the thread is stopped.
 */
 class ClothInterface
 {
@@ -47,6 +62,16 @@ public:
      * @brief user constructor for general use
     */
     ClothInterface(IntegrationMethod _intm, Config _cnfg, FixPtSetup _fxpts, std::string _objPath = "obj/");
+    /**
+     * @brief user constructor for batch runs, sets everything up from a scene description
+     *
+     * The config is set to SCENE and every point listed in the scene is fixed.
+    */
+    ClothInterface(const SceneDescription &_scene);
+    /**
+     * @brief destructor, stops the sim thread if it's running
+    */
+    ~ClothInterface();
     /**
      * @brief initializes cloth to member parameters
     */
@@ -69,6 +94,10 @@ public:
      * @brief returns number of triangles in the cloth
     */
     size_t numClothTris() const { return m_cloth.numTriangles(); }
+    /**
+     * @brief returns the current position of the given cloth point
+    */
+    ngl::Vec3 clothPtPos(size_t _id) const { return m_cloth.posAtPoint(_id); }
     /**
      * @brief returns current path to the obj files
     */
@@ -89,6 +118,71 @@ public:
      * @brief returns whether or not the wind is on
     */
     bool isWindOn() const { return m_windOn; }
+    /**
+     * @brief returns whether or not the cloth collides with itself
+    */
+    bool isSelfCollisionOn() const { return m_cloth.selfCollision(); }
+    /**
+     * @brief returns whether or not cgm/imex keep their system between steps
+    */
+    bool isJacobianReuseOn() const { return m_cloth.jacobianReuse(); }
+    /**
+     * @brief returns how many cgm/imex steps rebuilt or reused their system, see Cloth::setJacobianReuse
+    */
+    const JacobianReuseStats &jacobianReuseStats() const { return m_cloth.jacobianReuseStats(); }
+    /**
+     * @brief returns whether or not a cloth point is being dragged
+    */
+    bool isDragging() const { return m_drag.active(); }
+    /**
+     * @brief returns the cloth point being dragged
+    */
+    size_t draggedClothPt() const { return m_drag.point(); }
+    /**
+     * @brief returns the directory cloth files are written out to
+    */
+    std::string writeOutDirectory() const { return m_writeOutDir; }
+    /**
+     * @brief returns the prefix of the cloth files written out
+    */
+    std::string writeOutPrefix() const { return m_writeOutPrefix; }
+    /**
+     * @brief returns whether or not updates are being recorded into a point cache
+    */
+    bool isRecording() const { return m_pointCache.isOpen(); }
+    /**
+     * @brief returns whether or not the CG solver statistics are being streamed out
+    */
+    bool isRecordingTelemetry() const { return m_telemetry.isOpen(); }
+    /**
+     * @brief returns the topology version, which changes every time the cloth is reinitialized
+    */
+    size_t topologyVersion() const { return m_topologyVersion; }
+    /**
+     * @brief returns whether or not the sim is running on its own thread
+    */
+    bool simThreadRunning() const { return m_simThread.joinable(); }
+    /**
+     * @brief returns the bytes used by the cloth, with the interface's position buffers
+     * counted as render buffers
+     *
+     * Walks the live cloth, so only call it while the sim thread is stopped, see printMemoryUsage.
+    */
+    ClothMemoryUsage memoryUsage() const;
+    /**
+     * @brief writes the memory breakdown out, see ClothMemoryUsage::print
+     *
+     * While the sim thread runs it's worked out and written from there between steps, so _out
+     * must outlive the call.
+    */
+    void printMemoryUsage(std::ostream &_out);
+    /**
+     * @brief writes the profiler's phase timings out as a Chrome trace, see Profiler::writeChromeTrace
+     *
+     * The sim thread records into the profiler every step, so while it runs the trace is written
+     * from there between steps, and a message says whether it worked.
+    */
+    void writeProfileTrace(std::string _filename);
 
     // SETTERS
     /**
@@ -102,15 +196,54 @@ public:
     /**
      * @brief sets which integration method will be used
     */
-    void setIntMethod(IntegrationMethod _intm) { m_intm = _intm; }
+    void setIntMethod(IntegrationMethod _intm);
     /**
      * @brief turns wind on/off
     */
-    void setWindState(bool _isWindOn) { m_windOn = _isWindOn; }
+    void setWindState(bool _isWindOn);
+    /**
+     * @brief turns self collision on/off, with the default thickness
+    */
+    void setSelfCollision(bool _isSelfCollisionOn);
+    /**
+     * @brief turn keeping the cgm/imex system between steps on/off, with the default tolerance
+    */
+    void setJacobianReuse(bool _isJacobianReuseOn);
     /**
-     * @brief sets the given cloth point to the given position and relaxes the model
+     * @brief sets the given cloth point to the given position and relaxes the cloth around it
+     *
+     * Only the rings of points around it are relaxed, see ClothDrag. The point is left as fixed
+     * or free as it was.
     */
     void setClothPtPos(size_t _id, ngl::Vec3 _pos);
+    /**
+     * @brief sets where writeOutCloth puts its files (directory/prefix.NNNN.obj)
+    */
+    void setWriteOutPath(std::string _directory, std::string _prefix);
+    /**
+     * @brief turns writing out the cloth before every step of the sim thread on/off
+    */
+    void setWriteOutEnabled(bool _writeOut);
+
+    // DRAGGING
+    /**
+     * @brief grabs the cloth point nearest to where the ray hits the cloth, holding it in place
+     *
+     * While it's held the sim treats it as fixed, following wherever dragClothPt puts it. Nothing
+     * is grabbed if the ray misses.
+     * @param _origin start of the ray, in the cloth's space
+     * @param _direction direction of the ray
+    */
+    void grabClothPt(ngl::Vec3 _origin, ngl::Vec3 _direction);
+    /**
+     * @brief moves the grabbed point to where the ray crosses the plane it was grabbed in, and
+     * relaxes the cloth around it
+    */
+    void dragClothPt(ngl::Vec3 _origin, ngl::Vec3 _direction);
+    /**
+     * @brief lets go of the grabbed point
+    */
+    void releaseClothPt();
 
     // RUN CLOTH SIM
     /**
@@ -121,25 +254,133 @@ public:
      * @brief spit out cloth data to render
     */
     void renderCloth(std::vector<float> &o_vertexData);
+    /**
+     * @brief spit out indexed cloth data to render
+     *
+     * Rebuilds the mesh's indices/UVs only if the topology has changed since it was last built,
+     * otherwise just refills the position/normal stream.
+    */
+    void renderCloth(ClothRenderMesh &io_mesh);
     /**
      * @brief write out cloth to file
+     *
+     * Files are formatted and written on a background thread, see ObjSequenceWriter.
     */
     void writeOutCloth();
+    /**
+     * @brief finish writing out any pending cloth file and end the current sequence
+    */
+    void stopWriteOut();
+    /**
+     * @brief starts recording the cloth into a point cache file (see PointCache.h)
+     *
+     * The current state is recorded straight away, then one frame per updateCloth. The sim
+     * thread writes the frames, so recording can't start while it runs.
+     * @returns false if the file couldn't be opened or the sim thread is running
+    */
+    bool startRecording(std::string _filename);
+    /**
+     * @brief finishes the point cache file being recorded, between steps if the sim thread is running
+    */
+    void stopRecording();
+    /**
+     * @brief starts streaming the CG solver statistics of every step to file (see SolverTelemetry.h)
+     *
+     * Unlike the point cache, the stream carries on through reinits, so one file can compare
+     * configs and materials. The sim thread records into the stream, so it can't start while
+     * it runs.
+     * @returns false if the file couldn't be opened or the sim thread is running
+    */
+    bool startTelemetry(std::string _filename, SolverTelemetry::Format _format = SolverTelemetry::CSV);
+    /**
+     * @brief finishes the solver telemetry file, between steps if the sim thread is running
+    */
+    void stopTelemetry();
+
+    // SIM THREAD
+    /**
+     * @brief starts running updateCloth on a worker thread, paced to real time
+     * @param _h time step of each update
+    */
+    void startSimThread(float _h);
+    /**
+     * @brief stops the sim thread after its current step, applying any queued changes first
+    */
+    void stopSimThread();
 
     // RUN FORCE/DISPLACEMENT TESTS
     /**
-     * @brief run force/displacement test in the weft direction
+     * @brief run force/displacement test in the weft direction, results/weft_test_results.csv
     */
     void runWeftTest();
     /**
-     * @brief run force/displacement test in the warp direction
+     * @brief run force/displacement test in the warp direction, results/warp_test_results.csv
     */
     void runWarpTest();
-    // runShearTest
+    /**
+     * @brief run force/displacement test in shear, results/shear_test_results.csv
+    */
+    void runShearTest();
+    /**
+     * @brief runs the given tests on the current material, all into one results file
+     *
+     * The tests use their own cloths (see ForceDisplacementTest.h), so the current cloth and
+     * settings are untouched. They read the current material, so they don't run while the sim
+     * thread does.
+     * @returns false if the results file couldn't be written or the sim thread is running
+    */
+    bool runForceTests(std::vector<ForceTestType> _tests, std::string _filename);
+    /**
+     * @brief fits the current material's weft/warp curves to measured results, see MaterialCalibration.h
+     *
+     * Either file may be missing, the tests with results are fitted. The fitted curves are written
+     * to the graph UI files and the cloth is reinitialized to them. Not while the sim thread runs.
+     * @returns false if neither file could be read or the sim thread is running
+    */
+    bool calibrateToMeasured(std::string _weftFile = "results/weft_test_results.txt",
+                             std::string _warpFile = "results/warp_test_results.txt");
 
 private:
-    // HELPER FUNCTIONS
+    // STRUCTS
+    /**
+     * @struct RenderTopology
+     * @brief the parts of a frame that only change when the cloth is reinitialized
+    */
+    struct RenderTopology
+    {
+        size_t version;
+        std::vector<size_t> indices;
+        std::vector<ngl::Vec2> cornerUVs;
+    };
+    /**
+     * @struct SimFrame
+     * @brief one finished step handed from the sim thread to the render thread
+    */
+    struct SimFrame
+    {
+        std::shared_ptr<const RenderTopology> topology;
+        std::vector<ngl::Vec3> positions;
+        std::vector<ngl::Vec3> normals;
+    };
 
+    // HELPER FUNCTIONS
+    /**
+     * @brief queues the command for the sim thread if it's running and we're not on it
+     * @returns true if the command was queued, false if the caller should go ahead itself
+    */
+    bool queueForSimThread(std::function<void()> _command);
+    /**
+     * @brief sim thread loop: apply queued changes, step, publish
+    */
+    void simLoop();
+    /**
+     * @brief copies the current cloth state into the triple buffer and publishes it
+    */
+    void publishFrame();
+    /**
+     * @brief stops the cloth file writer, reporting any frames of the sequence it couldn't write
+    */
+    void finishObjSequence();
 
     // MEMBER VARIABLES
     Cloth m_cloth = Cloth(WOOL);        /**< Cloth object */
@@ -150,10 +391,30 @@ private:
     size_t m_sideLength = 15;           /**< Length of the cloth's side, for fixing points */
 
     std::string m_objPath = "obj/";     /**< Path to the obj files */
+    SceneDescription m_scene;           /**< Scene used by the SCENE config */
 
     bool m_windOn = false;                                  /**< Whether or not the wind external force is turned on */
-    ngl::Vec3 m_windVector = ngl::Vec3(1.0f, 0.0f, 1.0f);   /**< Current base wind vector */
+    WindField m_windField = WindField(ngl::Vec3(1.0f, 0.0f, 1.0f)); /**< Wind blowing on the cloth when it's on */
     size_t m_updateCount = 0;                               /**< Count of how many updates we've done in this config */
+    size_t m_topologyVersion = 0;                           /**< Bumped every time the cloth is reinitialized */
+    std::vector<ngl::Vec3> m_renderPositions;               /**< Position buffer for renderCloth */
+    ClothDrag m_drag;                                       /**< Point being dragged around, if any */
+    std::atomic<size_t> m_dragRequests{0};                  /**< Count of dragClothPt calls, to skip stale queued moves */
+
+    std::string m_writeOutDir = "results/increaseY";    /**< Directory cloth files are written out to */
+    std::string m_writeOutPrefix = "warpYMax";          /**< Prefix of the cloth files written out */
+    ObjSequenceWriter m_objWriter;                      /**< Background writer for cloth files */
+    std::vector<ngl::Vec3> m_writePositions;            /**< Position snapshot handed to the writers */
+    PointCacheWriter m_pointCache;                      /**< Point cache being recorded into */
+    bool m_writeOutOn = false;                          /**< Whether the sim thread writes out the cloth every step */
+    SolverTelemetry m_telemetry;                        /**< Sink for the cloth's CG solver statistics */
+
+    std::thread m_simThread;                                /**< Worker thread running the sim */
+    std::atomic<bool> m_simRunning{false};                  /**< Cleared to ask the sim thread to stop */
+    float m_simStep = 0.01f;                                /**< Time step used by the sim thread */
+    SpscQueue<std::function<void()>, 64> m_commands;        /**< UI changes waiting to be applied between steps */
+    TripleBuffer<SimFrame> m_frames;                        /**< Finished frames, sim thread -> render thread */
+    std::shared_ptr<const RenderTopology> m_topology;       /**< Topology attached to the frames being published */
 };
 
 #endif
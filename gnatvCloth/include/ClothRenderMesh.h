@@ -0,0 +1,81 @@
+/**
+ * @file ClothRenderMesh.h
+ * @brief CPU side of the indexed cloth render path, kept free of OpenGL so it can be tested headless
+ * @author Rachel Strohkorb
+*/
+
+#ifndef CLOTHRENDERMESH_H_
+#define CLOTHRENDERMESH_H_
+
+#include <cstdint>
+#include <vector>
+#include <ngl/Vec2.h>
+#include <ngl/Vec3.h>
+
+/**
+ * @class ClothRenderMesh
+ * @brief builds the static (indices, UVs) and streamed (positions, normals) vertex data for the cloth
+ *
+ * A render vertex is made for each unique masspoint/UV pair, so masspoints on a UV seam get one
+ * vertex per side of the seam. The index buffer and UVs only change when the topology does; each
+ * frame only the interleaved position/normal stream is refilled.
+*/
+class ClothRenderMesh
+{
+public:
+    // BUILD
+    /**
+     * @brief builds the render vertices, index buffer and UVs for a cloth topology
+     * @param _indices masspoint ids, 3 per triangle
+     * @param _cornerUVs UV coordinates of each triangle corner, in the same order as _indices
+     * @param _version topology version the mesh is built from, see version()
+    */
+    void build(const std::vector<size_t> &_indices, const std::vector<ngl::Vec2> &_cornerUVs, size_t _version);
+    /**
+     * @brief refills the position/normal stream from the current cloth state
+     * @param _positions position per masspoint
+     * @param _normals vertex normal per masspoint
+    */
+    void fillStream(const std::vector<ngl::Vec3> &_positions, const std::vector<ngl::Vec3> &_normals);
+
+    // GETTERS
+    /**
+     * @brief returns the topology version the mesh was last built from (0 if never built)
+    */
+    size_t version() const { return m_version; }
+    /**
+     * @brief returns the number of render vertices
+    */
+    size_t numVertices() const { return m_vertexToMassPoint.size(); }
+    /**
+     * @brief returns the index buffer, 3 per triangle
+    */
+    const std::vector<uint32_t> &indices() const { return m_indices; }
+    /**
+     * @brief returns the UV buffer, 2 floats per render vertex
+    */
+    const std::vector<float> &uvs() const { return m_uvs; }
+    /**
+     * @brief returns the masspoint each render vertex takes its position/normal from
+    */
+    const std::vector<size_t> &vertexToMassPoint() const { return m_vertexToMassPoint; }
+    /**
+     * @brief returns the interleaved stream, position (3 floats) then normal (3 floats) per render vertex
+    */
+    const std::vector<float> &stream() const { return m_stream; }
+
+    /**
+     * @brief number of floats per render vertex in the stream
+    */
+    static constexpr size_t c_streamStride = 6;
+
+private:
+    // MEMBER VARIABLES
+    size_t m_version = 0;                       /**< Topology version the mesh was built from */
+    std::vector<uint32_t> m_indices;            /**< Index buffer */
+    std::vector<float> m_uvs;                   /**< UVs per render vertex */
+    std::vector<size_t> m_vertexToMassPoint;    /**< Masspoint per render vertex */
+    std::vector<float> m_stream;                /**< Position/normal stream, reused between frames */
+};
+
+#endif
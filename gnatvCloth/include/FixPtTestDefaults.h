@@ -63,6 +63,17 @@ static auto toParamXZ = [](ngl::Vec3 _v) -> ngl::Vec2
     return n;
 };
 
+// define which points are held still for each of the weft/warp/shear tests
+static std::vector<size_t> weftTestHoldPts = {
+    2, 3, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51
+};
+static std::vector<size_t> warpTestHoldPts = {
+    0, 1, 64, 65, 66, 67, 68, 69, 70, 71, 72, 73, 74, 75, 76, 77, 78, 79, 80, 81, 82, 83, 84, 85, 86, 87, 88, 89, 90, 91, 92, 93
+};
+static std::vector<size_t> shearTestHoldPts = {
+    1, 3, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63
+};
+
 // define which points need to be pulled for each of the weft/warp/shear tests
 static std::vector<size_t> weftTestPullPts = {
     1, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 0
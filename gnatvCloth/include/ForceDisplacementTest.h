@@ -0,0 +1,136 @@
+/**
+ * @file ForceDisplacementTest.h
+ * @brief Weft/warp/shear force-displacement tests, one cloth per force level, run in parallel
+ * @author Rachel Strohkorb
+ *
+ * Each test holds one edge of a test cloth and pulls the opposite edge with a constant force,
+ * then measures how far the pulled edge has moved. The edges, forces and meshes come from
+ * FixPtTestDefaults.h:
+ *
+ *  weft   weftTestCloth.obj, pulls weftTestPullPts along +x with weftTestForces
+ *  warp   clothHiResXZ.obj, pulls warpTestPullPts along -z with warpTestForces
+ *  shear  clothHiResXZ.obj, pulls shearTestPullRight along +z (along the edge) with shearTestForces
+ *
+ * Weft and warp step the load up quasi-statically: the forces are applied in order to one cloth
+ * and Cloth::solveStatic finds the equilibrium at each level, starting from the last one. Shear
+ * uses the dynamic mode, a fixed number of RK4 steps per level from rest, as a membrane with no
+ * compressive stiffness has no unique equilibrium under an edge shear.
+*/
+
+#ifndef FORCEDISPLACEMENTTEST_H_
+#define FORCEDISPLACEMENTTEST_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <ngl/Vec2.h>
+#include <ngl/Vec3.h>
+#include "Cloth.h"
+
+/**
+ * @enum ForceTestType
+ * @brief the three characterization tests
+*/
+enum ForceTestType {FORCE_TEST_WEFT, FORCE_TEST_WARP, FORCE_TEST_SHEAR};
+
+/**
+ * @enum ForceTestMode
+ * @brief how the displacement at each force level is found
+*/
+enum ForceTestMode
+{
+    FORCE_TEST_STATIC,      /**< Load stepping, solve for equilibrium at each level */
+    FORCE_TEST_DYNAMIC      /**< Run steps RK4 steps of h from rest at each level, levels in parallel */
+};
+
+/**
+ * @struct ForceTestSetup
+ * @brief which mesh a test uses, what it holds, what it pulls and how hard
+*/
+struct ForceTestSetup
+{
+    std::string name;                                   /**< weft, warp or shear */
+    std::string mesh;                                   /**< Path to the .obj file */
+    std::function<ngl::Vec2(ngl::Vec3)> toParam;        /**< toParam plane of the mesh */
+    std::vector<size_t> held;                           /**< Masspoints held in place */
+    std::vector<size_t> pulled;                         /**< Masspoints the force is applied to */
+    ngl::Vec3 direction;                                /**< Unit direction of the pull */
+    std::vector<float> forces;                          /**< Force per pulled point, one per level */
+    ForceTestMode mode = FORCE_TEST_STATIC;             /**< Static load stepping or dynamic */
+    size_t steps = 20;                                  /**< RK4 steps run per level, dynamic mode */
+    float h = 0.01f;                                    /**< Time step, dynamic mode */
+    float tolerance = 1e-2f;                            /**< Equilibrium tolerance relative to the load, static mode */
+
+    /**
+     * @brief returns the standard setup for the given test
+     * @param _objPath directory holding the default .obj files
+    */
+    static ForceTestSetup standard(ForceTestType _type, const std::string &_objPath);
+};
+
+/**
+ * @struct ForceTestLevel
+ * @brief result of one force level
+*/
+struct ForceTestLevel
+{
+    float force = 0.0f;             /**< Force applied to each pulled point */
+    float displacement = 0.0f;      /**< Mean displacement of the pulled points along the pull */
+    bool stable = true;             /**< False if the cloth blew up, or didn't reach equilibrium */
+    size_t newtonIterations = 0;    /**< Newton steps to reach equilibrium, static mode */
+    size_t cgIterations = 0;        /**< CG iterations over those Newton steps, static mode */
+    float residual = 0.0f;          /**< Relative force left at equilibrium, static mode */
+    double ms = 0.0;                /**< Time taken by this level */
+};
+
+/**
+ * @struct ForceTestResult
+ * @brief result of a whole test
+*/
+struct ForceTestResult
+{
+    std::string name;                       /**< weft, warp or shear */
+    ForceTestMode mode = FORCE_TEST_STATIC; /**< How the levels were run */
+    material_type material = WOOL;          /**< Material tested */
+    size_t masspoints = 0;                  /**< Masspoints in the test cloth */
+    std::vector<ForceTestLevel> levels;     /**< One per force, in order */
+    double seconds = 0.0;                   /**< Wall time of the whole test */
+};
+
+/**
+ * @brief runs every force level of a test
+ *
+ * Static mode steps the load up on one cloth. A level whose solve doesn't converge is retried
+ * from the previous equilibrium in smaller load increments.
+ *
+ * In dynamic mode the levels are independent, every one starts from the cloth at rest on its
+ * own copy, so they run side by side on a pool of threads (see parallelFor) with the cloth's
+ * own OpenMP loops off.
+ * @param _numThreads threads in the pool for dynamic mode, 0 for one per hardware thread
+*/
+ForceTestResult runForceTest(const ForceTestSetup &_setup, material_type _material, size_t _numThreads = 0);
+
+/**
+ * @brief called in static mode once each level reaches equilibrium, with the test cloth and the level index
+ *
+ * The cloth's Jacobians are those of the equilibrium, ready for Cloth::solveStiffness.
+*/
+using ForceTestLevelCallback = std::function<void(Cloth &, size_t)>;
+
+/**
+ * @brief runs every force level of a test on a cloth made from the given material data
+ * @param _atLevel called after each static level, ignored in dynamic mode
+*/
+ForceTestResult runForceTest(const ForceTestSetup &_setup, const MaterialData &_material, size_t _numThreads = 0,
+                             const ForceTestLevelCallback &_atLevel = nullptr);
+
+/**
+ * @brief writes the results out as CSV, one row per force level
+ *
+ * Columns: test,mode,material,masspoints,level,force,displacement,stable,newton_iterations,
+ * cg_iterations,residual,level_ms,test_seconds
+ * @returns false if the file couldn't be written
+*/
+bool writeForceTestResults(const std::vector<ForceTestResult> &_results, const std::string &_filename);
+
+#endif
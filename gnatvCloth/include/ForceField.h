@@ -0,0 +1,136 @@
+/**
+ * @file ForceField.h
+ * @brief External forces on the cloth's masspoints, evaluated in place as the forces are summed
+ * @author Rachel Strohkorb
+ *
+ * A force field gives the force on a masspoint from its id, position, velocity and the sim time.
+ * Cloth evaluates its fields wherever it sums up the forces (every RK4 stage, every Newton and
+ * line search step of solveStatic), adding each field's force straight onto the masspoints, so no
+ * per-masspoint force array is built. Dense fields act on every masspoint, inside the parallel
+ * per-masspoint pass, so their force must be safe to call from several threads at once. Sparse
+ * fields act only on their own list of masspoints, after that pass.
+ *
+ * The fields add to the forces but not to the Jacobians, so the implicit solve treats them as
+ * constant over the step, just like the external force array passed to Cloth::update.
+*/
+
+#ifndef FORCEFIELD_H_
+#define FORCEFIELD_H_
+
+#include <functional>
+#include <vector>
+#include <ngl/Vec3.h>
+#include "ArrayView.h"
+
+/**
+ * @class ForceField
+ * @brief base class for the external forces plugged into a cloth, see Cloth::addForceField
+*/
+class ForceField
+{
+public:
+    virtual ~ForceField() = default;
+    /**
+     * @brief returns whether or not the field only acts on the masspoints listed by points
+    */
+    virtual bool sparse() const { return false; }
+    /**
+     * @brief returns the masspoints a sparse field acts on
+    */
+    virtual ArrayView<size_t> points() const { return ArrayView<size_t>(); }
+    /**
+     * @brief returns the force on one masspoint
+     * @param _i the masspoint's index in points() for a sparse field, the masspoint itself for a dense one
+     * @param _pt the masspoint
+     * @param _pos its position
+     * @param _vel its velocity
+     * @param _t sim time, see Cloth::time
+    */
+    virtual ngl::Vec3 force(size_t _i, size_t _pt, const ngl::Vec3 &_pos, const ngl::Vec3 &_vel, float _t) const = 0;
+};
+
+/**
+ * @class UniformForce
+ * @brief the same force on every masspoint
+*/
+class UniformForce : public ForceField
+{
+public:
+    UniformForce(const ngl::Vec3 &_force) : m_force(_force) {;}
+    ngl::Vec3 force(size_t, size_t, const ngl::Vec3 &, const ngl::Vec3 &, float) const override { return m_force; }
+
+private:
+    ngl::Vec3 m_force;  /**< Force on each masspoint */
+};
+
+/**
+ * @class PointForce
+ * @brief a push away from (or, with a negative strength, a pull towards) a point, fading to
+ * nothing at the given radius
+*/
+class PointForce : public ForceField
+{
+public:
+    /**
+     * @param _centre where the force comes from
+     * @param _strength force on a masspoint at the centre, positive pushes away
+     * @param _radius distance beyond which there's no force, falling off linearly
+    */
+    PointForce(const ngl::Vec3 &_centre, float _strength, float _radius) :
+        m_centre(_centre), m_strength(_strength), m_radius(_radius) {;}
+    ngl::Vec3 force(size_t _i, size_t _pt, const ngl::Vec3 &_pos, const ngl::Vec3 &_vel, float _t) const override;
+
+private:
+    ngl::Vec3 m_centre; /**< Where the force comes from */
+    float m_strength;   /**< Force at the centre */
+    float m_radius;     /**< Reach of the force */
+};
+
+/**
+ * @class SparseForces
+ * @brief a force of its own on each of a few masspoints
+*/
+class SparseForces : public ForceField
+{
+public:
+    /**
+     * @brief the same force on each of the masspoints, change them with setForce
+    */
+    SparseForces(const std::vector<size_t> &_points, const ngl::Vec3 &_force = ngl::Vec3(0.0f)) :
+        m_points(_points), m_forces(_points.size(), _force) {;}
+    /**
+     * @brief sets the force on the _i'th masspoint of the list
+    */
+    void setForce(size_t _i, const ngl::Vec3 &_force) { m_forces[_i] = _force; }
+    /**
+     * @brief sets the force on every masspoint of the list
+    */
+    void setForces(const ngl::Vec3 &_force);
+    bool sparse() const override { return true; }
+    ArrayView<size_t> points() const override { return m_points; }
+    ngl::Vec3 force(size_t _i, size_t, const ngl::Vec3 &, const ngl::Vec3 &, float) const override { return m_forces[_i]; }
+
+private:
+    std::vector<size_t> m_points;       /**< Masspoints the forces act on */
+    std::vector<ngl::Vec3> m_forces;    /**< Force on each of them */
+};
+
+/**
+ * @class CallbackForce
+ * @brief a force worked out by a function, called from several threads at once
+*/
+class CallbackForce : public ForceField
+{
+public:
+    using Function = std::function<ngl::Vec3(size_t _pt, const ngl::Vec3 &_pos, const ngl::Vec3 &_vel, float _t)>;
+    CallbackForce(Function _function) : m_function(std::move(_function)) {;}
+    ngl::Vec3 force(size_t, size_t _pt, const ngl::Vec3 &_pos, const ngl::Vec3 &_vel, float _t) const override
+    {
+        return m_function(_pt, _pos, _vel, _t);
+    }
+
+private:
+    Function m_function;    /**< Force on a masspoint from its id, position, velocity and the time */
+};
+
+#endif
@@ -7,6 +7,7 @@
 #ifndef MASSPOINT_H_
 #define MASSPOINT_H_
 
+#include <vector>
 #include <unordered_map>
 #include <ngl/Vec3.h>
 #include <ngl/Mat3.h>
@@ -58,6 +59,13 @@ public:
      * @brief returns current number of jacobians stored
     */
     size_t numJacobians() const { return m_jacobians.size(); }
+    /**
+     * @brief returns an estimate of the heap bytes held by the jacobian map
+     *
+     * Each entry is a separately allocated node, so this counts the node (next pointer and
+     * key/value pair) plus typical allocator overhead per entry, and the bucket array.
+    */
+    size_t jacobianBytes() const;
     /**
      * @brief returns the position jacobian matrix derived from the given masspoint id
      *
@@ -130,6 +138,13 @@ public:
      * @brief zeros out all currently stored jacobians
     */
     void resetJacobians();
+    /**
+     * @brief creates zero'd jacobian entries for the given ids
+     *
+     * Lets the cloth set up the sparsity pattern up front instead of growing the map
+     * during the first force calculation.
+    */
+    void initJacobians(const std::vector<size_t> &_ids);
     /**
      * @brief adds position jacobian to the running total for the given id
      *
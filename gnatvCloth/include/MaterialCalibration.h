@@ -0,0 +1,88 @@
+/**
+ * @file MaterialCalibration.h
+ * @brief Fits the weft/warp/shear curves of a material to measured force-displacement data
+ * @author Rachel Strohkorb
+ *
+ * Each target is a static force test (see ForceDisplacementTest.h) with the forces and
+ * displacements measured on a real sample. calibrateMaterial adjusts the curve data values, the
+ * points dragged around in the graph UI, until the simulated displacements match.
+ *
+ * The fit is Levenberg-Marquardt. Its Jacobian comes from the equilibria themselves rather than
+ * from rerunning the tests with each value nudged: at an equilibrium f(x, y) + fext = 0, so the
+ * displacement d = g . x moves with the data y as dd/dy = lambda . df/dy, where K lambda = g and
+ * K is the stiffness. That's one extra CG solve per force level (Cloth::solveStiffness) and a
+ * pass over the triangles (Cloth::materialSensitivity), whatever the number of data values.
+ * The targets run side by side on a pool of threads.
+*/
+
+#ifndef MATERIALCALIBRATION_H_
+#define MATERIALCALIBRATION_H_
+
+#include <string>
+#include <vector>
+#include "Cloth.h"
+#include "ForceDisplacementTest.h"
+
+/**
+ * @struct CalibrationTarget
+ * @brief a test setup and the displacements measured at its forces
+*/
+struct CalibrationTarget
+{
+    ForceTestSetup setup;               /**< Test to run, its forces are the measured ones */
+    std::vector<float> displacements;   /**< Measured displacement at each of setup.forces */
+};
+
+/**
+ * @brief reads measured force/displacement pairs into a target for the given test
+ *
+ * Takes either the old results text layout (results/weft_test_results.txt) or the CSV written
+ * by writeForceTestResults, using the rows for this test.
+ * @param _objPath directory holding the default .obj files
+ * @returns false if the file couldn't be read or had no pairs in it
+*/
+bool readCalibrationTarget(ForceTestType _type, const std::string &_objPath, const std::string &_filename,
+                           CalibrationTarget &o_target);
+
+/**
+ * @struct CalibrationSettings
+ * @brief which curves are fitted and when to stop
+*/
+struct CalibrationSettings
+{
+    bool fitWeft = true;            /**< Adjust the weft data */
+    bool fitWarp = true;            /**< Adjust the warp data */
+    bool fitShear = false;          /**< Adjust the shear data, only weakly seen by weft/warp tests */
+    float smoothing = 1e-2f;        /**< Weight on the curvature of each curve's change, relative to the data */
+    size_t maxIterations = 20;      /**< Cap on Levenberg-Marquardt steps */
+    float tolerance = 1e-3f;        /**< Stop once a step improves the objective by less than this fraction */
+    size_t numThreads = 0;          /**< Threads the targets run on, 0 for one per hardware thread */
+};
+
+/**
+ * @struct CalibrationResult
+ * @brief the fitted material and how the fit went
+*/
+struct CalibrationResult
+{
+    MaterialData material;          /**< Fitted material, ready for MaterialData::writeGraphs */
+    std::vector<float> errors;      /**< RMS displacement error at the start and after each accepted step */
+    size_t iterations = 0;          /**< Steps tried, accepted or not */
+    size_t levelsUsed = 0;          /**< Force levels in the final fit, unconverged levels are left out */
+    double seconds = 0.0;           /**< Wall time of the whole fit */
+};
+
+/**
+ * @brief fits the material's curves to the targets
+ *
+ * Only static targets can be fitted, dynamic ones (shear) are skipped. The first weft/warp values,
+ * the stress at rest, stay put, and after each step weft/warp are kept non-negative and every
+ * curve non-decreasing. There are usually fewer force levels than data values, so the change to
+ * each curve is kept smooth, and values past the strains the tests reach carry on its trend.
+ * Steps move no value by more than half its size, and a step that leaves a level unconverged is
+ * rejected, so the fit only goes as far as Cloth::solveStatic can follow it.
+*/
+CalibrationResult calibrateMaterial(const MaterialData &_initial, const std::vector<CalibrationTarget> &_targets,
+                                    const CalibrationSettings &_settings = CalibrationSettings());
+
+#endif
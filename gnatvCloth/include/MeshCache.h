@@ -0,0 +1,187 @@
+/**
+ * @file MeshCache.h
+ * @brief Binary cache of the precomputed mesh data for a cloth .obj file
+ * @author Rachel Strohkorb
+*/
+
+#ifndef MESHCACHE_H_
+#define MESHCACHE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+#include <ngl/Vec2.h>
+#include <ngl/Vec3.h>
+
+/**
+ * @class MeshCache
+ * @brief memory maps the precomputed data (positions, UVs, triangle indices, r-weights,
+ * rest areas and jacobian sparsity pattern) written out after an .obj has been parsed
+ * once, so later inits of the same cloth skip the parse and setup work
+ *
+ * Masses aren't stored, they depend on the material, so a cloth of any material can load
+ * the cache and work its masses out from the rest areas.
+ *
+ * The cache lives next to the .obj file and is keyed by the toParam plane. It also records the
+ * .obj's size, modification time and a hash of its contents. An .obj whose size and time still
+ * match is taken as unchanged without being read. One that was only touched is hashed to check,
+ * and one of a different size is stale straight away.
+*/
+class MeshCache
+{
+public:
+    // CONSTRUCTORS
+    /**
+     * @brief default constructor, nothing mapped
+    */
+    MeshCache()=default;
+    /**
+     * @brief destructor, unmaps the cache file
+    */
+    ~MeshCache();
+    /**
+     * @brief the mapping is owned, so no copies
+    */
+    MeshCache(const MeshCache &)=delete;
+    MeshCache &operator=(const MeshCache &)=delete;
+
+    // CACHE FILES
+    /**
+     * @brief returns the path of the cache file for the given .obj file
+    */
+    static std::string cachePath(const std::string &_objFilename) { return _objFilename + ".cache"; }
+    /**
+     * @brief builds the cache key from the toParam plane, the .obj itself is checked in load
+     *
+     * The toParam function is fingerprinted by sampling it at a few probe points, which is
+     * enough to tell the XY/XZ/YZ planes (and scaled versions of them) apart.
+     * Returns 0 if the .obj file doesn't exist.
+    */
+    static uint64_t makeKey(const std::string &_objFilename, std::function<ngl::Vec2(ngl::Vec3)> _toParam);
+    /**
+     * @brief FNV-1a hash of a block of bytes, chained on from _hash, good enough to tell .obj files apart
+    */
+    static uint64_t hashBytes(const void *_data, size_t _size, uint64_t _hash = 14695981039346656037ull);
+    /**
+     * @brief maps the cache file for the given .obj, returns false if it is missing, stale or its
+     * indices and sparsity don't fit its masspoints
+    */
+    bool load(const std::string &_objFilename, uint64_t _key);
+    /**
+     * @brief unmaps the current cache file
+    */
+    void unload();
+    /**
+     * @brief writes out a cache file for the given .obj, returns false if it couldn't be written
+     * @param _uvs three UV coordinates per triangle, in triangle order
+     * @param _ru _rv r-weights per triangle
+     * @param _sparsityOffsets offsets into _sparsityIds for each masspoint (numMasses + 1 entries)
+     * @param _sparsityIds ids of the masspoints each masspoint shares a jacobian with
+    */
+    static bool save(const std::string &_objFilename, uint64_t _key,
+                     const std::vector<ngl::Vec3> &_positions,
+                     const std::vector<uint32_t> &_indices, const std::vector<ngl::Vec2> &_uvs,
+                     const std::vector<ngl::Vec3> &_ru, const std::vector<ngl::Vec3> &_rv,
+                     const std::vector<float> &_restAreas,
+                     const std::vector<uint32_t> &_sparsityOffsets, const std::vector<uint32_t> &_sparsityIds);
+
+    // GETTERS (valid while loaded)
+    /**
+     * @brief returns whether or not a cache file is currently mapped
+    */
+    bool loaded() const { return m_data != nullptr; }
+    /**
+     * @brief returns the number of masspoints stored in the cache
+    */
+    size_t numMasses() const { return m_numMasses; }
+    /**
+     * @brief returns the number of triangles stored in the cache
+    */
+    size_t numTriangles() const { return m_numTriangles; }
+    /**
+     * @brief returns the masspoint positions, 3 floats per masspoint
+    */
+    const float *positions() const { return m_positions; }
+    /**
+     * @brief returns the triangle indices, 3 per triangle
+    */
+    const uint32_t *indices() const { return m_indices; }
+    /**
+     * @brief returns the triangle UV coordinates, 6 floats per triangle
+    */
+    const float *uvs() const { return m_uvs; }
+    /**
+     * @brief returns the weft direction r-weights, 3 floats per triangle
+    */
+    const float *ru() const { return m_ru; }
+    /**
+     * @brief returns the warp direction r-weights, 3 floats per triangle
+    */
+    const float *rv() const { return m_rv; }
+    /**
+     * @brief returns the rest surface area of each triangle
+    */
+    const float *restAreas() const { return m_restAreas; }
+    /**
+     * @brief returns the sparsity offsets, numMasses + 1 entries
+    */
+    const uint32_t *sparsityOffsets() const { return m_sparsityOffsets; }
+    /**
+     * @brief returns the sparsity ids, indexed through sparsityOffsets
+    */
+    const uint32_t *sparsityIds() const { return m_sparsityIds; }
+
+private:
+    // STRUCT
+    /**
+     * @struct Header
+     * @brief fixed size header at the start of every cache file
+    */
+    struct Header
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t key;
+        uint64_t numMasses;
+        uint64_t numTriangles;
+        uint64_t numSparsityIds;
+        uint64_t objSize;
+        int64_t objTime;
+        uint64_t objHash;
+    };
+
+    // HELPER FUNCTIONS
+    /**
+     * @brief gets the size and modification time of a file
+     * @returns false if the file doesn't exist
+    */
+    static bool fileStamp(const std::string &_filename, uint64_t &o_size, int64_t &o_time);
+    /**
+     * @brief returns the hash of a file's contents, 0 if it can't be read
+    */
+    static uint64_t hashFile(const std::string &_filename);
+    /**
+     * @brief checks every triangle index and sparsity id is a masspoint, and the sparsity offsets
+     * run in order from 0 to the number of ids
+    */
+    bool validTopology(size_t _numSparsityIds) const;
+
+    // MEMBER VARIABLES
+    void *m_data = nullptr;     /**< Start of the mapped file */
+    size_t m_size = 0;          /**< Size of the mapped file */
+
+    size_t m_numMasses = 0;     /**< Number of masspoints in the cache */
+    size_t m_numTriangles = 0;  /**< Number of triangles in the cache */
+
+    const float *m_positions = nullptr;             /**< Mapped masspoint positions */
+    const uint32_t *m_indices = nullptr;            /**< Mapped triangle indices */
+    const float *m_uvs = nullptr;                   /**< Mapped triangle UVs */
+    const float *m_ru = nullptr;                    /**< Mapped weft r-weights */
+    const float *m_rv = nullptr;                    /**< Mapped warp r-weights */
+    const float *m_restAreas = nullptr;             /**< Mapped triangle rest areas */
+    const uint32_t *m_sparsityOffsets = nullptr;    /**< Mapped sparsity offsets */
+    const uint32_t *m_sparsityIds = nullptr;        /**< Mapped sparsity ids */
+};
+
+#endif
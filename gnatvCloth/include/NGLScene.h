@@ -13,10 +13,11 @@
 #include <ngl/Vec3.h>
 #include <ngl/Vec4.h>
 #include <ngl/Mat4.h>
-#include <ngl/AbstractVAO.h>
+#include <ngl/Types.h>
 
 #include "WindowParams.h"
 #include "ClothInterface.h"
+#include "ClothRenderMesh.h"
 
 #include <QEvent>
 #include <QResizeEvent>
@@ -93,6 +94,14 @@ public slots:
      * @brief turn on/off the wind
     */
     void toggleWind(bool _isWindOn);
+    /**
+     * @brief turn on/off self collision
+    */
+    void toggleSelfCollision(bool _isSelfCollisionOn);
+    /**
+     * @brief turn on/off keeping the cgm/imex system between steps
+    */
+    void toggleJacobianReuse(bool _isJacobianReuseOn);
     /**
      * @brief turn on/off writing out cloth to file
     */
@@ -121,11 +130,15 @@ public slots:
     /**
      * @brief run force/displacement test in warp direction
     */
-    //void runWarpTest();
+    void runWarpTest();
     /**
      * @brief run force/displacement test in shear direction
     */
-    //void runShearTest();
+    void runShearTest();
+    /**
+     * @brief fit the weft/warp graphs to the measured test results, then reinit the cloth to them
+    */
+    void calibrateToMeasured();
 
 private:
     /**
@@ -156,11 +169,29 @@ private:
      * @param _event the Qt Event structure
     */
     void wheelEvent( QWheelEvent *_event) override;
+    /**
+     * @brief returns the rotation the mouse has put on the cloth
+    */
+    ngl::Mat4 mouseRotation() const;
+    /**
+     * @brief works out the ray through the given mouse position, in the cloth's space
+     * @param _x mouse x in widget coordinates
+     * @param _y mouse y in widget coordinates
+    */
+    void mouseRay(int _x, int _y, ngl::Vec3 &o_origin, ngl::Vec3 &o_direction) const;
     /**
      * @brief prepares ngl checker shader for use for the next object to be drawn
      * @param _tx current transformation, usually mouse rotation
     */
     void loadMatrixToCheckerShader(const ngl::Mat4 &_tx);
+    /**
+     * @brief uploads the cloth's index buffer and UVs, called when the cloth topology changes
+    */
+    void uploadClothTopology();
+    /**
+     * @brief streams the cloth's positions/normals into the orphaned stream buffer
+    */
+    void streamClothVertices();
 
     // MEMBER VARIABLES
     WinParams m_win;                /**< Windows parameters for mouse control etc. */
@@ -169,13 +200,17 @@ private:
     ngl::Mat4 m_project;            /**< Project matrix */
     ngl::Vec4 m_lightPos;           /**< Light position in world space */
 
-    std::unique_ptr<ngl::AbstractVAO> m_clothVAO;   /**< VAO for the cloth triangles */
+    ClothRenderMesh m_renderMesh;   /**< CPU side cloth render data (indices, UVs, position/normal stream) */
+    GLuint m_clothVAO = 0;          /**< VAO for the indexed cloth mesh */
+    GLuint m_clothStreamVBO = 0;    /**< Position/normal buffer, orphaned and refilled every frame */
+    GLuint m_clothUVVBO = 0;        /**< UV buffer, uploaded once per topology */
+    GLuint m_clothEBO = 0;          /**< Index buffer, uploaded once per topology */
+    size_t m_uploadedVersion = 0;   /**< Topology version currently in the UV/index buffers */
 
     ClothInterface m_ci;            /**< ClothInterface object */
 
     bool m_wireframe = false;       /**< Whether or not the cloth is visualized in wireframe */
-    int m_timerId;                  /**< Id for starting/stopping the timer */
-    bool m_writeOut = false;        /**< whether or not we're writing the cloth to file */
+    int m_timerId = 0;              /**< Id for starting/stopping the repaint timer */
 };
 
 
@@ -0,0 +1,131 @@
+/**
+ * @file ObjSequenceWriter.h
+ * @brief Background writer for baking a cloth sim out to a numbered .obj sequence
+ * @author Rachel Strohkorb
+*/
+
+#ifndef OBJSEQUENCEWRITER_H_
+#define OBJSEQUENCEWRITER_H_
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <ngl/Vec2.h>
+#include <ngl/Vec3.h>
+
+/**
+ * @class ObjSequenceWriter
+ * @brief formats and writes .obj files on a worker thread so baking doesn't stall the sim
+ *
+ * The parts of the file that don't change between frames (UVs and faces) are formatted once
+ * in start. Each submitted frame is copied into a back buffer and handed to the worker, which
+ * formats positions and normals with std::to_chars while the sim carries on. The sim only
+ * waits if it gets a whole frame ahead of the writer.
+*/
+class ObjSequenceWriter
+{
+public:
+    // CONSTRUCTORS
+    /**
+     * @brief default constructor, writer is not running
+    */
+    ObjSequenceWriter()=default;
+    /**
+     * @brief destructor, finishes writing any pending frame
+    */
+    ~ObjSequenceWriter();
+    /**
+     * @brief the writer owns a thread, so no copies
+    */
+    ObjSequenceWriter(const ObjSequenceWriter &)=delete;
+    ObjSequenceWriter &operator=(const ObjSequenceWriter &)=delete;
+
+    // START/STOP
+    /**
+     * @brief starts the worker thread for a new sequence
+     * @param _directory directory the files go in, created if it doesn't exist
+     * @param _prefix file prefix, files are named prefix.NNNN.obj
+     * @param _uvs UV coordinates per masspoint
+     * @param _indices triangle indices, 3 per triangle
+    */
+    void start(const std::string &_directory, const std::string &_prefix,
+               const std::vector<ngl::Vec2> &_uvs, const std::vector<size_t> &_indices);
+    /**
+     * @brief writes out any pending frame and stops the worker thread
+    */
+    void stop();
+
+    // GETTERS
+    /**
+     * @brief returns whether or not the worker thread is running
+    */
+    bool running() const { return m_thread.joinable(); }
+    /**
+     * @brief returns the number of frames written out so far in this sequence
+    */
+    size_t framesWritten();
+    /**
+     * @brief returns the number of frames in this sequence that couldn't be written, the first
+     * one is also reported on std::cerr
+    */
+    size_t framesFailed();
+    /**
+     * @brief returns the filename a given frame is written to
+    */
+    std::string frameFilename(size_t _frame) const;
+
+    // WRITE FRAMES
+    /**
+     * @brief hands a frame to the worker thread to be written out
+     * @param _frame frame number used in the filename
+     * @param _positions position per masspoint
+     * @param _normals vertex normal per masspoint
+    */
+    void submit(size_t _frame, const std::vector<ngl::Vec3> &_positions, const std::vector<ngl::Vec3> &_normals);
+
+private:
+    // STRUCT
+    /**
+     * @struct Snapshot
+     * @brief the per-frame data the worker needs
+    */
+    struct Snapshot
+    {
+        size_t frame = 0;
+        std::vector<ngl::Vec3> positions;
+        std::vector<ngl::Vec3> normals;
+    };
+
+    // HELPER FUNCTIONS
+    /**
+     * @brief worker thread loop, waits on frames and writes them out
+    */
+    void writerLoop();
+    /**
+     * @brief formats and writes one frame to file
+     * @returns false if the file couldn't be opened, written or closed
+    */
+    bool writeFrame(const Snapshot &_snapshot);
+
+    // MEMBER VARIABLES
+    std::string m_directory;    /**< Directory files are written to */
+    std::string m_prefix;       /**< Prefix of the written files */
+    std::string m_uvBlock;      /**< Preformatted vt lines */
+    std::string m_faceBlock;    /**< Preformatted f lines */
+    std::string m_frameText;    /**< Formatting buffer for the current frame, reused between frames */
+
+    Snapshot m_front;           /**< Frame being written by the worker */
+    Snapshot m_back;            /**< Frame waiting to be written */
+    bool m_backFull = false;    /**< Whether or not m_back holds a frame the worker hasn't taken yet */
+    bool m_stop = false;        /**< Tells the worker to finish up */
+    size_t m_framesWritten = 0; /**< Frames written in this sequence */
+    size_t m_framesFailed = 0;  /**< Frames in this sequence that couldn't be written */
+
+    std::thread m_thread;               /**< Worker thread */
+    std::mutex m_mutex;                 /**< Guards the handoff between m_back and m_front */
+    std::condition_variable m_cond;     /**< Signals handoff/stop between the sim and the worker */
+};
+
+#endif
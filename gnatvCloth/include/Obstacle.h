@@ -0,0 +1,95 @@
+/**
+ * @file Obstacle.h
+ * @brief Static obstacle for the cloth to collide with, stored as a signed distance grid
+ * @author Rachel Strohkorb
+ *
+ * The obstacle's .obj is turned into a regular grid of signed distances to its surface,
+ * negative inside. Finding how far a point is from the obstacle, and which way is out, is then
+ * one trilinear lookup whatever the size of the mesh. Building the grid tests every node
+ * against every triangle, so it's written out next to the .obj and reused until the .obj
+ * or the cell size changes.
+ *
+ * The sign comes from the winding number of the mesh around each node, so the mesh should
+ * be closed with its faces wound counter-clockwise seen from outside.
+*/
+
+#ifndef OBSTACLE_H_
+#define OBSTACLE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <ngl/Vec3.h>
+
+/**
+ * @class Obstacle
+ * @brief signed distance grid built from a triangle mesh, see Cloth::addObstacle
+*/
+class Obstacle
+{
+public:
+    /**
+     * @brief returns the path of the distance grid cache for the given .obj file
+    */
+    static std::string cachePath(const std::string &_objFilename) { return _objFilename + ".sdf"; }
+    /**
+     * @brief reads the obstacle's distance grid from its cache, or builds it from the .obj
+     * and writes the cache
+     * @param _cellSize grid spacing, 0 for a 32nd of the mesh's longest side
+     * @returns false if the .obj couldn't be read, had no faces or a face with a bad vertex id
+    */
+    bool load(const std::string &_objFilename, float _cellSize = 0.0f);
+    /**
+     * @brief builds the distance grid for the given triangles, no files involved
+     * @param _indices three vertex ids per triangle
+    */
+    void build(const std::vector<ngl::Vec3> &_vertices, const std::vector<size_t> &_indices, float _cellSize = 0.0f);
+    /**
+     * @brief returns whether or not the last load read the cache rather than building the grid
+    */
+    bool loadedFromCache() const { return m_fromCache; }
+    /**
+     * @brief returns whether or not there's a grid to query
+    */
+    bool empty() const { return m_phi.empty(); }
+    /**
+     * @brief returns the grid spacing
+    */
+    float cellSize() const { return m_cellSize; }
+    /**
+     * @brief returns the bytes held by the grid
+    */
+    size_t memoryBytes() const { return m_phi.capacity() * sizeof(float); }
+    /**
+     * @brief returns the signed distance from _p to the surface, negative inside
+     *
+     * Trilinear in the grid values, with o_normal the normalized gradient of the same
+     * interpolation, pointing out of the obstacle. Points off the grid are reported as
+     * far away (the grid reaches a few cells past the mesh), with o_normal left as is.
+    */
+    float distance(const ngl::Vec3 &_p, ngl::Vec3 &o_normal) const;
+
+private:
+    /**
+     * @brief writes the grid out to the cache file
+    */
+    bool writeCache(const std::string &_filename, uint64_t _key) const;
+    /**
+     * @brief reads the grid from the cache file, false if it's missing or was built from something else
+    */
+    bool readCache(const std::string &_filename, uint64_t _key);
+    /**
+     * @brief returns the grid value at node (i, j, k)
+    */
+    float at(size_t _i, size_t _j, size_t _k) const { return m_phi[(_k * m_ny + _j) * m_nx + _i]; }
+
+    ngl::Vec3 m_origin;         /**< Position of node (0, 0, 0) */
+    float m_cellSize = 0.0f;    /**< Grid spacing */
+    size_t m_nx = 0;            /**< Nodes along x */
+    size_t m_ny = 0;            /**< Nodes along y */
+    size_t m_nz = 0;            /**< Nodes along z */
+    std::vector<float> m_phi;   /**< Signed distance at each node, x fastest */
+    bool m_fromCache = false;   /**< Whether the last load read the cache */
+};
+
+#endif
@@ -0,0 +1,50 @@
+/**
+ * @file ParallelFor.h
+ * @brief Runs independent jobs across a short-lived pool of threads
+ * @author Rachel Strohkorb
+*/
+
+#ifndef PARALLELFOR_H_
+#define PARALLELFOR_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief calls _job(i) for every i in [0, _count), spread over a pool of threads
+ *
+ * Each thread takes the next index until they're all gone, so uneven jobs balance out.
+ * Returns once every job has finished.
+ * @param _numThreads threads in the pool, 0 for one per hardware thread
+*/
+template <typename Job>
+void parallelFor(size_t _count, size_t _numThreads, Job &&_job)
+{
+    if(_numThreads == 0)
+    {
+        _numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    _numThreads = std::min(_numThreads, _count);
+    std::atomic<size_t> next{0};
+    auto worker = [&]()
+    {
+        for(size_t i = next++; i < _count; i = next++)
+        {
+            _job(i);
+        }
+    };
+    std::vector<std::thread> pool;
+    for(size_t t = 0; t < _numThreads; ++t)
+    {
+        pool.emplace_back(worker);
+    }
+    for(auto &t : pool)
+    {
+        t.join();
+    }
+}
+
+#endif
@@ -0,0 +1,170 @@
+/**
+ * @file PointCache.h
+ * @brief Compressed, random-access binary cache for baked cloth simulations
+ * @author Rachel Strohkorb
+ *
+ * File layout:
+ *  1. Header (counts, frame table offset)
+ *  2. UV coordinates per point, triangle indices and the reference positions, stored once
+ *  3. One block per frame: the bounding box of the frame's displacement from the reference
+ *     positions, then the displacements quantized to 16 bits within that box, delta-encoded
+ *     from point to point and written as zigzag varints
+ *  4. Frame table holding the file offset of every frame block
+ *
+ * Frames are encoded against the reference positions rather than against the previous frame,
+ * so any frame can be decoded on its own straight from the frame table.
+*/
+
+#ifndef POINTCACHE_H_
+#define POINTCACHE_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <ngl/Vec2.h>
+#include <ngl/Vec3.h>
+
+/**
+ * @class PointCacheWriter
+ * @brief records cloth frames into a point cache file
+*/
+class PointCacheWriter
+{
+public:
+    // CONSTRUCTORS
+    /**
+     * @brief default constructor, no file open
+    */
+    PointCacheWriter()=default;
+    /**
+     * @brief destructor, finishes the file if it's still open
+    */
+    ~PointCacheWriter();
+    /**
+     * @brief the writer owns a file handle, so no copies
+    */
+    PointCacheWriter(const PointCacheWriter &)=delete;
+    PointCacheWriter &operator=(const PointCacheWriter &)=delete;
+
+    // OPEN/CLOSE
+    /**
+     * @brief starts a new cache file
+     * @param _uvs UV coordinates per point
+     * @param _indices triangle indices, 3 per triangle
+     * @returns false if the file couldn't be opened
+    */
+    bool open(const std::string &_filename, const std::vector<ngl::Vec2> &_uvs, const std::vector<size_t> &_indices);
+    /**
+     * @brief writes out the frame table and closes the file
+    */
+    void close();
+
+    // GETTERS
+    /**
+     * @brief returns whether or not a file is open for recording
+    */
+    bool isOpen() const { return m_file != nullptr; }
+    /**
+     * @brief returns the number of frames recorded so far
+    */
+    size_t numFrames() const { return m_frameOffsets.size(); }
+
+    // RECORD
+    /**
+     * @brief encodes and appends a frame
+     *
+     * The first frame recorded becomes the reference positions the others are encoded against.
+    */
+    void writeFrame(const std::vector<ngl::Vec3> &_positions);
+
+private:
+    // MEMBER VARIABLES
+    std::FILE *m_file = nullptr;                /**< File being recorded into */
+    size_t m_numPoints = 0;                     /**< Number of points per frame */
+    uint64_t m_offset = 0;                      /**< Current write offset in the file */
+    std::vector<ngl::Vec3> m_reference;         /**< Reference positions, set from the first frame */
+    std::vector<uint64_t> m_frameOffsets;       /**< File offset of each frame block */
+    std::vector<uint8_t> m_encoded;             /**< Encoding buffer, reused between frames */
+};
+
+/**
+ * @class PointCacheReader
+ * @brief memory maps a point cache file and decodes any frame on request
+*/
+class PointCacheReader
+{
+public:
+    // CONSTRUCTORS
+    /**
+     * @brief default constructor, no file open
+    */
+    PointCacheReader()=default;
+    /**
+     * @brief destructor, unmaps the file
+    */
+    ~PointCacheReader();
+    /**
+     * @brief the reader owns the mapping, so no copies
+    */
+    PointCacheReader(const PointCacheReader &)=delete;
+    PointCacheReader &operator=(const PointCacheReader &)=delete;
+
+    // OPEN/CLOSE
+    /**
+     * @brief maps a finished cache file
+     * @returns false if the file is missing, unfinished or not a point cache
+    */
+    bool open(const std::string &_filename);
+    /**
+     * @brief unmaps the current file
+    */
+    void close();
+
+    // GETTERS
+    /**
+     * @brief returns whether or not a file is mapped
+    */
+    bool isOpen() const { return m_data != nullptr; }
+    /**
+     * @brief returns the number of points per frame
+    */
+    size_t numPoints() const { return m_numPoints; }
+    /**
+     * @brief returns the number of triangles in the cached mesh
+    */
+    size_t numTriangles() const { return m_numTriangles; }
+    /**
+     * @brief returns the number of frames in the file
+    */
+    size_t numFrames() const { return m_numFrames; }
+    /**
+     * @brief fills the list with the UV coordinates of each point
+    */
+    void uvs(std::vector<ngl::Vec2> &o_uvs) const;
+    /**
+     * @brief fills the list with the triangle indices, 3 per triangle
+    */
+    void indices(std::vector<size_t> &o_indices) const;
+
+    // DECODE
+    /**
+     * @brief decodes the given frame without touching any other frame
+     * @returns false if the frame is out of range or damaged
+    */
+    bool readFrame(size_t _frame, std::vector<ngl::Vec3> &o_positions) const;
+
+private:
+    // MEMBER VARIABLES
+    const uint8_t *m_data = nullptr;        /**< Start of the mapped file */
+    size_t m_size = 0;                      /**< Size of the mapped file */
+    size_t m_numPoints = 0;                 /**< Number of points per frame */
+    size_t m_numTriangles = 0;              /**< Number of triangles in the cached mesh */
+    size_t m_numFrames = 0;                 /**< Number of frames in the file */
+    const uint8_t *m_uvs = nullptr;         /**< Mapped UV block */
+    const uint8_t *m_indices = nullptr;     /**< Mapped triangle index block */
+    const uint8_t *m_reference = nullptr;   /**< Mapped reference positions */
+    const uint8_t *m_frameTable = nullptr;  /**< Mapped frame table */
+};
+
+#endif
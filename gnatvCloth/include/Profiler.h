@@ -0,0 +1,124 @@
+/**
+ * @file Profiler.h
+ * @brief Scoped phase timers recorded into a ring buffer, exportable as a Chrome trace
+ * @author Rachel Strohkorb
+ *
+ * Timers are placed with GNATV_PROFILE_SCOPE("name") and only compiled in when
+ * GNATV_PROFILING is defined (qmake CONFIG+=profiling), so they cost nothing otherwise.
+ * The trace written by writeChromeTrace opens in chrome://tracing or ui.perfetto.dev.
+*/
+
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @class Profiler
+ * @brief process wide ring buffer of timed phases
+ *
+ * Recording is lock-free, each event claims the next slot in the ring, and once the ring is
+ * full the oldest events are overwritten. Reading the events while other threads are still
+ * recording can pick up a slot mid-write, so export between steps, as
+ * ClothInterface::writeProfileTrace does with a running sim.
+*/
+class Profiler
+{
+public:
+    /**
+     * @struct Event
+     * @brief one timed phase, times in nanoseconds since the profiler was created
+    */
+    struct Event
+    {
+        const char *name;
+        uint64_t start;
+        uint64_t duration;
+        uint32_t thread;
+    };
+
+    /**
+     * @brief returns the profiler
+    */
+    static Profiler &instance();
+    /**
+     * @brief returns the current time in nanoseconds since the profiler was created
+    */
+    uint64_t now() const;
+    /**
+     * @brief returns a small id for the calling thread, stable for the thread's lifetime
+    */
+    static uint32_t threadId();
+
+    // RECORD
+    /**
+     * @brief adds a phase to the ring
+     * @param _name phase name, must outlive the profiler (a string literal)
+    */
+    void record(const char *_name, uint64_t _start, uint64_t _duration);
+    /**
+     * @brief throws away everything recorded so far
+    */
+    void clear() { m_next = 0; }
+
+    // READ/EXPORT
+    /**
+     * @brief returns the number of slots in the ring
+    */
+    size_t capacity() const { return m_events.size(); }
+    /**
+     * @brief returns the events still in the ring, oldest first
+    */
+    std::vector<Event> events() const;
+    /**
+     * @brief writes the events out in the Chrome trace-event JSON format
+     * @returns false if the file couldn't be written
+    */
+    bool writeChromeTrace(const std::string &_filename) const;
+
+private:
+    /**
+     * @brief creates the ring, use instance()
+    */
+    Profiler(size_t _capacity);
+
+    // MEMBER VARIABLES
+    std::vector<Event> m_events;                    /**< Ring of events */
+    std::atomic<uint64_t> m_next{0};                /**< Total events recorded, next slot is m_next % capacity */
+    std::chrono::steady_clock::time_point m_epoch;  /**< Time the profiler was created */
+};
+
+/**
+ * @class ProfileScope
+ * @brief times from construction to destruction and records the phase, use GNATV_PROFILE_SCOPE
+*/
+class ProfileScope
+{
+public:
+    explicit ProfileScope(const char *_name) : m_name(_name), m_start(Profiler::instance().now()) {}
+    ~ProfileScope()
+    {
+        auto &profiler = Profiler::instance();
+        profiler.record(m_name, m_start, profiler.now() - m_start);
+    }
+    ProfileScope(const ProfileScope &)=delete;
+    ProfileScope &operator=(const ProfileScope &)=delete;
+
+private:
+    const char *m_name;     /**< Phase name */
+    uint64_t m_start;       /**< Start time */
+};
+
+#if defined(GNATV_PROFILING)
+#define GNATV_PROFILE_CONCAT_(a, b) a##b
+#define GNATV_PROFILE_CONCAT(a, b) GNATV_PROFILE_CONCAT_(a, b)
+#define GNATV_PROFILE_SCOPE(_name) ProfileScope GNATV_PROFILE_CONCAT(profileScope_, __LINE__)(_name)
+#else
+#define GNATV_PROFILE_SCOPE(_name)
+#endif
+
+#endif
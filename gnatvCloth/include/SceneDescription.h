@@ -0,0 +1,107 @@
+/**
+ * @file SceneDescription.h
+ * @brief Text description of a cloth scene, for running the sim without the UI
+ * @author Rachel Strohkorb
+ *
+ * One setting per line, a keyword followed by its values, # starts a comment:
+ *
+ *  mesh clothLowResXZ.obj          .obj file, relative to the scene file
+ *  grid 100 100                    or a generated n x m grid (see ClothGrid), instead of a mesh
+ *  plane xz                        toParam plane, xy or xz
+ *  material wool                   wool, jute or custom (graphsFromUI data)
+ *  integrator cgm                  cgm, rk4, symplectic, verlet, rk45 or imex
+ *  dt 0.01                         time step
+ *  steps 200                       number of steps to run
+ *  damping 9.0                     damping coefficient
+ *  fixed 0 1 2 3                   masspoint ids held in place (may be repeated)
+ *  wind 1.0 0.0 1.0                turns gusty wind on, the mean air velocity in m/s (see WindField)
+ *  selfcollision 0.05              turns self collision on, the thickness is optional (see Cloth::setSelfCollision)
+ *  jacobianreuse 0.001             keeps the cgm/imex system between steps, the tolerance is optional (see Cloth::setJacobianReuse)
+ *  obstacle table.obj 0.05         static obstacle, the distance grid spacing is optional (may be repeated)
+ *  objsequence results/bake frame  write an obj per step, directory then prefix
+ *  pointcache results/bake.pc      record every step into a point cache
+ *  telemetry results/cg.csv csv    stream the CG solver statistics, csv or binary
+ *
+ * A scene can also describe a parameter sweep, run by ClothEnsemble. Every combination of the
+ * swept values is run, anything not swept comes from the settings above:
+ *
+ *  sweep damping 3 6 9 12          damping coefficients
+ *  sweep wind 0 0.5 1              wind strengths, multiplying the wind velocity (0 for no wind)
+ *  sweep material wool jute        materials
+ *  sweep dt 0.005 0.01             time steps
+*/
+
+#ifndef SCENEDESCRIPTION_H_
+#define SCENEDESCRIPTION_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <ngl/Vec3.h>
+#include "Cloth.h"
+#include "Obstacle.h"
+
+/**
+ * @struct SceneObstacle
+ * @brief an obstacle listed in a scene
+*/
+struct SceneObstacle
+{
+    std::string mesh;       /**< Path to the obstacle's .obj file */
+    float cellSize = 0.0f;  /**< Distance grid spacing, 0 for automatic */
+};
+
+/**
+ * @struct SceneDescription
+ * @brief everything needed to set up and run a cloth sim, read from a scene file
+*/
+struct SceneDescription
+{
+    std::string mesh;                   /**< Path to the .obj file */
+    size_t gridN = 0;                   /**< Grid masspoints along the weft, 0 to use the mesh */
+    size_t gridM = 0;                   /**< Grid masspoints along the warp */
+    bool planeXY = false;               /**< Whether the toParam plane is XY (otherwise XZ) */
+    material_type material = WOOL;      /**< Cloth material */
+    IntegrationMethod integrator = CGM; /**< How to step the cloth forward */
+    float dt = 0.01f;                   /**< Time step */
+    size_t steps = 100;                 /**< Number of steps to run */
+    float damping = 9.0f;               /**< Damping coefficient */
+    std::vector<size_t> fixedPoints;    /**< Masspoints held in place */
+    bool windOn = false;                /**< Whether or not the wind is on */
+    ngl::Vec3 wind = ngl::Vec3(1.0f, 0.0f, 1.0f);   /**< Mean air velocity of the wind */
+    bool selfCollision = false;         /**< Whether or not the cloth collides with itself */
+    float collisionThickness = 0.0f;    /**< Self collision thickness, 0 for automatic */
+    bool jacobianReuse = false;         /**< Whether or not cgm/imex keep their system between steps */
+    float reuseTolerance = 1e-3f;       /**< How far the triangles can move before the system is rebuilt */
+    std::vector<SceneObstacle> obstacles;   /**< Static obstacles */
+    std::string objSequenceDir;         /**< Directory for the obj sequence, empty for none */
+    std::string objSequencePrefix = "frame";        /**< Prefix of the obj sequence files */
+    std::string pointCache;             /**< Point cache file, empty for none */
+    std::string telemetry;              /**< Solver telemetry file, empty for none */
+    bool telemetryBinary = false;       /**< Whether the telemetry is binary (otherwise CSV) */
+
+    std::vector<float> sweepDamping;            /**< Swept damping coefficients */
+    std::vector<float> sweepWind;               /**< Swept wind strengths */
+    std::vector<material_type> sweepMaterial;   /**< Swept materials */
+    std::vector<float> sweepDt;                 /**< Swept time steps */
+
+    /**
+     * @brief returns whether or not the scene sweeps any parameter
+    */
+    bool isSweep() const { return !(sweepDamping.empty() && sweepWind.empty() && sweepMaterial.empty() && sweepDt.empty()); }
+
+    /**
+     * @brief reads the scene from file
+     * @param o_error set to a description of the first problem found
+     * @returns false if the file couldn't be read or has a bad line
+    */
+    bool load(const std::string &_filename, std::string &o_error);
+    /**
+     * @brief loads the distance grid of every obstacle, building any that aren't cached
+     * @param o_error set to the obstacle that couldn't be read
+     * @returns the obstacles that could be read
+    */
+    std::vector<std::shared_ptr<const Obstacle>> loadObstacles(std::string &o_error) const;
+};
+
+#endif
@@ -0,0 +1,136 @@
+/**
+ * @file SelfCollision.h
+ * @brief Bounding volume hierarchy over a cloth's triangles, for finding where the cloth comes close to itself
+ * @author Rachel Strohkorb
+ *
+ * The hierarchy is built once from the triangle topology (median splits of the rest positions)
+ * and after that only refit: each step the leaf boxes are recomputed from the current positions
+ * and the internal boxes grown to fit their children. A cloth's triangles stay next to the same
+ * neighbours however it moves, so the tree stays tight enough without ever being rebuilt.
+ *
+ * Boxes are swept over the step, from x to x + h v, so a query also finds features that are
+ * about to come within range. Contacts are vertex-triangle (a vertex near a triangle it isn't a
+ * corner of) and edge-edge (two edges sharing no vertex), see Cloth::setSelfCollision for the
+ * response. A query walks the tree against itself once to get the pairs of triangles whose
+ * boxes come within the thickness, then tests their features. Each vertex and edge is only
+ * tested from one of its triangles, its owner, so no pair of features is found twice.
+*/
+
+#ifndef SELFCOLLISION_H_
+#define SELFCOLLISION_H_
+
+#include <array>
+#include <vector>
+#include <ngl/Vec3.h>
+
+/**
+ * @brief returns the barycentric weights of the point on triangle abc closest to p
+ * (Ericson, Real-Time Collision Detection 5.1.5)
+*/
+ngl::Vec3 closestPointOnTriangle(const ngl::Vec3 &_p, const ngl::Vec3 &_a, const ngl::Vec3 &_b, const ngl::Vec3 &_c);
+
+/**
+ * @struct CollisionContact
+ * @brief two features of the cloth within range of each other
+*/
+struct CollisionContact
+{
+    bool edgeEdge = false;          /**< Edge-edge, otherwise vertex-triangle */
+    size_t points[4] = {0, 0, 0, 0};    /**< Vertex then the triangle's corners, or the first edge then the second */
+    float weights[4] = {0.0f, 0.0f, 0.0f, 0.0f};   /**< Signed weights, sum of weight * x is the separation vector */
+    ngl::Vec3 normal;               /**< Unit direction from the second feature to the first */
+    float distance = 0.0f;          /**< Separation along the normal */
+};
+
+/**
+ * @class SelfCollision
+ * @brief refittable BVH over a triangle mesh with vertex-triangle and edge-edge proximity queries
+*/
+class SelfCollision
+{
+public:
+    /**
+     * @brief builds the hierarchy and edge list for the given triangles
+     * @param _positions masspoint positions to split on
+     * @param _indices three masspoint ids per triangle
+    */
+    void build(const std::vector<ngl::Vec3> &_positions, const std::vector<size_t> &_indices);
+    /**
+     * @brief returns whether or not build has been called with any triangles
+    */
+    bool empty() const { return m_nodes.empty(); }
+    /**
+     * @brief returns the number of nodes in the hierarchy
+    */
+    size_t numNodes() const { return m_nodes.size(); }
+    /**
+     * @brief returns the bytes held by the hierarchy, triangle and edge lists
+    */
+    size_t memoryBytes() const;
+    /**
+     * @brief refits every box to the triangles swept over the step, leaves first
+    */
+    void refit(const std::vector<ngl::Vec3> &_positions, const std::vector<ngl::Vec3> &_velocities, float _h);
+    /**
+     * @brief finds every pair of features within _thickness of each other, now or at some point in the step
+     *
+     * A pair is reported if its current distance is under _thickness plus how far the two
+     * could close over the step. Call refit first. The triangle pairs are split into chunks
+     * whose vertex-triangle and edge-edge tests run in parallel with OpenMP, the contacts come
+     * out in the same order either way.
+     * @param _parallel whether or not the queries run in parallel
+    */
+    void findContacts(const std::vector<ngl::Vec3> &_positions, const std::vector<ngl::Vec3> &_velocities,
+                      float _h, float _thickness, bool _parallel, std::vector<CollisionContact> &o_contacts) const;
+    /**
+     * @brief returns the first triangle hit by the ray from _origin along _direction, -1 if it misses
+     *
+     * Call refit first, with _h 0 for boxes around the current positions. Subtrees are skipped
+     * once their box is further along the ray than the nearest hit so far.
+     * @param o_t how far along _direction the hit is
+     * @param o_weights barycentric weights of the hit on the triangle's corners
+    */
+    long raycast(const std::vector<ngl::Vec3> &_positions, const ngl::Vec3 &_origin, const ngl::Vec3 &_direction,
+                 float &o_t, ngl::Vec3 &o_weights) const;
+    /**
+     * @brief returns the three masspoint ids of the given triangle
+    */
+    std::array<size_t, 3> triangle(size_t _t) const { return {m_indices[3 * _t], m_indices[3 * _t + 1], m_indices[3 * _t + 2]}; }
+
+private:
+    /**
+     * @struct Node
+     * @brief box around a subtree, a leaf holds one triangle
+    */
+    struct Node
+    {
+        ngl::Vec3 min;          /**< Lower corner of the box */
+        ngl::Vec3 max;          /**< Upper corner of the box */
+        size_t left = 0;        /**< Index of the left child, children always come after their parent */
+        size_t right = 0;       /**< Index of the right child */
+        long triangle = -1;     /**< Triangle held by a leaf, -1 for internal nodes */
+    };
+
+    /**
+     * @brief builds the subtree over _tris[_begin, _end), returns its root index
+    */
+    size_t buildNode(std::vector<size_t> &io_tris, size_t _begin, size_t _end, const std::vector<ngl::Vec3> &_centroids);
+    /**
+     * @brief appends every pair of leaves under _node whose boxes come within _margin
+    */
+    void selfPairs(size_t _node, float _margin, std::vector<std::array<size_t, 2>> &io_pairs) const;
+    /**
+     * @brief appends every pair of leaves, one under each node, whose boxes come within _margin
+    */
+    void nodePairs(size_t _a, size_t _b, float _margin, std::vector<std::array<size_t, 2>> &io_pairs) const;
+
+    std::vector<Node> m_nodes;                      /**< The hierarchy, root first */
+    std::vector<size_t> m_indices;                  /**< Three masspoint ids per triangle */
+    std::vector<std::array<size_t, 2>> m_edges;     /**< Every edge once, lower id first */
+    std::vector<std::array<size_t, 3>> m_triEdges;  /**< Edge indices of each triangle */
+    std::vector<size_t> m_pointOwner;               /**< First triangle of each masspoint */
+    std::vector<size_t> m_edgeOwner;                /**< First triangle of each edge */
+    size_t m_numPoints = 0;                         /**< Masspoints the mesh was built with */
+};
+
+#endif
@@ -0,0 +1,110 @@
+/**
+ * @file SolverTelemetry.h
+ * @brief Per-step statistics from the CG solver, streamed out to CSV or binary files
+ * @author Rachel Strohkorb
+ *
+ * CSV layout, one row per CG solve:
+ *  step,material,masspoints,h,iterations,capped,rstest,rsfinal,precon_min,precon_max,residuals
+ * where residuals is the preconditioned residual (r.z) before the first iteration and after
+ * every iteration, separated by ';'.
+ *
+ * Binary layout: the magic "GNTVTEL1", then per solve the step (uint64), material (uint32),
+ * masspoints (uint64), h, rstest, precon min/max (float32), iterations (uint64), capped (uint8),
+ * the residual count (uint64) and the residuals (float32), in native byte order.
+*/
+
+#ifndef SOLVERTELEMETRY_H_
+#define SOLVERTELEMETRY_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/**
+ * @struct SolverStepStats
+ * @brief what the CG solver did in one step
+*/
+struct SolverStepStats
+{
+    uint32_t material = 0;          /**< Cloth material (material_type) */
+    size_t masspoints = 0;          /**< Number of masspoints, also the iteration cap */
+    float h = 0.0f;                 /**< Time step */
+    size_t iterations = 0;          /**< Iterations run */
+    bool capped = false;            /**< Whether the solve stopped at the iteration cap rather than converging */
+    float rstest = 0.0f;            /**< Convergence reference, the solve stops at rs < epsilon * rstest */
+    float preconMin = 0.0f;         /**< Smallest preconditioner diagonal entry */
+    float preconMax = 0.0f;         /**< Largest preconditioner diagonal entry */
+    std::vector<float> residuals;   /**< r.z before the first iteration then after each one */
+};
+
+/**
+ * @class SolverTelemetry
+ * @brief sink for solver statistics, see Cloth::setSolverTelemetry
+*/
+class SolverTelemetry
+{
+public:
+    /**
+     * @enum Format
+     * @brief file formats the stats can be streamed out in
+    */
+    enum Format {CSV, BINARY};
+
+    // CONSTRUCTORS
+    /**
+     * @brief default constructor, no file open
+    */
+    SolverTelemetry()=default;
+    /**
+     * @brief destructor, closes the file
+    */
+    ~SolverTelemetry();
+    /**
+     * @brief the sink owns a file handle, so no copies
+    */
+    SolverTelemetry(const SolverTelemetry &)=delete;
+    SolverTelemetry &operator=(const SolverTelemetry &)=delete;
+
+    // OPEN/CLOSE
+    /**
+     * @brief starts a new telemetry file, step numbering starts again from 0
+     * @returns false if the file couldn't be opened
+    */
+    bool open(const std::string &_filename, Format _format);
+    /**
+     * @brief flushes and closes the file
+    */
+    void close();
+
+    // GETTERS
+    /**
+     * @brief returns whether or not a file is open
+    */
+    bool isOpen() const { return m_file != nullptr; }
+    /**
+     * @brief returns the number of steps recorded into the current file
+    */
+    size_t numSteps() const { return m_step; }
+
+    // RECORD
+    /**
+     * @brief appends one solve to the file
+    */
+    void record(const SolverStepStats &_stats);
+
+    // READ
+    /**
+     * @brief reads back a binary telemetry file
+     * @returns false if the file is missing, truncated or not a telemetry file
+    */
+    static bool readBinary(const std::string &_filename, std::vector<SolverStepStats> &o_steps);
+
+private:
+    // MEMBER VARIABLES
+    std::FILE *m_file = nullptr;    /**< File being streamed into */
+    Format m_format = CSV;          /**< Format of the open file */
+    size_t m_step = 0;              /**< Steps recorded into the open file */
+};
+
+#endif
@@ -0,0 +1,68 @@
+/**
+ * @file SpscQueue.h
+ * @brief Lock-free bounded queue with a single producer and a single consumer
+ * @author Rachel Strohkorb
+*/
+
+#ifndef SPSCQUEUE_H_
+#define SPSCQUEUE_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+/**
+ * @class SpscQueue
+ * @brief fixed size ring buffer, one thread pushes and one other thread pops
+ *
+ * One slot is always left empty to tell a full queue from an empty one, so the queue
+ * holds at most _capacity - 1 items.
+*/
+template <typename T, size_t _capacity>
+class SpscQueue
+{
+public:
+    // PRODUCER
+    /**
+     * @brief moves the item onto the back of the queue
+     * @returns false (leaving _item untouched) if the queue is full
+    */
+    bool push(T &&_item)
+    {
+        auto tail = m_tail.load(std::memory_order_relaxed);
+        auto next = (tail + 1) % _capacity;
+        if(next == m_head.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        m_items[tail] = std::move(_item);
+        m_tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // CONSUMER
+    /**
+     * @brief moves the front item out of the queue
+     * @returns false if the queue is empty
+    */
+    bool pop(T &o_item)
+    {
+        auto head = m_head.load(std::memory_order_relaxed);
+        if(head == m_tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        o_item = std::move(m_items[head]);
+        m_head.store((head + 1) % _capacity, std::memory_order_release);
+        return true;
+    }
+
+private:
+    // MEMBER VARIABLES
+    std::array<T, _capacity> m_items;   /**< Ring of items */
+    std::atomic<size_t> m_head{0};      /**< Next item to pop, written by the consumer */
+    std::atomic<size_t> m_tail{0};      /**< Next free slot, written by the producer */
+};
+
+#endif
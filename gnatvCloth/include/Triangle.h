@@ -85,6 +85,10 @@ public:
      * @brief sets the UV coordinates of the third vertex
     */
     void setUV3(const ngl::Vec2 _uv3) { m_cUV = _uv3; }
+    /**
+     * @brief sets previously computed resting state weights, see computeR
+    */
+    void setR(const ngl::Vec3 _ru, const ngl::Vec3 _rv) { m_ru = _ru; m_rv = _rv; }
 
     // STATE OPERATORS
     /**
@@ -100,6 +104,10 @@ public:
      * state.
     */
     void computeR(std::function<ngl::Vec2(ngl::Vec3)> _toParam);
+    /**
+     * @brief returns the surface area of the triangle with vertices _a, _b and _c
+    */
+    static float area(const ngl::Vec3 &_a, const ngl::Vec3 &_b, const ngl::Vec3 &_c);
 
 private:
     // HELPER FUNCTIONS
@@ -0,0 +1,71 @@
+/**
+ * @file TripleBuffer.h
+ * @brief Lock-free triple buffer for handing the latest state from one thread to another
+ * @author Rachel Strohkorb
+*/
+
+#ifndef TRIPLEBUFFER_H_
+#define TRIPLEBUFFER_H_
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @class TripleBuffer
+ * @brief single writer/single reader handoff where neither side ever waits on the other
+ *
+ * The writer fills writeBuffer() and publishes it, the reader picks up the newest published
+ * buffer with update(). The third buffer sits in the middle, so the writer always has a free
+ * buffer to fill and the reader's buffer is never touched until it asks for a new one.
+ * Frames the reader doesn't get to in time are simply replaced.
+*/
+template <typename T>
+class TripleBuffer
+{
+public:
+    // WRITER
+    /**
+     * @brief returns the buffer the writer fills, owned by the writer until publish
+    */
+    T &writeBuffer() { return m_buffers[m_write]; }
+    /**
+     * @brief hands the write buffer over to the reader, the writer gets the old middle buffer back
+    */
+    void publish()
+    {
+        auto old = m_middle.exchange(static_cast<uint8_t>(m_write | c_fresh), std::memory_order_acq_rel);
+        m_write = old & c_index;
+    }
+
+    // READER
+    /**
+     * @brief swaps in the newest published buffer
+     * @returns false if nothing has been published since the last update
+    */
+    bool update()
+    {
+        if(!(m_middle.load(std::memory_order_relaxed) & c_fresh))
+        {
+            return false;
+        }
+        auto old = m_middle.exchange(m_read, std::memory_order_acq_rel);
+        m_read = old & c_index;
+        return true;
+    }
+    /**
+     * @brief returns the buffer the reader currently holds
+    */
+    const T &readBuffer() const { return m_buffers[m_read]; }
+
+private:
+    static constexpr uint8_t c_index = 0x3;     /**< Bits holding the buffer index in m_middle */
+    static constexpr uint8_t c_fresh = 0x4;     /**< Bit set in m_middle when it holds an unread buffer */
+
+    // MEMBER VARIABLES
+    T m_buffers[3];                     /**< The three buffers */
+    uint8_t m_write = 0;                /**< Buffer owned by the writer */
+    std::atomic<uint8_t> m_middle{1};   /**< Buffer in between, plus the fresh bit */
+    uint8_t m_read = 2;                 /**< Buffer owned by the reader */
+};
+
+#endif
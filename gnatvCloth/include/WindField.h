@@ -0,0 +1,77 @@
+/**
+ * @file WindField.h
+ * @brief The sim's wind, an air velocity that varies over time and space
+ * @author Rachel Strohkorb
+ *
+ * The wind is a mean velocity scaled by a gust factor that rises and falls smoothly over time,
+ * plus turbulence: coherent noise over space, carried along with the mean wind, so neighbouring
+ * parts of the cloth feel much the same wind and the pattern sweeps across it. Both are value
+ * noise built from a hash of the lattice point and the seed, so the field holds no random state,
+ * is the same for the same seed, and can be evaluated from any number of threads at once.
+ *
+ * The field only gives the air's velocity, Cloth turns it into drag and lift on each triangle
+ * (see Cloth::setWind). A default constructed field is still air.
+*/
+
+#ifndef WINDFIELD_H_
+#define WINDFIELD_H_
+
+#include <cstdint>
+#include <ngl/Vec3.h>
+
+/**
+ * @class WindField
+ * @brief gusty, turbulent wind velocity as a function of position and time
+*/
+class WindField
+{
+public:
+    /**
+     * @brief still air
+    */
+    WindField() = default;
+    /**
+     * @brief wind blowing along _mean, with the default gusts and turbulence
+     * @param _mean mean air velocity, in m/s
+     * @param _seed picks the gust and turbulence pattern
+    */
+    WindField(const ngl::Vec3 &_mean, uint32_t _seed = 0) : m_mean(_mean), m_seed(_seed) {;}
+    /**
+     * @brief returns the mean air velocity
+    */
+    ngl::Vec3 mean() const { return m_mean; }
+    /**
+     * @brief returns whether or not the air is still everywhere, always
+    */
+    bool still() const { return m_mean == ngl::Vec3(0.0f); }
+    /**
+     * @brief sets how much the gusts change the wind's strength, and over how long
+     * @param _strength the gust factor ranges over 1 +- _strength (never below 0)
+     * @param _period seconds between independent gust values
+    */
+    void setGusts(float _strength, float _period);
+    /**
+     * @brief sets how much the wind varies over space, and over what distance
+     * @param _strength turbulent velocity as a fraction of the mean wind speed, per axis
+     * @param _scale distance between independent turbulence values
+    */
+    void setTurbulence(float _strength, float _scale);
+    /**
+     * @brief returns the factor the gusts scale the wind by at time _t
+    */
+    float gust(float _t) const;
+    /**
+     * @brief returns the air velocity at _p at time _t
+    */
+    ngl::Vec3 velocity(const ngl::Vec3 &_p, float _t) const;
+
+private:
+    ngl::Vec3 m_mean = ngl::Vec3(0.0f); /**< Mean air velocity */
+    uint32_t m_seed = 0;                /**< Picks the noise pattern */
+    float m_gustStrength = 0.5f;        /**< Gust factor range around 1 */
+    float m_gustPeriod = 2.0f;          /**< Seconds between gust lattice points */
+    float m_turbulence = 0.3f;          /**< Turbulent velocity as a fraction of the mean speed */
+    float m_turbulenceScale = 3.0f;     /**< Distance between turbulence lattice points */
+};
+
+#endif
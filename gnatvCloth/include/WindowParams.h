@@ -25,6 +25,10 @@ struct WinParams
      * @brief flag to indicate if the Right mouse button is pressed when dragging
     */
     bool translate=false;
+    /**
+     * @brief flag to indicate if a cloth point is being dragged (shift + left mouse button)
+    */
+    bool drag=false;
     /**
      * @brief the previous x mouse value
     */
@@ -1,71 +1,83 @@
 #include <iostream>
 #include <fstream>
 #include <numeric>
+#include <algorithm>
+#include <limits>
+#include <cmath>
 #include <unordered_map>
+#include <unordered_set>
 #include <boost/algorithm/string.hpp>
 #include "Materials.h"
 #include "Cloth.h"
+#include "MeshCache.h"
+#include "Profiler.h"
 
-Cloth::Cloth(material_type _mt)
+namespace
 {
-    // set mass and equation values for material
-    m_material = _mt;
-    switch(_mt)
-    {
-    case WOOL:
-    {
-        m_mass = wool_mass;
-        m_weft = boost::math::cubic_b_spline<float>(wool_weftData.begin(), wool_weftData.end(),
-                                                    wool_weftStart, wool_weftStep, 0.0f);
-        m_warp = boost::math::cubic_b_spline<float>(wool_warpData.begin(), wool_warpData.end(),
-                                                    wool_warpStart, wool_warpStep, 0.0f);
-        m_shear = boost::math::cubic_b_spline<float>(wool_shearData.begin(), wool_shearData.end(),
-                                                     0.0f, wool_shearStep);
-        m_shearOffset = wool_shearStart;
-    } break;
-    case JUTE:
+    /**
+     * @brief fraction of the way back out to the collision thickness a contact is moved per step,
+     * so a contact already inside it is eased out rather than thrown apart
+    */
+    const float c_separationRate = 0.1f;
+
+    /**
+     * @brief density of air, kg per cubic meter
+    */
+    const float c_airDensity = 1.225f;
+
+    /**
+     * @brief most sub-steps an explicit update is split into
+    */
+    const size_t c_maxSubsteps = 256;
+
+    /**
+     * @brief how many times the iterations of the first solve on a kept system the solves on it can
+     * take before it's rebuilt
+    */
+    const float c_iterationGrowth = 1.5f;
+
+    /**
+     * @brief classic 4th order Runge-Kutta
+    */
+    const ButcherTableau c_rk4 =
+    {
+        4,
+        {{0.0f}, {0.5f}, {0.0f, 0.5f}, {0.0f, 0.0f, 1.0f}},
+        {1.0f / 6.0f, 1.0f / 3.0f, 1.0f / 3.0f, 1.0f / 6.0f},
+        {0.0f}
+    };
+
+    /**
+     * @brief Dormand-Prince 5(4), the 7th stage is at the end of the step
+    */
+    const ButcherTableau c_dormandPrince =
     {
-        m_mass = jute_mass;
-        m_weft = boost::math::cubic_b_spline<float>(jute_weftData.begin(), jute_weftData.end(),
-                                                    jute_weftStart, jute_weftStep, 0.0f);
-        m_warp = boost::math::cubic_b_spline<float>(jute_warpData.begin(), jute_warpData.end(),
-                                                    jute_warpStart, jute_warpStep, 0.0f);
-        m_shear = boost::math::cubic_b_spline<float>(jute_shearData.begin(), jute_shearData.end(),
-                                                     0.0f, jute_shearStep);
-        m_shearOffset = jute_shearStart;
-    } break;
-    case CUSTOM:
+        7,
+        {
+            {0.0f},
+            {1.0f / 5.0f},
+            {3.0f / 40.0f, 9.0f / 40.0f},
+            {44.0f / 45.0f, -56.0f / 15.0f, 32.0f / 9.0f},
+            {19372.0f / 6561.0f, -25360.0f / 2187.0f, 64448.0f / 6561.0f, -212.0f / 729.0f},
+            {9017.0f / 3168.0f, -355.0f / 33.0f, 46732.0f / 5247.0f, 49.0f / 176.0f, -5103.0f / 18656.0f},
+            {35.0f / 384.0f, 0.0f, 500.0f / 1113.0f, 125.0f / 192.0f, -2187.0f / 6784.0f, 11.0f / 84.0f}
+        },
+        {35.0f / 384.0f, 0.0f, 500.0f / 1113.0f, 125.0f / 192.0f, -2187.0f / 6784.0f, 11.0f / 84.0f, 0.0f},
+        {71.0f / 57600.0f, 0.0f, -71.0f / 16695.0f, 71.0f / 1920.0f, -17253.0f / 339200.0f, 22.0f / 525.0f, -1.0f / 40.0f}
+    };
+
+    /**
+     * @brief reads one graph UI file, a start line, a step line then one stress value per line
+    */
+    bool readGraph(const std::string &_filename, MaterialCurve &o_curve)
     {
-        m_mass = wool_mass;
-        // read in from ui graph files
-        float custom_weftStart, custom_warpStart, custom_shearStart;
-        float custom_weftStep, custom_warpStep, custom_shearStep;
-        std::vector<float> custom_weftData, custom_warpData, custom_shearData;
-        std::ifstream in;
-        std::string line;
-        // weft file
-        in.open("graphsFromUI/weft_graphData.txt");
-        while(std::getline(in, line))
+        std::ifstream in(_filename);
+        if(!in)
         {
-            // split line
-            std::vector<std::string> res;
-            boost::split(res, line, [](char c){return c == ' ';});
-            if(res[0] == "start")
-            {
-                custom_weftStart = std::stof(res[1]);
-            }
-            else if(res[0] == "step")
-            {
-                custom_weftStep = std::stof(res[1]);
-            }
-            else
-            {
-                custom_weftData.push_back(std::stof(res[0]));
-            }
+            return false;
         }
-        in.close();
-        // warp file
-        in.open("graphsFromUI/warp_graphData.txt");
+        o_curve.data.clear();
+        std::string line;
         while(std::getline(in, line))
         {
             // split line
@@ -73,98 +85,390 @@ Cloth::Cloth(material_type _mt)
             boost::split(res, line, [](char c){return c == ' ';});
             if(res[0] == "start")
             {
-                custom_warpStart = std::stof(res[1]);
+                o_curve.start = std::stof(res[1]);
             }
             else if(res[0] == "step")
             {
-                custom_warpStep = std::stof(res[1]);
+                o_curve.step = std::stof(res[1]);
             }
-            else
+            else if(!res[0].empty())
             {
-                custom_warpData.push_back(std::stof(res[0]));
+                o_curve.data.push_back(std::stof(res[0]));
             }
         }
-        in.close();
-        // shear file
-        in.open("graphsFromUI/shear_graphData.txt");
-        while(std::getline(in, line))
+        return true;
+    }
+
+    /**
+     * @brief writes one graph UI file, the same layout VisGraph::outputGraphToFile writes
+    */
+    bool writeGraph(const std::string &_filename, const MaterialCurve &_curve)
+    {
+        std::ofstream out(_filename, std::ofstream::out | std::ofstream::trunc);
+        out << "start " << _curve.start << "f\n";
+        out << "step " << _curve.step << "f\n";
+        for(auto y : _curve.data)
         {
-            // split line
-            std::vector<std::string> res;
-            boost::split(res, line, [](char c){return c == ' ';});
-            if(res[0] == "start")
-            {
-                custom_shearStart = std::stof(res[1]);
-            }
-            else if(res[0] == "step")
-            {
-                custom_shearStep = std::stof(res[1]);
-            }
-            else
-            {
-                custom_shearData.push_back(std::stof(res[0]));
-            }
+            out << y << '\n';
         }
-        in.close();
-        // set the material properties
-        m_weft = boost::math::cubic_b_spline<float>(custom_weftData.begin(), custom_weftData.end(),
-                                                    custom_weftStart, custom_weftStep, 0.0f);
-        m_warp = boost::math::cubic_b_spline<float>(custom_warpData.begin(), custom_warpData.end(),
-                                                    custom_warpStart, custom_warpStep, 0.0f);
-        m_shear = boost::math::cubic_b_spline<float>(custom_shearData.begin(), custom_shearData.end(),
-                                                     0.0f, custom_shearStep);
-        m_shearOffset = custom_shearStart;
+        return static_cast<bool>(out);
+    }
+}
+
+MaterialData MaterialData::standard(material_type _mt)
+{
+    MaterialData material;
+    switch(_mt)
+    {
+    case WOOL:
+    {
+        material.mass = wool_mass;
+        material.weft = {wool_weftStart, wool_weftStep, wool_weftData};
+        material.warp = {wool_warpStart, wool_warpStep, wool_warpData};
+        material.shear = {wool_shearStart, wool_shearStep, wool_shearData};
+    } break;
+    case JUTE:
+    {
+        material.mass = jute_mass;
+        material.weft = {jute_weftStart, jute_weftStep, jute_weftData};
+        material.warp = {jute_warpStart, jute_warpStep, jute_warpData};
+        material.shear = {jute_shearStart, jute_shearStep, jute_shearData};
+    } break;
+    case CUSTOM:
+    {
+        // read in from ui graph files
+        material.mass = wool_mass;
+        material.readGraphs("graphsFromUI");
     } break;
     }
+    return material;
+}
+
+bool MaterialData::readGraphs(const std::string &_dir)
+{
+    bool ok = readGraph(_dir + "/weft_graphData.txt", weft);
+    ok = readGraph(_dir + "/warp_graphData.txt", warp) && ok;
+    return readGraph(_dir + "/shear_graphData.txt", shear) && ok;
+}
+
+bool MaterialData::writeGraphs(const std::string &_dir) const
+{
+    bool ok = writeGraph(_dir + "/weft_graphData.txt", weft);
+    ok = writeGraph(_dir + "/warp_graphData.txt", warp) && ok;
+    return writeGraph(_dir + "/shear_graphData.txt", shear) && ok;
+}
+
+Cloth::Cloth(material_type _mt)
+{
+    // set mass and equation values for material
+    m_material = _mt;
+    setMaterial(MaterialData::standard(_mt));
+}
+
+Cloth::Cloth(const MaterialData &_material)
+{
+    m_material = CUSTOM;
+    setMaterial(_material);
+}
+
+void Cloth::setMaterial(const MaterialData &_material)
+{
+    m_materialData = _material;
+    m_mass = _material.mass;
+    // weft and warp have no stiffness at zero strain, shear is shifted to start at 0
+    m_weft = boost::math::cubic_b_spline<float>(_material.weft.data.begin(), _material.weft.data.end(),
+                                                _material.weft.start, _material.weft.step, 0.0f);
+    m_warp = boost::math::cubic_b_spline<float>(_material.warp.data.begin(), _material.warp.data.end(),
+                                                _material.warp.start, _material.warp.step, 0.0f);
+    m_shear = boost::math::cubic_b_spline<float>(_material.shear.data.begin(), _material.shear.data.end(),
+                                                 0.0f, _material.shear.step);
+    m_shearOffset = _material.shear.start;
 }
 
 void Cloth::init(std::string _filename, std::function<ngl::Vec2(ngl::Vec3)> _toParam,
                  std::vector<size_t> _corners, float _dampingCoefficient)
 {
-    // read in object data
-    readObj(_filename);
+    // try the precomputed mesh cache first, keyed on the parametric plane and checked against the obj
+    uint64_t cacheKey = 0;
+    bool fromCache = false;
+    if(m_useMeshCache)
+    {
+        cacheKey = MeshCache::makeKey(_filename, _toParam);
+        fromCache = readCache(_filename, cacheKey);
+    }
+    if(!fromCache)
+    {
+        // read in object data
+        std::vector<Triref> triangles;
+        readObj(_filename, triangles);
+        auto sparsity = setupMesh(std::move(triangles), _toParam);
+        // save the results for next time
+        if(m_useMeshCache && !m_mspts.empty())
+        {
+            writeCache(_filename, cacheKey, sparsity);
+        }
+    }
+    finishInit(_corners, _dampingCoefficient);
+}
+
+void Cloth::init(const ClothGrid &_grid, std::vector<size_t> _corners, float _dampingCoefficient)
+{
+    // masspoints and triangles straight from the grid
+    auto &positions = _grid.positions();
+    auto &uvs = _grid.uvs();
+    auto &indices = _grid.indices();
+    m_mspts.reserve(positions.size());
+    for(size_t i = 0; i < positions.size(); ++i)
+    {
+        m_mspts.push_back(MassPoint(positions[i], i));
+    }
+    std::vector<Triref> triangles;
+    triangles.reserve(indices.size() / 3);
+    for(size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        Triref tr;
+        tr.a = indices[i];
+        tr.b = indices[i + 1];
+        tr.c = indices[i + 2];
+        tr.tri.setUV1(uvs[tr.a]);
+        tr.tri.setUV2(uvs[tr.b]);
+        tr.tri.setUV3(uvs[tr.c]);
+        triangles.push_back(tr);
+    }
+    setupMesh(std::move(triangles), _grid.toParam());
+    finishInit(_corners, _dampingCoefficient);
+}
+
+std::vector<std::vector<size_t>> Cloth::setupMesh(std::vector<Triref> _triangles, std::function<ngl::Vec2(ngl::Vec3)> _toParam)
+{
     // finish creating triangles, compute r-weights
-    for(auto& tr : m_triangles)
+    for(auto& tr : _triangles)
     {
         tr.tri.setVertices(m_mspts[tr.a].pos(), m_mspts[tr.b].pos(), m_mspts[tr.c].pos());
         tr.tri.computeR(_toParam);
     }
+    m_rest = std::make_shared<const RestMesh>(RestMesh{std::move(_triangles)});
+    updateAreas();
     // determine mass of the masspoints
     std::vector<std::vector<float>> massCollect;
     massCollect.resize(m_mspts.size());
     // accumulate masses of triangles connected to each masspoint
-    for(auto t : m_triangles)
+    for(auto &t : m_rest->triangles)
     {
         auto tmass = t.tri.surface_area() * m_mass;
         massCollect[t.a].push_back(tmass);
         massCollect[t.b].push_back(tmass);
         massCollect[t.c].push_back(tmass);
     }
-    // for each masspoint, sum over collected values to get mass, set damping
+    // for each masspoint, sum over collected values to get mass
     for(size_t i = 0; i < m_mspts.size(); ++i)
     {
         auto totalMass = std::accumulate(massCollect[i].begin(), massCollect[i].end(), 0.0f);
         m_mspts[i].setMass(totalMass/3);
-        m_mspts[i].setDamping(_dampingCoefficient);
     }
+    // set up the jacobian sparsity pattern
+    auto sparsity = sparsityPattern();
+    for(size_t i = 0; i < m_mspts.size(); ++i)
+    {
+        m_mspts[i].initJacobians(sparsity[i]);
+    }
+    return sparsity;
+}
+
+void Cloth::finishInit(std::vector<size_t> _corners, float _dampingCoefficient)
+{
+    // set damping
+    setDampingCoefficient(_dampingCoefficient);
     // assign corners
     m_corners = _corners;
     // initialize the filter matrix for CG method, assuming all unconstrained
     m_filter.resize(m_mspts.size());
+    // set up the vertex normal buffers
+    buildNormalAdjacency();
+    m_normalsDirty = true;
+    // collision thickness and hierarchy for the new mesh, the pick hierarchy is rebuilt when it's next used
+    buildCollision();
+    m_pickTree = SelfCollision();
+}
+
+void Cloth::setDampingCoefficient(const float _dampingCoefficient)
+{
+    for(auto &m : m_mspts)
+    {
+        m.setDamping(_dampingCoefficient);
+    }
+    // the damping is on the system's diagonal
+    m_systemKept = false;
+}
+
+void Cloth::setJacobianReuse(const bool _reuse, const float _tolerance)
+{
+    m_jacobianReuse = _reuse;
+    m_reuseTolerance = _tolerance;
+    m_systemKept = false;
+    m_reuseStats = JacobianReuseStats();
+}
+
+void Cloth::setSelfCollision(const bool _selfCollision, const float _thickness)
+{
+    m_selfCollision = _selfCollision;
+    m_thicknessSetting = _thickness;
+    m_contacts.clear();
+    buildCollision();
+}
+
+void Cloth::setCollisionThickness(const float _thickness)
+{
+    m_thicknessSetting = _thickness;
+    buildCollision();
+}
+
+void Cloth::setAirCoefficients(const float _drag, const float _lift)
+{
+    m_dragCoefficient = _drag;
+    m_liftCoefficient = _lift;
+}
+
+void Cloth::addObstacle(std::shared_ptr<const Obstacle> _obstacle)
+{
+    m_obstacles.push_back(std::move(_obstacle));
+}
+
+void Cloth::addForceField(std::shared_ptr<const ForceField> _field)
+{
+    m_forceFields.push_back(std::move(_field));
+}
+
+void Cloth::removeForceField(const ForceField *_field)
+{
+    m_forceFields.erase(std::remove_if(m_forceFields.begin(), m_forceFields.end(),
+                                       [_field](const std::shared_ptr<const ForceField> &_f) { return _f.get() == _field; }),
+                        m_forceFields.end());
+}
+
+void Cloth::clearForceFields()
+{
+    m_forceFields.clear();
+}
+
+void Cloth::clearObstacles()
+{
+    m_obstacles.clear();
+    m_obstacleDistances.clear();
+    m_obstacleNormals.clear();
 }
 
 void Cloth::clear()
 {
     m_mspts.clear();
-    m_triangles.clear();
+    m_rest = std::make_shared<const RestMesh>();
+    m_areas.clear();
     m_corners.clear();
     m_filter.clear();
+    m_faceNormals.clear();
+    m_normals.clear();
+    m_adjacency.reset();
+    m_normalsDirty = true;
+    m_collision = SelfCollision();
+    m_pickTree = SelfCollision();
+    m_contacts.clear();
+    m_obstacleDistances.clear();
+    m_obstacleNormals.clear();
+    m_airForces.clear();
+    m_time = 0.0f;
+    m_startPos.clear();
+    m_trialPos.clear();
+    m_trialVel.clear();
+    m_stageForces = ClothForces();
+    for(size_t s = 0; s < m_stageVel.size(); ++s)
+    {
+        m_stageVel[s].clear();
+        m_stageAcc[s].clear();
+    }
+    m_adaptiveStep = 0.0f;
+    m_adaptiveStats = AdaptiveStepStats();
+    m_systemKept = false;
+    m_systemStates.clear();
+    m_precon.clear();
+    m_preconInv.clear();
+    m_implicitUpdate = false;
+    m_reuseStats = JacobianReuseStats();
+}
+
+ClothMemoryUsage Cloth::memoryUsage() const
+{
+    ClothMemoryUsage usage;
+    usage.numMasses = m_mspts.size();
+    usage.massPoints = m_mspts.capacity() * sizeof(MassPoint);
+    // the rest mesh is shared between copies like the adjacency
+    usage.triangles = m_rest->triangles.capacity() * sizeof(Triref) / static_cast<size_t>(m_rest.use_count()) +
+                      m_areas.capacity() * sizeof(float) + m_corners.capacity() * sizeof(size_t);
+    for(auto &m : m_mspts)
+    {
+        usage.jacobians += m.jacobianBytes();
+    }
+    // the preconditioner and its inverse are kept between CG solves, the explicit methods never make them
+    usage.solverWorkspaces = (m_filter.capacity() + m_precon.capacity() + m_preconInv.capacity()) * sizeof(ngl::Mat3) +
+                             m_collision.memoryBytes() + m_pickTree.memoryBytes() +
+                             m_contacts.capacity() * sizeof(CollisionContact) +
+                             m_obstacleDistances.capacity() * sizeof(float) +
+                             m_obstacleNormals.capacity() * sizeof(ngl::Vec3) +
+                             (m_airForces.capacity() + m_startPos.capacity() + m_trialPos.capacity() +
+                              m_trialVel.capacity()) * sizeof(ngl::Vec3) + m_stageForces.memoryBytes() +
+                             m_systemStates.capacity() * sizeof(TriangleStrain);
+    for(size_t s = 0; s < m_stageVel.size(); ++s)
+    {
+        usage.solverWorkspaces += (m_stageVel[s].capacity() + m_stageAcc[s].capacity()) * sizeof(ngl::Vec3);
+    }
+    // while it's stepped implicitly, each step's conjugateGradient peaks at 11 vectors (r, p, vel, hforce,
+    // x, Ap, b, bfp, z, bfilter, jvt) plus up to 3 returned temporaries per masspoint
+    if(m_implicitUpdate)
+    {
+        usage.solverWorkspaces += m_mspts.size() * 14 * sizeof(ngl::Vec3);
+    }
+    // obstacle grids are shared between copies like the adjacency
+    for(auto &o : m_obstacles)
+    {
+        usage.solverWorkspaces += o->memoryBytes() / static_cast<size_t>(o.use_count());
+    }
+    // each spline keeps its coefficients (data points plus 2) alongside the object itself, plus the data they came from
+    const size_t materialPoints = m_materialData.weft.data.size() + m_materialData.warp.data.size() +
+                                  m_materialData.shear.data.size();
+    usage.materialTables = 3 * sizeof(m_weft) + (materialPoints + 6) * sizeof(float) +
+                           (m_materialData.weft.data.capacity() + m_materialData.warp.data.capacity() +
+                            m_materialData.shear.data.capacity()) * sizeof(float);
+    usage.renderBuffers = (m_faceNormals.capacity() + m_normals.capacity()) * sizeof(ngl::Vec3);
+    // the adjacency is shared between copies, so each is charged its share
+    if(m_adjacency)
+    {
+        usage.renderBuffers += (m_adjacency->offsets.capacity() + m_adjacency->triangles.capacity()) * sizeof(size_t) /
+                               static_cast<size_t>(m_adjacency.use_count());
+    }
+    return usage;
+}
+
+void ClothMemoryUsage::print(std::ostream &_out) const
+{
+    auto line = [&_out](const char *_name, size_t _bytes)
+    {
+        _out << "  " << _name << ": " << _bytes / 1024.0 << " KiB\n";
+    };
+    _out << "cloth memory (" << numMasses << " masspoints)\n";
+    line("masspoints", massPoints);
+    line("triangles", triangles);
+    line("jacobians", jacobians);
+    line("solver workspaces", solverWorkspaces);
+    line("material tables", materialTables);
+    line("render buffers", renderBuffers);
+    line("total", total());
+    _out << "  bytes per masspoint: " << bytesPerMasspoint() << '\n';
 }
 
 void Cloth::render(std::vector<float> &o_vertexData)
 {
+    GNATV_PROFILE_SCOPE("render");
     // determine vertex normals
-    auto vNorms = calcNormals();
+    auto &vNorms = normals();
 
     // lambda for adding the data
     auto listAdd = [&o_vertexData] (ngl::Vec3 vert, ngl::Vec3 norm, ngl::Vec2 uv) -> void
@@ -183,17 +487,18 @@ void Cloth::render(std::vector<float> &o_vertexData)
     };
 
     // spit out the triangle/vertex/uv data
-    o_vertexData.reserve(m_triangles.size() * 8);
-    for(auto tr : m_triangles)
+    o_vertexData.reserve(m_rest->triangles.size() * 3 * 8);
+    for(auto &tr : m_rest->triangles)
     {
-        listAdd(tr.tri.v1(), vNorms[tr.a], tr.tri.v1UV());
-        listAdd(tr.tri.v2(), vNorms[tr.b], tr.tri.v2UV());
-        listAdd(tr.tri.v3(), vNorms[tr.c], tr.tri.v3UV());
+        listAdd(m_mspts[tr.a].pos(), vNorms[tr.a], tr.tri.v1UV());
+        listAdd(m_mspts[tr.b].pos(), vNorms[tr.b], tr.tri.v2UV());
+        listAdd(m_mspts[tr.c].pos(), vNorms[tr.c], tr.tri.v3UV());
     }
 }
 
 void Cloth::writeToObj(std::string _filename)
 {
+    GNATV_PROFILE_SCOPE("writeToObj");
     // create file
     std::ofstream obj;
     obj.open(_filename);
@@ -204,30 +509,21 @@ void Cloth::writeToObj(std::string _filename)
         obj << "v ";
         obj << m.pos().m_x << " " << m.pos().m_y << " " << m.pos().m_z <<'\n';
     }
-    // collect UV coords
-    std::vector<ngl::Vec2> uvs;
-    uvs.resize(m_mspts.size());
-    for(auto tr : m_triangles)
-    {
-        uvs[tr.a] = tr.tri.v1UV();
-        uvs[tr.b] = tr.tri.v2UV();
-        uvs[tr.c] = tr.tri.v3UV();
-    }
     // write out UV coords
+    std::vector<ngl::Vec2> uvs;
+    vertexUVs(uvs);
     for(auto uv : uvs)
     {
         obj << "vt " << uv.m_x << " " << uv.m_y << '\n';
     }
-    // collect vertex normals
-    auto vNorms = calcNormals();
     // write out vertex normals
-    for(auto n : vNorms)
+    for(auto n : normals())
     {
         obj << "vn ";
         obj << n.m_x << " " << n.m_y << " " << n.m_z << '\n';
     }
     // write out triangles
-    for(auto tr : m_triangles)
+    for(auto tr : m_rest->triangles)
     {
         obj << "f ";
         obj << (tr.a + 1) << "/" << (tr.a + 1) << "/" << (tr.a + 1) << " ";
@@ -238,53 +534,310 @@ void Cloth::writeToObj(std::string _filename)
     obj.close();
 }
 
-void Cloth::update(float _h, bool _useRK4, bool _gravityOn, std::vector<ngl::Vec3> _externalf)
+void Cloth::positions(std::vector<ngl::Vec3> &o_positions) const
+{
+    o_positions.resize(m_mspts.size());
+    for(size_t i = 0; i < m_mspts.size(); ++i)
+    {
+        o_positions[i] = m_mspts[i].pos();
+    }
+}
+
+const std::vector<ngl::Vec3> &Cloth::normals()
+{
+    if(m_normalsDirty)
+    {
+        calcNormals();
+        m_normalsDirty = false;
+    }
+    return m_normals;
+}
+
+void Cloth::vertexNormals(std::vector<ngl::Vec3> &o_normals)
+{
+    auto &n = normals();
+    o_normals.assign(n.begin(), n.end());
+}
+
+void Cloth::vertexUVs(std::vector<ngl::Vec2> &o_uvs) const
+{
+    // collect UV coords from the triangles
+    o_uvs.resize(m_mspts.size());
+    for(auto &tr : m_rest->triangles)
+    {
+        o_uvs[tr.a] = tr.tri.v1UV();
+        o_uvs[tr.b] = tr.tri.v2UV();
+        o_uvs[tr.c] = tr.tri.v3UV();
+    }
+}
+
+void Cloth::triangleIndices(std::vector<size_t> &o_indices) const
+{
+    o_indices.resize(m_rest->triangles.size() * 3);
+    for(size_t i = 0; i < m_rest->triangles.size(); ++i)
+    {
+        o_indices[i*3] = m_rest->triangles[i].a;
+        o_indices[i*3 + 1] = m_rest->triangles[i].b;
+        o_indices[i*3 + 2] = m_rest->triangles[i].c;
+    }
+}
+
+void Cloth::triangleUVs(std::vector<ngl::Vec2> &o_uvs) const
+{
+    o_uvs.resize(m_rest->triangles.size() * 3);
+    for(size_t i = 0; i < m_rest->triangles.size(); ++i)
+    {
+        o_uvs[i*3] = m_rest->triangles[i].tri.v1UV();
+        o_uvs[i*3 + 1] = m_rest->triangles[i].tri.v2UV();
+        o_uvs[i*3 + 2] = m_rest->triangles[i].tri.v3UV();
+    }
+}
+
+void Cloth::update(float _h, IntegrationMethod _method, bool _gravityOn, ArrayView<ngl::Vec3> _externalf)
 {
+    GNATV_PROFILE_SCOPE("update");
     bool useJvel = false;
     bool useDamping = true;
+    const bool implicit = _method == CGM || _method == IMEX;
+    m_implicitUpdate = implicit;
+    // a kept system is only rebuilt once it has drifted too far from the cloth, see setJacobianReuse
+    const bool reuse = implicit && m_jacobianReuse && systemCurrent(_h, _method);
+    if(implicit && m_jacobianReuse)
+    {
+        ++(reuse ? m_reuseStats.reused : m_reuseStats.rebuilt);
+    }
     // STEP 0 - ZERO OUT CURRENT FORCES/JACOBIANS ON EACH MASSPOINT
-    nullForces();
+    nullForces(!reuse);
     // STEP 1 - FORCE CALCULATIONS
-    forceCalc(_gravityOn, _externalf, true, useJvel);
-    // STEP 2 - LET'S INTEGRATE
-    if(_useRK4)
+    // IMEX only puts the stiff weft/warp terms in the system, the rest of the force is taken as it
+    // is at the start of the step
+    m_tensileJacobians = _method == IMEX;
+    forceCalc(_gravityOn, _externalf, implicit && !reuse, useJvel);
+    m_tensileJacobians = false;
+    if(implicit && m_jacobianReuse && !reuse)
+    {
+        m_systemStates.resize(m_rest->triangles.size());
+        #pragma omp parallel for schedule(static) if(m_parallel)
+        for(size_t t = 0; t < m_rest->triangles.size(); ++t)
+        {
+            auto &tr = m_rest->triangles[t];
+            m_systemStates[t] = triangleStrain(tr, m_mspts[tr.a].pos(), m_mspts[tr.b].pos(), m_mspts[tr.c].pos());
+        }
+        m_systemKept = true;
+        m_systemStep = _h;
+        m_systemMethod = _method;
+    }
+    // STEP 2 - COLLISIONS, KEEP CONTACTS FROM CLOSING
+    bool colliding = false;
+    if(m_selfCollision)
+    {
+        findContacts(_h);
+        projectContactVelocities(_h);
+        colliding = !m_contacts.empty();
+    }
+    if(!m_obstacles.empty())
     {
-        rk4Integrate(_h, _gravityOn, _externalf);
+        projectObstacleVelocities(_h);
+        colliding = true;
+    }
+    // STEP 3 - LET'S INTEGRATE
+    if(!implicit)
+    {
+        explicitIntegrate(_h, _method, _gravityOn, _externalf);
     }
     else
     {
-        auto deltaVel = conjugateGradient(_h, useJvel, useDamping);
+        // hold contact vertices along their normals for the solve only
+        std::vector<ngl::Mat3> freeFilter;
+        if(colliding)
+        {
+            freeFilter = m_filter;
+            filterContacts();
+        }
+        auto deltaVel = conjugateGradient(_h, useJvel, useDamping, reuse);
+        if(m_systemKept && !reuse)
+        {
+            m_systemIterations = m_lastIterations;
+        }
+        if(colliding)
+        {
+            m_filter.swap(freeFilter);
+        }
         // Update particle velocities and positions
+        GNATV_PROFILE_SCOPE("update.positions");
         for(size_t i = 0; i < m_mspts.size(); ++i)
         {
-            auto newVel = m_mspts[i].vel() + deltaVel[i];
-            auto newPos = m_mspts[i].pos() + (_h * newVel);
-            m_mspts[i].setVel(newVel);
-            m_mspts[i].setPos(newPos);
+            m_mspts[i].setVel(m_mspts[i].vel() + deltaVel[i]);
+        }
+        if(colliding)
+        {
+            projectContactVelocities(_h);
+            projectObstacleVelocities(_h);
+        }
+        for(size_t i = 0; i < m_mspts.size(); ++i)
+        {
+            m_mspts[i].setPos(m_mspts[i].pos() + (_h * m_mspts[i].vel()));
         }
     }
-    // STEP 3 - CLEANUP AND STATE HANDLING
-    for(auto& tr : m_triangles)
+    // STEP 4 - CLEANUP AND STATE HANDLING
+    m_time += _h;
     {
-        tr.tri.setVertices(m_mspts[tr.a].pos(), m_mspts[tr.b].pos(), m_mspts[tr.c].pos());
+        GNATV_PROFILE_SCOPE("update.areas");
+        updateAreas();
     }
+    m_normalsDirty = true;
 }
 
-void Cloth::fixCorners(std::vector<bool> _isPtFixed)
+StaticSolveStats Cloth::solveStatic(bool _gravityOn, ArrayView<ngl::Vec3> _externalf,
+                                    float _tolerance, size_t _maxIterations)
 {
-    for(size_t i = 0; i < _isPtFixed.size(); ++i)
+    GNATV_PROFILE_SCOPE("solveStatic");
+    StaticSolveStats stats;
+    // the near-zero snapping puts small steps in f, enough to stall Newton short of equilibrium
+    m_smoothForces = true;
+    const size_t n = m_mspts.size();
+    // equilibrium is at rest, so the only air force left is the wind's
+    for(auto &m : m_mspts)
+    {
+        m.setVel(ngl::Vec3(0.0f));
+    }
+    // the tolerance is relative to the load on the free points, the fields at the starting positions
+    std::vector<ngl::Vec3> applied(n, ngl::Vec3(0.0f));
+    for(size_t i = 0; i < n; ++i)
+    {
+        if(!_externalf.empty())
+        {
+            applied[i] += _externalf[i];
+        }
+        if(_gravityOn)
+        {
+            applied[i] += ngl::Vec3(0.0f, -9.8f, 0.0f) * m_mspts[i].mass();
+        }
+    }
+    for(auto &field : m_forceFields)
+    {
+        auto points = field->points();
+        for(size_t k = 0; k < (field->sparse() ? points.size() : n); ++k)
+        {
+            auto pt = field->sparse() ? points[k] : k;
+            applied[pt] += field->force(k, pt, m_mspts[pt].pos(), m_mspts[pt].vel(), m_time);
+        }
+    }
+    filter(applied);
+    float scale = std::max(1.0f, std::sqrt(vecVecDotOp(applied, applied)));
+    // the first step moves no free point further than a tenth of a typical edge, see the regularization below
+    float edge = 0.0f;
+    for(auto area : m_areas)
+    {
+        edge += std::sqrt(2.0f * area);
+    }
+    edge = m_rest->triangles.empty() ? 1.0f : edge / m_rest->triangles.size();
+    nullForces();
+    forceCalc(_gravityOn, _externalf, true);
+    float maxAccel = 0.0f;
+    for(size_t i = 0; i < n; ++i)
     {
-        // set the point as fixed
-        m_mspts[m_corners[i]].setFixed(_isPtFixed[i]);
-        // update the filter matrix
-        if(_isPtFixed[i])
+        maxAccel = std::max(maxAccel, (m_filter[i] * m_mspts[i].forces()).length() / m_mspts[i].mass());
+    }
+    float mu = maxAccel / (0.1f * edge);
+    float fnorm = freeForceNorm();
+    std::vector<ngl::Vec3> f(n), x0(n), dx;
+    // line search points are evaluated off to the side, at rest, the masspoints only move once one is accepted
+    std::vector<ngl::Vec3> trial(n), rest(n, ngl::Vec3(0.0f));
+    ClothForces trialForces;
+    // |f| over the last few steps, to spot the solve stalling at the float noise floor
+    std::vector<float> history;
+    while(fnorm > _tolerance * scale && stats.newtonIterations < _maxIterations)
+    {
+        history.push_back(fnorm);
+        if(history.size() > 8 && fnorm > 0.9f * history[history.size() - 9])
+        {
+            break;
+        }
+        ++stats.newtonIterations;
+        // STEP 1 - SOLVE (-Jpos + mu M) dx = f
+        for(size_t i = 0; i < n; ++i)
         {
-            m_filter[m_corners[i]] = ngl::Mat3(0.0f);
+            f[i] = m_mspts[i].forces();
+            x0[i] = m_mspts[i].pos();
+        }
+        filter(f);
+        bool accepted = false;
+        float alpha = 1.0f;
+        auto slope = stiffnessSolve(f, mu, dx, stats.cgIterations) ? vecVecDotOp(f, dx) : 0.0f;
+        // STEP 2 - LINE SEARCH ALONG dx
+        // f is minus the energy gradient, so f.dx is how fast the energy drops along dx. Going past
+        // the minimum turns it negative, a secant step on it (exact for a quadratic) then pulls back
+        for(size_t ls = 0; ls < 8 && slope > 0.0f && !accepted; ++ls)
+        {
+            for(size_t i = 0; i < n; ++i)
+            {
+                trial[i] = x0[i] + (alpha * dx[i]);
+            }
+            evaluateForces(trial, rest, m_time, _gravityOn, _externalf, false, trialForces);
+            f = trialForces.forces;
+            filter(f);
+            auto trialSlope = vecVecDotOp(f, dx);
+            if(trialSlope >= -0.5f * slope && std::isfinite(trialSlope))
+            {
+                accepted = true;
+            }
+            else
+            {
+                alpha *= std::isfinite(trialSlope) ? std::max(0.1f, slope / (slope - trialSlope)) : 0.1f;
+            }
+        }
+        // STEP 3 - ADJUST THE REGULARIZATION
+        // mu M keeps the step bounded where the cloth has no stiffness (slack or compressed),
+        // it shrinks while full steps succeed so the solve ends up as plain Newton
+        if(accepted)
+        {
+            for(size_t i = 0; i < n; ++i)
+            {
+                m_mspts[i].setPos(trial[i]);
+            }
+            fnorm = std::sqrt(vecVecDotOp(f, f));
+            if(alpha == 1.0f)
+            {
+                mu *= 0.3f;
+            }
         }
         else
         {
-            m_filter[m_corners[i]] = ngl::Mat3(1.0f);
+            mu *= 4.0f;
         }
+        // forces and jacobians at the new positions for the next step
+        nullForces();
+        forceCalc(_gravityOn, _externalf, true);
+    }
+    m_smoothForces = false;
+    stats.residual = fnorm / scale;
+    stats.converged = fnorm <= _tolerance * scale;
+    updateAreas();
+    m_normalsDirty = true;
+    return stats;
+}
+
+void Cloth::fixCorners(std::vector<bool> _isPtFixed)
+{
+    for(size_t i = 0; i < _isPtFixed.size(); ++i)
+    {
+        fixPoint(m_corners[i], _isPtFixed[i]);
+    }
+}
+
+void Cloth::fixPoint(const size_t _pt, const bool _fixed)
+{
+    // set the point as fixed
+    m_mspts[_pt].setFixed(_fixed);
+    // update the filter matrix
+    if(_fixed)
+    {
+        m_filter[_pt] = ngl::Mat3(0.0f);
+    }
+    else
+    {
+        m_filter[_pt] = ngl::Mat3(1.0f);
     }
 }
 
@@ -300,52 +853,146 @@ std::vector<bool> Cloth::isCornerFixed() const
 
 void Cloth::newtonRelax()
 {
-    // make sure all the forces/jacobians are reset
-    nullForces();
-    // run a force calculation on the current state (no gravity, no externalf)
-    std::vector<ngl::Vec3> externalf;
-    externalf.resize(m_mspts.size());
-    forceCalc(false, externalf, true);
-    // lambda for calculating the length squared of the force vector
-    auto forceLength = [this]() -> float
-    {
-            float total;
-            for(auto m : m_mspts)
+    // relax towards equilibrium with no load on the cloth
+    solveStatic(false, ArrayView<ngl::Vec3>());
+}
+
+long Cloth::pick(const ngl::Vec3 &_origin, const ngl::Vec3 &_direction)
+{
+    GNATV_PROFILE_SCOPE("pick");
+    std::vector<ngl::Vec3> pos;
+    positions(pos);
+    if(m_pickTree.empty())
+    {
+        std::vector<size_t> indices;
+        triangleIndices(indices);
+        m_pickTree.build(pos, indices);
+    }
+    // nothing is swept, the boxes just fit the current positions
+    m_pickTree.refit(pos, pos, 0.0f);
+    float t;
+    ngl::Vec3 weights;
+    auto hit = m_pickTree.raycast(pos, _origin, _direction, t, weights);
+    if(hit < 0)
+    {
+        return -1;
+    }
+    // the corner with the largest weight is the one nearest the hit
+    auto corners = m_pickTree.triangle(static_cast<size_t>(hit));
+    size_t nearest = weights.m_y > weights.m_x ? 1 : 0;
+    if(weights.m_z > weights[nearest])
+    {
+        nearest = 2;
+    }
+    return static_cast<long>(corners[nearest]);
+}
+
+std::vector<size_t> Cloth::ringNeighbourhood(const size_t _pt, const size_t _rings) const
+{
+    std::vector<size_t> points = {_pt};
+    if(!m_adjacency)
+    {
+        return points;
+    }
+    std::unordered_set<size_t> seen = {_pt};
+    // each ring is the unseen corners of the triangles around the last one
+    size_t ringStart = 0;
+    for(size_t ring = 0; ring < _rings; ++ring)
+    {
+        size_t ringEnd = points.size();
+        for(size_t p = ringStart; p < ringEnd; ++p)
+        {
+            auto i = points[p];
+            for(size_t k = m_adjacency->offsets[i]; k < m_adjacency->offsets[i + 1]; ++k)
             {
-                total += m.forces().lengthSquared();
+                auto &tr = m_rest->triangles[m_adjacency->triangles[k]];
+                for(auto j : {tr.a, tr.b, tr.c})
+                {
+                    if(seen.insert(j).second)
+                    {
+                        points.push_back(j);
+                    }
+                }
             }
-            return total;
-    };
-    // starting guess is current positions
-    std::vector<ngl::Vec3> x;
-    x.reserve(m_mspts.size());
-    for(auto m : m_mspts)
+        }
+        ringStart = ringEnd;
+    }
+    return points;
+}
+
+Cloth Cloth::region(const std::vector<size_t> &_points, std::vector<size_t> &o_toCloth) const
+{
+    Cloth r(m_materialData);
+    r.m_material = m_material;
+    r.m_parallel = false;
+    r.m_useMeshCache = false;
+    o_toCloth = _points;
+    if(!m_adjacency)
+    {
+        return r;
+    }
+    std::unordered_map<size_t, size_t> toRegion;
+    for(size_t i = 0; i < _points.size(); ++i)
     {
-        x.push_back(m.pos());
+        toRegion[_points[i]] = i;
     }
-    // while loop for the iterations
-    float forceMagnitude = forceLength();
-    size_t k = 0;
-    while(forceMagnitude > 1e-5f)
+    // every triangle touching the points, their other corners are the region's fixed boundary
+    std::vector<size_t> tris;
+    for(auto i : _points)
+    {
+        tris.insert(tris.end(), m_adjacency->triangles.begin() + static_cast<long>(m_adjacency->offsets[i]),
+                    m_adjacency->triangles.begin() + static_cast<long>(m_adjacency->offsets[i + 1]));
+    }
+    std::sort(tris.begin(), tris.end());
+    tris.erase(std::unique(tris.begin(), tris.end()), tris.end());
+    for(auto t : tris)
     {
-        // need to solve for delta x : J * deltax = -F
-        auto deltax = sor();
-        // update x and masspoint positions
-        for(size_t i = 0; i < x.size(); ++i)
+        auto &tr = m_rest->triangles[t];
+        for(auto j : {tr.a, tr.b, tr.c})
         {
-            x[i] += deltax[i];
-            m_mspts[i].setPos(x[i]);
+            if(toRegion.emplace(j, o_toCloth.size()).second)
+            {
+                o_toCloth.push_back(j);
+            }
         }
-        // redo the force calculations
-        nullForces();
-        forceCalc(false, externalf, true);
-        forceMagnitude = forceLength();
-        ++k;
     }
+    // masspoints keep their state, triangles their rest shapes
+    r.m_mspts.reserve(o_toCloth.size());
+    for(size_t i = 0; i < o_toCloth.size(); ++i)
+    {
+        auto &m = m_mspts[o_toCloth[i]];
+        r.m_mspts.push_back(MassPoint(m.pos(), i, m.mass(), false, m.dampingCoefficient()));
+        r.m_mspts.back().setVel(m.vel());
+    }
+    RestMesh rest;
+    rest.triangles.reserve(tris.size());
+    r.m_areas.reserve(tris.size());
+    for(auto t : tris)
+    {
+        auto tr = m_rest->triangles[t];
+        tr.a = toRegion[tr.a];
+        tr.b = toRegion[tr.b];
+        tr.c = toRegion[tr.c];
+        rest.triangles.push_back(tr);
+        r.m_areas.push_back(m_areas[t]);
+    }
+    r.m_rest = std::make_shared<const RestMesh>(std::move(rest));
+    auto sparsity = r.sparsityPattern();
+    for(size_t i = 0; i < r.m_mspts.size(); ++i)
+    {
+        r.m_mspts[i].initJacobians(sparsity[i]);
+    }
+    r.finishInit({}, o_toCloth.empty() ? 1.0f : m_mspts[o_toCloth[0]].dampingCoefficient());
+    for(size_t i = 0; i < o_toCloth.size(); ++i)
+    {
+        r.fixPoint(i, i >= _points.size() || m_mspts[o_toCloth[i]].fixed());
+    }
+    return r;
 }
 
-void Cloth::readObj(std::string _filename)
+void Cloth::readObj(std::string _filename, std::vector<Triref> &o_triangles)
 {
+    GNATV_PROFILE_SCOPE("readObj");
     std::vector<ngl::Vec2> uvs;
     // import cloth data from obj
     std::ifstream clothFile;
@@ -408,7 +1055,7 @@ void Cloth::readObj(std::string _filename)
             tr.c = stoul(numres3[0]) - 1;  // subtract 1 since obj files index faces at 1
             tr.tri.setUV3(uvs[stoul(numres3[1]) - 1]);
             // push back triangle
-            m_triangles.push_back(tr);
+            o_triangles.push_back(tr);
         }
         break;
         default: break;
@@ -417,95 +1064,471 @@ void Cloth::readObj(std::string _filename)
     clothFile.close();
 }
 
-void Cloth::nullForces()
+bool Cloth::readCache(std::string _filename, uint64_t _key)
 {
+    MeshCache cache;
+    if(!cache.load(_filename, _key))
+    {
+        return false;
+    }
+    // masspoints
+    auto pos = cache.positions();
+    auto offsets = cache.sparsityOffsets();
+    auto ids = cache.sparsityIds();
+    m_mspts.reserve(cache.numMasses());
+    for(size_t i = 0; i < cache.numMasses(); ++i)
+    {
+        MassPoint m (ngl::Vec3(pos[i*3], pos[i*3 + 1], pos[i*3 + 2]), i);
+        m.initJacobians(std::vector<size_t>(ids + offsets[i], ids + offsets[i + 1]));
+        m_mspts.push_back(m);
+    }
+    // triangles
+    auto indices = cache.indices();
+    auto uvs = cache.uvs();
+    auto ru = cache.ru();
+    auto rv = cache.rv();
+    auto restAreas = cache.restAreas();
+    std::vector<float> masses(m_mspts.size(), 0.0f);
+    RestMesh rest;
+    rest.triangles.reserve(cache.numTriangles());
+    for(size_t i = 0; i < cache.numTriangles(); ++i)
+    {
+        Triref tr;
+        tr.a = indices[i*3];
+        tr.b = indices[i*3 + 1];
+        tr.c = indices[i*3 + 2];
+        tr.tri.setUV1(ngl::Vec2(uvs[i*6], uvs[i*6 + 1]));
+        tr.tri.setUV2(ngl::Vec2(uvs[i*6 + 2], uvs[i*6 + 3]));
+        tr.tri.setUV3(ngl::Vec2(uvs[i*6 + 4], uvs[i*6 + 5]));
+        tr.tri.setVertices(m_mspts[tr.a].pos(), m_mspts[tr.b].pos(), m_mspts[tr.c].pos());
+        tr.tri.setR(ngl::Vec3(ru[i*3], ru[i*3 + 1], ru[i*3 + 2]), ngl::Vec3(rv[i*3], rv[i*3 + 1], rv[i*3 + 2]));
+        rest.triangles.push_back(tr);
+        // masses come from this cloth's material, summed in triangle order as setupMesh does
+        auto tmass = restAreas[i] * m_mass;
+        masses[tr.a] += tmass;
+        masses[tr.b] += tmass;
+        masses[tr.c] += tmass;
+    }
+    for(size_t i = 0; i < m_mspts.size(); ++i)
+    {
+        m_mspts[i].setMass(masses[i]/3);
+    }
+    m_rest = std::make_shared<const RestMesh>(std::move(rest));
+    updateAreas();
+    return true;
+}
+
+void Cloth::writeCache(std::string _filename, uint64_t _key, const std::vector<std::vector<size_t>> &_sparsity)
+{
+    // flatten the masspoint data
+    std::vector<ngl::Vec3> positions;
+    positions.reserve(m_mspts.size());
+    for(auto &m : m_mspts)
+    {
+        positions.push_back(m.pos());
+    }
+    // flatten the triangle data
+    std::vector<uint32_t> indices;
+    std::vector<ngl::Vec2> uvs;
+    std::vector<ngl::Vec3> ru, rv;
+    std::vector<float> restAreas;
+    indices.reserve(m_rest->triangles.size() * 3);
+    uvs.reserve(m_rest->triangles.size() * 3);
+    ru.reserve(m_rest->triangles.size());
+    rv.reserve(m_rest->triangles.size());
+    restAreas.reserve(m_rest->triangles.size());
+    for(auto &tr : m_rest->triangles)
+    {
+        indices.push_back(static_cast<uint32_t>(tr.a));
+        indices.push_back(static_cast<uint32_t>(tr.b));
+        indices.push_back(static_cast<uint32_t>(tr.c));
+        uvs.push_back(tr.tri.v1UV());
+        uvs.push_back(tr.tri.v2UV());
+        uvs.push_back(tr.tri.v3UV());
+        ru.push_back(tr.tri.ru());
+        rv.push_back(tr.tri.rv());
+        restAreas.push_back(tr.tri.surface_area());
+    }
+    // flatten the sparsity pattern
+    std::vector<uint32_t> offsets, ids;
+    offsets.reserve(_sparsity.size() + 1);
+    offsets.push_back(0);
+    for(auto &row : _sparsity)
+    {
+        for(auto id : row)
+        {
+            ids.push_back(static_cast<uint32_t>(id));
+        }
+        offsets.push_back(static_cast<uint32_t>(ids.size()));
+    }
+    // a failed write just means we parse the obj again next time
+    MeshCache::save(_filename, _key, positions, indices, uvs, ru, rv, restAreas, offsets, ids);
+}
+
+std::vector<std::vector<size_t>> Cloth::sparsityPattern() const
+{
+    // each masspoint shares a jacobian with every masspoint it shares a triangle with
+    std::vector<std::vector<size_t>> sparsity;
+    sparsity.resize(m_mspts.size());
+    for(auto &tr : m_rest->triangles)
+    {
+        for(auto i : {tr.a, tr.b, tr.c})
+        {
+            sparsity[i].push_back(tr.a);
+            sparsity[i].push_back(tr.b);
+            sparsity[i].push_back(tr.c);
+        }
+    }
+    for(auto &row : sparsity)
+    {
+        std::sort(row.begin(), row.end());
+        row.erase(std::unique(row.begin(), row.end()), row.end());
+    }
+    return sparsity;
+}
+
+void Cloth::updateAreas()
+{
+    auto &triangles = m_rest->triangles;
+    m_areas.resize(triangles.size());
+    for(size_t t = 0; t < triangles.size(); ++t)
+    {
+        auto &tr = triangles[t];
+        m_areas[t] = Triangle::area(m_mspts[tr.a].pos(), m_mspts[tr.b].pos(), m_mspts[tr.c].pos());
+    }
+}
+
+void Cloth::nullForces(bool _jacobians)
+{
+    GNATV_PROFILE_SCOPE("nullForces");
     for(auto& m : m_mspts)
     {
         m.resetForce();
-        m.resetJacobians();
+        if(_jacobians)
+        {
+            m.resetJacobians();
+        }
+    }
+    if(_jacobians)
+    {
+        m_systemKept = false;
     }
 }
 
-void Cloth::forceCalc(bool _gravityOn, std::vector<ngl::Vec3> _externalf, bool _calcJacobians, bool _useJvel)
+bool Cloth::systemCurrent(float _h, IntegrationMethod _method) const
 {
-    // Internal force calculations per triangle
-    for(auto tr : m_triangles)
+    if(!m_systemKept || _h != m_systemStep || _method != m_systemMethod || m_systemStates.size() != m_rest->triangles.size())
     {
-        forceCalcPerTriangle(tr, _calcJacobians, _useJvel);
+        return false;
     }
-    // gravity
-    ngl::Vec3 fgravity, airRes;
-    if(_gravityOn)
+    // CG struggling means the system no longer fits the cloth, whatever the triangles say
+    if(m_lastCapped || m_lastIterations > c_iterationGrowth * m_systemIterations + 1)
+    {
+        return false;
+    }
+    float drift = 0.0f;
+    #pragma omp parallel for schedule(static) reduction(max:drift) if(m_parallel)
+    for(size_t t = 0; t < m_rest->triangles.size(); ++t)
+    {
+        auto &tr = m_rest->triangles[t];
+        auto now = triangleStrain(tr, m_mspts[tr.a].pos(), m_mspts[tr.b].pos(), m_mspts[tr.c].pos());
+        auto &kept = m_systemStates[t];
+        // a strain coming off (or going onto) its clamp switches its stiffness on (or off), which
+        // the kept jacobians can't follow however small the change
+        bool clampChanged = (now.strain.m_x > 0.0f) != (kept.strain.m_x > 0.0f) ||
+                            (now.strain.m_y > 0.0f) != (kept.strain.m_y > 0.0f) ||
+                            (now.strain.m_z > m_shearOffset) != (kept.strain.m_z > m_shearOffset);
+        // the jacobians follow the weft/warp directions, so a triangle turning without stretching
+        // stales them too
+        float triangleDrift = clampChanged ? std::numeric_limits<float>::max() :
+                              std::max((now.U - kept.U).length(), (now.V - kept.V).length());
+        drift = std::max(drift, triangleDrift);
+    }
+    return drift <= m_reuseTolerance;
+}
+
+void Cloth::forceCalc(bool _gravityOn, ArrayView<ngl::Vec3> _externalf, bool _calcJacobians, bool _useJvel)
+{
+    GNATV_PROFILE_SCOPE("forceCalc");
+    // Internal force calculations per triangle, jacobian assembly is interleaved so it gets its own name
+    {
+        GNATV_PROFILE_SCOPE(_calcJacobians ? "forceCalc.trianglesAndJacobians" : "forceCalc.triangles");
+        for(size_t t = 0; t < m_rest->triangles.size(); ++t)
+        {
+            forceCalcPerTriangle(t, _calcJacobians, _useJvel);
+        }
+    }
+    // drag and lift on each triangle, gathered onto the masspoints below
+    bool airOn = _gravityOn && !m_rest->triangles.empty();
+    if(airOn)
     {
-        fgravity = ngl::Vec3(0.0f, -9.8f, 0.0f);
+        aerodynamicForces();
     }
     else
     {
-        fgravity  = ngl::Vec3(0.0f);
+        m_airForces.clear();
     }
-    // air resistance
+    GNATV_PROFILE_SCOPE("forceCalc.external");
+    if(!m_obstacles.empty())
+    {
+        m_obstacleDistances.resize(m_mspts.size());
+        m_obstacleNormals.resize(m_mspts.size());
+    }
+    // air, external and dense field forces, and where each masspoint is relative to the obstacles
+    #pragma omp parallel for schedule(static) if(m_parallel)
     for(size_t i = 0; i < m_mspts.size(); ++i)
     {
-        if(_gravityOn)
+        m_mspts[i].addForce(externalForce(i, m_mspts[i].pos(), m_mspts[i].vel(), m_time, _gravityOn, _externalf, m_airForces));
+        if(!m_obstacles.empty())
         {
-            airRes = m_mspts[i].vel();
-            if(airRes != ngl::Vec3(0.0f))
+            float nearest = std::numeric_limits<float>::max();
+            ngl::Vec3 normal(0.0f, 1.0f, 0.0f);
+            for(auto &o : m_obstacles)
             {
-                airRes.normalize();
-                airRes *= -1.0f * m_mspts[i].vel().lengthSquared();
+                ngl::Vec3 n = normal;
+                float d = o->distance(m_mspts[i].pos(), n);
+                if(d < nearest)
+                {
+                    nearest = d;
+                    normal = n;
+                }
             }
+            m_obstacleDistances[i] = nearest;
+            m_obstacleNormals[i] = normal;
         }
-        else
+    }
+    // sparse fields only visit their own masspoints
+    for(auto &field : m_forceFields)
+    {
+        if(field->sparse())
         {
-            airRes = ngl::Vec3(0.0f);
+            auto points = field->points();
+            for(size_t k = 0; k < points.size(); ++k)
+            {
+                auto &m = m_mspts[points[k]];
+                m.addForce(field->force(k, points[k], m.pos(), m.vel(), m_time));
+            }
         }
-        m_mspts[i].addForce((fgravity * m_mspts[i].mass()) + airRes + _externalf[i]);
     }
 }
 
-void Cloth::forceCalcPerTriangle(Triref _tr, bool _calcJacobians, bool _useJvel)
+void Cloth::forceCalcPerTriangle(size_t _t, bool _calcJacobians, bool _useJvel)
 {
-    // 1.1 - CALC U AND V
-    ngl::Vec3 ru, rv, U, V;
-    ru = _tr.tri.ru();
-    rv = _tr.tri.rv();
-    U = (ru.m_x * m_mspts[_tr.a].pos()) + (ru.m_y * m_mspts[_tr.b].pos()) + (ru.m_z * m_mspts[_tr.c].pos());
-    V = (rv.m_x * m_mspts[_tr.a].pos()) + (rv.m_y * m_mspts[_tr.b].pos()) + (rv.m_z * m_mspts[_tr.c].pos());
-    U = cleanNearZero(U);
-    V = cleanNearZero(V);
-    // 1.2 - ACQUIRE STRAIN/STRESS VALUES
-    auto strain = calcStrain(U, V);
-    auto stress = calcStress(strain);
-    // 1.3 - COMPUTE FORCE CONTRIBUTIONS
-    ngl::Vec3 fa, fb, fc;
-    auto nd = -1 * _tr.tri.surface_area();
+    auto &_tr = m_rest->triangles[_t];
+    // 1.1 - ACQUIRE U/V AND STRAIN/STRESS VALUES
+    auto state = triangleStrain(_tr, m_mspts[_tr.a].pos(), m_mspts[_tr.b].pos(), m_mspts[_tr.c].pos());
+    // 1.2 - COMPUTE FORCE CONTRIBUTIONS
+    ngl::Vec3 f[3];
+    triangleForces(_t, state, f);
+    // 1.3 - APPLY FORCE CONTRIBUTIONS TO TRIANGLE POINTS
+    m_mspts[_tr.a].addForce(f[0]);
+    m_mspts[_tr.b].addForce(f[1]);
+    m_mspts[_tr.c].addForce(f[2]);
+    // 1.4 - COMPUTE JACOBIAN CONTRIBUTIONS
+    if(_calcJacobians)
+    {
+        computeJpos(_t, state.U, state.V, state.strain, state.stress);
+        if(_useJvel)
+        {
+            computeJvel(_t, state.U, state.V);
+        }
+    }
+}
+
+Cloth::TriangleStrain Cloth::triangleStrain(const Triref &_tr, const ngl::Vec3 &_a, const ngl::Vec3 &_b, const ngl::Vec3 &_c) const
+{
+    TriangleStrain state;
+    auto ru = _tr.tri.ru();
+    auto rv = _tr.tri.rv();
+    state.U = (ru.m_x * _a) + (ru.m_y * _b) + (ru.m_z * _c);
+    state.V = (rv.m_x * _a) + (rv.m_y * _b) + (rv.m_z * _c);
+    if(!m_smoothForces)
+    {
+        state.U = cleanNearZero(state.U);
+        state.V = cleanNearZero(state.V);
+    }
+    state.strain = calcStrain(state.U, state.V);
+    state.stress = calcStress(state.strain);
+    return state;
+}
+
+void Cloth::triangleForces(size_t _t, const TriangleStrain &_state, ngl::Vec3 *o_forces) const
+{
+    auto &tri = m_rest->triangles[_t].tri;
+    auto ru = tri.ru();
+    auto rv = tri.rv();
+    auto nd = -1 * m_areas[_t];
+    auto &stress = _state.stress;
+    auto &U = _state.U;
+    auto &V = _state.V;
     auto forceCont = [nd, stress, U, V] (float rui, float rvi) -> ngl::Vec3
     {
         return nd * ((stress.m_x * (rui * U)) + (stress.m_y * (rvi * V)) + (stress.m_z * ((rui * V) + (rvi * U))));
     };
-    fa = forceCont(ru.m_x, rv.m_x);
-    fb = forceCont(ru.m_y, rv.m_y);
-    fc = forceCont(ru.m_z, rv.m_z);
-    // 1.4 - APPLY FORCE CONTRIBUTIONS TO TRIANGLE POINTS
-    m_mspts[_tr.a].addForce(fa);
-    m_mspts[_tr.b].addForce(fb);
-    m_mspts[_tr.c].addForce(fc);
-    // 1.5 - COMPUTE JACOBIAN CONTRIBUTIONS
-    if(_calcJacobians)
+    o_forces[0] = forceCont(ru.m_x, rv.m_x);
+    o_forces[1] = forceCont(ru.m_y, rv.m_y);
+    o_forces[2] = forceCont(ru.m_z, rv.m_z);
+}
+
+ngl::Vec3 Cloth::externalForce(size_t _pt, const ngl::Vec3 &_pos, const ngl::Vec3 &_vel, float _time, bool _gravityOn,
+                                ArrayView<ngl::Vec3> _externalf, const std::vector<ngl::Vec3> &_airForces) const
+{
+    ngl::Vec3 fext(0.0f);
+    // a third of the air force on each triangle goes to each corner
+    if(!_airForces.empty())
     {
-        computeJpos(_tr, U, V, strain, stress);
-        if(_useJvel)
+        for(size_t k = m_adjacency->offsets[_pt]; k < m_adjacency->offsets[_pt + 1]; ++k)
+        {
+            fext += _airForces[m_adjacency->triangles[k]];
+        }
+        fext /= 3.0f;
+    }
+    if(_gravityOn)
+    {
+        fext += ngl::Vec3(0.0f, -9.8f, 0.0f) * m_mspts[_pt].mass();
+    }
+    if(!_externalf.empty())
+    {
+        fext += _externalf[_pt];
+    }
+    for(auto &field : m_forceFields)
+    {
+        if(!field->sparse())
+        {
+            fext += field->force(_pt, _pt, _pos, _vel, _time);
+        }
+    }
+    return fext;
+}
+
+void Cloth::evaluateForces(ArrayView<ngl::Vec3> _pos, ArrayView<ngl::Vec3> _vel, float _time, bool _gravityOn,
+                           ArrayView<ngl::Vec3> _externalf, bool _jacobians, ClothForces &o_forces) const
+{
+    GNATV_PROFILE_SCOPE("evaluateForces");
+    const size_t n = m_mspts.size();
+    const size_t nt = m_rest->triangles.size();
+    o_forces.forces.resize(n);
+    o_forces.triangleForces.resize(3 * nt);
+    const bool airOn = _gravityOn && nt > 0;
+    if(airOn)
+    {
+        o_forces.airForces.resize(nt);
+    }
+    else
+    {
+        o_forces.airForces.clear();
+    }
+    if(_jacobians)
+    {
+        // the rows only depend on the topology, so they're laid out once per workspace
+        if(o_forces.offsets.size() != n + 1)
+        {
+            auto sparsity = sparsityPattern();
+            o_forces.offsets.assign(1, 0);
+            o_forces.columns.clear();
+            for(auto &row : sparsity)
+            {
+                o_forces.columns.insert(o_forces.columns.end(), row.begin(), row.end());
+                o_forces.offsets.push_back(o_forces.columns.size());
+            }
+        }
+        o_forces.jacobians.resize(o_forces.columns.size());
+        o_forces.triangleJacobians.resize(9 * nt);
+    }
+    // STEP 1 - EACH TRIANGLE'S FORCES (AND JACOBIANS) ON ITS CORNERS
+    {
+        GNATV_PROFILE_SCOPE(_jacobians ? "evaluateForces.trianglesAndJacobians" : "evaluateForces.triangles");
+        #pragma omp parallel for schedule(static) if(m_parallel)
+        for(size_t t = 0; t < nt; ++t)
         {
-            computeJvel(_tr, U, V);
+            auto &tr = m_rest->triangles[t];
+            auto state = triangleStrain(tr, _pos[tr.a], _pos[tr.b], _pos[tr.c]);
+            triangleForces(t, state, &o_forces.triangleForces[3 * t]);
+            if(_jacobians)
+            {
+                jposBlocks(t, state, &o_forces.triangleJacobians[9 * t]);
+            }
+            if(airOn)
+            {
+                o_forces.airForces[t] = airForce(_pos[tr.a], _pos[tr.b], _pos[tr.c],
+                                                 _vel[tr.a], _vel[tr.b], _vel[tr.c], _time);
+            }
+        }
+    }
+    // STEP 2 - EACH MASSPOINT GATHERS FROM ITS OWN TRIANGLES, THROUGH THE ADJACENCY INIT BUILT
+    GNATV_PROFILE_SCOPE("evaluateForces.gather");
+    #pragma omp parallel for schedule(static) if(m_parallel)
+    for(size_t i = 0; i < n; ++i)
+    {
+        auto f = externalForce(i, _pos[i], _vel[i], _time, _gravityOn, _externalf, o_forces.airForces);
+        size_t rowStart = _jacobians ? o_forces.offsets[i] : 0;
+        size_t rowEnd = _jacobians ? o_forces.offsets[i + 1] : 0;
+        for(size_t k = rowStart; k < rowEnd; ++k)
+        {
+            o_forces.jacobians[k] = ngl::Mat3(0.0f);
+        }
+        for(size_t k = nt > 0 ? m_adjacency->offsets[i] : 0; nt > 0 && k < m_adjacency->offsets[i + 1]; ++k)
+        {
+            auto t = m_adjacency->triangles[k];
+            auto &tr = m_rest->triangles[t];
+            size_t corners[] = {tr.a, tr.b, tr.c};
+            size_t corner = (tr.a == i) ? 0 : ((tr.b == i) ? 1 : 2);
+            f += o_forces.triangleForces[(3 * t) + corner];
+            if(_jacobians)
+            {
+                auto first = o_forces.columns.begin() + static_cast<long>(rowStart);
+                auto last = o_forces.columns.begin() + static_cast<long>(rowEnd);
+                for(size_t j = 0; j < 3; ++j)
+                {
+                    auto block = std::lower_bound(first, last, corners[j]) - o_forces.columns.begin();
+                    o_forces.jacobians[static_cast<size_t>(block)] += o_forces.triangleJacobians[(9 * t) + (3 * corner) + j];
+                }
+            }
         }
+        o_forces.forces[i] = f;
     }
+    // sparse fields only visit their own masspoints
+    for(auto &field : m_forceFields)
+    {
+        if(field->sparse())
+        {
+            auto points = field->points();
+            for(size_t k = 0; k < points.size(); ++k)
+            {
+                o_forces.forces[points[k]] += field->force(k, points[k], _pos[points[k]], _vel[points[k]], _time);
+            }
+        }
+    }
+}
+
+ngl::Mat3 ClothForces::jacobian(size_t _i, size_t _j) const
+{
+    if(_i + 1 >= offsets.size() || jacobians.size() != columns.size())
+    {
+        return ngl::Mat3(0.0f);
+    }
+    auto first = columns.begin() + static_cast<long>(offsets[_i]);
+    auto last = columns.begin() + static_cast<long>(offsets[_i + 1]);
+    auto it = std::lower_bound(first, last, _j);
+    if(it == last || *it != _j)
+    {
+        return ngl::Mat3(0.0f);
+    }
+    return jacobians[static_cast<size_t>(it - columns.begin())];
 }
 
-std::vector<ngl::Vec3> Cloth::conjugateGradient(float _h, bool _useJvel, bool _useDamping)
+size_t ClothForces::memoryBytes() const
 {
+    return (forces.capacity() + triangleForces.capacity() + airForces.capacity()) * sizeof(ngl::Vec3) +
+           (offsets.capacity() + columns.capacity()) * sizeof(size_t) +
+           (jacobians.capacity() + triangleJacobians.capacity()) * sizeof(ngl::Mat3);
+}
+
+std::vector<ngl::Vec3> Cloth::conjugateGradient(float _h, bool _useJvel, bool _useDamping, bool _keptPrecon)
+{
+    GNATV_PROFILE_SCOPE("conjugateGradient");
     // 3.1 - SET INITIAL VALUES
     std::vector<ngl::Vec3> r, p, vel, hforce, x, Ap, b, bfp, z;
-    std::vector<ngl::Mat3> Pi, PiInv;
     float alpha, rsold, rsnew, rstest, epsilon;
 
     r.resize(m_mspts.size());
@@ -516,8 +1539,6 @@ std::vector<ngl::Vec3> Cloth::conjugateGradient(float _h, bool _useJvel, bool _u
     x.resize(m_mspts.size());
     z.reserve(m_mspts.size());
     Ap.reserve(m_mspts.size());
-    Pi.reserve(m_mspts.size());
-    PiInv.reserve(m_mspts.size());
 
     // set velocity and force vectors
     for(auto m : m_mspts)
@@ -539,16 +1560,24 @@ std::vector<ngl::Vec3> Cloth::conjugateGradient(float _h, bool _useJvel, bool _u
         }
     }
 
-    // set the preconditioning matrix Pi (diag = 1/A diag) and its inverse
-    Pi = createPrecon(_useJvel, _useDamping, _h);
-    for(auto m : Pi)
-    {
-        auto minv = m;
-        minv.m_00 = 1/m.m_00;
-        minv.m_11 = 1/m.m_11;
-        minv.m_22 = 1/m.m_22;
-        PiInv.push_back(minv);
+    // set the preconditioning matrix Pi (diag = 1/A diag) and its inverse, unless the last ones still fit
+    if(!_keptPrecon || m_precon.size() != m_mspts.size())
+    {
+        GNATV_PROFILE_SCOPE("conjugateGradient.precon");
+        m_precon = createPrecon(_useJvel, _useDamping, _h);
+        m_preconInv.clear();
+        m_preconInv.reserve(m_precon.size());
+        for(auto m : m_precon)
+        {
+            auto minv = m;
+            minv.m_00 = 1/m.m_00;
+            minv.m_11 = 1/m.m_11;
+            minv.m_22 = 1/m.m_22;
+            m_preconInv.push_back(minv);
+        }
     }
+    const auto &Pi = m_precon;
+    const auto &PiInv = m_preconInv;
     // determine b = hforce + h^2Jvt
     for(size_t i = 0; i < m_mspts.size(); ++i)
     {
@@ -564,178 +1593,534 @@ std::vector<ngl::Vec3> Cloth::conjugateGradient(float _h, bool _useJvel, bool _u
     rstest = vecVecDotOp(bfilter, bfp);
     r = bfilter; // if x not init to 0, r = filter(b - Ax)
 
+    // solver statistics, only gathered if someone's listening beyond the iterations the system reuse watches
+    SolverStepStats stats;
+    stats.capped = true;
+    bool recordStats = m_telemetry != nullptr && m_telemetry->isOpen();
+    if(recordStats)
+    {
+        stats.material = m_material;
+        stats.masspoints = m_mspts.size();
+        stats.h = _h;
+        stats.rstest = rstest;
+        stats.preconMin = std::numeric_limits<float>::max();
+        stats.preconMax = std::numeric_limits<float>::lowest();
+        for(auto &m : Pi)
+        {
+            stats.preconMin = std::min({stats.preconMin, m.m_00, m.m_11, m.m_22});
+            stats.preconMax = std::max({stats.preconMax, m.m_00, m.m_11, m.m_22});
+        }
+    }
+
     // lambda for multiplying r and PiInv
-    auto multPiInv = [PiInv] (std::vector<ngl::Vec3> r) -> std::vector<ngl::Vec3>
+    auto multPiInv = [&PiInv] (const std::vector<ngl::Vec3> &r) -> std::vector<ngl::Vec3>
     {
         std::vector<ngl::Vec3> PiInvR;
         PiInvR.reserve(PiInv.size());
         for(size_t i = 0; i < PiInv.size(); ++i)
         {
-            PiInvR.push_back(PiInv[i] * r[i]);
+            PiInvR.push_back(PiInv[i] * r[i]);
+        }
+        return PiInvR;
+    };
+
+    // other loop variables
+    p = multPiInv(r);
+    filter(p);
+    rsnew = vecVecDotOp(r, p);
+    epsilon = 1e-5f;
+    if(recordStats)
+    {
+        stats.residuals.push_back(rsnew);
+    }
+
+    // 3.2 - CONJUGATE GRADIENT METHOD LOOP
+    GNATV_PROFILE_SCOPE("conjugateGradient.iterations");
+    // a cloth with no force on it has nothing to solve for, x stays 0
+    if(rstest <= 0.0f)
+    {
+        stats.capped = false;
+    }
+    for(size_t k = 0; stats.capped && k < m_mspts.size(); ++k)
+    //while(rsnew > (epsilon * rstest))
+    {
+        Ap = jMatrixMultOp(true, _useJvel, _useDamping, _h, p);
+        filter(Ap);
+        alpha = rsnew / vecVecDotOp(p, Ap);
+        for(size_t i = 0; i < m_mspts.size(); ++i)
+        {
+            x[i] += alpha * p[i];
+            r[i] = r[i] - (alpha * Ap[i]);
+        }
+        z = multPiInv(r);
+        rsold = rsnew;
+        rsnew = vecVecDotOp(r, z);
+        for(size_t i = 0; i < m_mspts.size(); ++i)
+        {
+            p[i] = z[i] + ((rsnew/rsold) * p[i]);
+        }
+        filter(p);
+        stats.iterations = k + 1;
+        if(recordStats)
+        {
+            stats.residuals.push_back(rsnew);
+        }
+        if(rsnew < (epsilon * rstest))
+        {
+            stats.capped = false;
+            break;
+        }
+    }
+    if(recordStats)
+    {
+        m_telemetry->record(stats);
+    }
+    m_lastIterations = stats.iterations;
+    m_lastCapped = stats.capped;
+    // a kept system goes back to the plain jacobians, which the next step's b is made from
+    if(m_systemKept)
+    {
+        for(auto &m : m_mspts)
+        {
+            m.multJpos(1.0f / (_h * _h));
+            if(_useJvel)
+            {
+                m.multJvel(1.0f / _h);
+            }
+        }
+    }
+    return x;
+}
+
+bool Cloth::stiffnessSolve(const std::vector<ngl::Vec3> &_b, float _mu, std::vector<ngl::Vec3> &o_x, size_t &io_iterations)
+{
+    const size_t n = m_mspts.size();
+    std::vector<ngl::Vec3> r = _b, z(n), p, Ap, precon(n);
+    o_x.assign(n, ngl::Vec3(0.0f));
+    // jacobi preconditioner from the diagonal of -Jpos + mu M
+    auto invDiag = [](float _d) -> float
+    {
+        return _d > 1e-8f ? 1.0f / _d : 1.0f;
+    };
+    for(size_t i = 0; i < n; ++i)
+    {
+        auto diag = (-1.0f * m_mspts[i].getJposDiag()) + ngl::Vec3(_mu * m_mspts[i].mass());
+        precon[i] = ngl::Vec3(invDiag(diag.m_x), invDiag(diag.m_y), invDiag(diag.m_z));
+    }
+    auto applyPrecon = [&]()
+    {
+        for(size_t i = 0; i < n; ++i)
+        {
+            z[i] = precon[i] * r[i];
         }
-        return PiInvR;
+        filter(z);
     };
-
-    // other loop variables
-    p = multPiInv(r);
-    filter(p);
-    rsnew = vecVecDotOp(r, p);
-    epsilon = 1e-5f;
-
-    // 3.2 - CONJUGATE GRADIENT METHOD LOOP
-    for(size_t k = 0; k < m_mspts.size(); ++k)
-    //while(rsnew > (epsilon * rstest))
+    applyPrecon();
+    p = z;
+    float rz = vecVecDotOp(r, z);
+    const float rzStart = rz;
+    size_t k = 0;
+    for(; k < n && rz > 1e-10f * rzStart; ++k)
     {
-        Ap = jMatrixMultOp(true, _useJvel, _useDamping, _h, p);
+        // Ap = -Jpos p + mu M p
+        Ap = jMatrixMultOp(false, false, false, 1.0f, p);
+        for(size_t i = 0; i < n; ++i)
+        {
+            Ap[i] = (_mu * m_mspts[i].mass() * p[i]) - Ap[i];
+        }
         filter(Ap);
-        auto testval = vecVecDotOp(p, Ap);
-        alpha = rsnew / vecVecDotOp(p, Ap);
-        for(size_t i = 0; i < m_mspts.size(); ++i)
+        auto pAp = vecVecDotOp(p, Ap);
+        if(!(pAp > 0.0f))
         {
-            x[i] += alpha * p[i];
-            r[i] = r[i] - (alpha * Ap[i]);
+            // not positive definite along p, keep what we have
+            break;
         }
-        z = multPiInv(r);
-        rsold = rsnew;
-        rsnew = vecVecDotOp(r, z);
-        for(size_t i = 0; i < m_mspts.size(); ++i)
+        auto alpha = rz / pAp;
+        for(size_t i = 0; i < n; ++i)
         {
-            p[i] = z[i] + ((rsnew/rsold) * p[i]);
+            o_x[i] += alpha * p[i];
+            r[i] -= alpha * Ap[i];
         }
-        filter(p);
-        if(rsnew < (epsilon * rstest))
+        applyPrecon();
+        auto rzNew = vecVecDotOp(r, z);
+        for(size_t i = 0; i < n; ++i)
         {
-            break;
+            p[i] = z[i] + ((rzNew / rz) * p[i]);
         }
+        rz = rzNew;
     }
-    return x;
+    io_iterations += k;
+    return k > 0;
 }
 
-std::vector<ngl::Vec3> Cloth::sor()
+float Cloth::freeForceNorm()
 {
-    // set initial values
-    std::vector<ngl::Vec3> b, r, phi, Ap;
-    b.reserve(m_mspts.size());
-    r.reserve(m_mspts.size());
-    phi.resize(m_mspts.size());
-    Ap.reserve(m_mspts.size());
-    for(auto m : m_mspts)
+    float total = 0.0f;
+    for(size_t i = 0; i < m_mspts.size(); ++i)
     {
-        b.push_back(-1.0f * m.forces());
+        total += (m_filter[i] * m_mspts[i].forces()).lengthSquared();
     }
-    r = b;
-    // use filter to account for fixed points
-    filter(r);
-    // test values for loop
-    float rs, omega;
-    rs = vecVecDotOp(r, r);
-    omega = 0.5f;
-    double epsilon = 1e-10;
-    size_t k = 0;
-    // run successive over-relaxation method
-    while(sqrt(static_cast<double>(rs)) > epsilon)
+    return std::sqrt(total);
+}
+
+bool Cloth::solveStiffness(const std::vector<ngl::Vec3> &_b, std::vector<ngl::Vec3> &o_x)
+{
+    auto b = _b;
+    filter(b);
+    size_t iterations = 0;
+    return stiffnessSolve(b, 0.0f, o_x, iterations);
+}
+
+MaterialData Cloth::materialSensitivity(const std::vector<ngl::Vec3> &_adjoint)
+{
+    // splines through the unit vector at each data value, built the same way as setMaterial's
+    auto unitSplines = [](const MaterialCurve &_curve, float _start, float _leftDerivative)
     {
-        for(size_t i = 0; i < m_mspts.size(); ++i)
+        std::vector<boost::math::cubic_b_spline<float>> splines;
+        std::vector<float> unit(_curve.data.size(), 0.0f);
+        for(size_t j = 0; j < unit.size(); ++j)
+        {
+            unit[j] = 1.0f;
+            splines.emplace_back(unit.begin(), unit.end(), _start, _curve.step, _leftDerivative);
+            unit[j] = 0.0f;
+        }
+        return splines;
+    };
+    auto weftUnits = unitSplines(m_materialData.weft, m_materialData.weft.start, 0.0f);
+    auto warpUnits = unitSplines(m_materialData.warp, m_materialData.warp.start, 0.0f);
+    auto shearUnits = unitSplines(m_materialData.shear, 0.0f, std::numeric_limits<float>::quiet_NaN());
+    MaterialData sensitivity;
+    sensitivity.weft = {m_materialData.weft.start, m_materialData.weft.step, std::vector<float>(weftUnits.size())};
+    sensitivity.warp = {m_materialData.warp.start, m_materialData.warp.step, std::vector<float>(warpUnits.size())};
+    sensitivity.shear = {m_materialData.shear.start, m_materialData.shear.step, std::vector<float>(shearUnits.size())};
+    // evaluate the strains the way solveStatic does
+    auto smoothForces = m_smoothForces;
+    m_smoothForces = true;
+    for(size_t t = 0; t < m_rest->triangles.size(); ++t)
+    {
+        auto &tr = m_rest->triangles[t];
+        auto ru = tr.tri.ru();
+        auto rv = tr.tri.rv();
+        auto U = (ru.m_x * m_mspts[tr.a].pos()) + (ru.m_y * m_mspts[tr.b].pos()) + (ru.m_z * m_mspts[tr.c].pos());
+        auto V = (rv.m_x * m_mspts[tr.a].pos()) + (rv.m_y * m_mspts[tr.b].pos()) + (rv.m_z * m_mspts[tr.c].pos());
+        auto strain = calcStrain(U, V);
+        // each corner's force is linear in the stress (see forceCalcPerTriangle), so the adjoint
+        // reduces to one weight per stress component
+        auto nd = -1 * m_areas[t];
+        ngl::Vec3 weight(0.0f);
+        size_t corners[] = {tr.a, tr.b, tr.c};
+        float rus[] = {ru.m_x, ru.m_y, ru.m_z};
+        float rvs[] = {rv.m_x, rv.m_y, rv.m_z};
+        for(size_t k = 0; k < 3; ++k)
+        {
+            auto &lambda = _adjoint[corners[k]];
+            weight.m_x += nd * rus[k] * lambda.dot(U);
+            weight.m_y += nd * rvs[k] * lambda.dot(V);
+            weight.m_z += nd * lambda.dot((rus[k] * V) + (rvs[k] * U));
+        }
+        // weft and warp stress clamped at zero don't respond to the data
+        if(m_weft(strain.m_x) > 0.0f)
+        {
+            for(size_t j = 0; j < weftUnits.size(); ++j)
+            {
+                sensitivity.weft.data[j] += weight.m_x * weftUnits[j](strain.m_x);
+            }
+        }
+        if(m_warp(strain.m_y) > 0.0f)
         {
-            // do the j-matrix mult
-            // grab the values of _vec needed for multiplying with the J-matrices of this mass
-            std::unordered_map<size_t, ngl::Vec3> phiPass;
-            auto keys = m_mspts[i].jacobianKeys();
-            for(auto k : keys)
+            for(size_t j = 0; j < warpUnits.size(); ++j)
             {
-                phiPass[k] = phi[k];
+                sensitivity.warp.data[j] += weight.m_y * warpUnits[j](strain.m_y);
             }
-            // pass them into the masspoint for the vector multiplication
-            auto sigma = m_mspts[i].jacobianVectorMult(false, false, false, phiPass);
-            // compute omega / diag (j)
-            // THIS BREAKS THE ALGORITHM since j has zero in diags
-            // TIME TO GIVE UP
-            auto omegaDiag = m_mspts[i].getJposDiag();
-            omegaDiag.m_x = omega / omegaDiag.m_x;
-            omegaDiag.m_y = omega / omegaDiag.m_y;
-            omegaDiag.m_z = omega / omegaDiag.m_z;
-            // compute phi[i] based on sigma
-            phi[i] = ((1 - omega) * phi[i]) + (omegaDiag * (b[i] - sigma));
         }
-        // update r, rs
-        Ap = jMatrixMultOp(false, false, false, 1.0f, phi);
-        for(size_t i = 0; i < r.size(); ++i)
+        for(size_t j = 0; j < shearUnits.size(); ++j)
         {
-            r[i] = b[i] - Ap[i];
+            sensitivity.shear.data[j] += weight.m_z * shearUnits[j](strain.m_z - m_shearOffset);
         }
-        // might want to filter phi here
-        rs = vecVecDotOp(r, r);
-        ++k;
     }
-    return phi;
+    m_smoothForces = smoothForces;
+    return sensitivity;
 }
 
-void Cloth::rk4Integrate(float _h, bool _gravityOn, std::vector<ngl::Vec3> _externalf)
+void Cloth::explicitIntegrate(float _h, IntegrationMethod _method, bool _gravityOn, ArrayView<ngl::Vec3> _externalf)
 {
-    std::vector<ngl::Vec3> initpos, initvel, k1pos, k1vel, k2pos, k2vel, k3pos, k3vel, k4pos, k4vel;
-    // 3.1 - DETERMINE INIT/K1 VALUES
-    for(auto m : m_mspts)
+    GNATV_PROFILE_SCOPE("explicitIntegrate");
+    const size_t n = m_mspts.size();
+    // a no-op once the buffers are the right size
+    m_startPos.resize(n);
+    m_trialPos.resize(n);
+    m_trialVel.resize(n);
+    for(size_t s = 0; s < m_stageVel.size(); ++s)
+    {
+        m_stageVel[s].resize(n);
+        m_stageAcc[s].resize(n);
+    }
+    // the step starts from the masspoints, with the forces update has just worked out on them
+    #pragma omp parallel for schedule(static) if(m_parallel)
+    for(size_t i = 0; i < n; ++i)
     {
-        initpos.push_back(m.pos());
-        initvel.push_back(m.vel());
-        k1pos.push_back(m.vel());
-        k1vel.push_back(m.forces());
+        m_startPos[i] = m_mspts[i].pos();
+        m_stageVel[0][i] = m_mspts[i].vel();
+        m_stageAcc[0][i] = m_filter[i] * m_mspts[i].forces();
     }
-    // 3.1.5 - UPDATE CLOTH STATE TO MATCH K1, RECALC FORCES
-    for(size_t i = 0; i < m_mspts.size(); ++i)
+    if(_method == RK45)
     {
-        m_mspts[i].setPos(initpos[i] + (k1pos[i] * _h * 0.5f));
-        m_mspts[i].setVel(initvel[i] + (k1vel[i] * _h * 0.5f));
+        adaptiveIntegrate(_h, _gravityOn, _externalf);
     }
-    nullForces();
-    forceCalc(_gravityOn, _externalf, false);
-    // 3.2 - DETERMINE K2 VALUES
-    for(size_t i = 0; i < m_mspts.size(); ++i)
+    else
+    {
+        size_t steps = 1;
+        // a cloth that's already blown up has no stable step, NaN fails the test and it takes one
+        const float stable = m_stableSubsteps ? stableTimestep(_method) : _h;
+        if(stable > 0.0f && stable < _h)
+        {
+            steps = static_cast<size_t>(std::ceil(_h / stable));
+            steps = std::min(std::max<size_t>(steps, 1), c_maxSubsteps);
+        }
+        const float h = _h / steps;
+        for(size_t i = 0; i < steps; ++i)
+        {
+            const float t = m_time + (i * h);
+            // Verlet's step ends with the forces at its end in stage 0, the others don't
+            if(i > 0 && _method != VERLET)
+            {
+                explicitDerivatives(0, m_startPos, t, _gravityOn, _externalf);
+            }
+            switch(_method)
+            {
+            case SYMPLECTIC_EULER: symplecticEulerStep(h); break;
+            case VERLET: verletStep(h, t, _gravityOn, _externalf); break;
+            default:
+            {
+                rungeKuttaStep(h, t, c_rk4, _gravityOn, _externalf);
+                m_startPos.swap(m_trialPos);
+                m_stageVel[0].swap(m_trialVel);
+            } break;
+            }
+        }
+    }
+    // the only write to the masspoints
+    #pragma omp parallel for schedule(static) if(m_parallel)
+    for(size_t i = 0; i < n; ++i)
     {
-        k2pos.push_back(initvel[i] + (k1vel[i] * _h * 0.5f));
-        k2vel.push_back(m_mspts[i].forces());
+        m_mspts[i].setPos(m_startPos[i]);
+        m_mspts[i].setVel(m_stageVel[0][i]);
     }
-    // 3.2.5 - UPDATE CLOTH STATE TO MATCH K2, RECALC FORCES
+}
+
+void Cloth::rk4Integrate(float _h, bool _gravityOn, ArrayView<ngl::Vec3> _externalf)
+{
+    GNATV_PROFILE_SCOPE("rk4Integrate");
+    explicitIntegrate(_h, RK4, _gravityOn, _externalf);
+}
+
+void Cloth::explicitDerivatives(size_t _stage, ArrayView<ngl::Vec3> _pos, float _time, bool _gravityOn,
+                                ArrayView<ngl::Vec3> _externalf)
+{
+    evaluateForces(_pos, m_stageVel[_stage], _time, _gravityOn, _externalf, false, m_stageForces);
+    auto &acc = m_stageAcc[_stage];
+    #pragma omp parallel for schedule(static) if(m_parallel)
     for(size_t i = 0; i < m_mspts.size(); ++i)
     {
-        m_mspts[i].setPos(initpos[i] + (k2pos[i] * _h * 0.5f));
-        m_mspts[i].setVel(initvel[i] + (k2vel[i] * _h * 0.5f));
+        acc[i] = m_filter[i] * m_stageForces.forces[i];
     }
-    nullForces();
-    forceCalc(_gravityOn, _externalf, false);
-    // 3.3 - DETERMINE K3 VALUES
-    for(size_t i = 0; i < m_mspts.size(); ++i)
+}
+
+float Cloth::rungeKuttaStep(float _h, float _time, const ButcherTableau &_tableau, bool _gravityOn,
+                            ArrayView<ngl::Vec3> _externalf)
+{
+    const size_t n = m_mspts.size();
+    // the state at the start plus h times the weighted stage derivatives
+    auto advance = [&](const float *_weights, size_t _count, std::vector<ngl::Vec3> &o_vel)
+    {
+        #pragma omp parallel for schedule(static) if(m_parallel)
+        for(size_t i = 0; i < n; ++i)
+        {
+            ngl::Vec3 dx(0.0f);
+            ngl::Vec3 dv(0.0f);
+            for(size_t j = 0; j < _count; ++j)
+            {
+                dx += _weights[j] * m_stageVel[j][i];
+                dv += _weights[j] * m_stageAcc[j][i];
+            }
+            m_trialPos[i] = m_startPos[i] + (_h * dx);
+            o_vel[i] = m_stageVel[0][i] + (_h * dv);
+        }
+    };
+    for(size_t s = 1; s < _tableau.stages; ++s)
     {
-        k3pos.push_back(initvel[i] + (k2vel[i] * _h * 0.5f));
-        k3vel.push_back(m_mspts[i].forces());
+        advance(_tableau.a[s], s, m_stageVel[s]);
+        float c = std::accumulate(_tableau.a[s], _tableau.a[s] + s, 0.0f);
+        explicitDerivatives(s, m_trialPos, _time + (c * _h), _gravityOn, _externalf);
     }
-    // 3.3.5 - UPDATE CLOTH STATE TO MATCH K3, RECALC FORCES
-    for(size_t i = 0; i < m_mspts.size(); ++i)
+    advance(_tableau.b, _tableau.stages, m_trialVel);
+    // the error is the largest position difference, or velocity difference over the step
+    float error = 0.0f;
+    if(_tableau.e[0] != 0.0f)
     {
-        m_mspts[i].setPos(initpos[i] + (k3pos[i] * _h));
-        m_mspts[i].setVel(initvel[i] + (k3vel[i] * _h));
+        #pragma omp parallel for schedule(static) reduction(max:error) if(m_parallel)
+        for(size_t i = 0; i < n; ++i)
+        {
+            ngl::Vec3 ex(0.0f);
+            ngl::Vec3 ev(0.0f);
+            for(size_t j = 0; j < _tableau.stages; ++j)
+            {
+                ex += _tableau.e[j] * m_stageVel[j][i];
+                ev += _tableau.e[j] * m_stageAcc[j][i];
+            }
+            error = std::max(error, _h * std::max(ex.length(), _h * ev.length()));
+        }
+        error /= m_adaptiveTolerance;
     }
-    nullForces();
-    forceCalc(_gravityOn, _externalf, false);
-    // 3.4 - DETERMINE K4 VALUES
+    return error;
+}
+
+void Cloth::symplecticEulerStep(float _h)
+{
+    #pragma omp parallel for schedule(static) if(m_parallel)
     for(size_t i = 0; i < m_mspts.size(); ++i)
     {
-        k4pos.push_back(initvel[i] + (k3vel[i] * _h));
-        k4vel.push_back(m_mspts[i].forces());
+        m_stageVel[0][i] += _h * m_stageAcc[0][i];
+        m_startPos[i] += _h * m_stageVel[0][i];
     }
-    // 3.5 - COMBINE K TERMS TO FORM DELTA VEL AND DELTA POS, UPDATE VEL AND POS
-    ngl::Vec3 deltavel, deltapos;
-    for(size_t i = 0; i < m_mspts.size(); ++i)
+}
+
+void Cloth::verletStep(float _h, float _time, bool _gravityOn, ArrayView<ngl::Vec3> _externalf)
+{
+    const size_t n = m_mspts.size();
+    #pragma omp parallel for schedule(static) if(m_parallel)
+    for(size_t i = 0; i < n; ++i)
     {
-        deltavel = (1.0f/6.0f) * (k1vel[i] + (2 * (k2vel[i] + k3vel[i])) + k4vel[i]);
-        deltapos = (1.0f/6.0f) * (k1pos[i] + (2 * (k2pos[i] + k3pos[i])) + k4pos[i]);
+        m_trialPos[i] = m_startPos[i] + (_h * m_stageVel[0][i]) + ((0.5f * _h * _h) * m_stageAcc[0][i]);
+        m_stageVel[1][i] = m_stageVel[0][i] + (_h * m_stageAcc[0][i]);
+    }
+    explicitDerivatives(1, m_trialPos, _time + _h, _gravityOn, _externalf);
+    #pragma omp parallel for schedule(static) if(m_parallel)
+    for(size_t i = 0; i < n; ++i)
+    {
+        m_stageVel[1][i] = m_stageVel[0][i] + ((0.5f * _h) * (m_stageAcc[0][i] + m_stageAcc[1][i]));
+    }
+    m_startPos.swap(m_trialPos);
+    m_stageVel[0].swap(m_stageVel[1]);
+    m_stageAcc[0].swap(m_stageAcc[1]);
+}
+
+void Cloth::adaptiveIntegrate(float _h, bool _gravityOn, ArrayView<ngl::Vec3> _externalf)
+{
+    m_adaptiveStats = AdaptiveStepStats();
+    const float minStep = _h / c_maxSubsteps;
+    float step = m_adaptiveStep > 0.0f ? m_adaptiveStep : std::min(_h, stableTimestep(RK45));
+    float t = 0.0f;
+    while(_h - t > 1e-6f * _h)
+    {
+        float h = std::min(step, _h - t);
+        float error = rungeKuttaStep(h, m_time + t, c_dormandPrince, _gravityOn, _externalf);
+        bool accepted = error <= 1.0f || h <= minStep;
+        // a rejected step never touched the start state, so it's simply retried from there
+        if(accepted)
+        {
+            t += h;
+            ++m_adaptiveStats.accepted;
+            m_adaptiveStats.lastStep = h;
+            // the last stage is at the end of the step, so it's the first stage of the next one
+            m_startPos.swap(m_trialPos);
+            std::swap(m_stageVel[0], m_stageVel[c_dormandPrince.stages - 1]);
+            std::swap(m_stageAcc[0], m_stageAcc[c_dormandPrince.stages - 1]);
+        }
+        else
+        {
+            ++m_adaptiveStats.rejected;
+        }
+        // the usual 5th order step size control, a step cut short to finish isn't held against the next
+        float factor = error > 0.0f ? 0.9f * std::pow(error, -0.2f) : 5.0f;
+        float proposed = h * std::min(5.0f, std::max(0.2f, factor));
+        step = std::max(minStep, (accepted && h < step) ? std::max(step, proposed) : proposed);
+    }
+    m_adaptiveStep = step;
+}
 
-        m_mspts[i].setPos(initpos[i] + (deltapos * _h));
-        m_mspts[i].setVel(initvel[i] + (deltavel * _h));
+float Cloth::stableTimestep(IntegrationMethod _method) const
+{
+    if(_method == CGM)
+    {
+        return std::numeric_limits<float>::max();
+    }
+    // the tangent stiffness each triangle adds to one of its corners, from the slopes of the curves
+    // at its current strain or one sample further along, whichever is steeper, plus its stress.
+    // The weights are the gradients of the weft/warp coordinates, so weft, warp and shear couple
+    // corner i to corner j by about |w_i||w_j|, and the row sum over j bounds the corner's share
+    // of the highest frequency (Gershgorin)
+    auto steeper = [](const StressCurve &_spline, float _strain, float _step)
+    {
+        return std::max(std::abs(_spline.prime(_strain)), std::abs(_spline.prime(_strain + _step)));
+    };
+    float stiffest = 0.0f;
+    #pragma omp parallel for schedule(static) reduction(max:stiffest) if(m_parallel)
+    for(size_t t = 0; t < m_rest->triangles.size(); ++t)
+    {
+        auto &tr = m_rest->triangles[t];
+        auto ru = tr.tri.ru();
+        auto rv = tr.tri.rv();
+        auto a = m_mspts[tr.a].pos();
+        auto b = m_mspts[tr.b].pos();
+        auto c = m_mspts[tr.c].pos();
+        auto U = (ru.m_x * a) + (ru.m_y * b) + (ru.m_z * c);
+        auto V = (rv.m_x * a) + (rv.m_y * b) + (rv.m_z * c);
+        float weft = std::max(0.5f * (U.dot(U) - 1.0f), 0.0f);
+        float warp = std::max(0.5f * (V.dot(V) - 1.0f), 0.0f);
+        float shear = std::max(U.dot(V), m_shearOffset) - m_shearOffset;
+        // IMEX takes weft and warp implicitly, they can't make it unstable
+        float kWeft = _method == IMEX ? 0.0f : steeper(m_weft, weft, m_materialData.weft.step) + std::abs(m_weft(weft));
+        float kWarp = _method == IMEX ? 0.0f : steeper(m_warp, warp, m_materialData.warp.step) + std::abs(m_warp(warp));
+        float kShear = steeper(m_shear, shear, m_materialData.shear.step) + std::abs(m_shear(shear));
+        float uSum = std::abs(ru.m_x) + std::abs(ru.m_y) + std::abs(ru.m_z);
+        float vSum = std::abs(rv.m_x) + std::abs(rv.m_y) + std::abs(rv.m_z);
+        for(int corner = 0; corner < 3; ++corner)
+        {
+            float u = std::abs(ru[corner]);
+            float v = std::abs(rv[corner]);
+            float k = (kWeft * u * uSum) + (kWarp * v * vSum) + (kShear * (u + v) * (uSum + vSum));
+            stiffest = std::max(stiffest, m_areas[t] * k);
+        }
+    }
+    // every masspoint gets at most the stiffest corner's share from each of its triangles
+    size_t valence = 0;
+    if(m_adjacency && m_adjacency->offsets.size() == m_mspts.size() + 1)
+    {
+        for(size_t i = 0; i < m_mspts.size(); ++i)
+        {
+            valence = std::max(valence, m_adjacency->offsets[i + 1] - m_adjacency->offsets[i]);
+        }
+    }
+    if(_method == IMEX)
+    {
+        // the CG solve divides the explicit shear force by the mass plus the damping the system adds
+        // for a step of h, which with a stiffness k keeps a masspoint stable while h^2 k <= 2 (2 m + h d)
+        float longest = std::numeric_limits<float>::max();
+        for(size_t i = 0; i < m_mspts.size() && valence > 0; ++i)
+        {
+            float k = stiffest * (m_adjacency->offsets[i + 1] - m_adjacency->offsets[i]);
+            float d = m_mspts[i].dampingCoefficient() * (std::max<size_t>(m_mspts[i].numJacobians(), 1) - 1);
+            float m = m_mspts[i].mass();
+            if(k > 0.0f && !m_mspts[i].fixed())
+            {
+                longest = std::min(longest, (d + std::sqrt((d * d) + (4.0f * k * m))) / k);
+            }
+        }
+        return longest == std::numeric_limits<float>::max() ? longest : 0.8f * longest;
+    }
+    // the explicit methods take the force as the acceleration, so this is the frequency squared
+    float frequency = std::sqrt(stiffest * std::max<size_t>(valence, 1));
+    if(frequency <= 0.0f)
+    {
+        return std::numeric_limits<float>::max();
     }
+    // where each method's stability region crosses the imaginary axis, RK45 starts from RK4's
+    float limit = (_method == SYMPLECTIC_EULER || _method == VERLET) ? 2.0f : 2.0f * std::sqrt(2.0f);
+    return 0.8f * limit / frequency;
 }
 
-ngl::Vec3 Cloth::calcStrain(ngl::Vec3 _u, ngl::Vec3 _v)
+ngl::Vec3 Cloth::calcStrain(ngl::Vec3 _u, ngl::Vec3 _v) const
 {
     // calc strain
     ngl::Vec3 strain;
@@ -743,7 +2128,10 @@ ngl::Vec3 Cloth::calcStrain(ngl::Vec3 _u, ngl::Vec3 _v)
     strain.m_y = 0.5f * (_v.dot(_v) - 1);
     strain.m_z = _u.dot(_v);
     // enforce strain uu and vv > 0, uv > offset, and handle near-zero values
-    strain = cleanNearZero(strain);
+    if(!m_smoothForces)
+    {
+        strain = cleanNearZero(strain);
+    }
     if(strain.m_x < 0.0f)
     {
         strain.m_x = 0.0f;
@@ -759,7 +2147,7 @@ ngl::Vec3 Cloth::calcStrain(ngl::Vec3 _u, ngl::Vec3 _v)
     return strain;
 }
 
-ngl::Vec3 Cloth::calcStrainPrime(ngl::Vec3 _u, ngl::Vec3 _up, ngl::Vec3 _v, ngl::Vec3 _vp)
+ngl::Vec3 Cloth::calcStrainPrime(ngl::Vec3 _u, ngl::Vec3 _up, ngl::Vec3 _v, ngl::Vec3 _vp) const
 {
     ngl::Vec3 strainp;
     strainp.m_x = _u.dot(_up);
@@ -781,7 +2169,7 @@ ngl::Vec3 Cloth::calcStrainPrime(ngl::Vec3 _u, ngl::Vec3 _up, ngl::Vec3 _v, ngl:
     return strainp;
 }
 
-ngl::Vec3 Cloth::calcStress(ngl::Vec3 _strain)
+ngl::Vec3 Cloth::calcStress(ngl::Vec3 _strain) const
 {
     // calc stress
     ngl::Vec3 stress;
@@ -789,7 +2177,10 @@ ngl::Vec3 Cloth::calcStress(ngl::Vec3 _strain)
     stress.m_y = m_warp(_strain.m_y);
     stress.m_z = m_shear(_strain.m_z - m_shearOffset);
     // enforce stress uu and vv > 0, and handle near-zero values
-    stress = cleanNearZero(stress);
+    if(!m_smoothForces)
+    {
+        stress = cleanNearZero(stress);
+    }
     if(stress.m_x < 0.0f)
     {
         stress.m_x = 0.0f;
@@ -801,57 +2192,70 @@ ngl::Vec3 Cloth::calcStress(ngl::Vec3 _strain)
     return stress;
 }
 
-void Cloth::computeJpos(Triref _tr, ngl::Vec3 _u, ngl::Vec3 _v, ngl::Vec3 _strain, ngl::Vec3 _stress)
+void Cloth::computeJpos(size_t _t, ngl::Vec3 _u, ngl::Vec3 _v, ngl::Vec3 _strain, ngl::Vec3 _stress)
+{
+    auto &_tr = m_rest->triangles[_t];
+    ngl::Mat3 J[9];
+    jposBlocks(_t, {_u, _v, _strain, _stress}, J);
+    // add position jacobian contributions to triangle points
+    size_t corners[] = {_tr.a, _tr.b, _tr.c};
+    for(size_t i = 0; i < 3; ++i)
+    {
+        for(size_t j = 0; j < 3; ++j)
+        {
+            m_mspts[corners[i]].addJpos(corners[j], J[(3 * i) + j]);
+        }
+    }
+}
+
+void Cloth::jposBlocks(size_t _t, const TriangleStrain &_state, ngl::Mat3 *o_blocks) const
 {
     // prepare initial values
-    ngl::Mat3 Jaa, Jab, Jac, Jba, Jbb, Jbc, Jca, Jcb, Jcc, UUt, VVt, UVt, VUt;
-    auto nd = -1 * _tr.tri.surface_area();
+    ngl::Mat3 UUt, VVt, UVt, VUt;
+    auto nd = -1 * m_areas[_t];
     ngl::Vec3 ru, rv, stressPrime;
-    ru = _tr.tri.ru();
-    rv = _tr.tri.rv();
-    UUt = vecVecTranspose(_u, _u);
-    VVt = vecVecTranspose(_v, _v);
-    UVt = vecVecTranspose(_u, _v);
-    VUt = vecVecTranspose(_v, _u);
+    ru = m_rest->triangles[_t].tri.ru();
+    rv = m_rest->triangles[_t].tri.rv();
+    auto stress = _state.stress;
+    UUt = vecVecTranspose(_state.U, _state.U);
+    VVt = vecVecTranspose(_state.V, _state.V);
+    UVt = vecVecTranspose(_state.U, _state.V);
+    VUt = vecVecTranspose(_state.V, _state.U);
     // calculate stressprime
-    stressPrime.m_x = m_weft.prime(_strain.m_x);
-    stressPrime.m_y = m_warp.prime(_strain.m_y);
-    stressPrime.m_z = m_shear.prime(_strain.m_z - m_shearOffset);
+    stressPrime.m_x = m_weft.prime(_state.strain.m_x);
+    stressPrime.m_y = m_warp.prime(_state.strain.m_y);
+    stressPrime.m_z = m_shear.prime(_state.strain.m_z - m_shearOffset);
     cleanNearZero(stressPrime);
+    // shear's force is explicit in an IMEX step, so it has no part in the jacobians
+    if(m_tensileJacobians)
+    {
+        stressPrime.m_z = 0.0f;
+        stress.m_z = 0.0f;
+    }
     // lambda for jacobian calculations
-    auto jposCont = [nd, stressPrime, _stress, UUt, VVt, UVt, VUt] (float rui, float ruj, float rvi, float rvj) -> ngl::Mat3
+    auto jposCont = [nd, stressPrime, stress, UUt, VVt, UVt, VUt] (float rui, float ruj, float rvi, float rvj) -> ngl::Mat3
     {
         ngl::Mat3 t1, t2, t3, t4;
         t1 = UUt * (stressPrime.m_x * ruj * rui);
         t2 = VVt * (stressPrime.m_y * rvj * rvi);
-        t3 = ((UVt * (ruj * rvi)) + (VUt * (rvj * rui))) * stressPrime.m_z;
-        t4 = ngl::Mat3((_stress.m_x * ruj * rui) + (_stress.m_y * rvj * rvi) + (_stress.m_z * ((ruj * rvi) + (rvj * rui))));
+        // d(shear strain)/dx = rv U + ru V on both sides
+        t3 = ((VVt * (ruj * rui)) + (VUt * (ruj * rvi)) + (UVt * (rvj * rui)) + (UUt * (rvj * rvi))) * stressPrime.m_z;
+        t4 = ngl::Mat3((stress.m_x * ruj * rui) + (stress.m_y * rvj * rvi) + (stress.m_z * ((ruj * rvi) + (rvj * rui))));
         return (t1 + t2 + t3 + t4) * nd;
     };
-    // calculate Jji
-    Jaa = jposCont(ru.m_x, ru.m_x, rv.m_x, rv.m_x);
-    Jab = jposCont(ru.m_y, ru.m_x, rv.m_y, rv.m_x);
-    Jac = jposCont(ru.m_z, ru.m_x, rv.m_z, rv.m_x);
-    Jba = jposCont(ru.m_x, ru.m_y, rv.m_x, rv.m_y);
-    Jbb = jposCont(ru.m_y, ru.m_y, rv.m_y, rv.m_y);
-    Jbc = jposCont(ru.m_z, ru.m_y, rv.m_z, rv.m_y);
-    Jca = jposCont(ru.m_x, ru.m_z, rv.m_x, rv.m_z);
-    Jcb = jposCont(ru.m_y, ru.m_z, rv.m_y, rv.m_z);
-    Jcc = jposCont(ru.m_z, ru.m_z, rv.m_z, rv.m_z);
-    // add position jacobian contributions to triangle points
-    m_mspts[_tr.a].addJpos(_tr.a, Jaa);
-    m_mspts[_tr.a].addJpos(_tr.b, Jab);
-    m_mspts[_tr.a].addJpos(_tr.c, Jac);
-    m_mspts[_tr.b].addJpos(_tr.a, Jba);
-    m_mspts[_tr.b].addJpos(_tr.b, Jbb);
-    m_mspts[_tr.b].addJpos(_tr.c, Jbc);
-    m_mspts[_tr.c].addJpos(_tr.a, Jca);
-    m_mspts[_tr.c].addJpos(_tr.b, Jcb);
-    m_mspts[_tr.c].addJpos(_tr.c, Jcc);
+    // calculate Jji, row i is the corner the force is on
+    for(size_t i = 0; i < 3; ++i)
+    {
+        for(size_t j = 0; j < 3; ++j)
+        {
+            o_blocks[(3 * i) + j] = jposCont(ru[j], ru[i], rv[j], rv[i]);
+        }
+    }
 }
 
-void Cloth::computeJvel(Triref _tr, ngl::Vec3 _u, ngl::Vec3 _v)
+void Cloth::computeJvel(size_t _t, ngl::Vec3 _u, ngl::Vec3 _v)
 {
+    auto &_tr = m_rest->triangles[_t];
     // flag for debug
     if((_tr.a == 0) || (_tr.b == 0) || (_tr.c == 0))
     {
@@ -860,7 +2264,7 @@ void Cloth::computeJvel(Triref _tr, ngl::Vec3 _u, ngl::Vec3 _v)
     // prepare initial values
     ngl::Mat3 Jaa, Jab, Jac, Jba, Jbb, Jbc, Jca, Jcb, Jcc, UUt, VVt, UVt, VUt;
     ngl::Vec3 ru, rv, Up, Vp, strainp, stressp;
-    auto nd = -1 * _tr.tri.surface_area();
+    auto nd = -1 * m_areas[_t];
     UUt = vecVecTranspose(_u, _u);
     VVt = vecVecTranspose(_v, _v);
     UVt = vecVecTranspose(_u, _v);
@@ -910,7 +2314,7 @@ void Cloth::computeJvel(Triref _tr, ngl::Vec3 _u, ngl::Vec3 _v)
     m_mspts[_tr.c].addJvel(_tr.c, Jcc);
 }
 
-ngl::Mat3 Cloth::vecVecTranspose(ngl::Vec3 _a, ngl::Vec3 _b)
+ngl::Mat3 Cloth::vecVecTranspose(ngl::Vec3 _a, ngl::Vec3 _b) const
 {
     ngl::Mat3 ret;
     ret.m_00 = _a.m_x * _b.m_x;
@@ -959,7 +2363,7 @@ float Cloth::vecVecDotOp(std::vector<ngl::Vec3> _a, std::vector<ngl::Vec3> _b)
     return result;
 }
 
-ngl::Vec3 Cloth::cleanNearZero(ngl::Vec3 io_a)
+ngl::Vec3 Cloth::cleanNearZero(ngl::Vec3 io_a) const
 {
     if(FCompare(io_a.m_x, 0.0f))
     {
@@ -976,34 +2380,79 @@ ngl::Vec3 Cloth::cleanNearZero(ngl::Vec3 io_a)
     return io_a;
 }
 
-std::vector<ngl::Vec3> Cloth::calcNormals()
+void Cloth::buildNormalAdjacency()
+{
+    auto adjacency = std::make_shared<NormalAdjacency>();
+    auto &offsets = adjacency->offsets;
+    auto &triangles = adjacency->triangles;
+    // count the triangles on each masspoint
+    offsets.assign(m_mspts.size() + 1, 0);
+    for(auto &tr : m_rest->triangles)
+    {
+        ++offsets[tr.a + 1];
+        ++offsets[tr.b + 1];
+        ++offsets[tr.c + 1];
+    }
+    for(size_t i = 0; i < m_mspts.size(); ++i)
+    {
+        offsets[i + 1] += offsets[i];
+    }
+    // fill in the triangle ids
+    triangles.resize(offsets.back());
+    auto next = offsets;
+    for(size_t t = 0; t < m_rest->triangles.size(); ++t)
+    {
+        triangles[next[m_rest->triangles[t].a]++] = t;
+        triangles[next[m_rest->triangles[t].b]++] = t;
+        triangles[next[m_rest->triangles[t].c]++] = t;
+    }
+    m_adjacency = adjacency;
+    m_faceNormals.resize(m_rest->triangles.size());
+    m_normals.resize(m_mspts.size());
+}
+
+void Cloth::calcNormals()
 {
-    std::vector<ngl::Vec3> vNorms;
-    vNorms.resize(m_mspts.size());
-    // calculate triangle norms, accumulate for each masspoint
-    for(auto tr : m_triangles)
+    GNATV_PROFILE_SCOPE("calcNormals");
+    // the adjacency is only missing if the masspoints/triangles were set up outside of init
+    if(!m_adjacency || m_adjacency->offsets.size() != m_mspts.size() + 1 || m_faceNormals.size() != m_rest->triangles.size())
     {
-        ngl::Vec3 triNormal, edge1, edge2;
-        edge1 = tr.tri.v2() - tr.tri.v1();
-        edge2 = tr.tri.v3() - tr.tri.v1();
-        triNormal = edge1.cross(edge2);
+        buildNormalAdjacency();
+    }
+    auto &offsets = m_adjacency->offsets;
+    auto &triangles = m_adjacency->triangles;
+    // calculate triangle norms from the current masspoint positions
+    const auto nt = m_rest->triangles.size();
+    #pragma omp parallel for schedule(static) if(m_parallel)
+    for(size_t t = 0; t < nt; ++t)
+    {
+        auto &tr = m_rest->triangles[t];
+        auto p1 = m_mspts[tr.a].pos();
+        auto edge1 = m_mspts[tr.b].pos() - p1;
+        auto edge2 = m_mspts[tr.c].pos() - p1;
+        auto triNormal = edge1.cross(edge2);
         if(triNormal != ngl::Vec3(0.0f))
         {
             triNormal.normalize();
         }
-        vNorms[tr.a] += triNormal;
-        vNorms[tr.b] += triNormal;
-        vNorms[tr.c] += triNormal;
+        m_faceNormals[t] = triNormal;
     }
-    // normalize to create the final normals
-    for(auto &vn : vNorms)
+    // gather for each masspoint, normalize to create the final normals
+    const auto nm = m_mspts.size();
+    #pragma omp parallel for schedule(static) if(m_parallel)
+    for(size_t i = 0; i < nm; ++i)
     {
+        ngl::Vec3 vn(0.0f, 0.0f, 0.0f);
+        for(size_t j = offsets[i]; j < offsets[i + 1]; ++j)
+        {
+            vn += m_faceNormals[triangles[j]];
+        }
         if(vn != ngl::Vec3(0.0f))
         {
             vn.normalize();
         }
+        m_normals[i] = vn;
     }
-    return vNorms;
 }
 
 std::vector<ngl::Mat3> Cloth::createPrecon(bool _useJvel, bool _useDamping, float _h)
@@ -1042,6 +2491,230 @@ std::vector<ngl::Mat3> Cloth::createPrecon(bool _useJvel, bool _useDamping, floa
     return precon;
 }
 
+void Cloth::buildCollision()
+{
+    std::vector<ngl::Vec3> pos;
+    positions(pos);
+    if(m_selfCollision)
+    {
+        std::vector<size_t> indices;
+        triangleIndices(indices);
+        m_collision.build(pos, indices);
+    }
+    else
+    {
+        m_collision = SelfCollision();
+    }
+    m_collisionThickness = m_thicknessSetting;
+    if(m_collisionThickness <= 0.0f && !m_rest->triangles.empty())
+    {
+        // a quarter of the mean edge length, interior edges counted twice
+        float total = 0.0f;
+        for(auto &tr : m_rest->triangles)
+        {
+            total += (pos[tr.a] - pos[tr.b]).length() + (pos[tr.b] - pos[tr.c]).length() +
+                     (pos[tr.c] - pos[tr.a]).length();
+        }
+        m_collisionThickness = 0.25f * total / (3 * m_rest->triangles.size());
+    }
+}
+
+void Cloth::findContacts(float _h)
+{
+    std::vector<ngl::Vec3> pos, vel;
+    pos.reserve(m_mspts.size());
+    vel.reserve(m_mspts.size());
+    for(auto &m : m_mspts)
+    {
+        pos.push_back(m.pos());
+        vel.push_back(m.vel());
+    }
+    {
+        GNATV_PROFILE_SCOPE("collision.refit");
+        m_collision.refit(pos, vel, _h);
+    }
+    GNATV_PROFILE_SCOPE("collision.query");
+    m_collision.findContacts(pos, vel, _h, m_collisionThickness, m_parallel, m_contacts);
+}
+
+void Cloth::projectContactVelocities(float _h)
+{
+    GNATV_PROFILE_SCOPE("collision.response");
+    const size_t maxPasses = 8;
+    for(size_t pass = 0; pass < maxPasses; ++pass)
+    {
+        bool changed = false;
+        for(auto &c : m_contacts)
+        {
+            // closing speed along the normal, and how much an impulse changes it
+            float vn = 0.0f;
+            float invMass = 0.0f;
+            for(size_t k = 0; k < 4; ++k)
+            {
+                auto &m = m_mspts[c.points[k]];
+                vn += c.weights[k] * c.normal.dot(m.vel());
+                if(!m.fixed())
+                {
+                    invMass += c.weights[k] * c.weights[k] / m.mass();
+                }
+            }
+            // the pair may close as far as the thickness by the end of the step, and no further
+            float target = (m_collisionThickness - c.distance) / _h;
+            if(target > 0.0f)
+            {
+                target *= c_separationRate;
+            }
+            if(vn >= target - 1e-6f || invMass <= 0.0f)
+            {
+                continue;
+            }
+            float impulse = (target - vn) / invMass;
+            for(size_t k = 0; k < 4; ++k)
+            {
+                auto &m = m_mspts[c.points[k]];
+                if(!m.fixed())
+                {
+                    m.setVel(m.vel() + ((c.weights[k] * impulse / m.mass()) * c.normal));
+                }
+            }
+            changed = true;
+        }
+        if(!changed)
+        {
+            break;
+        }
+    }
+}
+
+void Cloth::aerodynamicForces()
+{
+    GNATV_PROFILE_SCOPE("forceCalc.air");
+    // the adjacency is only missing if the masspoints/triangles were set up outside of init
+    if(!m_adjacency || m_adjacency->offsets.size() != m_mspts.size() + 1 || m_faceNormals.size() != m_rest->triangles.size())
+    {
+        buildNormalAdjacency();
+    }
+    m_airForces.resize(m_rest->triangles.size());
+    const auto nt = m_rest->triangles.size();
+    #pragma omp parallel for schedule(static) if(m_parallel)
+    for(size_t t = 0; t < nt; ++t)
+    {
+        auto &tr = m_rest->triangles[t];
+        auto &a = m_mspts[tr.a];
+        auto &b = m_mspts[tr.b];
+        auto &c = m_mspts[tr.c];
+        m_airForces[t] = airForce(a.pos(), b.pos(), c.pos(), a.vel(), b.vel(), c.vel(), m_time);
+    }
+}
+
+ngl::Vec3 Cloth::airForce(const ngl::Vec3 &_a, const ngl::Vec3 &_b, const ngl::Vec3 &_c, const ngl::Vec3 &_va,
+                          const ngl::Vec3 &_vb, const ngl::Vec3 &_vc, float _time) const
+{
+    // air velocity relative to the triangle
+    auto air = (_va + _vb + _vc) / -3.0f;
+    if(!m_wind.still())
+    {
+        air += m_wind.velocity((_a + _b + _c) / 3.0f, _time);
+    }
+    auto area2 = (_b - _a).cross(_c - _a);
+    float doubleArea = area2.length();
+    float speed2 = air.lengthSquared();
+    if(doubleArea <= 0.0f || speed2 <= 0.0f)
+    {
+        return ngl::Vec3(0.0f);
+    }
+    auto normal = area2 / doubleArea;
+    auto along = air / std::sqrt(speed2);
+    // the side of the triangle the air hits, and how square on it is
+    float cosine = normal.dot(along);
+    if(cosine < 0.0f)
+    {
+        normal = -1.0f * normal;
+        cosine = -cosine;
+    }
+    float pressure = 0.5f * doubleArea * speed2 * cosine;
+    // lift is across the air, towards the normal, and goes as cos * sin
+    auto across = normal - (cosine * along);
+    return pressure * (((0.5f * c_airDensity * m_dragCoefficient) * along) + ((0.5f * c_airDensity * m_liftCoefficient) * across));
+}
+
+void Cloth::projectObstacleVelocities(float _h)
+{
+    if(m_obstacleDistances.empty())
+    {
+        return;
+    }
+    GNATV_PROFILE_SCOPE("collision.obstacles");
+    #pragma omp parallel for schedule(static) if(m_parallel)
+    for(size_t i = 0; i < m_mspts.size(); ++i)
+    {
+        auto &m = m_mspts[i];
+        if(m.fixed() || m_obstacleDistances[i] == std::numeric_limits<float>::max())
+        {
+            continue;
+        }
+        // same rule as the self contacts, against a surface that doesn't move
+        float target = (m_collisionThickness - m_obstacleDistances[i]) / _h;
+        if(target > 0.0f)
+        {
+            target *= c_separationRate;
+        }
+        float vn = m_obstacleNormals[i].dot(m.vel());
+        if(vn < target)
+        {
+            m.setVel(m.vel() + ((target - vn) * m_obstacleNormals[i]));
+        }
+    }
+}
+
+void Cloth::filterContacts()
+{
+    // distinct normals of the touching contacts at each free vertex, obstacles only while
+    // the forces push the vertex into them
+    std::unordered_map<size_t, std::vector<ngl::Vec3>> touching;
+    for(size_t i = 0; i < m_obstacleDistances.size(); ++i)
+    {
+        if(m_obstacleDistances[i] < m_collisionThickness && !m_mspts[i].fixed() &&
+           m_obstacleNormals[i].dot(m_mspts[i].forces()) < 0.0f)
+        {
+            touching[i].push_back(m_obstacleNormals[i]);
+        }
+    }
+    for(auto &c : m_contacts)
+    {
+        if(c.edgeEdge || c.distance >= m_collisionThickness || m_mspts[c.points[0]].fixed())
+        {
+            continue;
+        }
+        auto &normals = touching[c.points[0]];
+        bool distinct = std::none_of(normals.begin(), normals.end(),
+                                     [&c](const ngl::Vec3 &_n) { return std::abs(_n.dot(c.normal)) > 0.99f; });
+        if(distinct)
+        {
+            normals.push_back(c.normal);
+        }
+    }
+    // one normal leaves a plane to move in, two a line, three or more nothing
+    for(auto &t : touching)
+    {
+        auto &n = t.second;
+        if(n.size() == 1)
+        {
+            m_filter[t.first] = ngl::Mat3(1.0f) - vecVecTranspose(n[0], n[0]);
+        }
+        else if(n.size() == 2)
+        {
+            auto line = n[0].cross(n[1]);
+            line.normalize();
+            m_filter[t.first] = vecVecTranspose(line, line);
+        }
+        else
+        {
+            m_filter[t.first] = ngl::Mat3(0.0f);
+        }
+    }
+}
+
 void Cloth::filter(std::vector<ngl::Vec3> &io_vec)
 {
     // apply filter matrix to the input vector
@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <cmath>
+#include "ClothDrag.h"
+#include "Profiler.h"
+
+namespace
+{
+    /**
+     * @brief relative force tolerance and Newton step cap for each relax, a move only has to look
+     * right for the next frame, the sim settles the rest
+    */
+    const float c_moveTolerance = 1e-2f;
+    const size_t c_moveIterations = 20;
+    /**
+     * @brief longest single step of a move, in edge lengths around the grabbed point. The relax
+     * stalls on steps much longer than this, the cloth has no stiffness to guide it until the
+     * edges around the point are stretched
+    */
+    const float c_stepEdges = 0.25f;
+    /**
+     * @brief most steps one move is split into, the rest of a long jump is left to the sim
+    */
+    const size_t c_maxSteps = 16;
+}
+
+void ClothDrag::grab(Cloth &io_cloth, size_t _pt, size_t _rings)
+{
+    if(active())
+    {
+        release(io_cloth);
+    }
+    m_point = _pt;
+    m_wasFixed = io_cloth.fixedAtPoint(_pt);
+    m_planeNormal = ngl::Vec3(0.0f);
+    // the grabbed point is a position constraint from now on
+    io_cloth.fixPoint(_pt, true);
+    io_cloth.setVelAtPoint(_pt, ngl::Vec3(0.0f));
+    auto points = io_cloth.ringNeighbourhood(_pt, _rings);
+    m_free = points.size();
+    m_region.reset(new Cloth(io_cloth.region(points, m_toCloth)));
+    // mean length of the edges around the point, for splitting up long moves
+    auto ring = io_cloth.ringNeighbourhood(_pt, 1);
+    m_edgeLength = 0.0f;
+    for(size_t i = 1; i < ring.size(); ++i)
+    {
+        m_edgeLength += (io_cloth.posAtPoint(ring[i]) - io_cloth.posAtPoint(_pt)).length();
+    }
+    m_edgeLength = ring.size() > 1 ? m_edgeLength / (ring.size() - 1) : 1.0f;
+}
+
+bool ClothDrag::grab(Cloth &io_cloth, const ngl::Vec3 &_origin, const ngl::Vec3 &_direction, size_t _rings)
+{
+    auto pt = io_cloth.pick(_origin, _direction);
+    if(pt < 0)
+    {
+        return false;
+    }
+    grab(io_cloth, static_cast<size_t>(pt), _rings);
+    // drag in the plane facing the ray, through the grabbed point
+    m_planePoint = io_cloth.posAtPoint(m_point);
+    m_planeNormal = _direction;
+    m_planeNormal.normalize();
+    return true;
+}
+
+StaticSolveStats ClothDrag::moveTo(Cloth &io_cloth, const ngl::Vec3 &_pos)
+{
+    GNATV_PROFILE_SCOPE("drag.relax");
+    StaticSolveStats stats;
+    if(!active())
+    {
+        return stats;
+    }
+    // start from wherever the cloth has got to, the boundary included
+    for(size_t i = 0; i < m_toCloth.size(); ++i)
+    {
+        m_region->setPosAtPoint(i, io_cloth.posAtPoint(m_toCloth[i]));
+    }
+    // walk the point over in short steps, relaxing after each
+    auto start = io_cloth.posAtPoint(m_point);
+    auto steps = static_cast<size_t>(std::ceil((_pos - start).length() / (c_stepEdges * m_edgeLength)));
+    steps = std::min(std::max<size_t>(steps, 1), c_maxSteps);
+    for(size_t s = 1; s <= steps; ++s)
+    {
+        m_region->setPosAtPoint(0, start + ((static_cast<float>(s) / steps) * (_pos - start)));
+        auto step = m_region->solveStatic(false, ArrayView<ngl::Vec3>(), c_moveTolerance, c_moveIterations);
+        stats.newtonIterations += step.newtonIterations;
+        stats.cgIterations += step.cgIterations;
+        stats.residual = step.residual;
+        stats.converged = step.converged;
+    }
+    io_cloth.setPosAtPoint(m_point, _pos);
+    io_cloth.setVelAtPoint(m_point, ngl::Vec3(0.0f));
+    for(size_t i = 0; i < m_free; ++i)
+    {
+        if(!io_cloth.fixedAtPoint(m_toCloth[i]))
+        {
+            io_cloth.setPosAtPoint(m_toCloth[i], m_region->posAtPoint(i));
+        }
+    }
+    return stats;
+}
+
+StaticSolveStats ClothDrag::moveAlong(Cloth &io_cloth, const ngl::Vec3 &_origin, const ngl::Vec3 &_direction)
+{
+    float along = m_planeNormal.dot(_direction);
+    if(!active() || std::abs(along) < 1e-6f)
+    {
+        return StaticSolveStats();
+    }
+    float t = m_planeNormal.dot(m_planePoint - _origin) / along;
+    return moveTo(io_cloth, _origin + (t * _direction));
+}
+
+void ClothDrag::release(Cloth &io_cloth)
+{
+    if(!active())
+    {
+        return;
+    }
+    io_cloth.fixPoint(m_point, m_wasFixed);
+    m_region.reset();
+    m_toCloth.clear();
+    m_free = 0;
+}
@@ -0,0 +1,172 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include "ClothEnsemble.h"
+#include "ClothGrid.h"
+#include "FixPtTestDefaults.h"
+#include "ParallelFor.h"
+
+ClothEnsemble::ClothEnsemble(const SceneDescription &_scene) :
+    m_scene(_scene)
+{
+    // every case shares the one copy of each obstacle
+    std::string error;
+    m_obstacles = m_scene.loadObstacles(error);
+    if(!error.empty())
+    {
+        std::cerr << error << '\n';
+    }
+}
+
+std::vector<EnsembleCase> ClothEnsemble::casesFromScene(const SceneDescription &_scene)
+{
+    // unswept parameters take the scene's value
+    auto dampings = _scene.sweepDamping.empty() ? std::vector<float>{_scene.damping} : _scene.sweepDamping;
+    auto winds = _scene.sweepWind.empty() ? std::vector<float>{_scene.windOn ? 1.0f : 0.0f} : _scene.sweepWind;
+    auto materials = _scene.sweepMaterial.empty() ? std::vector<material_type>{_scene.material} : _scene.sweepMaterial;
+    auto dts = _scene.sweepDt.empty() ? std::vector<float>{_scene.dt} : _scene.sweepDt;
+    const char *materialNames[] = {"wool", "jute", "custom"};
+    std::vector<EnsembleCase> cases;
+    for(auto material : materials)
+    {
+        for(auto damping : dampings)
+        {
+            for(auto wind : winds)
+            {
+                for(auto dt : dts)
+                {
+                    EnsembleCase c;
+                    c.material = material;
+                    c.damping = damping;
+                    c.windStrength = wind;
+                    c.dt = dt;
+                    c.steps = _scene.steps;
+                    c.integrator = _scene.integrator;
+                    std::ostringstream name;
+                    name << materialNames[material] << " damping " << damping << " wind " << wind << " dt " << dt;
+                    c.name = name.str();
+                    cases.push_back(c);
+                }
+            }
+        }
+    }
+    return cases;
+}
+
+const Cloth &ClothEnsemble::prototype(material_type _material)
+{
+    auto found = m_prototypes.find(_material);
+    if(found != m_prototypes.end())
+    {
+        return found->second;
+    }
+    Cloth c(_material);
+    if(m_scene.gridN > 0)
+    {
+        ClothGrid grid(m_scene.gridN, m_scene.gridM, m_scene.planeXY ? PLANE_XY : PLANE_XZ);
+        c.init(grid, m_scene.fixedPoints, m_scene.damping);
+    }
+    else if(m_scene.planeXY)
+    {
+        c.init(m_scene.mesh, toParamXY, m_scene.fixedPoints, m_scene.damping);
+    }
+    else
+    {
+        c.init(m_scene.mesh, toParamXZ, m_scene.fixedPoints, m_scene.damping);
+    }
+    c.fixCorners(std::vector<bool>(m_scene.fixedPoints.size(), true));
+    c.setSelfCollision(m_scene.selfCollision, m_scene.collisionThickness);
+    c.setJacobianReuse(m_scene.jacobianReuse, m_scene.reuseTolerance);
+    for(auto &o : m_obstacles)
+    {
+        c.addObstacle(o);
+    }
+    // build the shared normal adjacency now, so the copies don't each build their own
+    c.normals();
+    c.setParallel(false);
+    return m_prototypes.emplace(_material, std::move(c)).first->second;
+}
+
+std::vector<EnsembleResult> ClothEnsemble::run(const std::vector<EnsembleCase> &_cases, size_t _numThreads)
+{
+    // set up every prototype before the threads start, they're read-only from then on
+    std::vector<const Cloth *> prototypes;
+    prototypes.reserve(_cases.size());
+    for(auto &c : _cases)
+    {
+        prototypes.push_back(&prototype(c.material));
+    }
+    std::vector<EnsembleResult> results(_cases.size());
+    parallelFor(_cases.size(), _numThreads, [&](size_t i)
+    {
+        results[i] = runCase(_cases[i], *prototypes[i]);
+    });
+    return results;
+}
+
+EnsembleResult ClothEnsemble::runCase(const EnsembleCase &_case, const Cloth &_prototype) const
+{
+    using clock = std::chrono::steady_clock;
+    EnsembleResult result;
+    result.settings = _case;
+    Cloth c = _prototype;
+    c.setDampingCoefficient(_case.damping);
+    if(_case.windStrength != 0.0f)
+    {
+        c.setWind(WindField(m_scene.wind * _case.windStrength));
+    }
+    auto runStart = clock::now();
+    for(size_t step = 0; step < _case.steps && result.stable; ++step)
+    {
+        auto stepStart = clock::now();
+        c.update(_case.dt, _case.integrator, true);
+        auto stepMs = std::chrono::duration<double, std::milli>(clock::now() - stepStart).count();
+        result.meanStepMs += stepMs;
+        result.maxStepMs = std::max(result.maxStepMs, stepMs);
+        ++result.stepsRun;
+        // a cloth that's blown up has non-finite positions, no point carrying on
+        for(size_t i = 0; i < c.numMasses() && result.stable; ++i)
+        {
+            auto p = c.posAtPoint(i);
+            result.stable = std::isfinite(p.m_x) && std::isfinite(p.m_y) && std::isfinite(p.m_z);
+        }
+    }
+    result.seconds = std::chrono::duration<double>(clock::now() - runStart).count();
+    if(result.stepsRun > 0)
+    {
+        result.meanStepMs /= result.stepsRun;
+    }
+    // summarise the final state
+    result.lowestY = c.numMasses() > 0 ? c.posAtPoint(0).m_y : 0.0f;
+    for(size_t i = 0; i < c.numMasses(); ++i)
+    {
+        auto p = c.posAtPoint(i);
+        result.centroid += p;
+        result.lowestY = std::min(result.lowestY, p.m_y);
+        result.maxSpeed = std::max(result.maxSpeed, c.velAtPoint(i).length());
+    }
+    if(c.numMasses() > 0)
+    {
+        result.centroid /= static_cast<float>(c.numMasses());
+    }
+    result.reuseRatio = c.jacobianReuseStats().reuseRatio();
+    return result;
+}
+
+void ClothEnsemble::printSummary(const std::vector<EnsembleResult> &_results, std::ostream &_out)
+{
+    _out << std::left << std::setw(44) << "case" << std::right
+         << std::setw(8) << "stable" << std::setw(8) << "steps" << std::setw(10) << "seconds"
+         << std::setw(10) << "step ms" << std::setw(10) << "lowest y" << std::setw(10) << "max speed"
+         << std::setw(8) << "reuse" << '\n';
+    for(auto &r : _results)
+    {
+        _out << std::left << std::setw(44) << r.settings.name << std::right
+             << std::setw(8) << (r.stable ? "yes" : "NO") << std::setw(8) << r.stepsRun
+             << std::setw(10) << std::setprecision(4) << r.seconds << std::setw(10) << r.meanStepMs
+             << std::setw(10) << r.lowestY << std::setw(10) << r.maxSpeed << std::setw(8) << r.reuseRatio << '\n';
+    }
+}
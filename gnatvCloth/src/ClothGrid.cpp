@@ -0,0 +1,115 @@
+#include <algorithm>
+#include "ClothGrid.h"
+#include "FixPtTestDefaults.h"
+
+ClothGrid::ClothGrid(size_t _n, size_t _m, GridPlane _plane, float _width, float _height) :
+    m_n(std::max<size_t>(_n, 2)), m_m(std::max<size_t>(_m, 2)), m_plane(_plane)
+{
+    // masspoints, row by row along the weft
+    m_positions.reserve(m_n * m_m);
+    m_uvs.reserve(m_n * m_m);
+    for(size_t j = 0; j < m_m; ++j)
+    {
+        auto v = j / static_cast<float>(m_m - 1);
+        for(size_t i = 0; i < m_n; ++i)
+        {
+            auto u = i / static_cast<float>(m_n - 1);
+            auto x = _width * (u - 0.5f);
+            auto y = _height * (v - 0.5f);
+            if(m_plane == PLANE_XY)
+            {
+                m_positions.push_back(ngl::Vec3(x, y, 0.0f));
+            }
+            else
+            {
+                m_positions.push_back(ngl::Vec3(x, 0.0f, y));
+            }
+            m_uvs.push_back(ngl::Vec2(u, v));
+        }
+    }
+    // two triangles per quad, wound so the normals face +z (XY) or +y (XZ)
+    m_indices.reserve((m_n - 1) * (m_m - 1) * 6);
+    bool flip = m_plane == PLANE_XZ;
+    for(size_t j = 0; j + 1 < m_m; ++j)
+    {
+        for(size_t i = 0; i + 1 < m_n; ++i)
+        {
+            auto a = id(i, j);
+            auto b = id(i + 1, j);
+            auto c = id(i, j + 1);
+            auto d = id(i + 1, j + 1);
+            if(flip)
+            {
+                m_indices.insert(m_indices.end(), {a, c, b, b, c, d});
+            }
+            else
+            {
+                m_indices.insert(m_indices.end(), {a, b, c, b, d, c});
+            }
+        }
+    }
+}
+
+std::function<ngl::Vec2(ngl::Vec3)> ClothGrid::toParam() const
+{
+    if(m_plane == PLANE_XY)
+    {
+        return toParamXY;
+    }
+    return toParamXZ;
+}
+
+std::vector<size_t> ClothGrid::corners() const
+{
+    return {id(0, 0), id(m_n - 1, 0), id(0, m_m - 1), id(m_n - 1, m_m - 1)};
+}
+
+std::vector<size_t> ClothGrid::weftHold() const
+{
+    std::vector<size_t> ids;
+    for(size_t j = 1; j + 1 < m_m; ++j)
+    {
+        ids.push_back(id(0, j));
+    }
+    return ids;
+}
+
+std::vector<size_t> ClothGrid::weftPull() const
+{
+    std::vector<size_t> ids;
+    for(size_t j = 1; j + 1 < m_m; ++j)
+    {
+        ids.push_back(id(m_n - 1, j));
+    }
+    return ids;
+}
+
+std::vector<size_t> ClothGrid::warpHold() const
+{
+    std::vector<size_t> ids;
+    for(size_t i = 1; i + 1 < m_n; ++i)
+    {
+        ids.push_back(id(i, 0));
+    }
+    return ids;
+}
+
+std::vector<size_t> ClothGrid::warpPull() const
+{
+    std::vector<size_t> ids;
+    for(size_t i = 1; i + 1 < m_n; ++i)
+    {
+        ids.push_back(id(i, m_m - 1));
+    }
+    return ids;
+}
+
+std::vector<size_t> ClothGrid::fixPoints() const
+{
+    auto ids = corners();
+    for(auto &set : {weftHold(), weftPull(), warpHold(), warpPull()})
+    {
+        ids.insert(ids.end(), set.begin(), set.end());
+    }
+    return ids;
+}
@@ -1,12 +1,14 @@
+#include <chrono>
 #include <string>
 #include <vector>
-#include <random>
 #include <fstream>
 #include <iostream>
 #include <ngl/Vec2.h>
 #include <ngl/Vec3.h>
 #include "ClothInterface.h"
 #include "FixPtTestDefaults.h"
+#include "MaterialCalibration.h"
+#include "Profiler.h"
 
 ClothInterface::ClothInterface()
 {
@@ -26,8 +28,37 @@ ClothInterface::ClothInterface(IntegrationMethod _intm, Config _cnfg, FixPtSetup
     fixClothPts();
 }
 
+ClothInterface::ClothInterface(const SceneDescription &_scene) :
+    m_cloth(_scene.material), m_intm(_scene.integrator), m_config(SCENE), m_scene(_scene)
+{
+    m_windOn = _scene.windOn;
+    m_windField = WindField(_scene.wind);
+    m_cloth.setSelfCollision(_scene.selfCollision, _scene.collisionThickness);
+    m_cloth.setJacobianReuse(_scene.jacobianReuse, _scene.reuseTolerance);
+    std::string error;
+    for(auto &o : _scene.loadObstacles(error))
+    {
+        m_cloth.addObstacle(o);
+    }
+    if(!error.empty())
+    {
+        std::cerr << error << '\n';
+    }
+    initCloth();
+    fixClothPts();
+}
+
+ClothInterface::~ClothInterface()
+{
+    stopSimThread();
+}
+
 void ClothInterface::initCloth()
 {
+    if(queueForSimThread([this]{ initCloth(); }))
+    {
+        return;
+    }
     // init variables
     std::string filename;
     std::function<ngl::Vec2(ngl::Vec3)> toParam;
@@ -72,18 +103,59 @@ void ClothInterface::initCloth()
         toParam = toParamXZ;
         fixpts = wwsTestFixpts;
     } break;
+    case SCENE:
+    {
+        filename = m_scene.mesh;
+        if(m_scene.planeXY)
+        {
+            toParam = toParamXY;
+        }
+        else
+        {
+            toParam = toParamXZ;
+        }
+        fixpts = m_scene.fixedPoints;
+        damping = m_scene.damping;
+    } break;
     }
-    // init cloth
+    // a running cloth file sequence or recording belongs to the old cloth
+    finishObjSequence();
+    m_pointCache.close();
+    // init cloth, a point being dragged belongs to the old one
+    m_drag.release(m_cloth);
     m_cloth.clear();
-    m_cloth.init(filename, toParam, fixpts, damping);
-    // set sideLength, reset update counter
-    m_sideLength = (fixpts.size() - 4) / 2;
+    if(m_config == SCENE && m_scene.gridN > 0)
+    {
+        ClothGrid grid(m_scene.gridN, m_scene.gridM, m_scene.planeXY ? PLANE_XY : PLANE_XZ);
+        m_cloth.init(grid, fixpts, damping);
+    }
+    else
+    {
+        m_cloth.init(filename, toParam, fixpts, damping);
+    }
+    m_cloth.setSolverTelemetry(&m_telemetry);
+    // the ui and scenes step at a fixed dt the explicit methods can't all take in one go
+    m_cloth.setStableSubsteps(true);
+    // set sideLength, reset update counter, flag the new topology
+    m_sideLength = fixpts.size() < 4 ? 0 : (fixpts.size() - 4) / 2;
     m_updateCount = 0;
+    ++m_topologyVersion;
 }
 
 void ClothInterface::fixClothPts()
 {
+    if(queueForSimThread([this]{ fixClothPts(); }))
+    {
+        return;
+    }
     std::vector<bool> whichFixPts;
+    // a scene lists exactly the points it wants fixed
+    if(m_config == SCENE)
+    {
+        whichFixPts.assign(m_scene.fixedPoints.size(), true);
+        m_cloth.fixCorners(whichFixPts);
+        return;
+    }
     // switch on _fixpt
     switch(m_fixpt)
     {
@@ -169,6 +241,10 @@ void ClothInterface::fixClothPts()
 
 void ClothInterface::reinitClothToGraphs()
 {
+    if(queueForSimThread([this]{ reinitClothToGraphs(); }))
+    {
+        return;
+    }
     m_cloth.clear();
     m_cloth = Cloth(CUSTOM);
     initCloth();
@@ -177,61 +253,186 @@ void ClothInterface::reinitClothToGraphs()
 
 void ClothInterface::setConfig(Config _config)
 {
+    if(queueForSimThread([this, _config]{ setConfig(_config); }))
+    {
+        return;
+    }
     m_config = _config;
     initCloth();
 }
 
 void ClothInterface::setFixPtSetup(FixPtSetup _fixpt)
 {
+    if(queueForSimThread([this, _fixpt]{ setFixPtSetup(_fixpt); }))
+    {
+        return;
+    }
     m_fixpt = _fixpt;
     fixClothPts();
 }
 
+void ClothInterface::setIntMethod(IntegrationMethod _intm)
+{
+    if(queueForSimThread([this, _intm]{ setIntMethod(_intm); }))
+    {
+        return;
+    }
+    m_intm = _intm;
+}
+
+void ClothInterface::setWindState(bool _isWindOn)
+{
+    if(queueForSimThread([this, _isWindOn]{ setWindState(_isWindOn); }))
+    {
+        return;
+    }
+    m_windOn = _isWindOn;
+}
+
+void ClothInterface::setSelfCollision(bool _isSelfCollisionOn)
+{
+    if(queueForSimThread([this, _isSelfCollisionOn]{ setSelfCollision(_isSelfCollisionOn); }))
+    {
+        return;
+    }
+    m_cloth.setSelfCollision(_isSelfCollisionOn);
+}
+
+void ClothInterface::setJacobianReuse(bool _isJacobianReuseOn)
+{
+    if(queueForSimThread([this, _isJacobianReuseOn]{ setJacobianReuse(_isJacobianReuseOn); }))
+    {
+        return;
+    }
+    m_cloth.setJacobianReuse(_isJacobianReuseOn);
+}
+
 void ClothInterface::setClothPtPos(size_t _id, ngl::Vec3 _pos)
 {
-    m_cloth.setPosAtPoint(_id, _pos);
-    m_cloth.newtonRelax();
+    if(queueForSimThread([this, _id, _pos]{ setClothPtPos(_id, _pos); }))
+    {
+        return;
+    }
+    // a one off drag, relaxing just the neighbourhood
+    bool dragging = m_drag.active() && m_drag.point() == _id;
+    if(!dragging)
+    {
+        m_drag.grab(m_cloth, _id);
+    }
+    m_drag.moveTo(m_cloth, _pos);
+    if(!dragging)
+    {
+        m_drag.release(m_cloth);
+    }
 }
 
-void ClothInterface::updateCloth(float _h)
+void ClothInterface::grabClothPt(ngl::Vec3 _origin, ngl::Vec3 _direction)
 {
-    // make external forces
-    std::vector<ngl::Vec3> externalf;
-    externalf.resize(m_cloth.numMasses());
-    std::default_random_engine gen(m_updateCount);
-    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
-    if(m_windOn)
+    if(queueForSimThread([this, _origin, _direction]{ grabClothPt(_origin, _direction); }))
     {
-        // create gusts of wind in the xz direction
-        for(size_t i = 0; i < externalf.size(); ++i)
-        {
-            auto windFactor = (((m_updateCount % 20)) + 1.0f)/3.0f;
-            externalf[i].m_x = m_windVector.m_x * dist(gen) * windFactor;
-            externalf[i].m_z = m_windVector.m_z * dist(gen) * windFactor;
-        }
+        return;
     }
-    else
+    m_drag.grab(m_cloth, _origin, _direction);
+}
+
+void ClothInterface::dragClothPt(ngl::Vec3 _origin, ngl::Vec3 _direction)
+{
+    // the mouse can move faster than the sim steps, only the newest queued move is worth relaxing
+    auto request = ++m_dragRequests;
+    auto move = [this, _origin, _direction, request]
     {
-        // run some wind for the first several updates of an XY config so it has a reason to move onto the z-axis
-        if(((m_config == LRXY) || (m_config == HRXY)) && (m_updateCount < 50))
+        if(request == m_dragRequests.load(std::memory_order_relaxed))
         {
-            for(size_t i = 0; i < externalf.size(); ++i)
-            {
-                externalf[i].m_x = m_windVector.m_x * dist(gen);
-                externalf[i].m_z = m_windVector.m_z * dist(gen);
-            }
+            m_drag.moveAlong(m_cloth, _origin, _direction);
         }
+    };
+    if(queueForSimThread(move))
+    {
+        return;
     }
-    // determine which integration method to use
-    bool _useRK4 = false;
-    if(m_intm == RK4)
+    move();
+}
+
+void ClothInterface::releaseClothPt()
+{
+    if(queueForSimThread([this]{ releaseClothPt(); }))
     {
-        _useRK4 = true;
+        return;
     }
+    m_drag.release(m_cloth);
+}
+
+void ClothInterface::setWriteOutPath(std::string _directory, std::string _prefix)
+{
+    if(queueForSimThread([this, _directory, _prefix]{ setWriteOutPath(_directory, _prefix); }))
+    {
+        return;
+    }
+    finishObjSequence();
+    m_writeOutDir = _directory;
+    m_writeOutPrefix = _prefix;
+}
+
+void ClothInterface::setWriteOutEnabled(bool _writeOut)
+{
+    if(queueForSimThread([this, _writeOut]{ setWriteOutEnabled(_writeOut); }))
+    {
+        return;
+    }
+    m_writeOutOn = _writeOut;
+    if(!m_writeOutOn)
+    {
+        finishObjSequence();
+    }
+}
+
+void ClothInterface::updateCloth(float _h)
+{
+    // run some wind for the first several updates of an XY config so it has a reason to move onto the z-axis
+    bool nudge = ((m_config == LRXY) || (m_config == HRXY)) && (m_updateCount < 50);
+    m_cloth.setWind((m_windOn || nudge) ? m_windField : WindField());
     // send to cloth update
-    m_cloth.update(_h, _useRK4, true, externalf);
+    m_cloth.update(_h, m_intm, true);
     // increment counter
     ++m_updateCount;
+    // record the new state
+    if(m_pointCache.isOpen())
+    {
+        m_cloth.positions(m_writePositions);
+        m_pointCache.writeFrame(m_writePositions);
+    }
+}
+
+ClothMemoryUsage ClothInterface::memoryUsage() const
+{
+    auto usage = m_cloth.memoryUsage();
+    usage.renderBuffers += (m_renderPositions.capacity() + m_writePositions.capacity()) * sizeof(ngl::Vec3);
+    return usage;
+}
+
+void ClothInterface::printMemoryUsage(std::ostream &_out)
+{
+    if(queueForSimThread([this, &_out]{ printMemoryUsage(_out); }))
+    {
+        return;
+    }
+    memoryUsage().print(_out);
+}
+
+void ClothInterface::writeProfileTrace(std::string _filename)
+{
+    if(queueForSimThread([this, _filename]{ writeProfileTrace(_filename); }))
+    {
+        return;
+    }
+    if(Profiler::instance().writeChromeTrace(_filename))
+    {
+        std::cout << "wrote " << _filename << '\n';
+    }
+    else
+    {
+        std::cerr << "couldn't write " << _filename << '\n';
+    }
 }
 
 void ClothInterface::renderCloth(std::vector<float> &o_vertexData)
@@ -239,133 +440,278 @@ void ClothInterface::renderCloth(std::vector<float> &o_vertexData)
     m_cloth.render(o_vertexData);
 }
 
+void ClothInterface::renderCloth(ClothRenderMesh &io_mesh)
+{
+    // while the sim thread runs, draw the newest frame it has finished
+    if(simThreadRunning())
+    {
+        m_frames.update();
+        auto &frame = m_frames.readBuffer();
+        if(frame.topology)
+        {
+            if(io_mesh.version() != frame.topology->version)
+            {
+                io_mesh.build(frame.topology->indices, frame.topology->cornerUVs, frame.topology->version);
+            }
+            io_mesh.fillStream(frame.positions, frame.normals);
+        }
+        return;
+    }
+    // static data only needs rebuilding when the cloth has been reinitialized
+    if(io_mesh.version() != m_topologyVersion)
+    {
+        std::vector<size_t> indices;
+        std::vector<ngl::Vec2> cornerUVs;
+        m_cloth.triangleIndices(indices);
+        m_cloth.triangleUVs(cornerUVs);
+        io_mesh.build(indices, cornerUVs, m_topologyVersion);
+    }
+    m_cloth.positions(m_renderPositions);
+    io_mesh.fillStream(m_renderPositions, m_cloth.normals());
+}
+
 void ClothInterface::writeOutCloth()
 {
-    // update count - we want 4 places in the number, so leading 0's matter
-    std::string count;
-    if(m_updateCount < 10)
+    // the UVs and faces don't change, so the writer formats them once per sequence
+    if(!m_objWriter.running())
     {
-        count = "000" + std::to_string(m_updateCount);
+        std::vector<ngl::Vec2> uvs;
+        std::vector<size_t> indices;
+        m_cloth.vertexUVs(uvs);
+        m_cloth.triangleIndices(indices);
+        m_objWriter.start(m_writeOutDir, m_writeOutPrefix, uvs, indices);
     }
-    else if(m_updateCount < 100)
+    // hand the current state over to the writer thread
+    m_cloth.positions(m_writePositions);
+    m_objWriter.submit(m_updateCount, m_writePositions, m_cloth.normals());
+}
+
+void ClothInterface::finishObjSequence()
+{
+    if(!m_objWriter.running())
     {
-        count = "00" + std::to_string(m_updateCount);
+        return;
     }
-    else if(m_updateCount < 1000)
+    m_objWriter.stop();
+    if(m_objWriter.framesFailed() > 0)
     {
-        count = "0" + std::to_string(m_updateCount);
+        std::cerr << m_objWriter.framesFailed() << " of " << m_objWriter.framesFailed() + m_objWriter.framesWritten()
+                  << " cloth files couldn't be written to " << m_writeOutDir << '\n';
     }
-    else
+}
+
+void ClothInterface::stopWriteOut()
+{
+    if(queueForSimThread([this]{ stopWriteOut(); }))
     {
-        count = std::to_string(m_updateCount);
+        return;
     }
-    std::string filename = "results/increaseY/warpYMax.";
-    filename = filename + count + ".obj";
-    m_cloth.writeToObj(filename);
+    finishObjSequence();
 }
 
-void ClothInterface::runWeftTest()
+bool ClothInterface::startRecording(std::string _filename)
 {
-    // save previous settings
-    auto old_config = m_config;
-    auto old_fixpt = m_fixpt;
-    auto old_windOn = m_windOn;
-    // change to settings needed for test
-    m_config = WEFTXZ;
-    m_fixpt = WEFT_TEST;
-    m_windOn = false;
-    // reinit
-    initCloth();
+    if(simThreadRunning())
+    {
+        std::cerr << "stop the sim before recording a point cache\n";
+        return false;
+    }
+    std::vector<ngl::Vec2> uvs;
+    std::vector<size_t> indices;
+    m_cloth.vertexUVs(uvs);
+    m_cloth.triangleIndices(indices);
+    if(!m_pointCache.open(_filename, uvs, indices))
+    {
+        return false;
+    }
+    m_cloth.positions(m_writePositions);
+    m_pointCache.writeFrame(m_writePositions);
+    return true;
+}
+
+void ClothInterface::stopRecording()
+{
+    if(queueForSimThread([this]{ stopRecording(); }))
+    {
+        return;
+    }
+    m_pointCache.close();
+}
+
+bool ClothInterface::startTelemetry(std::string _filename, SolverTelemetry::Format _format)
+{
+    if(simThreadRunning())
+    {
+        std::cerr << "stop the sim before recording solver telemetry\n";
+        return false;
+    }
+    return m_telemetry.open(_filename, _format);
+}
 
-    // open file
-    std::ofstream out;
-    out.open("results/weft_test_results.txt", std::ofstream::out | std::ofstream::trunc);
-    out << "Weft Test Results\n\n";
-    // take an initial measurement of the elements being pulled - going in positive x
-    std::vector<float> initPos;
-    initPos.reserve(weftTestPullPts.size());
-    for(auto k : weftTestPullPts)
-    {
-        initPos.push_back(m_cloth.posAtPoint(k).m_x);
-    }
-    // test loop
-    size_t numTests = weftTestForces.size();
-    for(size_t i = 0; i < numTests; ++i)
-    {
-        // make external forces
-        std::vector<ngl::Vec3> externalf;
-        externalf.resize(m_cloth.numMasses());
-        for(auto k : weftTestPullPts)
+void ClothInterface::stopTelemetry()
+{
+    if(queueForSimThread([this]{ stopTelemetry(); }))
+    {
+        return;
+    }
+    m_telemetry.close();
+}
+
+void ClothInterface::startSimThread(float _h)
+{
+    if(simThreadRunning())
+    {
+        return;
+    }
+    m_simStep = _h;
+    // publish the starting state so there's something to draw straight away
+    m_topology.reset();
+    publishFrame();
+    m_simRunning = true;
+    m_simThread = std::thread(&ClothInterface::simLoop, this);
+}
+
+void ClothInterface::stopSimThread()
+{
+    if(!simThreadRunning())
+    {
+        return;
+    }
+    m_simRunning = false;
+    m_simThread.join();
+    // anything queued after the last step still gets applied
+    std::function<void()> command;
+    while(m_commands.pop(command))
+    {
+        command();
+    }
+}
+
+bool ClothInterface::queueForSimThread(std::function<void()> _command)
+{
+    if(!simThreadRunning() || std::this_thread::get_id() == m_simThread.get_id())
+    {
+        return false;
+    }
+    // the queue only fills up if the sim is stalled, so just wait for a free slot
+    while(!m_commands.push(std::move(_command)))
+    {
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+void ClothInterface::simLoop()
+{
+    auto step = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(m_simStep));
+    auto next = std::chrono::steady_clock::now();
+    while(m_simRunning.load(std::memory_order_acquire))
+    {
+        // apply ui changes between steps
+        std::function<void()> command;
+        while(m_commands.pop(command))
         {
-            externalf[k] = ngl::Vec3(weftTestForces[i], 0.0f, 0.0f);
+            command();
         }
-        // run updates with this external force applied
-        size_t numLoops = 20;
-        for(size_t j = 0; j < numLoops; ++j)
+        // step and hand the result over to the renderer
+        if(m_writeOutOn)
         {
-            m_cloth.update(0.01f, true, false, externalf);
+            writeOutCloth();
         }
-        // record displacements
-        out << "Test " << i << ", Force " << weftTestForces[i] << " resulted in the following average displacement: \n";
-        float result = 0.0f;
-        for(size_t k = 0; k < weftTestPullPts.size(); ++k)
+        updateCloth(m_simStep);
+        publishFrame();
+        // don't run ahead of real time, a slow step just starts the next one straight away
+        next += step;
+        auto now = std::chrono::steady_clock::now();
+        if(next > now)
         {
-            result += m_cloth.posAtPoint(weftTestPullPts[k]).m_x - initPos[k];
-            //out << m_cloth.posAtPoint(weftTestPullPts[k]).m_x - initPos[k] << ' ';
+            std::this_thread::sleep_until(next);
         }
-        result = result / weftTestPullPts.size();
-        out << result << '\n';
-        //out << '\n';
-//        // make external forces - 0 vector
-//        std::vector<ngl::Vec3> externalf;
-//        externalf.resize(m_cloth.numMasses());
-//        // displace the end points by the displacement amount in positive x direction
-//        for(size_t j = 0; j < weftTestPullPts.size(); ++j)
-//        {
-//            auto newPos = m_cloth.posAtPoint(weftTestPullPts[j]);
-//            newPos.m_x = initPos[j] + weftTestDisp[i];
-//            m_cloth.setPosAtPoint(weftTestPullPts[j], newPos);
-//        }
-//        // run internal forces
-//        m_cloth.forceCalc(0.01f, false, externalf, false);
-//        // output the sum of the forces at the test points
-//        ngl::Vec3 result;
-//        out << "Test " << i << ", Displacement "<< weftTestDisp[i]<< " resulted in the total edge force:\n";
-//        for(size_t k = 0; k < weftTestPullPts.size(); ++k)
-//        {
-//            result += m_cloth.forcesAtPoint(weftTestPullPts[k]).m_x;
-//            //out << m_cloth.forcesAtPoint(weftTestPullPts[k]).m_x << ' ';
-//        }
-//        //out << '\n';
-//        out << result.m_x << ' ' << result.m_y << ' ' << result.m_z << '\n';
-//        // run updates until equilibrium is reached
-//        size_t equilibriumLoops = 10;
-//        for(size_t l = 0; l < equilibriumLoops; ++l)
-//        {
-//            m_cloth.update(0.01f, true, false, externalf);
-//        }
-//        result.null();
-//        // forces on these points after equilibrium
-//        out << "After Equilibrium: \n";
-//        for(size_t k = 0; k < weftTestPullPts.size(); ++k)
-//        {
-//            result += m_cloth.forcesAtPoint(weftTestPullPts[k]).m_x;
-//        }
-//        out << result.m_x << ' ' << result.m_y << ' ' << result.m_z << '\n';
-        // print out update so we know what's going on
-        std::cout<<"Weft Test: finished loop "<< i << '\n';
-    }
-
-    // close file
-    out.close();
-    // now that we're done, reinit back to old settings
-    m_config = old_config;
-    m_fixpt = old_fixpt;
-    m_windOn = old_windOn;
-    initCloth();
+        else
+        {
+            next = now;
+        }
+    }
+}
+
+void ClothInterface::publishFrame()
+{
+    // the topology is shared between frames, only remade when the cloth is reinitialized
+    if(!m_topology || m_topology->version != m_topologyVersion)
+    {
+        auto topology = std::make_shared<RenderTopology>();
+        topology->version = m_topologyVersion;
+        m_cloth.triangleIndices(topology->indices);
+        m_cloth.triangleUVs(topology->cornerUVs);
+        m_topology = topology;
+    }
+    auto &frame = m_frames.writeBuffer();
+    frame.topology = m_topology;
+    m_cloth.positions(frame.positions);
+    auto &normals = m_cloth.normals();
+    frame.normals.assign(normals.begin(), normals.end());
+    m_frames.publish();
+}
+
+void ClothInterface::runWeftTest()
+{
+    runForceTests({FORCE_TEST_WEFT}, "results/weft_test_results.csv");
 }
 
 void ClothInterface::runWarpTest()
 {
+    runForceTests({FORCE_TEST_WARP}, "results/warp_test_results.csv");
+}
 
+void ClothInterface::runShearTest()
+{
+    runForceTests({FORCE_TEST_SHEAR}, "results/shear_test_results.csv");
+}
+
+bool ClothInterface::runForceTests(std::vector<ForceTestType> _tests, std::string _filename)
+{
+    if(simThreadRunning())
+    {
+        std::cerr << "stop the sim before running the force tests\n";
+        return false;
+    }
+    // the tests run on their own cloths, the current one is left alone
+    std::vector<ForceTestResult> results;
+    for(auto test : _tests)
+    {
+        results.push_back(runForceTest(ForceTestSetup::standard(test, m_objPath), m_cloth.material()));
+        std::cout << results.back().name << " test: " << results.back().levels.size() << " force levels in "
+                  << results.back().seconds << " s\n";
+    }
+    return writeForceTestResults(results, _filename);
+}
+
+bool ClothInterface::calibrateToMeasured(std::string _weftFile, std::string _warpFile)
+{
+    if(simThreadRunning())
+    {
+        std::cerr << "stop the sim before calibrating\n";
+        return false;
+    }
+    std::vector<CalibrationTarget> targets;
+    CalibrationTarget target;
+    if(readCalibrationTarget(FORCE_TEST_WEFT, m_objPath, _weftFile, target))
+    {
+        targets.push_back(target);
+    }
+    if(readCalibrationTarget(FORCE_TEST_WARP, m_objPath, _warpFile, target))
+    {
+        targets.push_back(target);
+    }
+    if(targets.empty())
+    {
+        return false;
+    }
+    auto result = calibrateMaterial(m_cloth.materialData(), targets);
+    std::cout << "calibration: RMS displacement error " << result.errors.front() << " -> " << result.errors.back()
+              << " over " << result.levelsUsed << " force levels, " << result.iterations << " steps in "
+              << result.seconds << " s\n";
+    result.material.writeGraphs("graphsFromUI");
+    reinitClothToGraphs();
+    return true;
 }
@@ -0,0 +1,60 @@
+#include <unordered_map>
+#include "ClothRenderMesh.h"
+
+constexpr size_t ClothRenderMesh::c_streamStride;
+
+void ClothRenderMesh::build(const std::vector<size_t> &_indices, const std::vector<ngl::Vec2> &_cornerUVs, size_t _version)
+{
+    m_version = _version;
+    m_indices.clear();
+    m_uvs.clear();
+    m_vertexToMassPoint.clear();
+    m_indices.reserve(_indices.size());
+    // render vertices already made for each masspoint, one per distinct UV
+    std::unordered_map<size_t, std::vector<uint32_t>> made;
+    for(size_t i = 0; i < _indices.size(); ++i)
+    {
+        auto mp = _indices[i];
+        auto uv = _cornerUVs[i];
+        auto &candidates = made[mp];
+        // reuse a vertex if this masspoint already has one with the same UV
+        bool found = false;
+        for(auto v : candidates)
+        {
+            if(m_uvs[v*2] == uv.m_x && m_uvs[v*2 + 1] == uv.m_y)
+            {
+                m_indices.push_back(v);
+                found = true;
+                break;
+            }
+        }
+        if(!found)
+        {
+            auto v = static_cast<uint32_t>(m_vertexToMassPoint.size());
+            m_vertexToMassPoint.push_back(mp);
+            m_uvs.push_back(uv.m_x);
+            m_uvs.push_back(uv.m_y);
+            candidates.push_back(v);
+            m_indices.push_back(v);
+        }
+    }
+    m_stream.resize(m_vertexToMassPoint.size() * c_streamStride);
+}
+
+void ClothRenderMesh::fillStream(const std::vector<ngl::Vec3> &_positions, const std::vector<ngl::Vec3> &_normals)
+{
+    m_stream.resize(m_vertexToMassPoint.size() * c_streamStride);
+    auto out = m_stream.data();
+    for(auto mp : m_vertexToMassPoint)
+    {
+        auto p = _positions[mp];
+        auto n = _normals[mp];
+        out[0] = p.m_x;
+        out[1] = p.m_y;
+        out[2] = p.m_z;
+        out[3] = n.m_x;
+        out[4] = n.m_y;
+        out[5] = n.m_z;
+        out += c_streamStride;
+    }
+}
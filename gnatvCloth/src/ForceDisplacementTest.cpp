@@ -0,0 +1,205 @@
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include "ForceDisplacementTest.h"
+#include "FixPtTestDefaults.h"
+#include "ParallelFor.h"
+
+ForceTestSetup ForceTestSetup::standard(ForceTestType _type, const std::string &_objPath)
+{
+    ForceTestSetup setup;
+    setup.toParam = toParamXZ;
+    switch(_type)
+    {
+    case FORCE_TEST_WEFT:
+    {
+        // strip along z, hold the x = -2.5 edge, pull the x = +2.5 edge
+        setup.name = "weft";
+        setup.mesh = _objPath + "weftTestCloth.obj";
+        setup.held = weftTestHoldPts;
+        setup.pulled = weftTestPullPts;
+        setup.direction = ngl::Vec3(1.0f, 0.0f, 0.0f);
+        setup.forces = weftTestForces;
+    } break;
+    case FORCE_TEST_WARP:
+    {
+        // hold the z = +5 edge (warp holds), pull the z = -5 edge
+        setup.name = "warp";
+        setup.mesh = _objPath + "clothHiResXZ.obj";
+        setup.held = warpTestHoldPts;
+        setup.pulled = warpTestPullPts;
+        setup.direction = ngl::Vec3(0.0f, 0.0f, -1.0f);
+        setup.forces = warpTestForces;
+        // the hi-res mesh is too stiff for RK4 at 0.01 once the pull gets past ~20,
+        // so dynamic runs take smaller steps over the same simulated time
+        setup.steps = 100;
+        setup.h = 0.002f;
+    } break;
+    case FORCE_TEST_SHEAR:
+    {
+        // hold the x = +5 edge, slide the x = -5 edge along itself
+        setup.name = "shear";
+        setup.mesh = _objPath + "clothHiResXZ.obj";
+        setup.held = shearTestHoldPts;
+        setup.pulled = shearTestPullRight;
+        setup.direction = ngl::Vec3(0.0f, 0.0f, 1.0f);
+        setup.forces = shearTestForces;
+        // with no bending or compressive stiffness the sheared cloth has no unique resting
+        // shape to solve for, so shear keeps stepping it dynamically
+        setup.mode = FORCE_TEST_DYNAMIC;
+    } break;
+    }
+    return setup;
+}
+
+namespace
+{
+    /**
+     * @brief mean displacement of the pulled points along the pull
+    */
+    float pullDisplacement(const Cloth &_cloth, const ForceTestSetup &_setup, const std::vector<ngl::Vec3> &_initPos)
+    {
+        float displacement = 0.0f;
+        for(size_t k = 0; k < _setup.pulled.size(); ++k)
+        {
+            displacement += (_cloth.posAtPoint(_setup.pulled[k]) - _initPos[k]).dot(_setup.direction);
+        }
+        return displacement / _setup.pulled.size();
+    }
+
+    /**
+     * @brief steps the load up through every level on one cloth, solving for equilibrium at each
+    */
+    void runStatic(Cloth &io_cloth, const ForceTestSetup &_setup, const std::vector<ngl::Vec3> &_initPos,
+                   const ForceTestLevelCallback &_atLevel, std::vector<ForceTestLevel> &o_levels)
+    {
+        using clock = std::chrono::steady_clock;
+        auto pull = std::make_shared<SparseForces>(_setup.pulled);
+        io_cloth.addForceField(pull);
+        std::vector<ngl::Vec3> lastPos;
+        float lastForce = 0.0f;
+        for(size_t i = 0; i < o_levels.size(); ++i)
+        {
+            auto levelStart = clock::now();
+            auto &level = o_levels[i];
+            level.force = _setup.forces[i];
+            io_cloth.positions(lastPos);
+            // halve the load increment until every sub-increment reaches equilibrium
+            StaticSolveStats stats;
+            for(size_t increments = 1; increments <= 4; increments *= 2)
+            {
+                for(size_t k = 0; k < lastPos.size(); ++k)
+                {
+                    io_cloth.setPosAtPoint(k, lastPos[k]);
+                }
+                for(size_t j = 1; j <= increments; ++j)
+                {
+                    auto force = lastForce + (level.force - lastForce) * j / increments;
+                    pull->setForces(_setup.direction * force);
+                    stats = io_cloth.solveStatic(false, ArrayView<ngl::Vec3>(), _setup.tolerance);
+                    level.newtonIterations += stats.newtonIterations;
+                    level.cgIterations += stats.cgIterations;
+                    if(!stats.converged)
+                    {
+                        break;
+                    }
+                }
+                if(stats.converged)
+                {
+                    break;
+                }
+            }
+            level.residual = stats.residual;
+            level.displacement = pullDisplacement(io_cloth, _setup, _initPos);
+            level.stable = stats.converged && std::isfinite(level.displacement);
+            lastForce = level.force;
+            if(_atLevel)
+            {
+                _atLevel(io_cloth, i);
+            }
+            level.ms = std::chrono::duration<double, std::milli>(clock::now() - levelStart).count();
+        }
+        io_cloth.removeForceField(pull.get());
+    }
+}
+
+ForceTestResult runForceTest(const ForceTestSetup &_setup, material_type _material, size_t _numThreads)
+{
+    auto result = runForceTest(_setup, MaterialData::standard(_material), _numThreads);
+    result.material = _material;
+    return result;
+}
+
+ForceTestResult runForceTest(const ForceTestSetup &_setup, const MaterialData &_material, size_t _numThreads,
+                             const ForceTestLevelCallback &_atLevel)
+{
+    using clock = std::chrono::steady_clock;
+    auto start = clock::now();
+    ForceTestResult result;
+    result.name = _setup.name;
+    result.mode = _setup.mode;
+    result.material = CUSTOM;
+    // set up the cloth at rest once, every dynamic level runs on a copy
+    Cloth prototype(_material);
+    prototype.init(_setup.mesh, _setup.toParam, _setup.held, 9.0f);
+    prototype.fixCorners(std::vector<bool>(_setup.held.size(), true));
+    result.masspoints = prototype.numMasses();
+    std::vector<ngl::Vec3> initPos;
+    for(auto k : _setup.pulled)
+    {
+        initPos.push_back(prototype.posAtPoint(k));
+    }
+    result.levels.resize(_setup.forces.size());
+    if(_setup.mode == FORCE_TEST_STATIC)
+    {
+        // each level starts from the last one, so they run in order
+        runStatic(prototype, _setup, initPos, _atLevel, result.levels);
+        result.seconds = std::chrono::duration<double>(clock::now() - start).count();
+        return result;
+    }
+    // run the levels side by side
+    prototype.setParallel(false);
+    parallelFor(_setup.forces.size(), _numThreads, [&](size_t i)
+    {
+        auto levelStart = clock::now();
+        auto &level = result.levels[i];
+        level.force = _setup.forces[i];
+        Cloth c = prototype;
+        c.addForceField(std::make_shared<SparseForces>(_setup.pulled, _setup.direction * level.force));
+        for(size_t j = 0; j < _setup.steps; ++j)
+        {
+            c.update(_setup.h, RK4, false);
+        }
+        level.displacement = pullDisplacement(c, _setup, initPos);
+        level.stable = std::isfinite(level.displacement);
+        level.ms = std::chrono::duration<double, std::milli>(clock::now() - levelStart).count();
+    });
+    result.seconds = std::chrono::duration<double>(clock::now() - start).count();
+    return result;
+}
+
+bool writeForceTestResults(const std::vector<ForceTestResult> &_results, const std::string &_filename)
+{
+    std::ofstream out(_filename, std::ofstream::out | std::ofstream::trunc);
+    if(!out)
+    {
+        return false;
+    }
+    const char *materialNames[] = {"wool", "jute", "custom"};
+    const char *modeNames[] = {"static", "dynamic"};
+    out << "test,mode,material,masspoints,level,force,displacement,stable,newton_iterations,cg_iterations,"
+        << "residual,level_ms,test_seconds\n";
+    for(auto &r : _results)
+    {
+        for(size_t i = 0; i < r.levels.size(); ++i)
+        {
+            auto &l = r.levels[i];
+            out << r.name << ',' << modeNames[r.mode] << ',' << materialNames[r.material] << ',' << r.masspoints << ','
+                << i << ',' << l.force << ',' << l.displacement << ',' << (l.stable ? 1 : 0) << ','
+                << l.newtonIterations << ',' << l.cgIterations << ',' << l.residual << ','
+                << l.ms << ',' << r.seconds << '\n';
+        }
+    }
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,18 @@
+#include <algorithm>
+#include "ForceField.h"
+
+ngl::Vec3 PointForce::force(size_t, size_t, const ngl::Vec3 &_pos, const ngl::Vec3 &, float) const
+{
+    auto away = _pos - m_centre;
+    float distance = away.length();
+    if(distance >= m_radius || distance <= 0.0f)
+    {
+        return ngl::Vec3(0.0f);
+    }
+    return (m_strength * (1.0f - distance / m_radius) / distance) * away;
+}
+
+void SparseForces::setForces(const ngl::Vec3 &_force)
+{
+    std::fill(m_forces.begin(), m_forces.end(), _force);
+}
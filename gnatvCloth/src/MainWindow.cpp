@@ -29,6 +29,8 @@ MainWindow::MainWindow(QWidget *parent) :QMainWindow(parent), m_ui(new Ui::MainW
   // toggle options slots
   connect(m_ui->m_wireframe, SIGNAL(toggled(bool)), m_gl, SLOT(toggleWireframe(bool)));
   connect(m_ui->m_isWindOn, SIGNAL(toggled(bool)), m_gl, SLOT(toggleWind(bool)));
+  connect(m_ui->m_selfCollision, SIGNAL(toggled(bool)), m_gl, SLOT(toggleSelfCollision(bool)));
+  connect(m_ui->m_jacobianReuse, SIGNAL(toggled(bool)), m_gl, SLOT(toggleJacobianReuse(bool)));
   connect(m_ui->m_writeOutCloth, SIGNAL(toggled(bool)), m_gl, SLOT(toggleWriteOut(bool)));
   // start/stop/reset sim slots
   connect(m_ui->m_startButton, SIGNAL(clicked()), m_gl, SLOT(startSim()));
@@ -100,6 +100,23 @@ void MassPoint::resetJacobians()
     }
 }
 
+size_t MassPoint::jacobianBytes() const
+{
+    const size_t node = sizeof(void *) + sizeof(std::pair<const size_t, Jacobian>);
+    const size_t allocOverhead = 2 * sizeof(void *);
+    return m_jacobians.size() * (node + allocOverhead) + m_jacobians.bucket_count() * sizeof(void *);
+}
+
+void MassPoint::initJacobians(const std::vector<size_t> &_ids)
+{
+    m_jacobians.reserve(_ids.size());
+    for(auto id : _ids)
+    {
+        m_jacobians[id].Jpos = ngl::Mat3(0.0f);
+        m_jacobians[id].Jvel = ngl::Mat3(0.0f);
+    }
+}
+
 void MassPoint::addJpos(const size_t _id, const ngl::Mat3 _jpos)
 {
     // make sure initial matrices are zero'd out
@@ -0,0 +1,388 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <boost/algorithm/string.hpp>
+#include "MaterialCalibration.h"
+#include "ParallelFor.h"
+
+bool readCalibrationTarget(ForceTestType _type, const std::string &_objPath, const std::string &_filename,
+                           CalibrationTarget &o_target)
+{
+    std::ifstream in(_filename);
+    if(!in)
+    {
+        return false;
+    }
+    o_target.setup = ForceTestSetup::standard(_type, _objPath);
+    o_target.setup.forces.clear();
+    o_target.displacements.clear();
+    std::string line;
+    while(std::getline(in, line))
+    {
+        if(line.rfind("test,", 0) == 0)
+        {
+            // csv header
+            continue;
+        }
+        if(line.rfind("Test ", 0) == 0)
+        {
+            // "Test i, Force F resulted in the following average displacement: " then d on the next line
+            auto force = line.find("Force ");
+            std::string displacement;
+            if(force == std::string::npos || !std::getline(in, displacement))
+            {
+                continue;
+            }
+            o_target.setup.forces.push_back(std::stof(line.substr(force + 6)));
+            o_target.displacements.push_back(std::stof(displacement));
+        }
+        else
+        {
+            // csv row, test,mode,material,masspoints,level,force,displacement,...
+            std::vector<std::string> res;
+            boost::split(res, line, [](char c){return c == ',';});
+            if(res.size() > 6 && res[0] == o_target.setup.name)
+            {
+                o_target.setup.forces.push_back(std::stof(res[5]));
+                o_target.displacements.push_back(std::stof(res[6]));
+            }
+        }
+    }
+    return !o_target.setup.forces.empty();
+}
+
+namespace
+{
+    /**
+     * @brief one adjustable data value
+    */
+    struct Parameter
+    {
+        MaterialCurve MaterialData::*curve;     /**< Curve the value belongs to */
+        size_t index;                           /**< Index into its data */
+    };
+
+    /**
+     * @brief the fit's residuals and their Jacobian at one set of data values
+    */
+    struct Evaluation
+    {
+        std::vector<double> residuals;              /**< Simulated minus measured displacement per level used */
+        std::vector<std::vector<double>> jacobian;  /**< d(residual)/d(parameter), one row per residual */
+        double error = 0.0;                         /**< RMS of the residuals */
+    };
+
+    /**
+     * @brief runs every static target on the material, collecting residuals and sensitivities
+    */
+    Evaluation evaluate(const MaterialData &_material, const std::vector<CalibrationTarget> &_targets,
+                        const std::vector<Parameter> &_params, size_t _numThreads)
+    {
+        std::vector<Evaluation> perTarget(_targets.size());
+        parallelFor(_targets.size(), _numThreads, [&](size_t t)
+        {
+            auto &target = _targets[t];
+            if(target.setup.mode != FORCE_TEST_STATIC)
+            {
+                return;
+            }
+            std::vector<std::vector<double>> rows(target.setup.forces.size());
+            std::vector<bool> solved(rows.size(), false);
+            auto atLevel = [&](Cloth &io_cloth, size_t _level)
+            {
+                // the displacement is the mean of the pulled points along the pull
+                std::vector<ngl::Vec3> g(io_cloth.numMasses()), adjoint;
+                for(auto k : target.setup.pulled)
+                {
+                    g[k] = target.setup.direction / static_cast<float>(target.setup.pulled.size());
+                }
+                solved[_level] = io_cloth.solveStiffness(g, adjoint);
+                auto sensitivity = io_cloth.materialSensitivity(adjoint);
+                for(auto &p : _params)
+                {
+                    rows[_level].push_back((sensitivity.*p.curve).data[p.index]);
+                }
+            };
+            auto result = runForceTest(target.setup, _material, 1, atLevel);
+            auto &eval = perTarget[t];
+            for(size_t i = 0; i < result.levels.size(); ++i)
+            {
+                // levels that didn't reach equilibrium have no meaningful sensitivities
+                if(result.levels[i].stable && solved[i])
+                {
+                    eval.residuals.push_back(result.levels[i].displacement - target.displacements[i]);
+                    eval.jacobian.push_back(std::move(rows[i]));
+                }
+            }
+        });
+        Evaluation eval;
+        for(auto &e : perTarget)
+        {
+            eval.residuals.insert(eval.residuals.end(), e.residuals.begin(), e.residuals.end());
+            eval.jacobian.insert(eval.jacobian.end(), e.jacobian.begin(), e.jacobian.end());
+        }
+        for(auto r : eval.residuals)
+        {
+            eval.error += r * r;
+        }
+        eval.error = eval.residuals.empty() ? 0.0 : std::sqrt(eval.error / eval.residuals.size());
+        return eval;
+    }
+
+    /**
+     * @brief solves the dense symmetric positive definite system A x = b by Cholesky, A is overwritten
+     * @returns false if A isn't positive definite
+    */
+    bool choleskySolve(std::vector<std::vector<double>> &io_A, const std::vector<double> &_b, std::vector<double> &o_x)
+    {
+        const size_t n = _b.size();
+        for(size_t j = 0; j < n; ++j)
+        {
+            for(size_t k = 0; k < j; ++k)
+            {
+                io_A[j][j] -= io_A[j][k] * io_A[j][k];
+            }
+            if(!(io_A[j][j] > 0.0))
+            {
+                return false;
+            }
+            io_A[j][j] = std::sqrt(io_A[j][j]);
+            for(size_t i = j + 1; i < n; ++i)
+            {
+                for(size_t k = 0; k < j; ++k)
+                {
+                    io_A[i][j] -= io_A[i][k] * io_A[j][k];
+                }
+                io_A[i][j] /= io_A[j][j];
+            }
+        }
+        // forward then back substitution with L and L^T
+        o_x = _b;
+        for(size_t i = 0; i < n; ++i)
+        {
+            for(size_t k = 0; k < i; ++k)
+            {
+                o_x[i] -= io_A[i][k] * o_x[k];
+            }
+            o_x[i] /= io_A[i][i];
+        }
+        for(size_t i = n; i-- > 0;)
+        {
+            for(size_t k = i + 1; k < n; ++k)
+            {
+                o_x[i] -= io_A[k][i] * o_x[k];
+            }
+            o_x[i] /= io_A[i][i];
+        }
+        return true;
+    }
+
+    /**
+     * @brief free values that are neighbours on the same curve, three at a time
+    */
+    std::vector<std::array<size_t, 3>> curvatureStencils(const std::vector<Parameter> &_params)
+    {
+        std::vector<std::array<size_t, 3>> stencils;
+        for(size_t i = 2; i < _params.size(); ++i)
+        {
+            if(_params[i - 2].curve == _params[i].curve && _params[i - 2].index + 2 == _params[i].index)
+            {
+                stencils.push_back({i - 2, i - 1, i});
+            }
+        }
+        return stencils;
+    }
+
+    /**
+     * @brief second difference of how far the material has moved from the initial one
+    */
+    double curvature(const MaterialData &_material, const MaterialData &_initial, const std::vector<Parameter> &_params,
+                     const std::array<size_t, 3> &_stencil)
+    {
+        const double weights[] = {1.0, -2.0, 1.0};
+        double c = 0.0;
+        for(size_t k = 0; k < 3; ++k)
+        {
+            auto &p = _params[_stencil[k]];
+            c += weights[k] * ((_material.*p.curve).data[p.index] - (_initial.*p.curve).data[p.index]);
+        }
+        return c;
+    }
+
+    /**
+     * @brief keeps a curve physically sensible, non-negative for weft/warp and non-decreasing
+    */
+    void projectCurve(MaterialCurve &io_curve, bool _nonNegative)
+    {
+        float lowest = _nonNegative ? 0.0f : -std::numeric_limits<float>::max();
+        for(auto &y : io_curve.data)
+        {
+            y = std::max(y, lowest);
+            lowest = y;
+        }
+    }
+}
+
+CalibrationResult calibrateMaterial(const MaterialData &_initial, const std::vector<CalibrationTarget> &_targets,
+                                    const CalibrationSettings &_settings)
+{
+    using clock = std::chrono::steady_clock;
+    auto start = clock::now();
+    CalibrationResult result;
+    result.material = _initial;
+    // gather the free data values, the weft/warp stress at rest stays put
+    std::vector<Parameter> params;
+    auto addCurve = [&](MaterialCurve MaterialData::*_curve, size_t _first)
+    {
+        for(size_t j = _first; j < (_initial.*_curve).data.size(); ++j)
+        {
+            params.push_back({_curve, j});
+        }
+    };
+    if(_settings.fitWeft)
+    {
+        addCurve(&MaterialData::weft, 1);
+    }
+    if(_settings.fitWarp)
+    {
+        addCurve(&MaterialData::warp, 1);
+    }
+    if(_settings.fitShear)
+    {
+        addCurve(&MaterialData::shear, 0);
+    }
+    const size_t n = params.size();
+    // with fewer force levels than values the fit alone is underdetermined, so the change to each
+    // curve is kept smooth, weighted against the data once the first Jacobian sets the scale
+    auto stencils = curvatureStencils(params);
+    double smoothWeight = 0.0;
+    auto objective = [&](const Evaluation &_eval, const MaterialData &_material)
+    {
+        double total = 0.0;
+        for(auto r : _eval.residuals)
+        {
+            total += r * r;
+        }
+        for(auto &stencil : stencils)
+        {
+            auto c = curvature(_material, _initial, params, stencil);
+            total += smoothWeight * c * c;
+        }
+        return total;
+    };
+    auto eval = evaluate(result.material, _targets, params, _settings.numThreads);
+    result.errors.push_back(static_cast<float>(eval.error));
+    result.levelsUsed = eval.residuals.size();
+    double damping = 1e-3;
+    while(result.iterations < _settings.maxIterations && n > 0 && !eval.residuals.empty())
+    {
+        ++result.iterations;
+        // normal equations J^T J dy = -J^T r, damped along their diagonal (Marquardt's scaling)
+        std::vector<std::vector<double>> JtJ(n, std::vector<double>(n, 0.0));
+        std::vector<double> Jtr(n, 0.0);
+        for(size_t r = 0; r < eval.residuals.size(); ++r)
+        {
+            auto &row = eval.jacobian[r];
+            for(size_t i = 0; i < n; ++i)
+            {
+                Jtr[i] -= row[i] * eval.residuals[r];
+                for(size_t j = 0; j <= i; ++j)
+                {
+                    JtJ[i][j] += row[i] * row[j];
+                }
+            }
+        }
+        double maxDiag = 0.0;
+        for(size_t i = 0; i < n; ++i)
+        {
+            maxDiag = std::max(maxDiag, JtJ[i][i]);
+        }
+        if(maxDiag == 0.0)
+        {
+            // none of the free values reach the tested strains
+            break;
+        }
+        if(smoothWeight == 0.0)
+        {
+            smoothWeight = _settings.smoothing * maxDiag;
+        }
+        // the smoothing rows, (1 -2 1) on each stencil
+        const double weights[] = {1.0, -2.0, 1.0};
+        for(auto &stencil : stencils)
+        {
+            auto c = curvature(result.material, _initial, params, stencil);
+            for(size_t a = 0; a < 3; ++a)
+            {
+                Jtr[stencil[a]] -= smoothWeight * weights[a] * c;
+                for(size_t b = 0; b <= a; ++b)
+                {
+                    JtJ[stencil[a]][stencil[b]] += smoothWeight * weights[a] * weights[b];
+                }
+            }
+        }
+        for(size_t i = 0; i < n; ++i)
+        {
+            // values past the strains the tests reach only follow the smoothing, the tiny extra
+            // diagonal keeps them put when there's none
+            JtJ[i][i] += (damping * JtJ[i][i]) + (1e-12 * maxDiag);
+        }
+        std::vector<double> step;
+        if(!choleskySolve(JtJ, Jtr, step))
+        {
+            damping *= 4.0;
+            continue;
+        }
+        // the fit is far from linear in the data, so no value moves more than half its size in one step
+        double scale = 1.0;
+        for(size_t i = 0; i < n; ++i)
+        {
+            auto &curve = result.material.*params[i].curve;
+            float largest = 0.0f;
+            for(auto y : curve.data)
+            {
+                largest = std::max(largest, std::abs(y));
+            }
+            auto limit = 0.5 * std::max(std::abs(curve.data[params[i].index]), 0.01f * largest);
+            if(std::abs(step[i]) * scale > limit)
+            {
+                scale = limit / std::abs(step[i]);
+            }
+        }
+        // take the step, keep the curves sensible and see if it helped
+        auto trial = result.material;
+        for(size_t i = 0; i < n; ++i)
+        {
+            (trial.*params[i].curve).data[params[i].index] += static_cast<float>(scale * step[i]);
+        }
+        projectCurve(trial.weft, true);
+        projectCurve(trial.warp, true);
+        projectCurve(trial.shear, false);
+        auto trialEval = evaluate(trial, _targets, params, _settings.numThreads);
+        auto current = objective(eval, result.material);
+        auto next = objective(trialEval, trial);
+        // a step that loses levels to instability doesn't count as an improvement
+        if(trialEval.residuals.size() < eval.residuals.size() || !(next < current))
+        {
+            damping *= 4.0;
+            if(damping > 1e8)
+            {
+                break;
+            }
+            continue;
+        }
+        result.material = trial;
+        eval = std::move(trialEval);
+        result.errors.push_back(static_cast<float>(eval.error));
+        result.levelsUsed = eval.residuals.size();
+        damping = std::max(damping * 0.3, 1e-9);
+        if((current - next) < _settings.tolerance * current)
+        {
+            break;
+        }
+    }
+    result.seconds = std::chrono::duration<double>(clock::now() - start).count();
+    return result;
+}
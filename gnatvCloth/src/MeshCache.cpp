@@ -0,0 +1,296 @@
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "MeshCache.h"
+
+namespace
+{
+    const char c_magic[4] = {'G', 'N', 'M', 'C'};
+    const uint32_t c_version = 3;
+}
+
+uint64_t MeshCache::hashBytes(const void *_data, size_t _size, uint64_t _hash)
+{
+    auto bytes = static_cast<const unsigned char *>(_data);
+    for(size_t i = 0; i < _size; ++i)
+    {
+        _hash ^= bytes[i];
+        _hash *= 1099511628211ull;
+    }
+    return _hash;
+}
+
+MeshCache::~MeshCache()
+{
+    unload();
+}
+
+bool MeshCache::fileStamp(const std::string &_filename, uint64_t &o_size, int64_t &o_time)
+{
+    std::error_code ec;
+    auto size = std::filesystem::file_size(_filename, ec);
+    if(ec)
+    {
+        return false;
+    }
+    auto time = std::filesystem::last_write_time(_filename, ec);
+    if(ec)
+    {
+        return false;
+    }
+    o_size = size;
+    o_time = static_cast<int64_t>(time.time_since_epoch().count());
+    return true;
+}
+
+uint64_t MeshCache::hashFile(const std::string &_filename)
+{
+    std::ifstream in(_filename, std::ifstream::binary);
+    if(!in.is_open())
+    {
+        return 0;
+    }
+    std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    return hashBytes(contents.data(), contents.size());
+}
+
+uint64_t MeshCache::makeKey(const std::string &_objFilename, std::function<ngl::Vec2(ngl::Vec3)> _toParam)
+{
+    // the obj is only read if load finds it was touched
+    uint64_t size = 0;
+    int64_t time = 0;
+    if(!fileStamp(_objFilename, size, time))
+    {
+        return 0;
+    }
+    // fingerprint the toParam plane with a few probe points
+    std::vector<ngl::Vec3> probes = {ngl::Vec3(1.0f, 0.0f, 0.0f), ngl::Vec3(0.0f, 1.0f, 0.0f),
+                                     ngl::Vec3(0.0f, 0.0f, 1.0f), ngl::Vec3(1.0f, 2.0f, 3.0f)};
+    std::vector<float> samples;
+    for(auto p : probes)
+    {
+        auto param = _toParam(p);
+        samples.push_back(param.m_x);
+        samples.push_back(param.m_y);
+    }
+    auto key = hashBytes(samples.data(), sizeof(float) * samples.size());
+    // never hand out the 'no key' value
+    return key == 0 ? 1 : key;
+}
+
+bool MeshCache::load(const std::string &_objFilename, uint64_t _key)
+{
+    unload();
+    if(_key == 0)
+    {
+        return false;
+    }
+    // map the file
+    int fd = open(cachePath(_objFilename).c_str(), O_RDONLY);
+    if(fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header))
+    {
+        close(fd);
+        return false;
+    }
+    void *data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED)
+    {
+        return false;
+    }
+    m_data = data;
+    m_size = static_cast<size_t>(st.st_size);
+    // check the header
+    Header header;
+    std::memcpy(&header, m_data, sizeof(Header));
+    if(std::memcmp(header.magic, c_magic, 4) != 0 || header.version != c_version || header.key != _key)
+    {
+        unload();
+        return false;
+    }
+    // an obj that's the same size and age as when the cache was written is taken as unchanged,
+    // one that's only been touched has to hash the same
+    uint64_t objSize = 0;
+    int64_t objTime = 0;
+    if(!fileStamp(_objFilename, objSize, objTime) || objSize != header.objSize ||
+       (objTime != header.objTime && hashFile(_objFilename) != header.objHash))
+    {
+        unload();
+        return false;
+    }
+    // check the size matches what the header says is stored, every count takes at least a byte
+    // so anything bigger than the file is garbage that could overflow the sum
+    size_t nm = header.numMasses;
+    size_t nt = header.numTriangles;
+    if(nm >= m_size || nt >= m_size || header.numSparsityIds >= m_size)
+    {
+        unload();
+        return false;
+    }
+    size_t expected = sizeof(Header) +
+            sizeof(float) * (nm * 3 + nt * (6 + 3 + 3 + 1)) +
+            sizeof(uint32_t) * (nt * 3 + nm + 1 + header.numSparsityIds);
+    if(expected != m_size)
+    {
+        unload();
+        return false;
+    }
+    // point at the arrays
+    auto cursor = static_cast<const char *>(m_data) + sizeof(Header);
+    auto take = [&cursor](size_t _bytes) -> const char *
+    {
+        auto start = cursor;
+        cursor += _bytes;
+        return start;
+    };
+    m_numMasses = nm;
+    m_numTriangles = nt;
+    m_positions = reinterpret_cast<const float *>(take(sizeof(float) * nm * 3));
+    m_indices = reinterpret_cast<const uint32_t *>(take(sizeof(uint32_t) * nt * 3));
+    m_uvs = reinterpret_cast<const float *>(take(sizeof(float) * nt * 6));
+    m_ru = reinterpret_cast<const float *>(take(sizeof(float) * nt * 3));
+    m_rv = reinterpret_cast<const float *>(take(sizeof(float) * nt * 3));
+    m_restAreas = reinterpret_cast<const float *>(take(sizeof(float) * nt));
+    m_sparsityOffsets = reinterpret_cast<const uint32_t *>(take(sizeof(uint32_t) * (nm + 1)));
+    m_sparsityIds = reinterpret_cast<const uint32_t *>(take(sizeof(uint32_t) * header.numSparsityIds));
+    // the cloth indexes its masspoints with these, so a damaged file mustn't get past here
+    if(!validTopology(header.numSparsityIds))
+    {
+        unload();
+        return false;
+    }
+    return true;
+}
+
+bool MeshCache::validTopology(size_t _numSparsityIds) const
+{
+    for(size_t i = 0; i < m_numTriangles * 3; ++i)
+    {
+        if(m_indices[i] >= m_numMasses)
+        {
+            return false;
+        }
+    }
+    if(m_sparsityOffsets[0] != 0 || m_sparsityOffsets[m_numMasses] != _numSparsityIds)
+    {
+        return false;
+    }
+    for(size_t i = 0; i < m_numMasses; ++i)
+    {
+        if(m_sparsityOffsets[i] > m_sparsityOffsets[i + 1])
+        {
+            return false;
+        }
+    }
+    for(size_t i = 0; i < _numSparsityIds; ++i)
+    {
+        if(m_sparsityIds[i] >= m_numMasses)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void MeshCache::unload()
+{
+    if(m_data != nullptr)
+    {
+        munmap(m_data, m_size);
+    }
+    m_data = nullptr;
+    m_size = 0;
+    m_numMasses = 0;
+    m_numTriangles = 0;
+}
+
+bool MeshCache::save(const std::string &_objFilename, uint64_t _key,
+                     const std::vector<ngl::Vec3> &_positions,
+                     const std::vector<uint32_t> &_indices, const std::vector<ngl::Vec2> &_uvs,
+                     const std::vector<ngl::Vec3> &_ru, const std::vector<ngl::Vec3> &_rv,
+                     const std::vector<float> &_restAreas,
+                     const std::vector<uint32_t> &_sparsityOffsets, const std::vector<uint32_t> &_sparsityIds)
+{
+    // the obj is stamped as it is now, it was parsed moments ago
+    uint64_t objSize = 0;
+    int64_t objTime = 0;
+    if(_key == 0 || !fileStamp(_objFilename, objSize, objTime))
+    {
+        return false;
+    }
+    auto objHash = hashFile(_objFilename);
+    if(objHash == 0)
+    {
+        return false;
+    }
+    // write to a temp file first so a half written cache is never picked up, named for this
+    // process and thread so writers racing on the same mesh don't write into each other's file
+    auto path = cachePath(_objFilename);
+    auto tmpPath = path + "." + std::to_string(getpid()) + "." +
+                   std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+    std::ofstream out(tmpPath, std::ofstream::binary | std::ofstream::trunc);
+    if(!out.is_open())
+    {
+        return false;
+    }
+    Header header;
+    std::memcpy(header.magic, c_magic, 4);
+    header.version = c_version;
+    header.key = _key;
+    header.numMasses = _positions.size();
+    header.numTriangles = _indices.size() / 3;
+    header.numSparsityIds = _sparsityIds.size();
+    header.objSize = objSize;
+    header.objTime = objTime;
+    header.objHash = objHash;
+    out.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+    // lambdas for writing out the arrays
+    auto writeFloats = [&out](const float *_data, size_t _count)
+    {
+        out.write(reinterpret_cast<const char *>(_data), static_cast<std::streamsize>(sizeof(float) * _count));
+    };
+    auto writeVec3s = [&out](const std::vector<ngl::Vec3> &_vec)
+    {
+        for(auto v : _vec)
+        {
+            float xyz[3] = {v.m_x, v.m_y, v.m_z};
+            out.write(reinterpret_cast<const char *>(xyz), sizeof(xyz));
+        }
+    };
+    auto writeIds = [&out](const std::vector<uint32_t> &_vec)
+    {
+        out.write(reinterpret_cast<const char *>(_vec.data()), static_cast<std::streamsize>(sizeof(uint32_t) * _vec.size()));
+    };
+    writeVec3s(_positions);
+    writeIds(_indices);
+    for(auto uv : _uvs)
+    {
+        float xy[2] = {uv.m_x, uv.m_y};
+        writeFloats(xy, 2);
+    }
+    writeVec3s(_ru);
+    writeVec3s(_rv);
+    writeFloats(_restAreas.data(), _restAreas.size());
+    writeIds(_sparsityOffsets);
+    writeIds(_sparsityIds);
+    out.close();
+    if(out.fail())
+    {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
@@ -3,13 +3,18 @@
 
 #include <ngl/NGLInit.h>
 #include <ngl/ShaderLib.h>
-#include <ngl/SimpleVAO.h>
-#include <ngl/VAOFactory.h>
 #include <ngl/Transformation.h>
+#include <cmath>
 #include <iostream>
 
 #include "NGLScene.h"
 
+namespace
+{
+    const ngl::Vec3 c_cameraFrom(0.0f, 10.0f, 20.0f);   /**< Camera position, looking at the origin */
+    const float c_fieldOfView = 45.0f;                  /**< Vertical field of view in degrees */
+}
+
 NGLScene::NGLScene(QWidget *_parent) : QOpenGLWidget( _parent )
 {
 //  // initialize clothInterface
@@ -32,20 +37,18 @@ NGLScene::NGLScene(QWidget *_parent) : QOpenGLWidget( _parent )
 NGLScene::~NGLScene()
 {
   std::cout<<"Shutting down NGL, removing VAO's and Shaders\n";
+  makeCurrent();
+  glDeleteBuffers(1, &m_clothStreamVBO);
+  glDeleteBuffers(1, &m_clothUVVBO);
+  glDeleteBuffers(1, &m_clothEBO);
+  glDeleteVertexArrays(1, &m_clothVAO);
+  doneCurrent();
 }
 
 void NGLScene::timerEvent(QTimerEvent *_event)
 {
     m_timerId = _event->timerId();
-//    for(size_t i = 0; i < 10; ++i)
-//    {
-//        m_cloth.update(0.001f, ngl::Vec3(0.0f));
-//    }
-    if(m_writeOut)
-    {
-        m_ci.writeOutCloth();
-    }
-    m_ci.updateCloth(0.01f);
+    // the sim steps on its own thread, we just redraw whatever it last finished
     update();
 }
 
@@ -54,7 +57,7 @@ void NGLScene::resizeGL(int _w , int _h)
   m_win.width  = static_cast<int>( _w * devicePixelRatio() );
   m_win.height = static_cast<int>( _h * devicePixelRatio() );
   //field of view, aspect ratio, near clipping plane, far clipping plane
-  m_project = ngl::perspective(45.0f, static_cast<float>(_w/_h),
+  m_project = ngl::perspective(c_fieldOfView, static_cast<float>(_w) / static_cast<float>(_h),
                              0.5f, 200.0f);
 }
 
@@ -72,7 +75,7 @@ void NGLScene::initializeGL()
   glEnable(GL_MULTISAMPLE);
 
   // set the camera
-  ngl::Vec3 from = {0.0f, 10.0f, 20.0f};
+  ngl::Vec3 from = c_cameraFrom;
   m_view = ngl::lookAt(from, ngl::Vec3::zero(), ngl::Vec3::up());
   // add a light from the camera pos
   m_lightPos.set(from.m_x, from.m_y, from.m_z, 1.0f);
@@ -89,8 +92,12 @@ void NGLScene::initializeGL()
   shader->setUniform("colour2",0.6f,0.6f,0.6f,1.0f);
   shader->setUniform("checkSize",15.0f);
 
-  //make a simple vao for the cloth triangles
-  m_clothVAO = ngl::VAOFactory::createVAO(ngl::simpleVAO, GL_TRIANGLES);
+  // make the buffers for the indexed cloth mesh, filled in paintGL
+  glGenVertexArrays(1, &m_clothVAO);
+  glGenBuffers(1, &m_clothStreamVBO);
+  glGenBuffers(1, &m_clothUVVBO);
+  glGenBuffers(1, &m_clothEBO);
+  m_uploadedVersion = 0;
 }
 
 void NGLScene::paintGL()
@@ -107,30 +114,85 @@ void NGLScene::paintGL()
   {
       glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
   }
-  // determine mouse rotation
-  ngl::Mat4 rotx;
-  ngl::Mat4 roty;
-  ngl::Mat4 mouseRotation;
-  rotx.rotateX(m_win.spinXFace);
-  roty.rotateY(m_win.spinYFace);
-  mouseRotation = roty * rotx;
+  // render cloth, only positions/normals change between frames
+  m_ci.renderCloth(m_renderMesh);
+  glBindVertexArray(m_clothVAO);
+  if(m_uploadedVersion != m_renderMesh.version())
+  {
+      uploadClothTopology();
+  }
+  streamClothVertices();
 
-  // render cloth
-  std::vector<float> tri;
-  m_ci.renderCloth(tri);
+  loadMatrixToCheckerShader(mouseRotation());
 
-  m_clothVAO->bind();
-  m_clothVAO->setData(ngl::SimpleVAO::VertexData(tri.size()*sizeof(float), tri[0]));
+  glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(m_renderMesh.indices().size()), GL_UNSIGNED_INT, nullptr);
+  glBindVertexArray(0);
+}
+
+void NGLScene::uploadClothTopology()
+{
+  // index buffer (bound to the VAO)
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_clothEBO);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(m_renderMesh.indices().size()*sizeof(uint32_t)),
+               m_renderMesh.indices().data(), GL_STATIC_DRAW);
+  // uvs
+  glBindBuffer(GL_ARRAY_BUFFER, m_clothUVVBO);
+  glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(m_renderMesh.uvs().size()*sizeof(float)),
+               m_renderMesh.uvs().data(), GL_STATIC_DRAW);
+  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 2*sizeof(float), nullptr);
+  glEnableVertexAttribArray(2);
+  // positions/normals, interleaved in the stream buffer
+  auto stride = static_cast<GLsizei>(ClothRenderMesh::c_streamStride*sizeof(float));
+  glBindBuffer(GL_ARRAY_BUFFER, m_clothStreamVBO);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, nullptr);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void *>(3*sizeof(float)));
+  glEnableVertexAttribArray(1);
+  m_uploadedVersion = m_renderMesh.version();
+}
 
-  m_clothVAO->setVertexAttributePointer(0, 3, GL_FLOAT, 8*sizeof(float), 0);
-  m_clothVAO->setVertexAttributePointer(1, 3, GL_FLOAT, 8*sizeof(float), 3);
-  m_clothVAO->setVertexAttributePointer(2, 2, GL_FLOAT, 8*sizeof(float), 6);
-  m_clothVAO->setNumIndices((tri.size()/8)*3);
+void NGLScene::streamClothVertices()
+{
+  // orphan the old storage so we never wait on the draw still using it, then refill
+  auto bytes = static_cast<GLsizeiptr>(m_renderMesh.stream().size()*sizeof(float));
+  glBindBuffer(GL_ARRAY_BUFFER, m_clothStreamVBO);
+  glBufferData(GL_ARRAY_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, m_renderMesh.stream().data());
+}
 
-  loadMatrixToCheckerShader(mouseRotation);
+ngl::Mat4 NGLScene::mouseRotation() const
+{
+  ngl::Mat4 rotx;
+  ngl::Mat4 roty;
+  rotx.rotateX(m_win.spinXFace);
+  roty.rotateY(m_win.spinYFace);
+  return roty * rotx;
+}
 
-  m_clothVAO->draw();
-  m_clothVAO->unbind();
+void NGLScene::mouseRay(int _x, int _y, ngl::Vec3 &o_origin, ngl::Vec3 &o_direction) const
+{
+  // mouse position in normalized device coordinates
+  float ndcX = 2.0f * _x * static_cast<float>(devicePixelRatio()) / m_win.width - 1.0f;
+  float ndcY = 1.0f - 2.0f * _y * static_cast<float>(devicePixelRatio()) / m_win.height;
+  // the camera's axes, as set up by lookAt in initializeGL
+  ngl::Vec3 forward = -1.0f * c_cameraFrom;
+  forward.normalize();
+  ngl::Vec3 right = forward.cross(ngl::Vec3::up());
+  right.normalize();
+  ngl::Vec3 up = right.cross(forward);
+  float tanHalf = std::tan(0.5f * c_fieldOfView * static_cast<float>(M_PI) / 180.0f);
+  float aspect = static_cast<float>(m_win.width) / static_cast<float>(m_win.height);
+  ngl::Vec3 direction = forward + (ndcX * tanHalf * aspect * right) + (ndcY * tanHalf * up);
+  // undo the mouse rotation, the cloth is drawn rotated by roty * rotx
+  ngl::Mat4 rotx;
+  ngl::Mat4 roty;
+  rotx.rotateX(-m_win.spinXFace);
+  roty.rotateY(-m_win.spinYFace);
+  ngl::Mat4 inverseRotation = rotx * roty;
+  auto origin = inverseRotation * ngl::Vec4(c_cameraFrom.m_x, c_cameraFrom.m_y, c_cameraFrom.m_z, 1.0f);
+  auto along = inverseRotation * ngl::Vec4(direction.m_x, direction.m_y, direction.m_z, 0.0f);
+  o_origin.set(origin.m_x, origin.m_y, origin.m_z);
+  o_direction.set(along.m_x, along.m_y, along.m_z);
 }
 
 void NGLScene::loadMatrixToCheckerShader(const ngl::Mat4 &_tx)
@@ -160,9 +222,10 @@ void NGLScene::keyPressEvent(QKeyEvent *_event)
       m_modelPos.set(ngl::Vec3::zero());
 
   break;
-  case Qt::Key_P :
-      startTimer(5);
-      break;
+  case Qt::Key_P : startSim(); break;
+  case Qt::Key_M : m_ci.printMemoryUsage(std::cout); break;
+  // export the phase timings, only recorded in CONFIG+=profiling builds
+  case Qt::Key_T : m_ci.writeProfileTrace("results/trace.json"); break;
   default : break;
   }
   // finally update the GLWindow and re-draw
@@ -178,17 +241,26 @@ void NGLScene::toggleWireframe(bool _mode)
 
 void NGLScene::startSim()
 {
-    startTimer(10);
+    // the start button and P both land here, only the first starts the sim and repaint timer
+    if(m_ci.simThreadRunning())
+    {
+        return;
+    }
+    m_ci.startSimThread(0.01f);
+    m_timerId = startTimer(16);
 }
 
 void NGLScene::stopSim()
 {
     killTimer(m_timerId);
+    m_ci.stopSimThread();
+    update();
 }
 
 void NGLScene::resetSim()
 {
     killTimer(m_timerId);
+    m_ci.stopSimThread();
     m_ci.initCloth();
     m_ci.fixClothPts();
     update();
@@ -231,6 +303,10 @@ void NGLScene::changeIntMethod(int _intm)
     {
     case 0: m_ci.setIntMethod(CGM); break;
     case 1: m_ci.setIntMethod(RK4); break;
+    case 2: m_ci.setIntMethod(SYMPLECTIC_EULER); break;
+    case 3: m_ci.setIntMethod(VERLET); break;
+    case 4: m_ci.setIntMethod(RK45); break;
+    case 5: m_ci.setIntMethod(IMEX); break;
     default: break;
     }
 }
@@ -240,9 +316,19 @@ void NGLScene::toggleWind(bool _isWindOn)
     m_ci.setWindState(_isWindOn);
 }
 
+void NGLScene::toggleSelfCollision(bool _isSelfCollisionOn)
+{
+    m_ci.setSelfCollision(_isSelfCollisionOn);
+}
+
+void NGLScene::toggleJacobianReuse(bool _isJacobianReuseOn)
+{
+    m_ci.setJacobianReuse(_isJacobianReuseOn);
+}
+
 void NGLScene::toggleWriteOut(bool _writeOut)
 {
-    m_writeOut = _writeOut;
+    m_ci.setWriteOutEnabled(_writeOut);
 }
 
 void NGLScene::setCornerX(double _x)
@@ -272,3 +358,18 @@ void NGLScene::runWeftTest()
 {
     m_ci.runWeftTest();
 }
+
+void NGLScene::runWarpTest()
+{
+    m_ci.runWarpTest();
+}
+
+void NGLScene::runShearTest()
+{
+    m_ci.runShearTest();
+}
+
+void NGLScene::calibrateToMeasured()
+{
+    m_ci.calibrateToMeasured();
+}
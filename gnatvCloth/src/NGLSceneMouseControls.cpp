@@ -8,7 +8,15 @@ void NGLScene::mouseMoveEvent( QMouseEvent* _event )
   // note the method buttons() is the button state when event was called
   // that is different from button() which is used to check which button was
   // pressed when the mousePress/Release event is generated
-  if ( m_win.rotate && _event->buttons() == Qt::LeftButton )
+  // shift + left mouse drags the grabbed cloth point
+  if ( m_win.drag && _event->buttons() == Qt::LeftButton )
+  {
+    ngl::Vec3 origin, direction;
+    mouseRay( _event->x(), _event->y(), origin, direction );
+    m_ci.dragClothPt( origin, direction );
+    update();
+  }
+  else if ( m_win.rotate && _event->buttons() == Qt::LeftButton )
   {
     int diffx = _event->x() - m_win.origX;
     int diffy = _event->y() - m_win.origY;
@@ -37,7 +45,15 @@ void NGLScene::mousePressEvent( QMouseEvent* _event )
 {
   // that method is called when the mouse button is pressed in this case we
   // store the value where the maouse was clicked (x,y) and set the Rotate flag to true
-  if ( _event->button() == Qt::LeftButton )
+  // shift + left mouse grabs the cloth point under the mouse instead
+  if ( _event->button() == Qt::LeftButton && _event->modifiers() & Qt::ShiftModifier )
+  {
+    ngl::Vec3 origin, direction;
+    mouseRay( _event->x(), _event->y(), origin, direction );
+    m_ci.grabClothPt( origin, direction );
+    m_win.drag = true;
+  }
+  else if ( _event->button() == Qt::LeftButton )
   {
     m_win.origX  = _event->x();
     m_win.origY  = _event->y();
@@ -60,6 +76,11 @@ void NGLScene::mouseReleaseEvent( QMouseEvent* _event )
   if ( _event->button() == Qt::LeftButton )
   {
     m_win.rotate = false;
+    if ( m_win.drag )
+    {
+      m_ci.releaseClothPt();
+      m_win.drag = false;
+    }
   }
   // right mouse translate mode
   if ( _event->button() == Qt::RightButton )
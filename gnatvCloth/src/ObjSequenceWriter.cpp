@@ -0,0 +1,190 @@
+#include <charconv>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include "ObjSequenceWriter.h"
+
+namespace
+{
+    // append a number to the string without going through iostreams
+    template <typename T>
+    void appendNumber(std::string &io_text, T _value)
+    {
+        char buffer[32];
+        auto res = std::to_chars(buffer, buffer + sizeof(buffer), _value);
+        io_text.append(buffer, res.ptr);
+    }
+
+    void appendVec3Line(std::string &io_text, const char *_tag, ngl::Vec3 _v)
+    {
+        io_text += _tag;
+        appendNumber(io_text, _v.m_x);
+        io_text += ' ';
+        appendNumber(io_text, _v.m_y);
+        io_text += ' ';
+        appendNumber(io_text, _v.m_z);
+        io_text += '\n';
+    }
+}
+
+ObjSequenceWriter::~ObjSequenceWriter()
+{
+    stop();
+}
+
+void ObjSequenceWriter::start(const std::string &_directory, const std::string &_prefix,
+                              const std::vector<ngl::Vec2> &_uvs, const std::vector<size_t> &_indices)
+{
+    stop();
+    m_directory = _directory;
+    m_prefix = _prefix;
+    std::error_code ec;
+    std::filesystem::create_directories(m_directory, ec);
+    // format the UV block once
+    m_uvBlock.clear();
+    for(auto uv : _uvs)
+    {
+        m_uvBlock += "vt ";
+        appendNumber(m_uvBlock, uv.m_x);
+        m_uvBlock += ' ';
+        appendNumber(m_uvBlock, uv.m_y);
+        m_uvBlock += '\n';
+    }
+    // format the face block once, position/uv/normal all share the masspoint index
+    m_faceBlock.clear();
+    for(size_t i = 0; i + 2 < _indices.size(); i += 3)
+    {
+        m_faceBlock += 'f';
+        for(size_t j = 0; j < 3; ++j)
+        {
+            auto id = _indices[i + j] + 1; // obj files index at 1
+            m_faceBlock += ' ';
+            appendNumber(m_faceBlock, id);
+            m_faceBlock += '/';
+            appendNumber(m_faceBlock, id);
+            m_faceBlock += '/';
+            appendNumber(m_faceBlock, id);
+        }
+        m_faceBlock += '\n';
+    }
+    // start the worker
+    m_backFull = false;
+    m_stop = false;
+    m_framesWritten = 0;
+    m_framesFailed = 0;
+    m_thread = std::thread(&ObjSequenceWriter::writerLoop, this);
+}
+
+void ObjSequenceWriter::stop()
+{
+    if(!m_thread.joinable())
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cond.notify_all();
+    m_thread.join();
+}
+
+size_t ObjSequenceWriter::framesWritten()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_framesWritten;
+}
+
+size_t ObjSequenceWriter::framesFailed()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_framesFailed;
+}
+
+std::string ObjSequenceWriter::frameFilename(size_t _frame) const
+{
+    // we want 4 places in the number, so leading 0's matter
+    char count[32];
+    std::snprintf(count, sizeof(count), "%04zu", _frame);
+    return m_directory + "/" + m_prefix + "." + count + ".obj";
+}
+
+void ObjSequenceWriter::submit(size_t _frame, const std::vector<ngl::Vec3> &_positions, const std::vector<ngl::Vec3> &_normals)
+{
+    // wait for the worker to take the previous frame
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cond.wait(lock, [this]{ return !m_backFull; });
+    }
+    // the worker never touches the back buffer while it's empty, so fill it unlocked
+    m_back.frame = _frame;
+    m_back.positions.assign(_positions.begin(), _positions.end());
+    m_back.normals.assign(_normals.begin(), _normals.end());
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_backFull = true;
+    }
+    m_cond.notify_all();
+}
+
+void ObjSequenceWriter::writerLoop()
+{
+    while(true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait(lock, [this]{ return m_backFull || m_stop; });
+            if(!m_backFull)
+            {
+                return;
+            }
+            std::swap(m_front, m_back);
+            m_backFull = false;
+        }
+        m_cond.notify_all();
+        bool written = writeFrame(m_front);
+        size_t failed = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if(written)
+            {
+                ++m_framesWritten;
+            }
+            else
+            {
+                ++m_framesFailed;
+            }
+            failed = m_framesFailed;
+        }
+        // a full disk or missing directory fails every frame after it, so only the first is reported
+        if(!written && failed == 1)
+        {
+            std::cerr << "couldn't write " << frameFilename(m_front.frame) << ", later failures are only counted\n";
+        }
+    }
+}
+
+bool ObjSequenceWriter::writeFrame(const Snapshot &_snapshot)
+{
+    // format the per-frame parts, then write the whole file in one go
+    m_frameText.clear();
+    m_frameText += "o Cloth\n";
+    for(auto p : _snapshot.positions)
+    {
+        appendVec3Line(m_frameText, "v ", p);
+    }
+    m_frameText += m_uvBlock;
+    for(auto n : _snapshot.normals)
+    {
+        appendVec3Line(m_frameText, "vn ", n);
+    }
+    m_frameText += m_faceBlock;
+    auto file = std::fopen(frameFilename(_snapshot.frame).c_str(), "wb");
+    if(file == nullptr)
+    {
+        return false;
+    }
+    bool written = std::fwrite(m_frameText.data(), 1, m_frameText.size(), file) == m_frameText.size();
+    // buffered data can still fail to reach the disk on close
+    return (std::fclose(file) == 0) && written;
+}
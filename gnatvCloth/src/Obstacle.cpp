@@ -0,0 +1,264 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include "Obstacle.h"
+#include "MeshCache.h"
+#include "SelfCollision.h"
+
+namespace
+{
+    const char c_magic[4] = {'G', 'N', 'S', 'D'};
+    const uint32_t c_version = 1;
+
+    /**
+     * @brief layout of the start of a distance grid cache file
+    */
+    struct Header
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t key;
+        uint64_t nx;
+        uint64_t ny;
+        uint64_t nz;
+        float origin[3];
+        float cellSize;
+    };
+
+    /**
+     * @brief solid angle of triangle abc seen from the origin, positive if it winds counter-clockwise
+     * around the origin (Van Oosterom and Strackee)
+    */
+    float solidAngle(const ngl::Vec3 &_a, const ngl::Vec3 &_b, const ngl::Vec3 &_c)
+    {
+        float la = _a.length();
+        float lb = _b.length();
+        float lc = _c.length();
+        float numerator = _a.dot(_b.cross(_c));
+        float denominator = la * lb * lc + _a.dot(_b) * lc + _b.dot(_c) * la + _c.dot(_a) * lb;
+        return 2.0f * std::atan2(numerator, denominator);
+    }
+}
+
+bool Obstacle::load(const std::string &_objFilename, float _cellSize)
+{
+    m_fromCache = false;
+    std::ifstream in(_objFilename, std::ifstream::binary);
+    if(!in.is_open())
+    {
+        return false;
+    }
+    std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    // the grid depends on the mesh and the spacing asked for
+    auto key = MeshCache::hashBytes(contents.data(), contents.size());
+    key = MeshCache::hashBytes(&_cellSize, sizeof(_cellSize), key);
+    if(readCache(cachePath(_objFilename), key))
+    {
+        m_fromCache = true;
+        return true;
+    }
+    // read vertices and faces, fanning out any polygons
+    std::vector<ngl::Vec3> vertices;
+    std::vector<size_t> indices;
+    std::istringstream lines(contents);
+    std::string line;
+    while(std::getline(lines, line))
+    {
+        std::istringstream tokens(line);
+        std::string type;
+        tokens >> type;
+        if(type == "v")
+        {
+            ngl::Vec3 v;
+            tokens >> v.m_x >> v.m_y >> v.m_z;
+            vertices.push_back(v);
+        }
+        else if(type == "f")
+        {
+            std::vector<size_t> face;
+            std::string corner;
+            while(tokens >> corner)
+            {
+                // v, v/vt, v//vn or v/vt/vn, negative ids count back from the last vertex
+                auto idText = corner.substr(0, corner.find('/'));
+                char *end = nullptr;
+                long id = std::strtol(idText.c_str(), &end, 10);
+                const long n = static_cast<long>(vertices.size());
+                // a face that isn't a number or names a vertex that isn't there leaves no mesh to trust
+                if(idText.empty() || *end != '\0' || id == 0 || id > n || id < -n)
+                {
+                    return false;
+                }
+                face.push_back(static_cast<size_t>(id < 0 ? n + id : id - 1));
+            }
+            for(size_t i = 2; i < face.size(); ++i)
+            {
+                indices.insert(indices.end(), {face[0], face[i - 1], face[i]});
+            }
+        }
+    }
+    if(indices.empty())
+    {
+        return false;
+    }
+    build(vertices, indices, _cellSize);
+    writeCache(cachePath(_objFilename), key);
+    return true;
+}
+
+void Obstacle::build(const std::vector<ngl::Vec3> &_vertices, const std::vector<size_t> &_indices, float _cellSize)
+{
+    // bounds of the mesh
+    ngl::Vec3 lo(std::numeric_limits<float>::max()), hi(std::numeric_limits<float>::lowest());
+    for(auto &v : _vertices)
+    {
+        lo.set(std::min(lo.m_x, v.m_x), std::min(lo.m_y, v.m_y), std::min(lo.m_z, v.m_z));
+        hi.set(std::max(hi.m_x, v.m_x), std::max(hi.m_y, v.m_y), std::max(hi.m_z, v.m_z));
+    }
+    auto extent = hi - lo;
+    float longest = std::max({extent.m_x, extent.m_y, extent.m_z});
+    m_cellSize = _cellSize > 0.0f ? _cellSize : longest / 32.0f;
+    // a few cells of padding so points coming up to the surface are on the grid
+    const size_t padding = 3;
+    m_origin = lo - ngl::Vec3(padding * m_cellSize);
+    m_nx = static_cast<size_t>(std::ceil(extent.m_x / m_cellSize)) + 2 * padding + 1;
+    m_ny = static_cast<size_t>(std::ceil(extent.m_y / m_cellSize)) + 2 * padding + 1;
+    m_nz = static_cast<size_t>(std::ceil(extent.m_z / m_cellSize)) + 2 * padding + 1;
+    m_phi.assign(m_nx * m_ny * m_nz, 0.0f);
+    const size_t nt = _indices.size() / 3;
+    const float fourPi = 4.0f * static_cast<float>(M_PI);
+
+    #pragma omp parallel for schedule(dynamic)
+    for(size_t n = 0; n < m_phi.size(); ++n)
+    {
+        auto p = m_origin + (m_cellSize * ngl::Vec3(static_cast<float>(n % m_nx),
+                                                    static_cast<float>((n / m_nx) % m_ny),
+                                                    static_cast<float>(n / (m_nx * m_ny))));
+        // nearest surface point, and how many times the mesh winds around p
+        float nearest = std::numeric_limits<float>::max();
+        float winding = 0.0f;
+        for(size_t t = 0; t < nt; ++t)
+        {
+            auto &a = _vertices[_indices[3 * t]];
+            auto &b = _vertices[_indices[3 * t + 1]];
+            auto &c = _vertices[_indices[3 * t + 2]];
+            auto w = closestPointOnTriangle(p, a, b, c);
+            auto closest = (w.m_x * a) + (w.m_y * b) + (w.m_z * c);
+            nearest = std::min(nearest, (p - closest).lengthSquared());
+            winding += solidAngle(a - p, b - p, c - p);
+        }
+        // a closed mesh winds once around points inside it and not at all around those outside
+        m_phi[n] = winding > 0.5f * fourPi ? -std::sqrt(nearest) : std::sqrt(nearest);
+    }
+}
+
+float Obstacle::distance(const ngl::Vec3 &_p, ngl::Vec3 &o_normal) const
+{
+    if(m_phi.empty())
+    {
+        return std::numeric_limits<float>::max();
+    }
+    auto g = (_p - m_origin) / m_cellSize;
+    if(g.m_x < 0.0f || g.m_y < 0.0f || g.m_z < 0.0f ||
+       g.m_x > m_nx - 1 || g.m_y > m_ny - 1 || g.m_z > m_nz - 1)
+    {
+        return std::numeric_limits<float>::max();
+    }
+    // cell holding _p and where it is inside it
+    auto i = std::min(static_cast<size_t>(g.m_x), m_nx - 2);
+    auto j = std::min(static_cast<size_t>(g.m_y), m_ny - 2);
+    auto k = std::min(static_cast<size_t>(g.m_z), m_nz - 2);
+    float fx = g.m_x - i;
+    float fy = g.m_y - j;
+    float fz = g.m_z - k;
+    float c000 = at(i, j, k), c100 = at(i + 1, j, k), c010 = at(i, j + 1, k), c110 = at(i + 1, j + 1, k);
+    float c001 = at(i, j, k + 1), c101 = at(i + 1, j, k + 1), c011 = at(i, j + 1, k + 1), c111 = at(i + 1, j + 1, k + 1);
+    // interpolate along x, then y, then z
+    float c00 = c000 + fx * (c100 - c000);
+    float c10 = c010 + fx * (c110 - c010);
+    float c01 = c001 + fx * (c101 - c001);
+    float c11 = c011 + fx * (c111 - c011);
+    float c0 = c00 + fy * (c10 - c00);
+    float c1 = c01 + fy * (c11 - c01);
+    // gradient of the same interpolation
+    ngl::Vec3 gradient;
+    gradient.m_x = (1.0f - fz) * ((1.0f - fy) * (c100 - c000) + fy * (c110 - c010)) +
+                   fz * ((1.0f - fy) * (c101 - c001) + fy * (c111 - c011));
+    gradient.m_y = (1.0f - fz) * (c10 - c00) + fz * (c11 - c01);
+    gradient.m_z = c1 - c0;
+    if(gradient.length() > 1e-12f)
+    {
+        gradient.normalize();
+        o_normal = gradient;
+    }
+    return c0 + fz * (c1 - c0);
+}
+
+bool Obstacle::writeCache(const std::string &_filename, uint64_t _key) const
+{
+    // write to a temp file of this writer's own first, as MeshCache::save does, so a half written
+    // grid is never picked up
+    auto tmpPath = _filename + "." + std::to_string(getpid()) + "." +
+                   std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+    std::ofstream out(tmpPath, std::ofstream::binary | std::ofstream::trunc);
+    if(!out.is_open())
+    {
+        return false;
+    }
+    Header header;
+    std::memcpy(header.magic, c_magic, 4);
+    header.version = c_version;
+    header.key = _key;
+    header.nx = m_nx;
+    header.ny = m_ny;
+    header.nz = m_nz;
+    header.origin[0] = m_origin.m_x;
+    header.origin[1] = m_origin.m_y;
+    header.origin[2] = m_origin.m_z;
+    header.cellSize = m_cellSize;
+    out.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+    out.write(reinterpret_cast<const char *>(m_phi.data()), static_cast<std::streamsize>(m_phi.size() * sizeof(float)));
+    out.close();
+    if(out.fail())
+    {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    return std::rename(tmpPath.c_str(), _filename.c_str()) == 0;
+}
+
+bool Obstacle::readCache(const std::string &_filename, uint64_t _key)
+{
+    std::ifstream in(_filename, std::ifstream::binary);
+    if(!in.is_open())
+    {
+        return false;
+    }
+    Header header;
+    if(!in.read(reinterpret_cast<char *>(&header), sizeof(Header)) ||
+       std::memcmp(header.magic, c_magic, 4) != 0 || header.version != c_version || header.key != _key)
+    {
+        return false;
+    }
+    std::vector<float> phi(header.nx * header.ny * header.nz);
+    if(phi.empty() || !in.read(reinterpret_cast<char *>(phi.data()), static_cast<std::streamsize>(phi.size() * sizeof(float))))
+    {
+        return false;
+    }
+    m_nx = header.nx;
+    m_ny = header.ny;
+    m_nz = header.nz;
+    m_origin = ngl::Vec3(header.origin[0], header.origin[1], header.origin[2]);
+    m_cellSize = header.cellSize;
+    m_phi.swap(phi);
+    return true;
+}
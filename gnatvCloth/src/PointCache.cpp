@@ -0,0 +1,337 @@
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "PointCache.h"
+
+namespace
+{
+    const char c_magic[4] = {'G', 'N', 'P', 'C'};
+    const uint32_t c_version = 1;
+    const float c_quantSteps = 65535.0f;
+
+    /**
+     * @brief fixed size header at the start of every point cache file
+     *
+     * frameTableOffset stays 0 until the writer is closed, so unfinished files are rejected.
+    */
+    struct Header
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t numPoints;
+        uint32_t numTriangles;
+        uint64_t numFrames;
+        uint64_t frameTableOffset;
+    };
+
+    /**
+     * @brief start of each frame block, followed by payloadBytes of varints
+    */
+    struct FrameHeader
+    {
+        float boxMin[3];
+        float boxMax[3];
+        uint32_t payloadBytes;
+    };
+
+    void putVarint(std::vector<uint8_t> &io_out, uint32_t _value)
+    {
+        while(_value >= 0x80)
+        {
+            io_out.push_back(static_cast<uint8_t>(_value | 0x80));
+            _value >>= 7;
+        }
+        io_out.push_back(static_cast<uint8_t>(_value));
+    }
+
+    bool getVarint(const uint8_t *&io_cursor, const uint8_t *_end, uint32_t &o_value)
+    {
+        o_value = 0;
+        for(uint32_t shift = 0; shift < 35 && io_cursor < _end; shift += 7)
+        {
+            auto byte = *io_cursor++;
+            o_value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+            if(!(byte & 0x80))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    uint32_t zigzag(int32_t _value) { return (static_cast<uint32_t>(_value) << 1) ^ static_cast<uint32_t>(_value >> 31); }
+    int32_t unzigzag(uint32_t _value) { return static_cast<int32_t>(_value >> 1) ^ -static_cast<int32_t>(_value & 1); }
+
+    template <typename T>
+    T readAt(const uint8_t *_data)
+    {
+        T value;
+        std::memcpy(&value, _data, sizeof(T));
+        return value;
+    }
+}
+
+// PointCacheWriter
+
+PointCacheWriter::~PointCacheWriter()
+{
+    close();
+}
+
+bool PointCacheWriter::open(const std::string &_filename, const std::vector<ngl::Vec2> &_uvs, const std::vector<size_t> &_indices)
+{
+    close();
+    m_file = std::fopen(_filename.c_str(), "wb");
+    if(m_file == nullptr)
+    {
+        return false;
+    }
+    m_numPoints = _uvs.size();
+    m_reference.clear();
+    m_frameOffsets.clear();
+    // header, finished off in close
+    Header header;
+    std::memcpy(header.magic, c_magic, 4);
+    header.version = c_version;
+    header.numPoints = static_cast<uint32_t>(m_numPoints);
+    header.numTriangles = static_cast<uint32_t>(_indices.size() / 3);
+    header.numFrames = 0;
+    header.frameTableOffset = 0;
+    std::fwrite(&header, sizeof(Header), 1, m_file);
+    // topology and UVs, stored once
+    for(auto uv : _uvs)
+    {
+        float xy[2] = {uv.m_x, uv.m_y};
+        std::fwrite(xy, sizeof(xy), 1, m_file);
+    }
+    for(auto id : _indices)
+    {
+        auto id32 = static_cast<uint32_t>(id);
+        std::fwrite(&id32, sizeof(id32), 1, m_file);
+    }
+    // the reference positions follow, written with the first frame
+    m_offset = sizeof(Header) + sizeof(float) * 2 * m_numPoints + sizeof(uint32_t) * (_indices.size() / 3) * 3;
+    return true;
+}
+
+void PointCacheWriter::close()
+{
+    if(m_file == nullptr)
+    {
+        return;
+    }
+    // a file without frames still needs its (zero'd) reference block
+    if(m_reference.empty())
+    {
+        m_reference.resize(m_numPoints);
+        std::vector<float> zeros(m_numPoints * 3, 0.0f);
+        std::fwrite(zeros.data(), sizeof(float), zeros.size(), m_file);
+        m_offset += sizeof(float) * zeros.size();
+    }
+    // frame table at the end, then point the header at it
+    uint64_t tableOffset = m_offset;
+    std::fwrite(m_frameOffsets.data(), sizeof(uint64_t), m_frameOffsets.size(), m_file);
+    uint64_t numFrames = m_frameOffsets.size();
+    std::fseek(m_file, offsetof(Header, numFrames), SEEK_SET);
+    std::fwrite(&numFrames, sizeof(numFrames), 1, m_file);
+    std::fwrite(&tableOffset, sizeof(tableOffset), 1, m_file);
+    std::fclose(m_file);
+    m_file = nullptr;
+}
+
+void PointCacheWriter::writeFrame(const std::vector<ngl::Vec3> &_positions)
+{
+    if(m_file == nullptr || _positions.size() != m_numPoints)
+    {
+        return;
+    }
+    // the first frame is stored in full as the reference
+    if(m_reference.empty())
+    {
+        m_reference = _positions;
+        for(auto p : m_reference)
+        {
+            float xyz[3] = {p.m_x, p.m_y, p.m_z};
+            std::fwrite(xyz, sizeof(xyz), 1, m_file);
+        }
+        m_offset += sizeof(float) * 3 * m_numPoints;
+    }
+    // bounding box of the displacement from the reference
+    FrameHeader frame;
+    for(size_t a = 0; a < 3; ++a)
+    {
+        frame.boxMin[a] = 0.0f;
+        frame.boxMax[a] = 0.0f;
+    }
+    for(size_t i = 0; i < m_numPoints; ++i)
+    {
+        auto d = _positions[i] - m_reference[i];
+        float da[3] = {d.m_x, d.m_y, d.m_z};
+        for(size_t a = 0; a < 3; ++a)
+        {
+            frame.boxMin[a] = std::fmin(frame.boxMin[a], da[a]);
+            frame.boxMax[a] = std::fmax(frame.boxMax[a], da[a]);
+        }
+    }
+    float scale[3];
+    for(size_t a = 0; a < 3; ++a)
+    {
+        auto range = frame.boxMax[a] - frame.boxMin[a];
+        scale[a] = range > 0.0f ? c_quantSteps / range : 0.0f;
+    }
+    // quantize within the box, delta-encode point to point
+    m_encoded.clear();
+    int32_t prev[3] = {0, 0, 0};
+    for(size_t i = 0; i < m_numPoints; ++i)
+    {
+        auto d = _positions[i] - m_reference[i];
+        float da[3] = {d.m_x, d.m_y, d.m_z};
+        for(size_t a = 0; a < 3; ++a)
+        {
+            auto q = static_cast<int32_t>(std::lround((da[a] - frame.boxMin[a]) * scale[a]));
+            putVarint(m_encoded, zigzag(q - prev[a]));
+            prev[a] = q;
+        }
+    }
+    frame.payloadBytes = static_cast<uint32_t>(m_encoded.size());
+    // append the block, remember where it went
+    m_frameOffsets.push_back(m_offset);
+    std::fwrite(&frame, sizeof(FrameHeader), 1, m_file);
+    std::fwrite(m_encoded.data(), 1, m_encoded.size(), m_file);
+    m_offset += sizeof(FrameHeader) + m_encoded.size();
+}
+
+// PointCacheReader
+
+PointCacheReader::~PointCacheReader()
+{
+    close();
+}
+
+bool PointCacheReader::open(const std::string &_filename)
+{
+    close();
+    int fd = ::open(_filename.c_str(), O_RDONLY);
+    if(fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header))
+    {
+        ::close(fd);
+        return false;
+    }
+    void *data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if(data == MAP_FAILED)
+    {
+        return false;
+    }
+    m_data = static_cast<const uint8_t *>(data);
+    m_size = static_cast<size_t>(st.st_size);
+    // check the header and that the blocks it describes fit in the file
+    auto header = readAt<Header>(m_data);
+    size_t np = header.numPoints;
+    size_t nt = header.numTriangles;
+    size_t fixedEnd = sizeof(Header) + sizeof(float) * 2 * np + sizeof(uint32_t) * 3 * nt + sizeof(float) * 3 * np;
+    if(std::memcmp(header.magic, c_magic, 4) != 0 || header.version != c_version ||
+            header.frameTableOffset < fixedEnd ||
+            header.frameTableOffset + sizeof(uint64_t) * header.numFrames != m_size)
+    {
+        close();
+        return false;
+    }
+    m_numPoints = np;
+    m_numTriangles = nt;
+    m_numFrames = header.numFrames;
+    m_uvs = m_data + sizeof(Header);
+    m_indices = m_uvs + sizeof(float) * 2 * np;
+    m_reference = m_indices + sizeof(uint32_t) * 3 * nt;
+    m_frameTable = m_data + header.frameTableOffset;
+    return true;
+}
+
+void PointCacheReader::close()
+{
+    if(m_data != nullptr)
+    {
+        munmap(const_cast<uint8_t *>(m_data), m_size);
+    }
+    m_data = nullptr;
+    m_size = 0;
+    m_numPoints = 0;
+    m_numTriangles = 0;
+    m_numFrames = 0;
+}
+
+void PointCacheReader::uvs(std::vector<ngl::Vec2> &o_uvs) const
+{
+    o_uvs.resize(m_numPoints);
+    for(size_t i = 0; i < m_numPoints; ++i)
+    {
+        o_uvs[i].m_x = readAt<float>(m_uvs + sizeof(float) * (i*2));
+        o_uvs[i].m_y = readAt<float>(m_uvs + sizeof(float) * (i*2 + 1));
+    }
+}
+
+void PointCacheReader::indices(std::vector<size_t> &o_indices) const
+{
+    o_indices.resize(m_numTriangles * 3);
+    for(size_t i = 0; i < o_indices.size(); ++i)
+    {
+        o_indices[i] = readAt<uint32_t>(m_indices + sizeof(uint32_t) * i);
+    }
+}
+
+bool PointCacheReader::readFrame(size_t _frame, std::vector<ngl::Vec3> &o_positions) const
+{
+    if(_frame >= m_numFrames)
+    {
+        return false;
+    }
+    // jump straight to the frame block
+    auto offset = readAt<uint64_t>(m_frameTable + sizeof(uint64_t) * _frame);
+    if(offset + sizeof(FrameHeader) > m_size)
+    {
+        return false;
+    }
+    auto frame = readAt<FrameHeader>(m_data + offset);
+    auto cursor = m_data + offset + sizeof(FrameHeader);
+    auto end = cursor + frame.payloadBytes;
+    if(end > m_data + m_size)
+    {
+        return false;
+    }
+    float step[3];
+    for(size_t a = 0; a < 3; ++a)
+    {
+        step[a] = (frame.boxMax[a] - frame.boxMin[a]) / c_quantSteps;
+    }
+    // undo the point to point deltas and the quantization, add back the reference
+    o_positions.resize(m_numPoints);
+    int32_t prev[3] = {0, 0, 0};
+    for(size_t i = 0; i < m_numPoints; ++i)
+    {
+        float d[3];
+        for(size_t a = 0; a < 3; ++a)
+        {
+            uint32_t code;
+            if(!getVarint(cursor, end, code))
+            {
+                return false;
+            }
+            prev[a] += unzigzag(code);
+            d[a] = frame.boxMin[a] + prev[a] * step[a];
+        }
+        auto refBase = m_reference + sizeof(float) * (i*3);
+        o_positions[i].m_x = readAt<float>(refBase) + d[0];
+        o_positions[i].m_y = readAt<float>(refBase + sizeof(float)) + d[1];
+        o_positions[i].m_z = readAt<float>(refBase + sizeof(float) * 2) + d[2];
+    }
+    return true;
+}
@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <cstdio>
+#include "Profiler.h"
+
+Profiler::Profiler(size_t _capacity) :
+    m_events(_capacity), m_epoch(std::chrono::steady_clock::now())
+{
+}
+
+Profiler &Profiler::instance()
+{
+    static Profiler profiler(1 << 16);
+    return profiler;
+}
+
+uint64_t Profiler::now() const
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::steady_clock::now() - m_epoch).count());
+}
+
+uint32_t Profiler::threadId()
+{
+    static std::atomic<uint32_t> nextId{0};
+    thread_local uint32_t id = nextId++;
+    return id;
+}
+
+void Profiler::record(const char *_name, uint64_t _start, uint64_t _duration)
+{
+    auto slot = m_next.fetch_add(1, std::memory_order_relaxed) % m_events.size();
+    m_events[slot] = {_name, _start, _duration, threadId()};
+}
+
+std::vector<Profiler::Event> Profiler::events() const
+{
+    // unwrap the ring, oldest first
+    uint64_t total = m_next.load(std::memory_order_acquire);
+    uint64_t count = std::min<uint64_t>(total, m_events.size());
+    std::vector<Event> out;
+    out.reserve(count);
+    for(uint64_t i = total - count; i < total; ++i)
+    {
+        out.push_back(m_events[i % m_events.size()]);
+    }
+    return out;
+}
+
+bool Profiler::writeChromeTrace(const std::string &_filename) const
+{
+    auto file = std::fopen(_filename.c_str(), "w");
+    if(file == nullptr)
+    {
+        return false;
+    }
+    // complete ('X') events, times in microseconds
+    std::fputs("{\"traceEvents\":[\n", file);
+    auto list = events();
+    // a slot claimed but not written yet still has no name, if someone exported mid-step
+    list.erase(std::remove_if(list.begin(), list.end(), [](const Event &_e) { return _e.name == nullptr; }), list.end());
+    for(size_t i = 0; i < list.size(); ++i)
+    {
+        auto &e = list[i];
+        std::fprintf(file, "{\"name\":\"%s\",\"cat\":\"gnatv\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%u}%s\n",
+                     e.name, e.start / 1000.0, e.duration / 1000.0, e.thread, i + 1 < list.size() ? "," : "");
+    }
+    std::fputs("],\"displayTimeUnit\":\"ms\"}\n", file);
+    return std::fclose(file) == 0;
+}
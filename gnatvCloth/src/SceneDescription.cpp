@@ -0,0 +1,258 @@
+#include <fstream>
+#include <filesystem>
+#include <boost/algorithm/string.hpp>
+#include "SceneDescription.h"
+
+namespace
+{
+    bool parseMaterial(const std::string &_name, material_type &o_material)
+    {
+        if(_name == "wool")
+        {
+            o_material = WOOL;
+        }
+        else if(_name == "jute")
+        {
+            o_material = JUTE;
+        }
+        else if(_name == "custom")
+        {
+            o_material = CUSTOM;
+        }
+        else
+        {
+            return false;
+        }
+        return true;
+    }
+
+    bool parseIntegrator(const std::string &_name, IntegrationMethod &o_integrator)
+    {
+        if(_name == "cgm")
+        {
+            o_integrator = CGM;
+        }
+        else if(_name == "rk4")
+        {
+            o_integrator = RK4;
+        }
+        else if(_name == "symplectic")
+        {
+            o_integrator = SYMPLECTIC_EULER;
+        }
+        else if(_name == "verlet")
+        {
+            o_integrator = VERLET;
+        }
+        else if(_name == "rk45")
+        {
+            o_integrator = RK45;
+        }
+        else if(_name == "imex")
+        {
+            o_integrator = IMEX;
+        }
+        else
+        {
+            return false;
+        }
+        return true;
+    }
+}
+
+bool SceneDescription::load(const std::string &_filename, std::string &o_error)
+{
+    std::ifstream in(_filename);
+    if(!in)
+    {
+        o_error = "can't open " + _filename;
+        return false;
+    }
+    // paths in the scene are relative to the scene file
+    auto baseDir = std::filesystem::path(_filename).parent_path();
+    auto resolve = [&baseDir](const std::string &_path) -> std::string
+    {
+        auto p = std::filesystem::path(_path);
+        return p.is_absolute() ? p.string() : (baseDir / p).string();
+    };
+    std::string line;
+    size_t lineNumber = 0;
+    while(std::getline(in, line))
+    {
+        ++lineNumber;
+        // strip comments, split line
+        line = line.substr(0, line.find('#'));
+        boost::trim(line);
+        if(line.empty())
+        {
+            continue;
+        }
+        std::vector<std::string> res;
+        boost::split(res, line, [](char c){return c == ' ' || c == '\t';}, boost::token_compress_on);
+        auto bad = [&](const std::string &_why) -> bool
+        {
+            o_error = _filename + ":" + std::to_string(lineNumber) + ": " + _why;
+            return false;
+        };
+        auto &key = res[0];
+        try
+        {
+            if(key == "mesh" && res.size() == 2)
+            {
+                mesh = resolve(res[1]);
+            }
+            else if(key == "grid" && res.size() == 3)
+            {
+                gridN = std::stoul(res[1]);
+                gridM = std::stoul(res[2]);
+                if(gridN < 2 || gridM < 2)
+                {
+                    return bad("grid needs at least 2 x 2 points");
+                }
+            }
+            else if(key == "plane" && res.size() == 2)
+            {
+                if(res[1] != "xy" && res[1] != "xz")
+                {
+                    return bad("plane must be xy or xz");
+                }
+                planeXY = res[1] == "xy";
+            }
+            else if(key == "material" && res.size() == 2)
+            {
+                if(!parseMaterial(res[1], material))
+                {
+                    return bad("material must be wool, jute or custom");
+                }
+            }
+            else if(key == "integrator" && res.size() == 2)
+            {
+                if(!parseIntegrator(res[1], integrator))
+                {
+                    return bad("integrator must be cgm, rk4, symplectic, verlet, rk45 or imex");
+                }
+            }
+            else if(key == "dt" && res.size() == 2)
+            {
+                dt = std::stof(res[1]);
+            }
+            else if(key == "steps" && res.size() == 2)
+            {
+                steps = std::stoul(res[1]);
+            }
+            else if(key == "damping" && res.size() == 2)
+            {
+                damping = std::stof(res[1]);
+            }
+            else if(key == "fixed")
+            {
+                for(size_t i = 1; i < res.size(); ++i)
+                {
+                    fixedPoints.push_back(std::stoul(res[i]));
+                }
+            }
+            else if(key == "wind" && res.size() == 4)
+            {
+                windOn = true;
+                wind = ngl::Vec3(std::stof(res[1]), std::stof(res[2]), std::stof(res[3]));
+            }
+            else if(key == "selfcollision" && res.size() <= 2)
+            {
+                selfCollision = true;
+                collisionThickness = res.size() == 2 ? std::stof(res[1]) : 0.0f;
+            }
+            else if(key == "jacobianreuse" && res.size() <= 2)
+            {
+                jacobianReuse = true;
+                reuseTolerance = res.size() == 2 ? std::stof(res[1]) : 1e-3f;
+            }
+            else if(key == "obstacle" && (res.size() == 2 || res.size() == 3))
+            {
+                SceneObstacle obstacle;
+                obstacle.mesh = resolve(res[1]);
+                obstacle.cellSize = res.size() == 3 ? std::stof(res[2]) : 0.0f;
+                obstacles.push_back(obstacle);
+            }
+            else if(key == "objsequence" && res.size() == 3)
+            {
+                objSequenceDir = resolve(res[1]);
+                objSequencePrefix = res[2];
+            }
+            else if(key == "pointcache" && res.size() == 2)
+            {
+                pointCache = resolve(res[1]);
+            }
+            else if(key == "telemetry" && (res.size() == 2 || res.size() == 3))
+            {
+                if(res.size() == 3 && res[2] != "csv" && res[2] != "binary")
+                {
+                    return bad("telemetry format must be csv or binary");
+                }
+                telemetry = resolve(res[1]);
+                telemetryBinary = res.size() == 3 && res[2] == "binary";
+            }
+            else if(key == "sweep" && res.size() >= 3)
+            {
+                for(size_t i = 2; i < res.size(); ++i)
+                {
+                    if(res[1] == "damping")
+                    {
+                        sweepDamping.push_back(std::stof(res[i]));
+                    }
+                    else if(res[1] == "wind")
+                    {
+                        sweepWind.push_back(std::stof(res[i]));
+                    }
+                    else if(res[1] == "dt")
+                    {
+                        sweepDt.push_back(std::stof(res[i]));
+                    }
+                    else if(res[1] == "material")
+                    {
+                        sweepMaterial.push_back(WOOL);
+                        if(!parseMaterial(res[i], sweepMaterial.back()))
+                        {
+                            return bad("material must be wool, jute or custom");
+                        }
+                    }
+                    else
+                    {
+                        return bad("can only sweep damping, wind, material or dt");
+                    }
+                }
+            }
+            else
+            {
+                return bad("don't understand '" + line + "'");
+            }
+        }
+        catch(const std::exception &)
+        {
+            return bad("bad number in '" + line + "'");
+        }
+    }
+    if(mesh.empty() && gridN == 0)
+    {
+        o_error = _filename + ": no mesh or grid given";
+        return false;
+    }
+    return true;
+}
+
+std::vector<std::shared_ptr<const Obstacle>> SceneDescription::loadObstacles(std::string &o_error) const
+{
+    std::vector<std::shared_ptr<const Obstacle>> loaded;
+    for(auto &o : obstacles)
+    {
+        auto obstacle = std::make_shared<Obstacle>();
+        if(obstacle->load(o.mesh, o.cellSize))
+        {
+            loaded.push_back(obstacle);
+        }
+        else
+        {
+            o_error = "can't read obstacle " + o.mesh;
+        }
+    }
+    return loaded;
+}
@@ -0,0 +1,509 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "SelfCollision.h"
+
+namespace
+{
+    /**
+     * @brief parameters s, t of the closest points p1 + s d1, p2 + t d2 on two segments (Ericson 5.1.9)
+    */
+    void closestOnSegments(const ngl::Vec3 &_p1, const ngl::Vec3 &_q1, const ngl::Vec3 &_p2, const ngl::Vec3 &_q2,
+                           float &o_s, float &o_t)
+    {
+        auto d1 = _q1 - _p1;
+        auto d2 = _q2 - _p2;
+        auto r = _p1 - _p2;
+        float a = d1.dot(d1);
+        float e = d2.dot(d2);
+        float f = d2.dot(r);
+        float c = d1.dot(r);
+        float b = d1.dot(d2);
+        float denom = a * e - b * b;
+        // parallel segments pick s = 0
+        o_s = denom > 1e-12f ? std::clamp((b * f - c * e) / denom, 0.0f, 1.0f) : 0.0f;
+        o_t = (b * o_s + f) / e;
+        if(o_t < 0.0f)
+        {
+            o_t = 0.0f;
+            o_s = std::clamp(-c / a, 0.0f, 1.0f);
+        }
+        else if(o_t > 1.0f)
+        {
+            o_t = 1.0f;
+            o_s = std::clamp((b - c) / a, 0.0f, 1.0f);
+        }
+    }
+
+    /**
+     * @brief grows [io_min, io_max] to hold _p
+    */
+    void expand(ngl::Vec3 &io_min, ngl::Vec3 &io_max, const ngl::Vec3 &_p)
+    {
+        io_min.set(std::min(io_min.m_x, _p.m_x), std::min(io_min.m_y, _p.m_y), std::min(io_min.m_z, _p.m_z));
+        io_max.set(std::max(io_max.m_x, _p.m_x), std::max(io_max.m_y, _p.m_y), std::max(io_max.m_z, _p.m_z));
+    }
+
+    /**
+     * @brief returns whether or not two boxes come within _margin of each other
+    */
+    bool overlaps(const ngl::Vec3 &_minA, const ngl::Vec3 &_maxA, const ngl::Vec3 &_minB, const ngl::Vec3 &_maxB,
+                  float _margin)
+    {
+        return _minA.m_x <= _maxB.m_x + _margin && _maxA.m_x + _margin >= _minB.m_x &&
+               _minA.m_y <= _maxB.m_y + _margin && _maxA.m_y + _margin >= _minB.m_y &&
+               _minA.m_z <= _maxB.m_z + _margin && _maxA.m_z + _margin >= _minB.m_z;
+    }
+
+    /**
+     * @brief triangle pairs handled by one parallel chunk of a query
+    */
+    constexpr size_t chunkSize = 256;
+}
+
+ngl::Vec3 closestPointOnTriangle(const ngl::Vec3 &_p, const ngl::Vec3 &_a, const ngl::Vec3 &_b, const ngl::Vec3 &_c)
+{
+    auto ab = _b - _a;
+    auto ac = _c - _a;
+    auto ap = _p - _a;
+    float d1 = ab.dot(ap);
+    float d2 = ac.dot(ap);
+    if(d1 <= 0.0f && d2 <= 0.0f)
+    {
+        return ngl::Vec3(1.0f, 0.0f, 0.0f);
+    }
+    auto bp = _p - _b;
+    float d3 = ab.dot(bp);
+    float d4 = ac.dot(bp);
+    if(d3 >= 0.0f && d4 <= d3)
+    {
+        return ngl::Vec3(0.0f, 1.0f, 0.0f);
+    }
+    float vc = d1 * d4 - d3 * d2;
+    if(vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+    {
+        float v = d1 / (d1 - d3);
+        return ngl::Vec3(1.0f - v, v, 0.0f);
+    }
+    auto cp = _p - _c;
+    float d5 = ab.dot(cp);
+    float d6 = ac.dot(cp);
+    if(d6 >= 0.0f && d5 <= d6)
+    {
+        return ngl::Vec3(0.0f, 0.0f, 1.0f);
+    }
+    float vb = d5 * d2 - d1 * d6;
+    if(vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+    {
+        float w = d2 / (d2 - d6);
+        return ngl::Vec3(1.0f - w, 0.0f, w);
+    }
+    float va = d3 * d6 - d5 * d4;
+    if(va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+    {
+        float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+        return ngl::Vec3(0.0f, 1.0f - w, w);
+    }
+    float denom = 1.0f / (va + vb + vc);
+    float v = vb * denom;
+    float w = vc * denom;
+    return ngl::Vec3(1.0f - v - w, v, w);
+}
+
+void SelfCollision::build(const std::vector<ngl::Vec3> &_positions, const std::vector<size_t> &_indices)
+{
+    m_nodes.clear();
+    m_indices = _indices;
+    m_numPoints = _positions.size();
+    const size_t nt = m_indices.size() / 3;
+    // edges, each once with the lower id first, and the three edges of each triangle
+    std::vector<std::array<size_t, 3>> keyed;
+    keyed.reserve(nt * 3);
+    for(size_t t = 0; t < nt; ++t)
+    {
+        for(size_t k = 0; k < 3; ++k)
+        {
+            auto i = m_indices[3 * t + k];
+            auto j = m_indices[3 * t + (k + 1) % 3];
+            keyed.push_back({std::min(i, j), std::max(i, j), 3 * t + k});
+        }
+    }
+    std::sort(keyed.begin(), keyed.end());
+    m_edges.clear();
+    m_edgeOwner.clear();
+    m_triEdges.assign(nt, {0, 0, 0});
+    for(size_t e = 0; e < keyed.size(); ++e)
+    {
+        // sorted by corner too, so the first copy of an edge comes from its lowest triangle
+        if(e == 0 || keyed[e][0] != keyed[e - 1][0] || keyed[e][1] != keyed[e - 1][1])
+        {
+            m_edges.push_back({keyed[e][0], keyed[e][1]});
+            m_edgeOwner.push_back(keyed[e][2] / 3);
+        }
+        m_triEdges[keyed[e][2] / 3][keyed[e][2] % 3] = m_edges.size() - 1;
+    }
+    m_pointOwner.assign(m_numPoints, nt);
+    for(size_t t = nt; t-- > 0;)
+    {
+        for(size_t k = 0; k < 3; ++k)
+        {
+            m_pointOwner[m_indices[3 * t + k]] = t;
+        }
+    }
+    if(nt == 0)
+    {
+        return;
+    }
+    // split on the triangle centroids
+    std::vector<ngl::Vec3> centroids(nt);
+    std::vector<size_t> tris(nt);
+    for(size_t t = 0; t < nt; ++t)
+    {
+        centroids[t] = (_positions[m_indices[3 * t]] + _positions[m_indices[3 * t + 1]] +
+                        _positions[m_indices[3 * t + 2]]) / 3.0f;
+        tris[t] = t;
+    }
+    m_nodes.reserve(2 * nt - 1);
+    buildNode(tris, 0, nt, centroids);
+    refit(_positions, std::vector<ngl::Vec3>(_positions.size()), 0.0f);
+}
+
+size_t SelfCollision::buildNode(std::vector<size_t> &io_tris, size_t _begin, size_t _end,
+                                const std::vector<ngl::Vec3> &_centroids)
+{
+    auto index = m_nodes.size();
+    m_nodes.emplace_back();
+    if(_end - _begin == 1)
+    {
+        m_nodes[index].triangle = static_cast<long>(io_tris[_begin]);
+        return index;
+    }
+    // split at the median along the widest axis of the centroids
+    ngl::Vec3 lo(std::numeric_limits<float>::max()), hi(std::numeric_limits<float>::lowest());
+    for(size_t i = _begin; i < _end; ++i)
+    {
+        expand(lo, hi, _centroids[io_tris[i]]);
+    }
+    auto extent = hi - lo;
+    int axis = extent.m_x >= extent.m_y && extent.m_x >= extent.m_z ? 0 : (extent.m_y >= extent.m_z ? 1 : 2);
+    auto mid = _begin + (_end - _begin) / 2;
+    std::nth_element(io_tris.begin() + _begin, io_tris.begin() + mid, io_tris.begin() + _end,
+                     [&](size_t _a, size_t _b) { return _centroids[_a][axis] < _centroids[_b][axis]; });
+    auto left = buildNode(io_tris, _begin, mid, _centroids);
+    auto right = buildNode(io_tris, mid, _end, _centroids);
+    m_nodes[index].left = left;
+    m_nodes[index].right = right;
+    return index;
+}
+
+size_t SelfCollision::memoryBytes() const
+{
+    return m_nodes.capacity() * sizeof(Node) + m_indices.capacity() * sizeof(size_t) +
+           m_edges.capacity() * sizeof(m_edges[0]) + m_triEdges.capacity() * sizeof(m_triEdges[0]) +
+           (m_pointOwner.capacity() + m_edgeOwner.capacity()) * sizeof(size_t);
+}
+
+void SelfCollision::refit(const std::vector<ngl::Vec3> &_positions, const std::vector<ngl::Vec3> &_velocities, float _h)
+{
+    // children come after their parents, so walking backwards sees every child first
+    for(size_t n = m_nodes.size(); n-- > 0;)
+    {
+        auto &node = m_nodes[n];
+        if(node.triangle >= 0)
+        {
+            node.min = ngl::Vec3(std::numeric_limits<float>::max());
+            node.max = ngl::Vec3(std::numeric_limits<float>::lowest());
+            for(size_t k = 0; k < 3; ++k)
+            {
+                auto i = m_indices[3 * node.triangle + k];
+                expand(node.min, node.max, _positions[i]);
+                expand(node.min, node.max, _positions[i] + (_h * _velocities[i]));
+            }
+        }
+        else
+        {
+            auto &l = m_nodes[node.left];
+            auto &r = m_nodes[node.right];
+            node.min.set(std::min(l.min.m_x, r.min.m_x), std::min(l.min.m_y, r.min.m_y), std::min(l.min.m_z, r.min.m_z));
+            node.max.set(std::max(l.max.m_x, r.max.m_x), std::max(l.max.m_y, r.max.m_y), std::max(l.max.m_z, r.max.m_z));
+        }
+    }
+}
+
+void SelfCollision::selfPairs(size_t _node, float _margin, std::vector<std::array<size_t, 2>> &io_pairs) const
+{
+    auto &node = m_nodes[_node];
+    if(node.triangle >= 0)
+    {
+        return;
+    }
+    selfPairs(node.left, _margin, io_pairs);
+    selfPairs(node.right, _margin, io_pairs);
+    nodePairs(node.left, node.right, _margin, io_pairs);
+}
+
+void SelfCollision::nodePairs(size_t _a, size_t _b, float _margin, std::vector<std::array<size_t, 2>> &io_pairs) const
+{
+    auto &a = m_nodes[_a];
+    auto &b = m_nodes[_b];
+    if(!overlaps(a.min, a.max, b.min, b.max, _margin))
+    {
+        return;
+    }
+    if(a.triangle >= 0 && b.triangle >= 0)
+    {
+        io_pairs.push_back({_a, _b});
+        return;
+    }
+    // descend into the bigger box, or the only one that can be split
+    auto extentA = a.max - a.min;
+    auto extentB = b.max - b.min;
+    bool splitA = b.triangle >= 0 ||
+                  (a.triangle < 0 && extentA.lengthSquared() >= extentB.lengthSquared());
+    if(splitA)
+    {
+        nodePairs(a.left, _b, _margin, io_pairs);
+        nodePairs(a.right, _b, _margin, io_pairs);
+    }
+    else
+    {
+        nodePairs(_a, b.left, _margin, io_pairs);
+        nodePairs(_a, b.right, _margin, io_pairs);
+    }
+}
+
+void SelfCollision::findContacts(const std::vector<ngl::Vec3> &_positions, const std::vector<ngl::Vec3> &_velocities,
+                                 float _h, float _thickness, bool _parallel, std::vector<CollisionContact> &o_contacts) const
+{
+    o_contacts.clear();
+    if(m_nodes.empty())
+    {
+        return;
+    }
+    std::vector<std::array<size_t, 2>> pairs;
+    selfPairs(0, _thickness, pairs);
+    const size_t numChunks = (pairs.size() + chunkSize - 1) / chunkSize;
+    std::vector<std::vector<CollisionContact>> found(numChunks);
+    // how far each point can travel over the step, and the box each edge sweeps
+    std::vector<float> reach(m_numPoints);
+    for(size_t i = 0; i < m_numPoints; ++i)
+    {
+        reach[i] = _h * _velocities[i].length();
+    }
+    std::vector<std::array<ngl::Vec3, 2>> edgeBoxes(m_edges.size());
+    for(size_t e = 0; e < m_edges.size(); ++e)
+    {
+        auto &box = edgeBoxes[e];
+        box[0] = box[1] = _positions[m_edges[e][0]];
+        expand(box[0], box[1], _positions[m_edges[e][1]]);
+        expand(box[0], box[1], _positions[m_edges[e][0]] + (_h * _velocities[m_edges[e][0]]));
+        expand(box[0], box[1], _positions[m_edges[e][1]] + (_h * _velocities[m_edges[e][1]]));
+    }
+
+    // vertex _v against the triangle of leaf _leaf
+    auto vertexTriangle = [&](size_t _v, const Node &_leaf, std::vector<CollisionContact> &io_out)
+    {
+        auto t = static_cast<size_t>(_leaf.triangle);
+        auto a = m_indices[3 * t], b = m_indices[3 * t + 1], c = m_indices[3 * t + 2];
+        if(_v == a || _v == b || _v == c)
+        {
+            return;
+        }
+        // most pairs are ruled out by the triangle's swept box alone
+        auto p = _positions[_v];
+        if(!overlaps(p, p, _leaf.min, _leaf.max, _thickness + reach[_v]))
+        {
+            return;
+        }
+        auto range = _thickness + reach[_v] + std::max({reach[a], reach[b], reach[c]});
+        auto w = closestPointOnTriangle(p, _positions[a], _positions[b], _positions[c]);
+        auto sep = p - ((w.m_x * _positions[a]) + (w.m_y * _positions[b]) + (w.m_z * _positions[c]));
+        auto d = sep.length();
+        if(d >= range)
+        {
+            return;
+        }
+        CollisionContact contact;
+        if(d > 1e-6f)
+        {
+            contact.normal = sep / d;
+        }
+        else
+        {
+            // on the triangle, push out the side it's facing
+            contact.normal = (_positions[b] - _positions[a]).cross(_positions[c] - _positions[a]);
+            if(contact.normal.length() < 1e-12f)
+            {
+                return;
+            }
+            contact.normal.normalize();
+        }
+        contact.points[0] = _v;
+        contact.points[1] = a;
+        contact.points[2] = b;
+        contact.points[3] = c;
+        contact.weights[0] = 1.0f;
+        contact.weights[1] = -w.m_x;
+        contact.weights[2] = -w.m_y;
+        contact.weights[3] = -w.m_z;
+        contact.distance = d;
+        io_out.push_back(contact);
+    };
+
+    // edge _e against edge _f
+    auto edgeEdge = [&](size_t _e, size_t _f, std::vector<CollisionContact> &io_out)
+    {
+        auto &e1 = m_edges[std::min(_e, _f)];
+        auto &e2 = m_edges[std::max(_e, _f)];
+        if(e1[0] == e2[0] || e1[0] == e2[1] || e1[1] == e2[0] || e1[1] == e2[1])
+        {
+            return;
+        }
+        auto p1 = _positions[e1[0]], q1 = _positions[e1[1]];
+        auto p2 = _positions[e2[0]], q2 = _positions[e2[1]];
+        auto &box1 = edgeBoxes[std::min(_e, _f)];
+        auto &box2 = edgeBoxes[std::max(_e, _f)];
+        if(!overlaps(box1[0], box1[1], box2[0], box2[1], _thickness))
+        {
+            return;
+        }
+        auto range = _thickness + std::max(reach[e1[0]], reach[e1[1]]) + std::max(reach[e2[0]], reach[e2[1]]);
+        float s, t;
+        closestOnSegments(p1, q1, p2, q2, s, t);
+        auto sep = (p1 + (s * (q1 - p1))) - (p2 + (t * (q2 - p2)));
+        auto d = sep.length();
+        // too close to tell which side is which, the vertex-triangle contacts cover it
+        if(d >= range || d < 1e-6f)
+        {
+            return;
+        }
+        CollisionContact contact;
+        contact.edgeEdge = true;
+        contact.normal = sep / d;
+        contact.points[0] = e1[0];
+        contact.points[1] = e1[1];
+        contact.points[2] = e2[0];
+        contact.points[3] = e2[1];
+        contact.weights[0] = 1.0f - s;
+        contact.weights[1] = s;
+        contact.weights[2] = t - 1.0f;
+        contact.weights[3] = -t;
+        contact.distance = d;
+        io_out.push_back(contact);
+    };
+
+    #pragma omp parallel for schedule(dynamic) if(_parallel)
+    for(size_t c = 0; c < numChunks; ++c)
+    {
+        auto end = std::min(pairs.size(), (c + 1) * chunkSize);
+        for(size_t i = c * chunkSize; i < end; ++i)
+        {
+            auto &leaf1 = m_nodes[pairs[i][0]];
+            auto &leaf2 = m_nodes[pairs[i][1]];
+            auto t1 = static_cast<size_t>(leaf1.triangle);
+            auto t2 = static_cast<size_t>(leaf2.triangle);
+            // vertices and edges are only tested from the triangle that owns them
+            for(size_t k = 0; k < 3; ++k)
+            {
+                auto v1 = m_indices[3 * t1 + k];
+                if(m_pointOwner[v1] == t1)
+                {
+                    vertexTriangle(v1, leaf2, found[c]);
+                }
+                auto v2 = m_indices[3 * t2 + k];
+                if(m_pointOwner[v2] == t2)
+                {
+                    vertexTriangle(v2, leaf1, found[c]);
+                }
+            }
+            for(auto e : m_triEdges[t1])
+            {
+                if(m_edgeOwner[e] != t1)
+                {
+                    continue;
+                }
+                for(auto f : m_triEdges[t2])
+                {
+                    if(m_edgeOwner[f] == t2)
+                    {
+                        edgeEdge(e, f, found[c]);
+                    }
+                }
+            }
+        }
+    }
+    for(auto &f : found)
+    {
+        o_contacts.insert(o_contacts.end(), f.begin(), f.end());
+    }
+}
+
+long SelfCollision::raycast(const std::vector<ngl::Vec3> &_positions, const ngl::Vec3 &_origin, const ngl::Vec3 &_direction,
+                            float &o_t, ngl::Vec3 &o_weights) const
+{
+    long hit = -1;
+    o_t = std::numeric_limits<float>::max();
+    if(m_nodes.empty())
+    {
+        return hit;
+    }
+    // entry distance of the ray into a box (slab test), max if it misses or starts past o_t
+    ngl::Vec3 inv;
+    for(size_t k = 0; k < 3; ++k)
+    {
+        inv[k] = std::abs(_direction[k]) > 1e-12f ? 1.0f / _direction[k] : std::copysign(1e12f, _direction[k]);
+    }
+    auto entry = [&](const Node &_node)
+    {
+        float tmin = 0.0f;
+        float tmax = o_t;
+        for(size_t k = 0; k < 3; ++k)
+        {
+            float t0 = (_node.min[k] - _origin[k]) * inv[k];
+            float t1 = (_node.max[k] - _origin[k]) * inv[k];
+            tmin = std::max(tmin, std::min(t0, t1));
+            tmax = std::min(tmax, std::max(t0, t1));
+        }
+        return tmin <= tmax ? tmin : std::numeric_limits<float>::max();
+    };
+    std::vector<size_t> stack = {0};
+    while(!stack.empty())
+    {
+        auto &node = m_nodes[stack.back()];
+        stack.pop_back();
+        if(entry(node) == std::numeric_limits<float>::max())
+        {
+            continue;
+        }
+        if(node.triangle < 0)
+        {
+            stack.push_back(node.left);
+            stack.push_back(node.right);
+            continue;
+        }
+        // Moller-Trumbore, either side of the triangle counts
+        auto &a = _positions[m_indices[3 * node.triangle]];
+        auto &b = _positions[m_indices[3 * node.triangle + 1]];
+        auto &c = _positions[m_indices[3 * node.triangle + 2]];
+        auto e1 = b - a;
+        auto e2 = c - a;
+        auto p = _direction.cross(e2);
+        float det = e1.dot(p);
+        if(std::abs(det) < 1e-12f)
+        {
+            continue;
+        }
+        auto s = _origin - a;
+        float u = s.dot(p) / det;
+        auto q = s.cross(e1);
+        float v = _direction.dot(q) / det;
+        float t = e2.dot(q) / det;
+        if(u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t >= 0.0f && t < o_t)
+        {
+            o_t = t;
+            o_weights.set(1.0f - u - v, u, v);
+            hit = node.triangle;
+        }
+    }
+    return hit;
+}
@@ -0,0 +1,123 @@
+#include <cstring>
+#include "SolverTelemetry.h"
+
+namespace
+{
+    const char c_magic[8] = {'G', 'N', 'T', 'V', 'T', 'E', 'L', '1'};
+
+    template <typename T>
+    void put(std::FILE *_file, T _value)
+    {
+        std::fwrite(&_value, sizeof(T), 1, _file);
+    }
+
+    template <typename T>
+    bool get(std::FILE *_file, T &o_value)
+    {
+        return std::fread(&o_value, sizeof(T), 1, _file) == 1;
+    }
+}
+
+SolverTelemetry::~SolverTelemetry()
+{
+    close();
+}
+
+bool SolverTelemetry::open(const std::string &_filename, Format _format)
+{
+    close();
+    m_file = std::fopen(_filename.c_str(), _format == CSV ? "w" : "wb");
+    if(m_file == nullptr)
+    {
+        return false;
+    }
+    m_format = _format;
+    m_step = 0;
+    if(m_format == CSV)
+    {
+        std::fputs("step,material,masspoints,h,iterations,capped,rstest,rsfinal,precon_min,precon_max,residuals\n", m_file);
+    }
+    else
+    {
+        std::fwrite(c_magic, 1, sizeof(c_magic), m_file);
+    }
+    return true;
+}
+
+void SolverTelemetry::close()
+{
+    if(m_file != nullptr)
+    {
+        std::fclose(m_file);
+        m_file = nullptr;
+    }
+}
+
+void SolverTelemetry::record(const SolverStepStats &_stats)
+{
+    if(m_file == nullptr)
+    {
+        return;
+    }
+    if(m_format == CSV)
+    {
+        std::fprintf(m_file, "%zu,%u,%zu,%g,%zu,%d,%g,%g,%g,%g,", m_step, _stats.material, _stats.masspoints,
+                     static_cast<double>(_stats.h), _stats.iterations, _stats.capped ? 1 : 0, static_cast<double>(_stats.rstest),
+                     _stats.residuals.empty() ? 0.0 : static_cast<double>(_stats.residuals.back()),
+                     static_cast<double>(_stats.preconMin), static_cast<double>(_stats.preconMax));
+        for(size_t i = 0; i < _stats.residuals.size(); ++i)
+        {
+            std::fprintf(m_file, i == 0 ? "%g" : ";%g", static_cast<double>(_stats.residuals[i]));
+        }
+        std::fputc('\n', m_file);
+    }
+    else
+    {
+        put<uint64_t>(m_file, m_step);
+        put<uint32_t>(m_file, _stats.material);
+        put<uint64_t>(m_file, _stats.masspoints);
+        put<float>(m_file, _stats.h);
+        put<float>(m_file, _stats.rstest);
+        put<float>(m_file, _stats.preconMin);
+        put<float>(m_file, _stats.preconMax);
+        put<uint64_t>(m_file, _stats.iterations);
+        put<uint8_t>(m_file, _stats.capped ? 1 : 0);
+        put<uint64_t>(m_file, _stats.residuals.size());
+        std::fwrite(_stats.residuals.data(), sizeof(float), _stats.residuals.size(), m_file);
+    }
+    ++m_step;
+}
+
+bool SolverTelemetry::readBinary(const std::string &_filename, std::vector<SolverStepStats> &o_steps)
+{
+    o_steps.clear();
+    auto file = std::fopen(_filename.c_str(), "rb");
+    if(file == nullptr)
+    {
+        return false;
+    }
+    char magic[sizeof(c_magic)];
+    bool ok = std::fread(magic, 1, sizeof(magic), file) == sizeof(magic) && std::memcmp(magic, c_magic, sizeof(magic)) == 0;
+    // read steps until the file runs out, a step cut short is an error
+    uint64_t step;
+    while(ok && get(file, step))
+    {
+        SolverStepStats s;
+        uint64_t masspoints, iterations, numResiduals;
+        uint8_t capped;
+        ok = get(file, s.material) && get(file, masspoints) && get(file, s.h) && get(file, s.rstest) &&
+             get(file, s.preconMin) && get(file, s.preconMax) && get(file, iterations) && get(file, capped) &&
+             get(file, numResiduals) && numResiduals <= iterations + 1;
+        if(ok)
+        {
+            s.masspoints = masspoints;
+            s.iterations = iterations;
+            s.capped = capped != 0;
+            s.residuals.resize(numResiduals);
+            ok = std::fread(s.residuals.data(), sizeof(float), numResiduals, file) == numResiduals;
+            o_steps.push_back(std::move(s));
+        }
+    }
+    std::fclose(file);
+    return ok;
+}
@@ -32,13 +32,18 @@ void Triangle::computeR(std::function<ngl::Vec2(ngl::Vec3)> _toParam)
     m_rv.m_z = (1/d) * (bp.m_x - ap.m_x);
 }
 
-void Triangle::update_sa()
+float Triangle::area(const ngl::Vec3 &_a, const ngl::Vec3 &_b, const ngl::Vec3 &_c)
 {
-    // calculate current surface area of the triangle by using
     // magnitude of cross product
-    ngl::Vec3 p1(m_b.m_x - m_a.m_x, m_b.m_y - m_a.m_y, m_b.m_z - m_a.m_z);
-    ngl::Vec3 p2(m_c.m_x - m_a.m_x, m_c.m_y - m_a.m_y, m_c.m_z - m_a.m_z);
+    ngl::Vec3 p1(_b.m_x - _a.m_x, _b.m_y - _a.m_y, _b.m_z - _a.m_z);
+    ngl::Vec3 p2(_c.m_x - _a.m_x, _c.m_y - _a.m_y, _c.m_z - _a.m_z);
     auto crs = p1.cross(p2);
     auto d = crs.length();
-    m_sa = d/2;
+    return d/2;
+}
+
+void Triangle::update_sa()
+{
+    // calculate current surface area of the triangle
+    m_sa = area(m_a, m_b, m_c);
 }
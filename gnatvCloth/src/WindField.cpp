@@ -0,0 +1,94 @@
+#include <algorithm>
+#include <cmath>
+#include "WindField.h"
+
+namespace
+{
+    /**
+     * @brief returns a value in [0, 1) from a hash of the lattice point, seed and channel
+    */
+    float latticeValue(int32_t _i, int32_t _j, int32_t _k, uint32_t _seed, uint32_t _channel)
+    {
+        uint32_t h = _seed * 0x9e3779b9u + _channel * 0x85ebca6bu;
+        h ^= static_cast<uint32_t>(_i) * 0x27d4eb2fu;
+        h = (h ^ (h >> 15)) * 0x2c1b3c6du;
+        h ^= static_cast<uint32_t>(_j) * 0x165667b1u;
+        h = (h ^ (h >> 12)) * 0x297a2d39u;
+        h ^= static_cast<uint32_t>(_k) * 0xd3a2646cu;
+        h = (h ^ (h >> 15)) * 0x85ebca6bu;
+        h ^= h >> 13;
+        return static_cast<float>(h >> 8) / 16777216.0f;
+    }
+
+    /**
+     * @brief smoothstep weight, so the noise has no creases at the lattice points
+    */
+    float fade(float _t)
+    {
+        return _t * _t * (3.0f - 2.0f * _t);
+    }
+
+    /**
+     * @brief value noise in [0, 1), trilinear between lattice points with smoothstep weights
+    */
+    float valueNoise(const ngl::Vec3 &_p, uint32_t _seed, uint32_t _channel)
+    {
+        auto i = static_cast<int32_t>(std::floor(_p.m_x));
+        auto j = static_cast<int32_t>(std::floor(_p.m_y));
+        auto k = static_cast<int32_t>(std::floor(_p.m_z));
+        float fx = fade(_p.m_x - i);
+        float fy = fade(_p.m_y - j);
+        float fz = fade(_p.m_z - k);
+        auto lerp = [](float _a, float _b, float _t) { return _a + _t * (_b - _a); };
+        auto corner = [&](int32_t _di, int32_t _dj, int32_t _dk)
+        {
+            return latticeValue(i + _di, j + _dj, k + _dk, _seed, _channel);
+        };
+        float x00 = lerp(corner(0, 0, 0), corner(1, 0, 0), fx);
+        float x10 = lerp(corner(0, 1, 0), corner(1, 1, 0), fx);
+        float x01 = lerp(corner(0, 0, 1), corner(1, 0, 1), fx);
+        float x11 = lerp(corner(0, 1, 1), corner(1, 1, 1), fx);
+        return lerp(lerp(x00, x10, fy), lerp(x01, x11, fy), fz);
+    }
+}
+
+void WindField::setGusts(float _strength, float _period)
+{
+    m_gustStrength = _strength;
+    m_gustPeriod = _period;
+}
+
+void WindField::setTurbulence(float _strength, float _scale)
+{
+    m_turbulence = _strength;
+    m_turbulenceScale = _scale;
+}
+
+float WindField::gust(float _t) const
+{
+    if(m_gustPeriod <= 0.0f)
+    {
+        return 1.0f;
+    }
+    float n = valueNoise(ngl::Vec3(_t / m_gustPeriod, 0.0f, 0.0f), m_seed, 0);
+    return std::max(0.0f, 1.0f + m_gustStrength * (2.0f * n - 1.0f));
+}
+
+ngl::Vec3 WindField::velocity(const ngl::Vec3 &_p, float _t) const
+{
+    if(still())
+    {
+        return ngl::Vec3(0.0f);
+    }
+    auto wind = m_mean;
+    if(m_turbulence > 0.0f && m_turbulenceScale > 0.0f)
+    {
+        // the turbulence is frozen into the air and carried along with it
+        auto q = (_p - (_t * m_mean)) / m_turbulenceScale;
+        float speed = m_mean.length() * m_turbulence;
+        wind += speed * ngl::Vec3(2.0f * valueNoise(q, m_seed, 1) - 1.0f,
+                                  2.0f * valueNoise(q, m_seed, 2) - 1.0f,
+                                  2.0f * valueNoise(q, m_seed, 3) - 1.0f);
+    }
+    return gust(_t) * wind;
+}
@@ -1,5 +1,7 @@
 TEMPLATE=subdirs
 SUBDIRS+=gnatvCloth/gnatvCloth.pro
 SUBDIRS+=test/test.pro
+SUBDIRS+=batch/batch.pro
+SUBDIRS+=bench/bench.pro
 
-OTHER_FILES+= README.md
\ No newline at end of file
+OTHER_FILES+= README.md
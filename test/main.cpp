@@ -1,9 +1,30 @@
 #include <gtest/gtest.h>
+#include <cstdio>
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <chrono>
+#include <thread>
 #include "MassPoint.h"
 #include "Triangle.h"
 #include "Cloth.h"
 #include "ClothInterface.h"
+#include "MeshCache.h"
+#include "PointCache.h"
+#include "ObjSequenceWriter.h"
+#include "TripleBuffer.h"
+#include "SceneDescription.h"
+#include "ClothGrid.h"
+#include "FixPtTestDefaults.h"
+#include "Profiler.h"
+#include "ClothEnsemble.h"
+#include "WindField.h"
+#include "ForceField.h"
+#include "ForceDisplacementTest.h"
+#include "MaterialCalibration.h"
+#include "Obstacle.h"
+#include "ClothDrag.h"
 
 int main(int argc, char **argv)
 {
@@ -275,6 +296,105 @@ TEST(Cloth,fixCorners)
     EXPECT_TRUE(c.isCornerFixed() == c4);
 }
 
+TEST(Cloth,meshCache)
+{
+    std::vector<size_t> corners = {0, 1, 2, 3};
+    auto toParam = [](ngl::Vec3 _v) -> ngl::Vec2
+    {
+        ngl::Vec2 n;
+        n.m_x = _v.m_x;
+        n.m_y = _v.m_z;
+        return n;
+    };
+    // parse without the cache, then write and read back the cache
+    std::string filename = "../gnatvCloth/obj/clothLowResXZ.obj";
+    std::remove(MeshCache::cachePath(filename).c_str());
+    Cloth parsed(WOOL);
+    parsed.setMeshCacheEnabled(false);
+    parsed.init(filename, toParam, corners, 2.0f);
+    Cloth written(WOOL);
+    written.init(filename, toParam, corners, 2.0f);
+    MeshCache cache;
+    EXPECT_TRUE(cache.load(filename, MeshCache::makeKey(filename, toParam)));
+    EXPECT_TRUE(cache.numMasses() == 289);
+    EXPECT_TRUE(cache.numTriangles() == 512);
+    cache.unload();
+    Cloth cached(WOOL);
+    cached.init(filename, toParam, corners, 2.0f);
+    EXPECT_TRUE(cached.numMasses() == parsed.numMasses());
+    EXPECT_TRUE(cached.numTriangles() == parsed.numTriangles());
+    EXPECT_FLOAT_EQ(cached.firstMass(), parsed.firstMass());
+    for(size_t i = 0; i < parsed.numMasses(); ++i)
+    {
+        EXPECT_TRUE(cached.posAtPoint(i) == parsed.posAtPoint(i));
+    }
+    // a different toParam plane must not pick up the same cache
+    auto toParamXY = [](ngl::Vec3 _v) -> ngl::Vec2
+    {
+        return ngl::Vec2(_v.m_x, _v.m_y);
+    };
+    EXPECT_FALSE(cache.load(filename, MeshCache::makeKey(filename, toParamXY)));
+    // the cache written by the wool cloth gives a jute cloth jute's masses
+    Cloth juteParsed(JUTE);
+    juteParsed.setMeshCacheEnabled(false);
+    juteParsed.init(filename, toParam, corners, 2.0f);
+    Cloth juteCached(JUTE);
+    juteCached.init(filename, toParam, corners, 2.0f);
+    EXPECT_TRUE(juteParsed.firstMass() != parsed.firstMass());
+    for(size_t i = 0; i < juteParsed.numMasses(); ++i)
+    {
+        EXPECT_FLOAT_EQ(juteCached.massAtPoint(i), juteParsed.massAtPoint(i));
+        EXPECT_FLOAT_EQ(cached.massAtPoint(i), parsed.massAtPoint(i));
+    }
+}
+
+TEST(MeshCache,staleAndDamaged)
+{
+    auto filename = (std::filesystem::temp_directory_path() / "gnatvClothCache.obj").string();
+    {
+        std::ofstream out(filename);
+        out << "v 0 0 0\nv 1 0 0\nv 0 0 1\nvt 0 0\nf 1/1 2/1 3/1\n";
+    }
+    auto key = MeshCache::makeKey(filename, toParamXZ);
+    EXPECT_TRUE(key != 0);
+    std::vector<ngl::Vec3> positions = {ngl::Vec3(0.0f), ngl::Vec3(1.0f, 0.0f, 0.0f), ngl::Vec3(0.0f, 0.0f, 1.0f)};
+    std::vector<ngl::Vec2> uvs(3, ngl::Vec2(0.0f, 0.0f));
+    std::vector<ngl::Vec3> r(1, ngl::Vec3(1.0f));
+    std::vector<float> areas = {0.5f};
+    std::vector<uint32_t> offsets = {0, 3, 6, 9};
+    std::vector<uint32_t> ids = {0, 1, 2, 0, 1, 2, 0, 1, 2};
+    MeshCache cache;
+    ASSERT_TRUE(MeshCache::save(filename, key, positions, {0, 1, 2}, uvs, r, r, areas, offsets, ids));
+    EXPECT_TRUE(cache.load(filename, key));
+    // touching the obj without changing it keeps the cache, it's hashed to check
+    std::filesystem::last_write_time(filename, std::filesystem::last_write_time(filename) + std::chrono::seconds(5));
+    EXPECT_TRUE(cache.load(filename, key));
+    // the same size with different contents doesn't
+    {
+        std::ofstream out(filename);
+        out << "v 0 0 0\nv 2 0 0\nv 0 0 1\nvt 0 0\nf 1/1 2/1 3/1\n";
+    }
+    std::filesystem::last_write_time(filename, std::filesystem::last_write_time(filename) + std::chrono::seconds(10));
+    EXPECT_FALSE(cache.load(filename, key));
+    // indices, offsets and ids that don't fit the masspoints are rejected
+    ASSERT_TRUE(MeshCache::save(filename, key, positions, {0, 1, 7}, uvs, r, r, areas, offsets, ids));
+    EXPECT_FALSE(cache.load(filename, key));
+    ASSERT_TRUE(MeshCache::save(filename, key, positions, {0, 1, 2}, uvs, r, r, areas, {0, 6, 3, 9}, ids));
+    EXPECT_FALSE(cache.load(filename, key));
+    ASSERT_TRUE(MeshCache::save(filename, key, positions, {0, 1, 2}, uvs, r, r, areas, {0, 3, 6, 8}, ids));
+    EXPECT_FALSE(cache.load(filename, key));
+    ids[4] = 3;
+    ASSERT_TRUE(MeshCache::save(filename, key, positions, {0, 1, 2}, uvs, r, r, areas, offsets, ids));
+    EXPECT_FALSE(cache.load(filename, key));
+    // and a cloth falls back to parsing the obj
+    Cloth c(WOOL);
+    c.init(filename, toParamXZ, {}, 2.0f);
+    EXPECT_TRUE(c.numMasses() == 3);
+    EXPECT_TRUE(c.numTriangles() == 1);
+    std::remove(MeshCache::cachePath(filename).c_str());
+    std::remove(filename.c_str());
+}
+
 TEST(ClothInterface,dfltctor)
 {
     ClothInterface ci("../gnatvCloth/obj/");
@@ -297,6 +417,30 @@ TEST(ClothInterface,userctor)
     EXPECT_TRUE(ci.fixPointSetup() == CORNERS);
 }
 
+TEST(ClothInterface,explicitStep)
+{
+    // the interface's fixed step is past what the explicit methods take in one go, so it sub-steps
+    for(auto method : {SYMPLECTIC_EULER, VERLET})
+    {
+        ClothInterface ci(method, LRXZ, HANG, "../gnatvCloth/obj/");
+        for(size_t i = 0; i < 250; ++i)
+        {
+            ci.updateCloth(0.01f);
+        }
+        for(size_t i = 0; i < ci.numClothPts(); ++i)
+        {
+            EXPECT_TRUE(std::isfinite(ci.clothPtPos(i).length()));
+        }
+    }
+    // and a cloth that blows up anyway fills with NaN rather than throwing out of the force threads
+    ClothGrid grid(5, 5, PLANE_XY, 1.0f, 1.0f);
+    Cloth c(WOOL);
+    c.init(grid, grid.corners(), 9.0f);
+    c.setPosAtPoint(12, ngl::Vec3(std::numeric_limits<float>::infinity(), 0.0f, 0.0f));
+    c.setStableSubsteps(true);
+    EXPECT_NO_THROW(c.update(0.01f, VERLET, true));
+}
+
 TEST(ClothInterface,setters)
 {
     ClothInterface ci("../gnatvCloth/obj/");
@@ -311,3 +455,1055 @@ TEST(ClothInterface,setters)
     EXPECT_TRUE(ci.numClothPts() == 1024);
     EXPECT_TRUE(ci.numClothTris() == 1922);
 }
+
+TEST(ClothInterface,writeOutCloth)
+{
+    auto dir = (std::filesystem::temp_directory_path() / "gnatvClothWriteOut").string();
+    std::filesystem::remove_all(dir);
+    ClothInterface ci("../gnatvCloth/obj/");
+    ci.setWriteOutPath(dir, "test");
+    EXPECT_TRUE(ci.writeOutDirectory() == dir);
+    EXPECT_TRUE(ci.writeOutPrefix() == "test");
+    for(size_t i = 0; i < 3; ++i)
+    {
+        ci.writeOutCloth();
+        ci.updateCloth(0.01f);
+    }
+    ci.stopWriteOut();
+    // every frame should be a complete obj of the cloth
+    for(size_t i = 0; i < 3; ++i)
+    {
+        std::ifstream in(dir + "/test.000" + std::to_string(i) + ".obj");
+        EXPECT_TRUE(in.is_open());
+        size_t numV = 0, numVt = 0, numVn = 0, numF = 0;
+        std::string line;
+        while(std::getline(in, line))
+        {
+            if(line.rfind("v ", 0) == 0) ++numV;
+            else if(line.rfind("vt ", 0) == 0) ++numVt;
+            else if(line.rfind("vn ", 0) == 0) ++numVn;
+            else if(line.rfind("f ", 0) == 0) ++numF;
+        }
+        EXPECT_TRUE(numV == 289);
+        EXPECT_TRUE(numVt == 289);
+        EXPECT_TRUE(numVn == 289);
+        EXPECT_TRUE(numF == 512);
+    }
+    std::filesystem::remove_all(dir);
+}
+
+TEST(ObjSequenceWriter,countsFailedFrames)
+{
+    auto dir = (std::filesystem::temp_directory_path() / "gnatvClothSequence").string();
+    std::filesystem::remove_all(dir);
+    std::vector<ngl::Vec3> pts = {ngl::Vec3(0.0f), ngl::Vec3(1.0f, 0.0f, 0.0f), ngl::Vec3(0.0f, 0.0f, 1.0f)};
+    std::vector<ngl::Vec2> uvs = {ngl::Vec2(0.0f, 0.0f), ngl::Vec2(1.0f, 0.0f), ngl::Vec2(0.0f, 1.0f)};
+    ObjSequenceWriter writer;
+    writer.start(dir, "tri", uvs, {0, 1, 2});
+    writer.submit(0, pts, pts);
+    writer.submit(1, pts, pts);
+    writer.stop();
+    EXPECT_TRUE(writer.framesWritten() == 2);
+    EXPECT_TRUE(writer.framesFailed() == 0);
+    EXPECT_TRUE(std::filesystem::exists(writer.frameFilename(1)));
+    // a file where the directory should be fails every frame, and none count as written
+    auto blocked = dir + "/blocked";
+    std::ofstream(blocked) << "not a directory\n";
+    writer.start(blocked, "tri", uvs, {0, 1, 2});
+    writer.submit(0, pts, pts);
+    writer.submit(1, pts, pts);
+    writer.stop();
+    EXPECT_TRUE(writer.framesWritten() == 0);
+    EXPECT_TRUE(writer.framesFailed() == 2);
+    std::filesystem::remove_all(dir);
+}
+
+TEST(PointCache,recordAndSeek)
+{
+    auto filename = (std::filesystem::temp_directory_path() / "gnatvClothTest.pc").string();
+    ClothInterface ci(CGM, LRXZ, HANG, "../gnatvCloth/obj/");
+    EXPECT_TRUE(ci.startRecording(filename));
+    EXPECT_TRUE(ci.isRecording());
+    std::vector<std::vector<ngl::Vec3>> frames;
+    frames.push_back({});
+    for(size_t i = 0; i < ci.numClothPts(); ++i)
+    {
+        frames.back().push_back(ci.clothPtPos(i));
+    }
+    for(size_t f = 0; f < 5; ++f)
+    {
+        ci.updateCloth(0.01f);
+        frames.push_back({});
+        for(size_t i = 0; i < ci.numClothPts(); ++i)
+        {
+            frames.back().push_back(ci.clothPtPos(i));
+        }
+    }
+    ci.stopRecording();
+    EXPECT_FALSE(ci.isRecording());
+    // decode frames out of order, each within quantization error of what was recorded
+    PointCacheReader reader;
+    EXPECT_TRUE(reader.open(filename));
+    EXPECT_TRUE(reader.numPoints() == 289);
+    EXPECT_TRUE(reader.numTriangles() == 512);
+    EXPECT_TRUE(reader.numFrames() == 6);
+    std::vector<ngl::Vec3> decoded;
+    for(size_t f : {4, 0, 5, 2})
+    {
+        EXPECT_TRUE(reader.readFrame(f, decoded));
+        for(size_t i = 0; i < decoded.size(); ++i)
+        {
+            EXPECT_NEAR(decoded[i].m_x, frames[f][i].m_x, 1e-4f);
+            EXPECT_NEAR(decoded[i].m_y, frames[f][i].m_y, 1e-4f);
+            EXPECT_NEAR(decoded[i].m_z, frames[f][i].m_z, 1e-4f);
+        }
+    }
+    EXPECT_FALSE(reader.readFrame(6, decoded));
+    reader.close();
+    std::remove(filename.c_str());
+}
+
+TEST(ClothRenderMesh,indexedRender)
+{
+    ClothInterface ci(CGM, LRXZ, HANG, "../gnatvCloth/obj/");
+    ClothRenderMesh mesh;
+    ci.renderCloth(mesh);
+    EXPECT_TRUE(mesh.version() == ci.topologyVersion());
+    EXPECT_TRUE(mesh.indices().size() == 512*3);
+    EXPECT_TRUE(mesh.numVertices() >= 289);
+    EXPECT_TRUE(mesh.uvs().size() == mesh.numVertices()*2);
+    EXPECT_TRUE(mesh.stream().size() == mesh.numVertices()*ClothRenderMesh::c_streamStride);
+    // streamed positions follow the cloth, static data stays put
+    ci.updateCloth(0.01f);
+    auto version = mesh.version();
+    ci.renderCloth(mesh);
+    EXPECT_TRUE(mesh.version() == version);
+    for(size_t v = 0; v < mesh.numVertices(); ++v)
+    {
+        auto p = ci.clothPtPos(mesh.vertexToMassPoint()[v]);
+        EXPECT_TRUE(FCompare(mesh.stream()[v*6], p.m_x));
+        EXPECT_TRUE(FCompare(mesh.stream()[v*6 + 1], p.m_y));
+        EXPECT_TRUE(FCompare(mesh.stream()[v*6 + 2], p.m_z));
+    }
+    // reinitializing rebuilds
+    ci.initCloth();
+    ci.renderCloth(mesh);
+    EXPECT_TRUE(mesh.version() == ci.topologyVersion());
+    EXPECT_TRUE(mesh.version() != version);
+}
+
+TEST(Cloth,cachedNormals)
+{
+    std::vector<size_t> corners = {0, 1, 2, 3};
+    auto toParam = [](ngl::Vec3 _v) -> ngl::Vec2
+    {
+        ngl::Vec2 n;
+        n.m_x = _v.m_x;
+        n.m_y = _v.m_z;
+        return n;
+    };
+    Cloth c(WOOL);
+    c.init("../gnatvCloth/obj/clothLowResXZ.obj", toParam, corners, 2.0f);
+    // flat XZ cloth, every normal points along y
+    auto &n = c.normals();
+    EXPECT_TRUE(n.size() == 289);
+    for(auto v : n)
+    {
+        EXPECT_TRUE(FCompare(std::abs(v.m_y), 1.0f));
+    }
+    // same buffer handed back until the cloth moves
+    EXPECT_TRUE(&c.normals() == &n);
+    // moving a point marks the normals dirty, and they match a cloth that never cached them
+    std::vector<ngl::Vec3> before(n.begin(), n.end());
+    auto moved = c.posAtPoint(144) + ngl::Vec3(0.0f, 0.5f, 0.0f);
+    c.setPosAtPoint(144, moved);
+    Cloth fresh(WOOL);
+    fresh.init("../gnatvCloth/obj/clothLowResXZ.obj", toParam, corners, 2.0f);
+    fresh.setPosAtPoint(144, moved);
+    size_t changed = 0;
+    for(size_t i = 0; i < before.size(); ++i)
+    {
+        auto v = c.normals()[i];
+        auto f = fresh.normals()[i];
+        EXPECT_TRUE(FCompare(v.m_x, f.m_x) && FCompare(v.m_y, f.m_y) && FCompare(v.m_z, f.m_z));
+        if(!FCompare(v.m_y, before[i].m_y))
+        {
+            ++changed;
+        }
+    }
+    EXPECT_TRUE(changed > 0);
+}
+
+TEST(TripleBuffer,latestWins)
+{
+    TripleBuffer<int> tb;
+    EXPECT_FALSE(tb.update());
+    for(int i = 1; i <= 3; ++i)
+    {
+        tb.writeBuffer() = i;
+        tb.publish();
+    }
+    // frames the reader missed are dropped, it only ever sees the newest
+    EXPECT_TRUE(tb.update());
+    EXPECT_TRUE(tb.readBuffer() == 3);
+    EXPECT_FALSE(tb.update());
+    EXPECT_TRUE(tb.readBuffer() == 3);
+}
+
+TEST(ClothInterface,simThread)
+{
+    ClothInterface ci(CGM, LRXZ, HANG, "../gnatvCloth/obj/");
+    std::vector<ngl::Vec3> start;
+    for(size_t i = 0; i < ci.numClothPts(); ++i)
+    {
+        start.push_back(ci.clothPtPos(i));
+    }
+    ci.startSimThread(0.01f);
+    EXPECT_TRUE(ci.simThreadRunning());
+    // changes made while running are applied between steps
+    ci.setWindState(true);
+    ci.setIntMethod(RK4);
+    ClothRenderMesh mesh;
+    ci.renderCloth(mesh);
+    EXPECT_TRUE(mesh.indices().size() == 512*3);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    ci.renderCloth(mesh);
+    // what the sim thread reads every step can't be swapped out under it
+    auto cacheFile = (std::filesystem::temp_directory_path() / "gnatvClothRunning.pc").string();
+    EXPECT_FALSE(ci.startRecording(cacheFile));
+    EXPECT_FALSE(ci.startTelemetry(cacheFile));
+    EXPECT_FALSE(ci.runForceTests({FORCE_TEST_WEFT}, cacheFile));
+    // and the memory breakdown is worked out between steps
+    std::ostringstream memory;
+    ci.printMemoryUsage(memory);
+    auto traceFile = (std::filesystem::temp_directory_path() / "gnatvClothRunningTrace.json").string();
+    std::remove(traceFile.c_str());
+    ci.writeProfileTrace(traceFile);
+    ci.stopSimThread();
+    EXPECT_FALSE(memory.str().empty());
+    EXPECT_TRUE(std::filesystem::exists(traceFile));
+    std::remove(traceFile.c_str());
+    EXPECT_FALSE(ci.simThreadRunning());
+    EXPECT_TRUE(ci.isWindOn());
+    EXPECT_TRUE(ci.intMethod() == RK4);
+    size_t moved = 0;
+    for(size_t i = 0; i < start.size(); ++i)
+    {
+        if(!FCompare(ci.clothPtPos(i).m_y, start[i].m_y))
+        {
+            ++moved;
+        }
+    }
+    EXPECT_TRUE(moved > 0);
+    // a reinit queued while running rebuilds the topology the renderer sees
+    ci.startSimThread(0.01f);
+    ci.setConfig(HRXZ);
+    ci.fixClothPts();
+    for(size_t i = 0; i < 500 && mesh.indices().size() != 1922*3; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        ci.renderCloth(mesh);
+    }
+    ci.stopSimThread();
+    EXPECT_TRUE(ci.numClothPts() == 1024);
+    EXPECT_TRUE(mesh.indices().size() == 1922*3);
+}
+
+TEST(SceneDescription,load)
+{
+    auto filename = (std::filesystem::temp_directory_path() / "gnatvClothTest.scene").string();
+    {
+        std::ofstream out(filename);
+        out << "# test scene\n";
+        out << "mesh " << std::filesystem::absolute("../gnatvCloth/obj/clothLowResXZ.obj").string() << '\n';
+        out << "plane xz\nmaterial jute\nintegrator rk4\n";
+        out << "dt 0.005\nsteps 3\ndamping 4.5\n";
+        out << "fixed 2 3   # hang\n";
+        out << "wind 2.0 0.0 1.0\n";
+        out << "selfcollision 0.05\n";
+        out << "jacobianreuse 0.002\n";
+        out << "obstacle table.obj 0.2\n";
+    }
+    SceneDescription scene;
+    std::string error;
+    EXPECT_TRUE(scene.load(filename, error));
+    EXPECT_FALSE(scene.planeXY);
+    EXPECT_TRUE(scene.material == JUTE);
+    EXPECT_TRUE(scene.integrator == RK4);
+    EXPECT_FLOAT_EQ(scene.dt, 0.005f);
+    EXPECT_TRUE(scene.steps == 3);
+    EXPECT_FLOAT_EQ(scene.damping, 4.5f);
+    EXPECT_TRUE(scene.fixedPoints == std::vector<size_t>({2, 3}));
+    EXPECT_TRUE(scene.windOn);
+    EXPECT_TRUE(scene.selfCollision);
+    EXPECT_FLOAT_EQ(scene.collisionThickness, 0.05f);
+    EXPECT_TRUE(scene.jacobianReuse);
+    EXPECT_FLOAT_EQ(scene.reuseTolerance, 0.002f);
+    ASSERT_TRUE(scene.obstacles.size() == 1);
+    EXPECT_FLOAT_EQ(scene.obstacles[0].cellSize, 0.2f);
+    // obstacle meshes are found next to the scene, this one doesn't exist
+    EXPECT_TRUE(scene.obstacles[0].mesh == (std::filesystem::temp_directory_path() / "table.obj").string());
+    EXPECT_TRUE(scene.loadObstacles(error).empty());
+    EXPECT_TRUE(error.find("table.obj") != std::string::npos);
+    scene.obstacles.clear();
+    // the scene drives a ClothInterface with no enum config
+    ClothInterface ci(scene);
+    EXPECT_TRUE(ci.initConfig() == SCENE);
+    EXPECT_TRUE(ci.intMethod() == RK4);
+    EXPECT_TRUE(ci.isWindOn());
+    EXPECT_TRUE(ci.isSelfCollisionOn());
+    EXPECT_TRUE(ci.isJacobianReuseOn());
+    EXPECT_TRUE(ci.numClothPts() == 289);
+    auto held = ci.clothPtPos(2);
+    for(size_t i = 0; i < scene.steps; ++i)
+    {
+        ci.updateCloth(scene.dt);
+    }
+    EXPECT_TRUE(ci.clothPtPos(2) == held);
+    // rk4 has no system to keep, switching to cgm starts counting
+    ci.setIntMethod(CGM);
+    ci.updateCloth(scene.dt);
+    ci.updateCloth(scene.dt);
+    EXPECT_TRUE(ci.jacobianReuseStats().reused + ci.jacobianReuseStats().rebuilt == 2);
+    ci.setJacobianReuse(false);
+    EXPECT_FALSE(ci.isJacobianReuseOn());
+    // bad lines are reported with their line number
+    {
+        std::ofstream out(filename);
+        out << "mesh cloth.obj\nplane yz\n";
+    }
+    SceneDescription badScene;
+    EXPECT_FALSE(badScene.load(filename, error));
+    EXPECT_TRUE(error.find(":2:") != std::string::npos);
+    std::remove(filename.c_str());
+}
+
+TEST(ClothGrid,generate)
+{
+    ClothGrid grid(17, 17, PLANE_XZ);
+    EXPECT_TRUE(grid.positions().size() == 289);
+    EXPECT_TRUE(grid.indices().size() == 512*3);
+    // fixed point sets follow the FixPtTestDefaults layout
+    EXPECT_TRUE(grid.corners() == std::vector<size_t>({0, 16, 272, 288}));
+    EXPECT_TRUE(grid.weftHold().size() == 15);
+    EXPECT_TRUE(grid.weftHold()[0] == 17);
+    EXPECT_TRUE(grid.warpPull()[0] == 273);
+    EXPECT_TRUE(grid.fixPoints().size() == lowResXZFixpts.size());
+    EXPECT_TRUE(grid.uvs()[288] == ngl::Vec2(1.0f, 1.0f));
+    // feeds straight into a cloth, no obj needed
+    Cloth c(WOOL);
+    c.init(grid, grid.fixPoints(), 9.0f);
+    EXPECT_TRUE(c.numMasses() == 289);
+    EXPECT_TRUE(c.numTriangles() == 512);
+    for(auto n : c.normals())
+    {
+        EXPECT_TRUE(FCompare(n.m_y, 1.0f));
+    }
+    c.fixCorners({0, 0, 1, 1});
+    for(size_t i = 0; i < 10; ++i)
+    {
+        c.update(0.01f, CGM, true, std::vector<ngl::Vec3>(c.numMasses()));
+    }
+    EXPECT_TRUE(c.posAtPoint(288) == grid.positions()[288]);
+    EXPECT_TRUE(c.posAtPoint(0).m_y < 0.0f);
+}
+
+TEST(Profiler,ringAndTrace)
+{
+    auto &profiler = Profiler::instance();
+    profiler.clear();
+    {
+        ProfileScope scope("outer");
+        ProfileScope inner("inner");
+    }
+    auto events = profiler.events();
+    ASSERT_TRUE(events.size() == 2);
+    EXPECT_TRUE(std::string(events[0].name) == "inner");
+    EXPECT_TRUE(events[1].start <= events[0].start);
+    EXPECT_TRUE(events[1].duration >= events[0].duration);
+    // once full the ring keeps only the newest events
+    for(size_t i = 0; i < profiler.capacity(); ++i)
+    {
+        profiler.record("fill", i, 1);
+    }
+    events = profiler.events();
+    EXPECT_TRUE(events.size() == profiler.capacity());
+    EXPECT_TRUE(events.front().start == 0 && events.back().start == profiler.capacity() - 1);
+    // chrome trace export
+    profiler.clear();
+    profiler.record("step", 1000, 2000);
+    std::string filename = "profilerTest.json";
+    ASSERT_TRUE(profiler.writeChromeTrace(filename));
+    std::ifstream in(filename);
+    std::string trace((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    EXPECT_TRUE(trace.find("\"name\":\"step\"") != std::string::npos);
+    EXPECT_TRUE(trace.find("\"ph\":\"X\",\"ts\":1.000,\"dur\":2.000") != std::string::npos);
+    std::remove(filename.c_str());
+    profiler.clear();
+}
+
+TEST(SolverTelemetry,recordSteps)
+{
+    Cloth c(WOOL);
+    c.init("../gnatvCloth/obj/clothLowResXZ.obj", toParamXZ, lowResXZFixpts, 9.0f);
+    c.fixCorners({0, 0, 1, 1});
+    SolverTelemetry telemetry;
+    c.setSolverTelemetry(&telemetry);
+    std::string filename = "telemetryTest.bin";
+    ASSERT_TRUE(telemetry.open(filename, SolverTelemetry::BINARY));
+    for(size_t i = 0; i < 3; ++i)
+    {
+        c.update(0.01f, CGM, true, std::vector<ngl::Vec3>(c.numMasses()));
+    }
+    // rk4 steps don't touch the solver
+    c.update(0.001f, RK4, true, std::vector<ngl::Vec3>(c.numMasses()));
+    EXPECT_TRUE(telemetry.numSteps() == 3);
+    telemetry.close();
+    std::vector<SolverStepStats> steps;
+    ASSERT_TRUE(SolverTelemetry::readBinary(filename, steps));
+    ASSERT_TRUE(steps.size() == 3);
+    for(auto &s : steps)
+    {
+        EXPECT_TRUE(s.masspoints == 289);
+        EXPECT_FLOAT_EQ(s.h, 0.01f);
+        EXPECT_TRUE(s.iterations > 0);
+        EXPECT_TRUE(s.residuals.size() == s.iterations + 1);
+        EXPECT_TRUE(s.preconMin > 0.0f && s.preconMin <= s.preconMax);
+        // a converged solve ends below the tolerance
+        EXPECT_TRUE(s.capped || s.residuals.back() < 1e-5f * s.rstest);
+    }
+    std::remove(filename.c_str());
+}
+
+TEST(Cloth,memoryUsage)
+{
+    Cloth c(WOOL);
+    EXPECT_TRUE(c.memoryUsage().bytesPerMasspoint() == 0.0);
+    EXPECT_TRUE(c.memoryUsage().materialTables > 0);
+    c.init("../gnatvCloth/obj/clothLowResXZ.obj", toParamXZ, lowResXZFixpts, 9.0f);
+    auto usage = c.memoryUsage();
+    EXPECT_TRUE(usage.numMasses == 289);
+    EXPECT_TRUE(usage.massPoints >= 289 * sizeof(MassPoint));
+    EXPECT_TRUE(usage.renderBuffers > 0);
+    // every masspoint has at least its own jacobian, which costs more than the matrices alone
+    EXPECT_TRUE(usage.jacobians > 289 * 2 * sizeof(ngl::Mat3));
+    EXPECT_TRUE(usage.total() == usage.massPoints + usage.triangles + usage.jacobians +
+                                 usage.solverWorkspaces + usage.materialTables + usage.renderBuffers);
+    std::ostringstream out;
+    usage.print(out);
+    EXPECT_TRUE(out.str().find("jacobians") != std::string::npos);
+    {
+        // a copy shares the rest mesh, so each is charged part of it, and both still step
+        Cloth copy = c;
+        EXPECT_TRUE(c.memoryUsage().triangles < usage.triangles);
+        auto held = c.posAtPoint(144);
+        copy.update(0.005f, CGM, true);
+        EXPECT_TRUE(copy.posAtPoint(144).m_y < held.m_y);
+        EXPECT_TRUE(c.posAtPoint(144).m_y == held.m_y);
+    }
+    EXPECT_TRUE(c.memoryUsage().triangles == usage.triangles);
+    {
+        // only implicit steps keep a preconditioner and need the CG temporaries
+        Cloth stepped = c;
+        stepped.update(0.001f, SYMPLECTIC_EULER, true);
+        auto explicitWorkspace = stepped.memoryUsage().solverWorkspaces;
+        stepped.update(0.001f, CGM, true);
+        EXPECT_TRUE(stepped.memoryUsage().solverWorkspaces >= explicitWorkspace + 289 * (2 * sizeof(ngl::Mat3) + 14 * sizeof(ngl::Vec3)));
+        stepped.update(0.001f, SYMPLECTIC_EULER, true);
+        EXPECT_TRUE(stepped.memoryUsage().solverWorkspaces < explicitWorkspace + 289 * (2 * sizeof(ngl::Mat3) + 14 * sizeof(ngl::Vec3)));
+    }
+    c.clear();
+    EXPECT_TRUE(c.memoryUsage().jacobians == 0);
+}
+
+TEST(ClothEnsemble,sweep)
+{
+    SceneDescription scene;
+    scene.mesh = "../gnatvCloth/obj/clothLowResXZ.obj";
+    scene.steps = 5;
+    scene.fixedPoints = {2, 3};
+    scene.sweepDamping = {3.0f, 9.0f};
+    scene.sweepMaterial = {WOOL, JUTE};
+    scene.sweepWind = {0.0f, 0.5f};
+    EXPECT_TRUE(scene.isSweep());
+    auto cases = ClothEnsemble::casesFromScene(scene);
+    ASSERT_TRUE(cases.size() == 8);
+    EXPECT_TRUE(cases[7].material == JUTE && cases[7].damping == 9.0f && cases[7].windStrength == 0.5f);
+    ClothEnsemble ensemble(scene);
+    auto results = ensemble.run(cases, 4);
+    ASSERT_TRUE(results.size() == cases.size());
+    for(auto &r : results)
+    {
+        EXPECT_TRUE(r.stable);
+        EXPECT_TRUE(r.stepsRun == 5);
+        // the cloth hangs from two corners, so something has fallen
+        EXPECT_TRUE(r.lowestY < 0.0f);
+    }
+    // each run matches the same case run on its own
+    Cloth c(JUTE);
+    c.init(scene.mesh, toParamXZ, scene.fixedPoints, 9.0f);
+    c.fixCorners({1, 1});
+    c.setWind(WindField(scene.wind * 0.5f));
+    std::vector<ngl::Vec3> externalf(c.numMasses());
+    for(size_t i = 0; i < scene.steps; ++i)
+    {
+        c.update(scene.dt, CGM, true, externalf);
+    }
+    float lowest = c.posAtPoint(0).m_y;
+    for(size_t i = 0; i < c.numMasses(); ++i)
+    {
+        lowest = std::min(lowest, c.posAtPoint(i).m_y);
+    }
+    EXPECT_FLOAT_EQ(results[7].lowestY, lowest);
+}
+
+TEST(ForceDisplacementTest,weftWarpShear)
+{
+    std::vector<ForceTestResult> results;
+    for(auto type : {FORCE_TEST_WEFT, FORCE_TEST_WARP, FORCE_TEST_SHEAR})
+    {
+        auto setup = ForceTestSetup::standard(type, "../gnatvCloth/obj/");
+        // a couple of dynamic levels keeps the test quick
+        setup.mode = FORCE_TEST_DYNAMIC;
+        setup.forces = {0.0f, setup.forces.back()};
+        results.push_back(runForceTest(setup, WOOL, 2));
+        auto &r = results.back();
+        ASSERT_TRUE(r.levels.size() == 2);
+        EXPECT_TRUE(r.levels[0].stable && r.levels[1].stable);
+        EXPECT_TRUE(FCompare(r.levels[0].displacement, 0.0f));
+        // pulling moves the edge the way it's pulled
+        EXPECT_TRUE(r.levels[1].displacement > 0.0f);
+    }
+    EXPECT_TRUE(results[0].masspoints == 182 && results[1].masspoints == 1024);
+    std::string filename = "forceTestResults.csv";
+    ASSERT_TRUE(writeForceTestResults(results, filename));
+    std::ifstream in(filename);
+    std::string line;
+    size_t rows = 0;
+    while(std::getline(in, line))
+    {
+        ++rows;
+    }
+    EXPECT_TRUE(rows == 7);
+    std::remove(filename.c_str());
+}
+
+TEST(Cloth,solveStatic)
+{
+    // step the weft test's first few loads up to equilibrium
+    auto setup = ForceTestSetup::standard(FORCE_TEST_WEFT, "../gnatvCloth/obj/");
+    EXPECT_TRUE(setup.mode == FORCE_TEST_STATIC);
+    setup.forces = {0.0f, 2.0f, 5.0f, 10.0f};
+    auto r = runForceTest(setup, WOOL);
+    ASSERT_TRUE(r.levels.size() == 4);
+    EXPECT_TRUE(r.levels[0].newtonIterations == 0);
+    for(size_t i = 1; i < r.levels.size(); ++i)
+    {
+        EXPECT_TRUE(r.levels[i].stable);
+        EXPECT_TRUE(r.levels[i].residual <= setup.tolerance);
+        EXPECT_TRUE(r.levels[i].displacement > r.levels[i - 1].displacement);
+    }
+    // solving again from equilibrium has nothing left to do
+    Cloth c(WOOL);
+    c.init(setup.mesh, setup.toParam, setup.held, 9.0f);
+    c.fixCorners(std::vector<bool>(setup.held.size(), true));
+    std::vector<ngl::Vec3> externalf(c.numMasses());
+    for(auto k : setup.pulled)
+    {
+        externalf[k] = setup.direction * 2.0f;
+    }
+    auto first = c.solveStatic(false, externalf, 1e-2f);
+    EXPECT_TRUE(first.converged);
+    EXPECT_TRUE(first.newtonIterations > 0);
+    EXPECT_TRUE(FCompare(c.velAtPoint(setup.pulled[0]).length(), 0.0f));
+    auto again = c.solveStatic(false, externalf, 1e-2f);
+    EXPECT_TRUE(again.converged);
+    EXPECT_TRUE(again.newtonIterations == 0);
+}
+
+TEST(MaterialCalibration,recoverWeft)
+{
+    // measure a stiffer wool, then fit wool's weft curve back to it
+    MaterialData truth = MaterialData::standard(WOOL);
+    for(auto &y : truth.weft.data)
+    {
+        y *= 1.5f;
+    }
+    CalibrationTarget target;
+    target.setup = ForceTestSetup::standard(FORCE_TEST_WEFT, "../gnatvCloth/obj/");
+    target.setup.forces = {0.0f, 1.0f, 2.0f, 5.0f, 10.0f};
+    for(auto &level : runForceTest(target.setup, truth).levels)
+    {
+        target.displacements.push_back(level.displacement);
+    }
+    CalibrationSettings settings;
+    settings.fitWarp = false;
+    settings.maxIterations = 6;
+    auto r = calibrateMaterial(MaterialData::standard(WOOL), {target}, settings);
+    EXPECT_TRUE(r.levelsUsed == 5);
+    EXPECT_TRUE(r.errors.back() < 0.1f * r.errors.front());
+    // the low strain values the test reaches come back, warp is untouched
+    EXPECT_TRUE(std::abs(r.material.weft.data[1] - truth.weft.data[1]) < 0.05f * truth.weft.data[1]);
+    EXPECT_TRUE(r.material.warp.data == MaterialData::standard(WOOL).warp.data);
+    EXPECT_TRUE(Cloth(r.material).material() == CUSTOM);
+}
+
+TEST(Cloth,selfCollision)
+{
+    // a grid folded in half along its middle column, the top half falling onto the bottom
+    ClothGrid grid(17, 9, PLANE_XZ);
+    auto fold = [&grid](Cloth &_c)
+    {
+        for(size_t i = 0; i < grid.positions().size(); ++i)
+        {
+            size_t col = i % 17;
+            if(col > 8)
+            {
+                auto mirror = grid.positions()[i - col + 16 - col];
+                _c.setPosAtPoint(i, ngl::Vec3(mirror.m_x, 0.3f, mirror.m_z));
+                _c.setVelAtPoint(i, ngl::Vec3(0.0f, -5.0f, 0.0f));
+            }
+            else if(col == 8)
+            {
+                _c.setPosAtPoint(i, grid.positions()[i] + ngl::Vec3(0.0f, 0.15f, 0.0f));
+            }
+        }
+    };
+    // lowest gap between the inner points and the ones they're folded onto
+    auto minGap = [](const Cloth &_c)
+    {
+        float gap = std::numeric_limits<float>::max();
+        for(size_t row = 1; row < 8; ++row)
+        {
+            for(size_t col = 10; col < 16; ++col)
+            {
+                gap = std::min(gap, _c.posAtPoint(row * 17 + col).m_y - _c.posAtPoint(row * 17 + 16 - col).m_y);
+            }
+        }
+        return gap;
+    };
+    Cloth free(WOOL);
+    free.init(grid, grid.corners(), 9.0f);
+    fold(free);
+    Cloth colliding(WOOL);
+    colliding.init(grid, grid.corners(), 9.0f);
+    colliding.setSelfCollision(true);
+    EXPECT_TRUE(colliding.selfCollision());
+    EXPECT_TRUE(colliding.collisionThickness() > 0.0f && colliding.collisionThickness() < 0.3f);
+    EXPECT_TRUE(colliding.memoryUsage().solverWorkspaces > free.memoryUsage().solverWorkspaces);
+    fold(colliding);
+    for(size_t i = 0; i < 20; ++i)
+    {
+        free.update(0.01f, CGM, false, std::vector<ngl::Vec3>(free.numMasses()));
+        colliding.update(0.01f, CGM, false, std::vector<ngl::Vec3>(colliding.numMasses()));
+    }
+    EXPECT_TRUE(minGap(free) < 0.0f);
+    EXPECT_FALSE(colliding.contacts().empty());
+    EXPECT_TRUE(minGap(colliding) > 0.5f * colliding.collisionThickness());
+}
+
+TEST(Obstacle,distanceAndDrape)
+{
+    // a 4 x 2 x 4 box with its top at y = -1, faces wound outwards
+    auto filename = (std::filesystem::temp_directory_path() / "gnatvClothObstacle.obj").string();
+    std::remove(Obstacle::cachePath(filename).c_str());
+    {
+        std::ofstream obj(filename);
+        obj << "v -2 -3 -2\nv 2 -3 -2\nv 2 -1 -2\nv -2 -1 -2\n"
+            << "v -2 -3 2\nv 2 -3 2\nv 2 -1 2\nv -2 -1 2\n"
+            << "f 1 4 3 2\nf 5 6 7 8\nf 1 5 8 4\nf 2 3 7 6\nf 4 8 7 3\nf 1 2 6 5\n";
+    }
+    auto box = std::make_shared<Obstacle>();
+    ASSERT_TRUE(box->load(filename, 0.1f));
+    EXPECT_FALSE(box->loadedFromCache());
+    ngl::Vec3 normal;
+    EXPECT_TRUE(std::abs(box->distance(ngl::Vec3(0.0f, -0.8f, 0.0f), normal) - 0.2f) < 0.02f);
+    EXPECT_TRUE(normal.m_y > 0.99f);
+    EXPECT_TRUE(std::abs(box->distance(ngl::Vec3(0.0f, -2.0f, 0.0f), normal) + 1.0f) < 0.02f);
+    EXPECT_TRUE(box->distance(ngl::Vec3(0.0f, 5.0f, 0.0f), normal) == std::numeric_limits<float>::max());
+    // a second load reads the same grid back from the cache
+    Obstacle cached;
+    ASSERT_TRUE(cached.load(filename, 0.1f));
+    EXPECT_TRUE(cached.loadedFromCache());
+    EXPECT_TRUE(FCompare(cached.distance(ngl::Vec3(0.3f, -0.8f, 0.1f), normal),
+                         box->distance(ngl::Vec3(0.3f, -0.8f, 0.1f), normal)));
+    // faces naming vertices that aren't there, or that aren't numbers, fail the load
+    auto badFilename = (std::filesystem::temp_directory_path() / "gnatvClothBadObstacle.obj").string();
+    for(auto face : {"f 0 1 2", "f 1 2 9", "f 1 2 -4", "f a b c"})
+    {
+        std::remove(Obstacle::cachePath(badFilename).c_str());
+        {
+            std::ofstream obj(badFilename);
+            obj << "v 0 0 0\nv 1 0 0\nv 0 1 0\n" << face << '\n';
+        }
+        Obstacle bad;
+        EXPECT_FALSE(bad.load(badFilename, 0.1f));
+    }
+    std::remove(badFilename.c_str());
+
+    // a loose cloth dropped onto the box comes to rest on top of it
+    ClothGrid grid(9, 9, PLANE_XZ, 3.0f, 3.0f);
+    Cloth c(WOOL);
+    c.init(grid, {}, 9.0f);
+    for(size_t i = 0; i < c.numMasses(); ++i)
+    {
+        c.setPosAtPoint(i, c.posAtPoint(i) + ngl::Vec3(0.0f, -0.8f, 0.0f));
+    }
+    c.addObstacle(box);
+    EXPECT_TRUE(c.numObstacles() == 1);
+    for(size_t i = 0; i < 200; ++i)
+    {
+        c.update(0.01f, CGM, true, std::vector<ngl::Vec3>(c.numMasses()));
+    }
+    for(size_t i = 0; i < c.numMasses(); ++i)
+    {
+        EXPECT_TRUE(c.posAtPoint(i).m_y > -1.0f);
+        EXPECT_TRUE(c.obstacleDistance(i) > 0.5f * c.collisionThickness());
+        EXPECT_TRUE(c.obstacleDistance(i) < 1.5f * c.collisionThickness());
+    }
+    std::remove(filename.c_str());
+    std::remove(Obstacle::cachePath(filename).c_str());
+}
+
+TEST(ClothDrag,pickAndRelaxLocally)
+{
+    ClothGrid grid(33, 33, PLANE_XZ, 8.0f, 8.0f);
+    Cloth c(WOOL);
+    c.init(grid, grid.corners(), 9.0f);
+    c.fixCorners({true, true, true, true});
+    // rays from above hit the masspoint nearest to them, from either side, and can miss
+    const size_t middle = 16 * 33 + 16;
+    EXPECT_TRUE(c.pick(ngl::Vec3(0.05f, 5.0f, -0.05f), ngl::Vec3(0.0f, -1.0f, 0.0f)) == static_cast<long>(middle));
+    EXPECT_TRUE(c.pick(ngl::Vec3(0.05f, -5.0f, -0.05f), ngl::Vec3(0.0f, 1.0f, 0.0f)) == static_cast<long>(middle));
+    EXPECT_TRUE(c.pick(ngl::Vec3(9.0f, 5.0f, 0.0f), ngl::Vec3(0.0f, -1.0f, 0.0f)) == -1);
+    EXPECT_TRUE(c.ringNeighbourhood(middle, 1).size() == 7);
+    // dragging the middle up only moves the rings around it
+    std::vector<ngl::Vec3> before;
+    c.positions(before);
+    ClothDrag drag;
+    ASSERT_TRUE(drag.grab(c, ngl::Vec3(0.05f, 5.0f, -0.05f), ngl::Vec3(0.0f, -1.0f, 0.0f), 3));
+    EXPECT_TRUE(drag.point() == middle);
+    EXPECT_TRUE(c.fixedAtPoint(middle));
+    EXPECT_TRUE(drag.regionSize() == 37);
+    // the ray crosses the drag plane, y = 0, right above the point
+    drag.moveAlong(c, ngl::Vec3(0.0f, 5.0f, 0.0f), ngl::Vec3(0.25f, -5.0f, 0.0f));
+    EXPECT_TRUE(c.posAtPoint(middle) == ngl::Vec3(0.25f, 0.0f, 0.0f));
+    EXPECT_TRUE(drag.moveTo(c, ngl::Vec3(0.0f, 0.5f, 0.0f)).newtonIterations > 0);
+    EXPECT_TRUE(c.posAtPoint(middle) == ngl::Vec3(0.0f, 0.5f, 0.0f));
+    auto nearby = c.ringNeighbourhood(middle, 3);
+    std::vector<bool> inRegion(c.numMasses(), false);
+    for(auto i : nearby)
+    {
+        inRegion[i] = true;
+    }
+    EXPECT_TRUE(c.posAtPoint(middle + 1).m_y > 0.1f);
+    for(size_t i = 0; i < c.numMasses(); ++i)
+    {
+        if(!inRegion[i])
+        {
+            EXPECT_TRUE(c.posAtPoint(i) == before[i]);
+        }
+    }
+    drag.release(c);
+    EXPECT_FALSE(drag.active());
+    EXPECT_FALSE(c.fixedAtPoint(middle));
+    EXPECT_TRUE(c.fixedAtPoint(0));
+}
+
+TEST(WindField,gustsTurbulenceAndDrag)
+{
+    WindField still;
+    EXPECT_TRUE(still.still());
+    EXPECT_TRUE(still.velocity(ngl::Vec3(1.0f, 2.0f, 3.0f), 4.0f) == ngl::Vec3(0.0f));
+    // the field is a pure function of position, time and seed
+    WindField wind(ngl::Vec3(2.0f, 0.0f, 0.0f), 7);
+    WindField same(ngl::Vec3(2.0f, 0.0f, 0.0f), 7);
+    WindField other(ngl::Vec3(2.0f, 0.0f, 0.0f), 8);
+    ngl::Vec3 p(0.3f, -0.2f, 1.1f);
+    EXPECT_TRUE(wind.velocity(p, 1.5f) == same.velocity(p, 1.5f));
+    EXPECT_FALSE(wind.velocity(p, 1.5f) == other.velocity(p, 1.5f));
+    float lowest = 2.0f;
+    float highest = 0.0f;
+    for(size_t i = 0; i < 200; ++i)
+    {
+        float g = wind.gust(0.1f * i);
+        lowest = std::min(lowest, g);
+        highest = std::max(highest, g);
+        // turbulence never turns the wind around, and nearby points feel nearly the same wind
+        auto v = wind.velocity(p, 0.1f * i);
+        EXPECT_TRUE(v.m_x >= 0.0f);
+        EXPECT_TRUE((v - wind.velocity(p + ngl::Vec3(0.01f, 0.0f, 0.0f), 0.1f * i)).length() < 0.05f);
+    }
+    // the gusts rise and fall within 1 +- 0.5
+    EXPECT_TRUE(lowest >= 0.5f && highest <= 1.5f);
+    EXPECT_TRUE(highest - lowest > 0.3f);
+
+    // a cloth held by its corners billows downwind, and stays flat in still air
+    ClothGrid grid(9, 9, PLANE_XY, 1.0f, 1.0f);
+    Cloth blown(WOOL);
+    blown.init(grid, grid.corners(), 9.0f);
+    blown.fixCorners({1, 1, 1, 1});
+    Cloth calm = blown;
+    blown.setWind(WindField(ngl::Vec3(0.0f, 0.0f, 3.0f)));
+    std::vector<ngl::Vec3> externalf(blown.numMasses());
+    for(size_t i = 0; i < 50; ++i)
+    {
+        blown.update(0.01f, CGM, true, externalf);
+        calm.update(0.01f, CGM, true, externalf);
+    }
+    EXPECT_TRUE(FCompare(blown.time(), 0.5f));
+    float blownZ = 0.0f;
+    float calmZ = 0.0f;
+    for(size_t i = 0; i < blown.numMasses(); ++i)
+    {
+        blownZ += blown.posAtPoint(i).m_z;
+        calmZ += calm.posAtPoint(i).m_z;
+    }
+    EXPECT_TRUE(blownZ / blown.numMasses() > 1e-3f);
+    EXPECT_TRUE(std::abs(calmZ / calm.numMasses()) < 1e-3f);
+}
+
+TEST(ForceField,matchesExternalForces)
+{
+    std::vector<ngl::Vec3> values = {ngl::Vec3(1.0f, 2.0f, 3.0f), ngl::Vec3(4.0f, 5.0f, 6.0f)};
+    ArrayView<ngl::Vec3> view(values);
+    EXPECT_TRUE(view.size() == 2 && view.data() == values.data() && view[1] == values[1]);
+    EXPECT_TRUE(ArrayView<ngl::Vec3>().empty());
+    // the fields evaluate to what they describe
+    PointForce push(ngl::Vec3(0.0f), 2.0f, 1.0f);
+    EXPECT_TRUE(push.force(0, 0, ngl::Vec3(0.5f, 0.0f, 0.0f), ngl::Vec3(0.0f), 0.0f) == ngl::Vec3(1.0f, 0.0f, 0.0f));
+    EXPECT_TRUE(push.force(0, 0, ngl::Vec3(0.0f, 2.0f, 0.0f), ngl::Vec3(0.0f), 0.0f) == ngl::Vec3(0.0f));
+    SparseForces sparse({3, 7}, ngl::Vec3(1.0f));
+    sparse.setForce(1, ngl::Vec3(2.0f));
+    EXPECT_TRUE(sparse.sparse() && sparse.points().size() == 2 && sparse.points()[1] == 7);
+    EXPECT_TRUE(sparse.force(1, 7, ngl::Vec3(0.0f), ngl::Vec3(0.0f), 0.0f) == ngl::Vec3(2.0f));
+
+    // fields step the cloth exactly as the same forces passed in as an array
+    ClothGrid grid(9, 9, PLANE_XZ, 1.0f, 1.0f);
+    Cloth byArray(WOOL);
+    byArray.init(grid, grid.corners(), 9.0f);
+    byArray.fixCorners({1, 1});
+    Cloth byField = byArray;
+    std::vector<size_t> pulled = {40, 41};
+    ngl::Vec3 pull(0.0f, 0.5f, 0.0f);
+    ngl::Vec3 breeze(0.01f, 0.0f, 0.0f);
+    std::vector<ngl::Vec3> externalf(byArray.numMasses(), breeze);
+    for(auto k : pulled)
+    {
+        externalf[k] += pull;
+    }
+    auto uniform = std::make_shared<UniformForce>(ngl::Vec3(0.005f, 0.0f, 0.0f));
+    byField.addForceField(uniform);
+    byField.addForceField(std::make_shared<CallbackForce>([](size_t, const ngl::Vec3 &, const ngl::Vec3 &, float)
+    {
+        return ngl::Vec3(0.005f, 0.0f, 0.0f);
+    }));
+    byField.addForceField(std::make_shared<SparseForces>(pulled, pull));
+    EXPECT_TRUE(byField.numForceFields() == 3);
+    for(size_t i = 0; i < 10; ++i)
+    {
+        byArray.update(0.01f, i % 2 == 1 ? RK4 : CGM, true, externalf);
+        byField.update(0.01f, i % 2 == 1 ? RK4 : CGM, true);
+    }
+    for(size_t i = 0; i < byArray.numMasses(); ++i)
+    {
+        EXPECT_TRUE((byArray.posAtPoint(i) - byField.posAtPoint(i)).length() < 1e-5f);
+    }
+    byField.removeForceField(uniform.get());
+    EXPECT_TRUE(byField.numForceFields() == 2);
+    byField.clearForceFields();
+    EXPECT_TRUE(byField.numForceFields() == 0);
+}
+
+TEST(Cloth,explicitIntegrators)
+{
+    // a cloth hanging from two corners, stretched 3% so it has some stiffness to be unstable with
+    ClothGrid grid(9, 9, PLANE_XY, 1.0f, 1.0f);
+    Cloth start(WOOL);
+    start.init(grid, grid.corners(), 9.0f);
+    start.fixCorners({0, 0, 1, 1});
+    for(size_t i = 0; i < start.numMasses(); ++i)
+    {
+        if(!start.fixedAtPoint(i))
+        {
+            auto p = start.posAtPoint(i);
+            start.setPosAtPoint(i, ngl::Vec3(1.03f * p.m_x, 1.03f * p.m_y, p.m_z));
+        }
+    }
+    EXPECT_TRUE(start.stableTimestep(CGM) == std::numeric_limits<float>::max());
+    float rk4Step = start.stableTimestep(RK4);
+    EXPECT_TRUE(rk4Step > 1e-4f && rk4Step < 0.01f);
+    EXPECT_TRUE(start.stableTimestep(VERLET) < rk4Step);
+    // RK4 in tiny steps is the reference, every method sub-stepped to its stable step stays stable
+    // and near it (the stretched cloth rings fast enough that they only roughly agree after 0.2s)
+    Cloth reference = start;
+    for(size_t i = 0; i < 400; ++i)
+    {
+        reference.update(0.0005f, RK4, true);
+    }
+    for(auto method : {RK4, SYMPLECTIC_EULER, VERLET, RK45})
+    {
+        Cloth c = start;
+        c.setStableSubsteps(true);
+        for(size_t i = 0; i < 20; ++i)
+        {
+            c.update(0.01f, method, true);
+        }
+        EXPECT_TRUE(FCompare(c.time(), 0.2f));
+        float furthest = 0.0f;
+        for(size_t i = 0; i < c.numMasses(); ++i)
+        {
+            furthest = std::max(furthest, (c.posAtPoint(i) - reference.posAtPoint(i)).length());
+        }
+        EXPECT_TRUE(furthest < 0.2f) << "method " << method << " is " << furthest << " off";
+        if(method == RK45)
+        {
+            EXPECT_TRUE(c.adaptiveStats().accepted > 1);
+            EXPECT_TRUE(c.adaptiveStats().lastStep > 0.0f && c.adaptiveStats().lastStep <= 0.01f);
+        }
+    }
+    // the stage buffers are kept between steps
+    Cloth c = start;
+    c.update(0.01f, RK45, true);
+    auto workspace = c.memoryUsage().solverWorkspaces;
+    c.update(0.01f, RK45, true);
+    EXPECT_TRUE(c.memoryUsage().solverWorkspaces == workspace);
+}
+
+TEST(Cloth,evaluateForces)
+{
+    ClothGrid grid(7, 7, PLANE_XY, 1.0f, 1.0f);
+    Cloth c(WOOL);
+    c.init(grid, grid.corners(), 9.0f);
+    c.fixCorners({1, 1, 0, 0});
+    c.setWind(WindField(ngl::Vec3(0.0f, 0.0f, 4.0f)));
+    c.addForceField(std::make_shared<SparseForces>(std::vector<size_t>{24}, ngl::Vec3(0.0f, 0.0f, 1.0f)));
+    // stretch and set the cloth moving, so every kind of force is in play
+    std::vector<ngl::Vec3> pos, vel(c.numMasses());
+    for(size_t i = 0; i < c.numMasses(); ++i)
+    {
+        auto p = c.posAtPoint(i);
+        c.setPosAtPoint(i, ngl::Vec3(1.05f * p.m_x, 1.02f * p.m_y, 0.01f * std::sin(7.0f * p.m_x)));
+        vel[i] = ngl::Vec3(0.0f, 0.1f * p.m_x, 0.2f * p.m_y);
+        c.setVelAtPoint(i, vel[i]);
+    }
+    c.positions(pos);
+    std::vector<ngl::Vec3> externalf(c.numMasses(), ngl::Vec3(0.1f, 0.0f, 0.0f));
+    c.forceCalc(true, externalf, true);
+    // the forces and jacobians forceCalc puts on the masspoints
+    ClothForces forces;
+    c.evaluateForces(pos, vel, c.time(), true, externalf, true, forces);
+    float scale = 0.0f;
+    for(size_t i = 0; i < c.numMasses(); ++i)
+    {
+        scale = std::max(scale, c.forcesAtPoint(i).length());
+    }
+    for(size_t i = 0; i < c.numMasses(); ++i)
+    {
+        EXPECT_TRUE((forces.forces[i] - c.forcesAtPoint(i)).length() <= 1e-5f * scale);
+        EXPECT_TRUE(c.posAtPoint(i) == pos[i]);
+    }
+    auto diagonal = forces.jacobian(24, 24);
+    EXPECT_TRUE(diagonal.m_00 < 0.0f);
+    EXPECT_TRUE(forces.jacobian(0, 48).m_00 == 0.0f);
+    // a trial state leaves the cloth where it was, and the same state from two threads at once
+    // gives the same forces
+    std::vector<ngl::Vec3> trial(pos);
+    trial[24] += ngl::Vec3(0.002f, 0.0f, 0.0f);
+    ClothForces first, second;
+    std::thread other([&]() { c.evaluateForces(trial, vel, c.time(), true, externalf, false, second); });
+    c.evaluateForces(trial, vel, c.time(), true, externalf, false, first);
+    other.join();
+    EXPECT_TRUE(first.forces == second.forces);
+    EXPECT_TRUE((first.forces[24] - forces.forces[24]).length() > 1e-3f);
+    EXPECT_TRUE(c.posAtPoint(24) == pos[24]);
+    // the jacobian predicts the change in force for a small stretch
+    auto predicted = forces.forces[24] + (diagonal * ngl::Vec3(0.002f, 0.0f, 0.0f));
+    EXPECT_TRUE((first.forces[24] - predicted).length() < 0.2f * (first.forces[24] - forces.forces[24]).length());
+}
+
+TEST(Cloth,imex)
+{
+    ClothGrid grid(17, 17, PLANE_XY, 1.0f, 1.0f);
+    Cloth start(WOOL);
+    start.init(grid, grid.corners(), 9.0f);
+    start.fixCorners({0, 0, 1, 1});
+    // only shear is explicit, and the damping in the system holds it well past what an explicit
+    // method manages with weft and warp as well
+    EXPECT_TRUE(start.stableTimestep(IMEX) > 0.01f);
+    EXPECT_TRUE(start.stableTimestep(IMEX) > start.stableTimestep(SYMPLECTIC_EULER));
+    // it hangs the way CGM does at the usual step
+    Cloth cgm = start;
+    Cloth imex = start;
+    for(size_t i = 0; i < 100; ++i)
+    {
+        cgm.update(0.01f, CGM, true);
+        imex.update(0.01f, IMEX, true);
+    }
+    float furthest = 0.0f;
+    float moved = 0.0f;
+    for(size_t i = 0; i < imex.numMasses(); ++i)
+    {
+        EXPECT_TRUE(std::isfinite(imex.posAtPoint(i).length()));
+        furthest = std::max(furthest, (imex.posAtPoint(i) - cgm.posAtPoint(i)).length());
+        moved = std::max(moved, (imex.posAtPoint(i) - start.posAtPoint(i)).length());
+    }
+    EXPECT_TRUE(moved > 1e-3f);
+    EXPECT_TRUE(furthest < 0.5f * moved);
+    // and the scene keyword picks it
+    auto filename = (std::filesystem::temp_directory_path() / "gnatvClothImex.scene").string();
+    {
+        std::ofstream out(filename);
+        out << "grid 5 5\nintegrator imex\n";
+    }
+    SceneDescription scene;
+    std::string error;
+    EXPECT_TRUE(scene.load(filename, error));
+    EXPECT_TRUE(scene.integrator == IMEX);
+    std::remove(filename.c_str());
+}
+
+TEST(Cloth,jacobianReuse)
+{
+    ClothGrid grid(9, 9, PLANE_XY, 1.0f, 1.0f);
+    Cloth start(WOOL);
+    start.init(grid, grid.corners(), 9.0f);
+    start.fixCorners({0, 0, 1, 1});
+    EXPECT_FALSE(start.jacobianReuse());
+    // a cloth at rest keeps the system it built on the first step
+    Cloth still = start;
+    still.setJacobianReuse(true);
+    for(size_t i = 0; i < 10; ++i)
+    {
+        still.update(0.01f, CGM, false);
+    }
+    EXPECT_EQ(still.jacobianReuseStats().rebuilt, 1u);
+    EXPECT_EQ(still.jacobianReuseStats().reused, 9u);
+    EXPECT_NEAR(still.jacobianReuseStats().reuseRatio(), 0.9, 1e-6);
+    // a new step size needs a new system
+    still.update(0.005f, CGM, false);
+    EXPECT_EQ(still.jacobianReuseStats().rebuilt, 2u);
+    // a falling cloth keeps rebuilding, and hangs where it does without reuse
+    Cloth fresh = start;
+    Cloth kept = start;
+    kept.setJacobianReuse(true);
+    for(size_t i = 0; i < 50; ++i)
+    {
+        fresh.update(0.01f, CGM, true);
+        kept.update(0.01f, CGM, true);
+    }
+    auto &stats = kept.jacobianReuseStats();
+    EXPECT_EQ(stats.rebuilt + stats.reused, 50u);
+    EXPECT_TRUE(stats.rebuilt > 1);
+    EXPECT_EQ(fresh.jacobianReuseStats().rebuilt + fresh.jacobianReuseStats().reused, 0u);
+    float furthest = 0.0f;
+    float moved = 0.0f;
+    for(size_t i = 0; i < kept.numMasses(); ++i)
+    {
+        EXPECT_TRUE(std::isfinite(kept.posAtPoint(i).length()));
+        furthest = std::max(furthest, (kept.posAtPoint(i) - fresh.posAtPoint(i)).length());
+        moved = std::max(moved, (fresh.posAtPoint(i) - start.posAtPoint(i)).length());
+    }
+    EXPECT_TRUE(moved > 1e-4f);
+    EXPECT_TRUE(furthest < 0.5f * moved);
+}
@@ -1,9 +1,34 @@
 TARGET=test
+CONFIG+=c++17
+
+# vertex normals are computed in parallel with OpenMP
+linux:QMAKE_CXXFLAGS+= -fopenmp
+linux:LIBS+= -fopenmp
+
+# scoped phase timers (see Profiler.h), build with CONFIG+=profiling to record them
+profiling:DEFINES+= GNATV_PROFILING
+
 SOURCES+= main.cpp \
           ../gnatvCloth/src/Cloth.cpp \
           ../gnatvCloth/src/MassPoint.cpp \
           ../gnatvCloth/src/Triangle.cpp \
-          ../gnatvCloth/src/ClothInterface.cpp
+          ../gnatvCloth/src/ClothInterface.cpp \
+          ../gnatvCloth/src/MeshCache.cpp \
+          ../gnatvCloth/src/ObjSequenceWriter.cpp \
+          ../gnatvCloth/src/PointCache.cpp \
+          ../gnatvCloth/src/ClothRenderMesh.cpp \
+          ../gnatvCloth/src/SceneDescription.cpp \
+          ../gnatvCloth/src/ClothGrid.cpp \
+          ../gnatvCloth/src/Profiler.cpp \
+          ../gnatvCloth/src/SolverTelemetry.cpp \
+          ../gnatvCloth/src/WindField.cpp \
+          ../gnatvCloth/src/ForceField.cpp \
+          ../gnatvCloth/src/ClothEnsemble.cpp \
+          ../gnatvCloth/src/ForceDisplacementTest.cpp \
+          ../gnatvCloth/src/MaterialCalibration.cpp \
+          ../gnatvCloth/src/SelfCollision.cpp \
+          ../gnatvCloth/src/Obstacle.cpp \
+          ../gnatvCloth/src/ClothDrag.cpp
 
 LIBS+= -lgtest
 INCLUDEPATH+= ../gnatvCloth/include